@@ -0,0 +1,126 @@
+// A microbenchmark for allocations that miss the thread's freelists.
+//
+// Every ComputeThread allocates --num-ops fresh objects of one small size
+// class, so every allocation goes to the RDMA heap.  With --alloc-chunk-size 0
+// each allocation costs a remote FAA and two remote header writes; otherwise
+// the thread reserves a chunk at a time and carves objects out of it locally.
+// Run it once each way to compare.  The heap must have room for 64 bytes per
+// allocation (plus one partly-used chunk per thread), so size --num-ops and
+// --seg-size to match, e.g.:
+//
+//   ./alloc_bench --node-id 0 --first-mn-id 0 --last-mn-id 0 --first-cn-id 0
+//                 --last-cn-id 0 --mn-port 33330 --cn-threads 1
+//                 --num-ops 16384 --alloc-chunk-size 0
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "bench_cfg.h"
+#include "cloudlab.h"
+
+/// The object that every allocation is for (one 64-byte size class with its
+/// header)
+struct object_t {
+  uint64_t words[6];
+};
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->import(BENCH_ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+  uint64_t num_ops = args->uget(NUM_OPS);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < args->uget(remus::CN_THREADS); ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+
+    uint64_t total_threads = (cn - c0 + 1) * args->uget(remus::CN_THREADS);
+    std::atomic<uint64_t> node_total(0);
+    std::vector<std::thread> worker_threads;
+    for (auto &t : compute_threads) {
+      worker_threads.push_back(std::thread([&, t]() {
+        t->pin();
+        std::vector<remus::rdma_ptr<object_t>> ptrs;
+        ptrs.reserve(num_ops);
+        t->arrive_control_barrier(total_threads);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < num_ops; ++i) {
+          ptrs.push_back(t->allocate<object_t>());
+        }
+        std::chrono::duration<double> secs =
+            std::chrono::steady_clock::now() - start;
+        t->arrive_control_barrier(total_threads);
+
+        auto throughput = num_ops / secs.count();
+        REMUS_INFO("Thread {}: {:.0f} allocations/s (chunk size {})",
+                   t->get_tid(), throughput,
+                   args->uget(remus::ALLOC_CHUNK_SIZE));
+        node_total += (uint64_t)throughput;
+        for (auto p : ptrs) {
+          t->deallocate(p);
+        }
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+    REMUS_INFO("Node {}: {} allocations/s", id, node_total.load());
+  }
+}
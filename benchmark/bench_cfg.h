@@ -0,0 +1,34 @@
+#pragma once
+
+#include <remus/cli.h>
+
+/// The number of timed operations each thread performs
+constexpr const char *NUM_OPS = "--num-ops";
+
+/// The number of untimed operations each thread performs before timing
+constexpr const char *WARMUP_OPS = "--warmup-ops";
+
+/// The number of keys that the YCSB driver loads into its HashMap
+constexpr const char *YCSB_KEYS = "--ycsb-keys";
+
+/// The skew of the YCSB driver's Zipfian key distribution
+constexpr const char *ZIPF_THETA = "--zipf-theta";
+
+/// Make the YCSB driver store values out of place
+constexpr const char *LARGE_VALUES = "--large-values";
+
+/// Command-line options shared by the benchmarks
+auto BENCH_ARGS = {
+    remus::U64_ARG_OPT(NUM_OPS, "Number of timed operations per thread",
+                       1 << 20),
+    remus::U64_ARG_OPT(WARMUP_OPS, "Number of untimed operations per thread",
+                       1 << 14),
+    remus::U64_ARG_OPT(YCSB_KEYS, "Number of keys in the YCSB HashMap",
+                       1 << 16),
+    remus::F64_ARG_OPT(ZIPF_THETA,
+                       "Zipfian skew of YCSB keys, in [0, 1) (0 is uniform)",
+                       0.99),
+    remus::BOOL_ARG_OPT(LARGE_VALUES,
+                        "Use 64-byte YCSB values, which are stored out of "
+                        "place"),
+};
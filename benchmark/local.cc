@@ -0,0 +1,171 @@
+// A microbenchmark for operations on memory of a co-located memory node.
+//
+// Every ComputeThread repeatedly reads, writes, CASes, and FAAs its own word
+// (and writes a multi-line object), first through the loopback QPs
+// (local_copy = false) and then through the local fast path, which uses the
+// CPU instead.  Both loops run in the same binary, so the difference is only
+// the cost of going through the RNIC.  Local CAS and FAA fall back to the
+// loopback QPs unless the RNIC's atomics are coherent with the CPU's.
+//
+// The memory node must be the compute node, e.g.:
+//
+//   ./local_bench --node-id 0 --first-mn-id 0 --last-mn-id 0 --first-cn-id 0
+//                 --last-cn-id 0 --mn-port 33330 --cn-threads 1
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "bench_cfg.h"
+#include "cloudlab.h"
+
+/// An object that spans several cache lines
+struct object_t {
+  uint64_t words[32];
+};
+
+/// Run `num_ops` iterations of `op`, and return the throughput in ops/sec
+template <typename F> double time_ops(uint64_t num_ops, F &&op) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < num_ops; ++i) {
+    op(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> secs = end - start;
+  return num_ops / secs.count();
+}
+
+/// Time every operation through the loopback QPs (local = false) or the local
+/// fast path (local = true), and return the throughput of each
+std::vector<double> time_all(std::shared_ptr<remus::ComputeThread> t,
+                             remus::rdma_ptr<uint64_t> word,
+                             remus::rdma_ptr<object_t> obj, uint64_t num_ops,
+                             bool local) {
+  object_t o{};
+  return {
+      time_ops(num_ops, [&](uint64_t) { t->Read(word, true, local); }),
+      time_ops(num_ops,
+               [&](uint64_t i) {
+                 t->Write(word, i, true, sizeof(uint64_t), local);
+               }),
+      time_ops(num_ops,
+               [&](uint64_t i) {
+                 t->CompareAndSwap(word, i, i + 1, true, local);
+               }),
+      time_ops(num_ops,
+               [&](uint64_t) { t->FetchAndAdd(word, 1, true, local); }),
+      time_ops(num_ops,
+               [&](uint64_t i) {
+                 o.words[0] = i;
+                 t->Write(obj, o, true, sizeof(object_t), local);
+               }),
+  };
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->import(BENCH_ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+  uint64_t num_ops = args->uget(NUM_OPS);
+  uint64_t warmup_ops = args->uget(WARMUP_OPS);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < args->uget(remus::CN_THREADS); ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    REMUS_ASSERT(memory_node, "Node {} must also be a memory node", id);
+    REMUS_INFO("Local atomics are {}",
+               compute_node->local_atomics() ? "on" : "off (loopback)");
+
+    const char *names[] = {"read", "write", "cas", "faa", "write-256B"};
+    uint64_t total_threads = (cn - c0 + 1) * args->uget(remus::CN_THREADS);
+    std::vector<std::thread> worker_threads;
+    for (auto &t : compute_threads) {
+      worker_threads.push_back(std::thread([&, t]() {
+        t->pin();
+        // NB: The default allocation policies may pick another memory node
+        auto word = t->allocate<uint64_t>();
+        auto obj = t->allocate<object_t>();
+        REMUS_ASSERT(t->is_local(word) && t->is_local(obj),
+                     "Allocated on another memory node; use one memory node");
+        t->Write(word, uint64_t(0));
+        t->arrive_control_barrier(total_threads);
+        time_all(t, word, obj, warmup_ops, false);
+        time_all(t, word, obj, warmup_ops, true);
+
+        t->arrive_control_barrier(total_threads);
+        auto loopback = time_all(t, word, obj, num_ops, false);
+        t->arrive_control_barrier(total_threads);
+        auto local = time_all(t, word, obj, num_ops, true);
+        t->arrive_control_barrier(total_threads);
+
+        for (size_t i = 0; i < loopback.size(); ++i) {
+          REMUS_INFO("Thread {}: {:<10} loopback {:.0f} ops/s, local {:.0f} "
+                     "ops/s ({:.1f}x)",
+                     t->get_tid(), names[i], loopback[i], local[i],
+                     local[i] / loopback[i]);
+        }
+        t->deallocate(obj);
+        t->deallocate(word);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+}
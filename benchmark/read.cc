@@ -0,0 +1,187 @@
+// A microbenchmark for the latency-bound path of small, synchronous Reads.
+//
+// Every ComputeThread repeatedly reads the same 8-byte word, first the way
+// Read() used to issue work requests (a fresh, reference-counted ibv_send_wr
+// and ibv_sge per operation) and then through the pooled work requests that
+// ComputeThread now uses.  Both loops run in the same binary, against the same
+// connections, so the difference is only the cost of building the request.
+//
+// For a single-machine run over soft-RoCE (rxe) loopback, make node 0 both the
+// only memory node and the only compute node, e.g.:
+//
+//   ./read_bench --node-id 0 --first-mn-id 0 --last-mn-id 0 --first-cn-id 0
+//                --last-cn-id 0 --mn-port 33330 --cn-threads 1
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "bench_cfg.h"
+#include "cloudlab.h"
+
+/// @brief A ComputeThread that can also issue Reads the old way
+/// @details
+/// ReadBaseline() reproduces the per-operation cost of the previous Read():
+/// two make_shared allocations, and shared_ptr copies (and thus atomic
+/// reference count updates) for every helper that the request was passed to.
+class BaselineComputeThread : public remus::ComputeThread {
+  /// The old calling convention: shared_ptrs, passed by value
+  template <typename T>
+  static void config_baseline(std::shared_ptr<ibv_send_wr> send_wr,
+                              std::shared_ptr<ibv_sge> sge,
+                              remus::rdma_ptr<T> ptr, uint8_t *seg,
+                              int32_t rkey, int32_t lkey,
+                              std::atomic<int> *ack) {
+    remus::internal::ReadConfig(*send_wr, *sge, ptr, seg, rkey, lkey, ack,
+                                sizeof(T), true, true);
+  }
+
+  /// The old calling convention: shared_ptrs, passed by value
+  static void post_baseline(std::shared_ptr<ibv_send_wr> send_wr,
+                            remus::internal::Connection *conn,
+                            std::atomic<int> *ack) {
+    remus::internal::Post(*send_wr, conn, ack);
+  }
+
+public:
+  using ComputeThread::ComputeThread;
+
+  /// @brief Read a fixed-sized object, allocating a fresh work request
+  /// @tparam T The type of the object to read
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @return The object read from the RDMA heap
+  template <typename T> T ReadBaseline(remus::rdma_ptr<T> ptr) {
+    auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
+    auto rkey = compute_node_->get_rkey(ptr.raw());
+    auto op = op_counter_t(this);
+    auto staging_buf = staging_buf_t(this, sizeof(T), alignof(T));
+    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
+    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
+    config_baseline(send_wr, sge, ptr, staging_buf.val(), rkey, ci.lkey_,
+                    op.val());
+    post_baseline(send_wr, ci.conn_.get(), op.val());
+    remus::internal::Poll(ci.conn_.get(), op.val(), ptr);
+    return *(T *)staging_buf.val();
+  }
+};
+
+/// Run `num_ops` iterations of `op`, and return the throughput in ops/sec
+template <typename F> double time_ops(uint64_t num_ops, F &&op) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < num_ops; ++i) {
+    op();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> secs = end - start;
+  return num_ops / secs.count();
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->import(BENCH_ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+  uint64_t num_ops = args->uget(NUM_OPS);
+  uint64_t warmup_ops = args->uget(WARMUP_OPS);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<BaselineComputeThread>> compute_threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < args->uget(remus::CN_THREADS); ++i) {
+      compute_threads.push_back(
+          std::make_shared<BaselineComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the word that everyone reads
+    if (id == c0) {
+      auto ptr = compute_threads[0]->allocate<uint64_t>();
+      compute_threads[0]->Write<uint64_t>(ptr, 42);
+      compute_threads[0]->set_root(ptr);
+    }
+
+    uint64_t total_threads = (cn - c0 + 1) * args->uget(remus::CN_THREADS);
+    std::atomic<uint64_t> baseline_total(0), pooled_total(0);
+    std::vector<std::thread> worker_threads;
+    for (auto &t : compute_threads) {
+      worker_threads.push_back(std::thread([&, t]() {
+        t->pin();
+        t->arrive_control_barrier(total_threads);
+        auto root = t->get_root<uint64_t>();
+        for (uint64_t i = 0; i < warmup_ops; ++i) {
+          REMUS_ASSERT(t->Read(root) == 42, "Read returned the wrong value");
+        }
+
+        t->arrive_control_barrier(total_threads);
+        auto baseline =
+            time_ops(num_ops, [&]() { return t->ReadBaseline(root); });
+        t->arrive_control_barrier(total_threads);
+        auto pooled = time_ops(num_ops, [&]() { return t->Read(root); });
+        t->arrive_control_barrier(total_threads);
+
+        REMUS_INFO("Thread {}: baseline {:.0f} ops/s, pooled {:.0f} ops/s "
+                   "({:+.1f}%)",
+                   t->get_tid(), baseline, pooled,
+                   100.0 * (pooled - baseline) / baseline);
+        baseline_total += (uint64_t)baseline;
+        pooled_total += (uint64_t)pooled;
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+    REMUS_INFO("Node {}: baseline {} ops/s, pooled {} ops/s", id,
+               baseline_total.load(), pooled_total.load());
+  }
+}
@@ -0,0 +1,119 @@
+// A standalone microbenchmark for the staging-buffer ring allocators.
+//
+// Each round acquires a window of small buffers and then releases them, either
+// in the order they were acquired, in reverse order, or in a random order.
+// Rounds are repeated until --num-ops buffers have been acquired and released,
+// first with ring_buf_t (which tracks allocations in an unordered_map) and then
+// with flat_ring_buf_t (which ComputeThread uses).  No RDMA is involved, so
+// this runs on any machine, e.g.:
+//
+//   ./ring_bench --num-ops 4194304
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <remus/cli.h>
+#include <remus/logging.h>
+#include <remus/ring.h>
+
+#include "bench_cfg.h"
+
+/// The size of the byte range that each ring manages (as in a ComputeThread
+/// with the default --cn-thread-bufsz)
+constexpr size_t kRingBytes = 1 << 19;
+
+/// The size and alignment of every buffer (as for a Read of a uint64_t)
+constexpr size_t kBufSize = 8;
+
+/// A way of ordering the releases in a round
+enum class Pattern { IN_ORDER, REVERSED, RANDOM };
+
+/// Produce the order in which a window of buffers is released
+std::vector<size_t> release_order(Pattern p, size_t window, std::mt19937 &rng) {
+  std::vector<size_t> order(window);
+  std::iota(order.begin(), order.end(), 0);
+  if (p == Pattern::REVERSED) {
+    std::reverse(order.begin(), order.end());
+  } else if (p == Pattern::RANDOM) {
+    std::shuffle(order.begin(), order.end(), rng);
+  }
+  return order;
+}
+
+/// Time num_ops acquire/release pairs on ring_buf_t, and return ns/op
+double bench_map_ring(uint8_t *range, uint64_t num_ops, size_t window,
+                      const std::vector<size_t> &order) {
+  std::unordered_map<uint8_t *, remus::ring_buf_t::buf_allocation_t> allocs;
+  uint8_t *start = range, *end = range;
+  std::vector<uint8_t *> bufs(window);
+  auto begin = std::chrono::steady_clock::now();
+  for (uint64_t done = 0; done < num_ops; done += window) {
+    for (size_t i = 0; i < window; ++i) {
+      bufs[i] = remus::ring_buf_t::acquire(range, end, start, kRingBytes,
+                                           allocs, kBufSize, kBufSize);
+      REMUS_ASSERT(bufs[i] != nullptr, "ring_buf_t ran out of space");
+    }
+    for (auto i : order) {
+      remus::ring_buf_t::release(bufs[i], allocs, start, range, kRingBytes);
+    }
+  }
+  std::chrono::duration<double, std::nano> ns =
+      std::chrono::steady_clock::now() - begin;
+  return ns.count() / num_ops;
+}
+
+/// Time num_ops acquire/release pairs on flat_ring_buf_t, and return ns/op
+double bench_flat_ring(uint8_t *range, uint64_t num_ops, size_t window,
+                       const std::vector<size_t> &order) {
+  remus::flat_ring_buf_t ring(range, kRingBytes, window);
+  std::vector<uint64_t> idxs(window);
+  auto begin = std::chrono::steady_clock::now();
+  for (uint64_t done = 0; done < num_ops; done += window) {
+    for (size_t i = 0; i < window; ++i) {
+      auto res = ring.acquire(kBufSize, kBufSize);
+      REMUS_ASSERT(res.buf_ != nullptr, "flat_ring_buf_t ran out of space");
+      idxs[i] = res.idx_;
+    }
+    for (auto i : order) {
+      ring.release(idxs[i]);
+    }
+  }
+  std::chrono::duration<double, std::nano> ns =
+      std::chrono::steady_clock::now() - begin;
+  return ns.count() / num_ops;
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(BENCH_ARGS);
+  args->parse(argc, argv);
+  uint64_t num_ops = args->uget(NUM_OPS);
+  uint64_t warmup_ops = args->uget(WARMUP_OPS);
+
+  auto range = std::make_unique<uint8_t[]>(kRingBytes);
+  std::mt19937 rng(0);
+  const std::pair<Pattern, std::string> patterns[] = {
+      {Pattern::IN_ORDER, "in-order"},
+      {Pattern::REVERSED, "reversed"},
+      {Pattern::RANDOM, "random"}};
+  for (auto &[pattern, name] : patterns) {
+    for (size_t window : {1, 8, 64, 256}) {
+      auto order = release_order(pattern, window, rng);
+      bench_map_ring(range.get(), warmup_ops, window, order);
+      auto map_ns = bench_map_ring(range.get(), num_ops, window, order);
+      bench_flat_ring(range.get(), warmup_ops, window, order);
+      auto flat_ns = bench_flat_ring(range.get(), num_ops, window, order);
+      REMUS_INFO("{:>8} window {:>3}: ring_buf_t {:6.1f} ns/op, "
+                 "flat_ring_buf_t {:6.1f} ns/op ({:.1f}x)",
+                 name, window, map_ns, flat_ns, map_ns / flat_ns);
+    }
+  }
+}
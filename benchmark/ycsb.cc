@@ -0,0 +1,278 @@
+// A YCSB-style driver for remus::HashMap.
+//
+// The first compute node makes a HashMap with one partition per Segment, and
+// then every ComputeThread inserts its share of --ycsb-keys keys.  Next, each
+// thread runs two mixes over Zipfian-distributed keys (--zipf-theta):
+// - YCSB-B: 95% lookups, 5% updates (read-heavy)
+// - YCSB-A: 50% lookups, 50% updates (update-heavy)
+// Every thread reports its throughput, and each node reports the total
+// throughput and the latency percentiles of lookups and updates.
+//
+// With --large-values, values are 64 bytes, so they are stored out of place
+// and a lookup takes two reads.  Each update then allocates a new value, and
+// the old ones are only reclaimed between mixes, so the heap needs room for
+// 80 bytes per update (e.g., raise --seg-size).
+//
+// For a single-machine run over soft-RoCE (rxe) loopback, make node 0 both the
+// only memory node and the only compute node, e.g.:
+//
+//   ./ycsb_bench --node-id 0 --first-mn-id 0 --last-mn-id 0 --first-cn-id 0
+//                --last-cn-id 0 --mn-port 33330 --cn-threads 4
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/hash_map.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/metrics.h>
+#include <remus/util.h>
+
+#include "bench_cfg.h"
+#include "cloudlab.h"
+
+/// A value that is too big to store in a slot
+using large_t = std::array<uint64_t, 8>;
+
+/// @brief The Zipfian generator from YCSB (Gray et al., "Quickly Generating
+/// Billion-Record Synthetic Databases")
+/// @details
+/// Rank 0 is the most popular key.  The constants take O(n) time to compute,
+/// so make one zipf_t and share it among threads; each thread passes its own
+/// random number generator to next().
+class zipf_t {
+  uint64_t n_;   // The number of keys
+  double theta_; // The skew
+  double alpha_; // 1 / (1 - theta)
+  double zetan_; // The sum of 1 / i^theta, for i in [1, n]
+  double eta_;   // A constant of the inversion
+
+public:
+  zipf_t(uint64_t n, double theta) : n_(n), theta_(theta) {
+    REMUS_ASSERT(n > 0, "Zipf needs at least one key");
+    REMUS_ASSERT(theta >= 0 && theta < 1, "Zipf theta must be in [0, 1)");
+    double zeta2 = 1 + std::pow(0.5, theta);
+    zetan_ = 0;
+    for (uint64_t i = 1; i <= n; ++i) {
+      zetan_ += 1 / std::pow((double)i, theta);
+    }
+    alpha_ = 1 / (1 - theta);
+    eta_ = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan_);
+  }
+
+  /// Pick the rank of a key
+  uint64_t next(std::mt19937_64 &rng) const {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    double uz = u * zetan_;
+    if (uz < 1) {
+      return 0;
+    }
+    if (uz < 1 + std::pow(0.5, theta_)) {
+      return std::min<uint64_t>(1, n_ - 1);
+    }
+    uint64_t r = n_ * std::pow(eta_ * u - eta_ + 1, alpha_);
+    return std::min(r, n_ - 1);
+  }
+};
+
+/// The results of one mix, summed over a node's threads
+struct results_t {
+  std::mutex lock_;               // Protects the other fields
+  double throughput_ = 0;         // Total ops/s
+  remus::histogram_t get_lat_;    // Lookup latencies, in ticks
+  remus::histogram_t update_lat_; // Update latencies, in ticks
+};
+
+/// Report one node's results for a mix
+void report(uint64_t id, const char *name, results_t &r) {
+  auto us = [](const remus::histogram_t &h, double q) {
+    return h.percentile(q) / remus::internal::tsc_per_ns() / 1000;
+  };
+  REMUS_INFO("Node {}: {} {:.0f} ops/s", id, name, r.throughput_);
+  REMUS_INFO("  get:    p50 {:.2f}us, p99 {:.2f}us, p99.9 {:.2f}us ({} ops)",
+             us(r.get_lat_, 0.5), us(r.get_lat_, 0.99),
+             us(r.get_lat_, 0.999), r.get_lat_.count());
+  REMUS_INFO("  update: p50 {:.2f}us, p99 {:.2f}us, p99.9 {:.2f}us ({} ops)",
+             us(r.update_lat_, 0.5), us(r.update_lat_, 0.99),
+             us(r.update_lat_, 0.999), r.update_lat_.count());
+}
+
+/// Make the value that an update of `key` writes
+template <typename V> V make_value(uint64_t key) {
+  V v{};
+  std::memcpy(&v, &key, sizeof(key));
+  return v;
+}
+
+/// Run the load phase and both mixes on one thread, on the map whose (raw)
+/// directory is `dir`
+template <typename V>
+void run(std::shared_ptr<remus::ComputeThread> t, uint64_t dir,
+         const zipf_t &zipf, uint64_t uid, uint64_t total_threads,
+         uint64_t keys, uint64_t num_ops, uint64_t warmup_ops,
+         results_t (&results)[2]) {
+  using map_t = remus::HashMap<uint64_t, V>;
+  map_t map(t.get(), remus::rdma_ptr<typename map_t::dir_t>(dir));
+  for (uint64_t k = uid; k < keys; k += total_threads) {
+    map.Insert(k, make_value<V>(k));
+  }
+  t->arrive_control_barrier(total_threads);
+
+  std::mt19937_64 rng(uid + 1);
+  const uint64_t read_pct[2] = {95, 50};
+  for (int w = 0; w < 2; ++w) {
+    // One operation of the mix, with its latency recorded in `get` or
+    // `update`
+    auto op = [&](remus::histogram_t *get, remus::histogram_t *update) {
+      uint64_t key = zipf.next(rng);
+      bool is_get = rng() % 100 < read_pct[w];
+      uint64_t start = __rdtsc();
+      if (is_get) {
+        REMUS_ASSERT(map.Get(key).has_value(), "Key {} is missing", key);
+      } else {
+        REMUS_ASSERT(map.Update(key, make_value<V>(key)),
+                     "Key {} is missing", key);
+      }
+      uint64_t ticks = __rdtsc() - start;
+      if (get != nullptr) {
+        (is_get ? get : update)->record(ticks);
+      }
+    };
+    for (uint64_t i = 0; i < warmup_ops; ++i) {
+      op(nullptr, nullptr);
+    }
+    remus::histogram_t get_lat, update_lat;
+    t->arrive_control_barrier(total_threads);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < num_ops; ++i) {
+      op(&get_lat, &update_lat);
+    }
+    std::chrono::duration<double> secs =
+        std::chrono::steady_clock::now() - start;
+    t->arrive_control_barrier(total_threads);
+    // No lookup can still be reading a replaced value
+    t->ReclaimDeferred();
+
+    auto throughput = num_ops / secs.count();
+    REMUS_INFO("Thread {}: {} {:.0f} ops/s", t->get_tid(),
+               w == 0 ? "YCSB-B" : "YCSB-A", throughput);
+    std::lock_guard<std::mutex> guard(results[w].lock_);
+    results[w].throughput_ += throughput;
+    results[w].get_lat_.merge(get_lat);
+    results[w].update_lat_.merge(update_lat);
+  }
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->import(BENCH_ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+  uint64_t num_ops = args->uget(NUM_OPS);
+  uint64_t warmup_ops = args->uget(WARMUP_OPS);
+  uint64_t keys = args->uget(YCSB_KEYS);
+  bool large = args->bget(LARGE_VALUES);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < args->uget(remus::CN_THREADS); ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the map, with one partition per Segment
+    if (id == c0) {
+      auto &t = compute_threads[0];
+      uint64_t parts = std::min<uint64_t>(
+          (mn - m0 + 1) * args->uget(remus::SEGS_PER_MN),
+          remus::HashMap<uint64_t, uint64_t>::kMaxParts);
+      auto dir = large ? remus::HashMap<uint64_t, large_t>::New(t.get(), keys,
+                                                                parts)
+                             .raw()
+                       : remus::HashMap<uint64_t, uint64_t>::New(t.get(), keys,
+                                                                 parts)
+                             .raw();
+      t->set_root(remus::rdma_ptr<uint64_t>(dir));
+    }
+
+    zipf_t zipf(keys, args->fget(ZIPF_THETA));
+    uint64_t threads = args->uget(remus::CN_THREADS);
+    uint64_t total_threads = (cn - c0 + 1) * threads;
+    results_t results[2];
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        t->pin();
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        auto dir = t->get_root<uint64_t>().raw();
+        if (large) {
+          run<large_t>(t, dir, zipf, uid, total_threads, keys, num_ops,
+                       warmup_ops, results);
+        } else {
+          run<uint64_t>(t, dir, zipf, uid, total_threads, keys, num_ops,
+                        warmup_ops, results);
+        }
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+    report(id, "YCSB-B (95% get)", results[0]);
+    report(id, "YCSB-A (50% get)", results[1]);
+  }
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace remus {
+
+/// @brief The levels of log messages, in increasing order of importance
+enum LogLevel : int {
+  LOG_DEBUG = 0, // Diagnostics (compiled out unless REMUS_LOG_LEVEL is DEBUG)
+  LOG_INFO = 1,  // Progress and configuration reports
+  LOG_NONE = 2,  // Nothing (as a threshold, disables DEBUG and INFO)
+};
+
+namespace internal {
+
+/// The messages below this level are skipped (see set_log_level())
+inline std::atomic<int> log_level_{LOG_DEBUG};
+
+/// The most messages per second from one call site (0 for no limit)
+inline std::atomic<uint64_t> log_rate_limit_{0};
+
+/// @brief A place in the code that logs, and its rate-limiting state
+/// @details
+/// Each REMUS_DEBUG/REMUS_INFO has a static log_site_t.  Its address is the
+/// message's id in the log rings, so the hot path never copies the file name.
+struct log_site_t {
+  const int level_;                      // The level of the messages
+  const char *const fmt_;                // The format string (a literal)
+  const char *const file_;               // Where the call site is
+  const uint32_t line_;                  // Where the call site is
+  std::atomic<uint64_t> window_{0};      // The second that count_ is for
+  std::atomic<uint64_t> count_{0};       // The messages logged in window_
+  std::atomic<uint64_t> suppressed_{0};  // The messages dropped by the limit
+  std::atomic<bool> registered_{false};  // Is it in the logger's site list?
+
+  log_site_t(int level, const char *fmt, const char *file, uint32_t line)
+      : level_(level), fmt_(fmt), file_(file), line_(line) {}
+
+  /// Report if the rate limit allows another message now
+  bool admit() {
+    uint64_t limit = log_rate_limit_.load(std::memory_order_relaxed);
+    if (limit == 0) {
+      return true;
+    }
+    uint64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+    // NB: Two threads may both reset the window; that only loosens the limit
+    if (window_.load(std::memory_order_relaxed) != now) {
+      window_.store(now, std::memory_order_relaxed);
+      count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < limit) {
+      return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+};
+
+/// @brief How one type of log argument is copied into a log ring, and back
+/// @details
+/// Trivially copyable values are copied as bytes, and formatted later.  Strings
+/// (including C strings) are copied by content, since they may not outlive the
+/// call.  Any other type is not encodable, so its message is formatted on the
+/// spot instead.
+///
+/// NB: A trivially copyable type whose formatter reads memory that it points
+///     to would be formatted after that memory may have changed; pass such
+///     values as strings.
+template <typename T> struct log_arg {
+  static constexpr bool kEncodable =
+      std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
+  using decoded_t = T;
+  static uint64_t size(const T &) { return sizeof(T); }
+  static void put(uint8_t *&p, const T &v) {
+    std::memcpy(p, &v, sizeof(T));
+    p += sizeof(T);
+  }
+  static T get(const uint8_t *&p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+  }
+};
+
+/// @brief Strings are copied into the log ring as a length and their bytes
+struct log_str_arg {
+  static constexpr bool kEncodable = true;
+  using decoded_t = std::string;
+  static uint64_t size(std::string_view v) {
+    return sizeof(uint32_t) + v.size();
+  }
+  static void put(uint8_t *&p, std::string_view v) {
+    uint32_t len = v.size();
+    std::memcpy(p, &len, sizeof(len));
+    std::memcpy(p + sizeof(len), v.data(), len);
+    p += sizeof(len) + len;
+  }
+  static std::string get(const uint8_t *&p) {
+    uint32_t len;
+    std::memcpy(&len, p, sizeof(len));
+    std::string v((const char *)p + sizeof(len), len);
+    p += sizeof(len) + len;
+    return v;
+  }
+};
+template <> struct log_arg<const char *> : log_str_arg {};
+template <> struct log_arg<char *> : log_str_arg {};
+template <> struct log_arg<std::string> : log_str_arg {};
+template <> struct log_arg<std::string_view> : log_str_arg {};
+
+/// Rebuild the arguments of a message from a log ring, and format it
+///
+/// @param fmt  The format string
+/// @param args The encoded arguments
+/// @return The formatted message
+template <typename... Args>
+std::string log_decode(std::string_view fmt,
+                       [[maybe_unused]] const uint8_t *args) {
+  // NB: Braced initialization evaluates the get()s in order
+  std::tuple<typename log_arg<Args>::decoded_t...> vals{
+      log_arg<Args>::get(args)...};
+  return std::apply(
+      [&](auto &...v) {
+        return std::vformat(fmt, std::make_format_args(v...));
+      },
+      vals);
+}
+
+/// "Decode" a message that was formatted before it was logged
+inline std::string log_decode_formatted(std::string_view,
+                                        const uint8_t *args) {
+  return log_str_arg::get(args);
+}
+
+/// @brief The header of one message in a log ring.  The encoded arguments
+/// follow it.
+struct log_entry_t {
+  uint64_t bytes_;          // The size of the entry, including this header
+  const log_site_t *site_;  // The call site (nullptr for padding)
+  std::string (*decode_)(std::string_view, const uint8_t *); // Its formatter
+};
+
+/// @brief A single-producer, single-consumer ring of log messages, owned by
+/// one thread
+/// @details
+/// The owning thread appends without locks or system calls.  When the ring is
+/// full, messages are dropped (and counted), rather than making the hot path
+/// wait for the writer.
+struct log_ring_t {
+  static constexpr uint64_t kSize = 1 << 16;   // The bytes in the ring
+  static constexpr uint64_t kMaxEntry = 4096;  // The largest entry
+
+  alignas(64) std::atomic<uint64_t> head_{0};  // Where the consumer reads
+  alignas(64) std::atomic<uint64_t> tail_{0};  // Where the producer writes
+  std::atomic<uint64_t> dropped_{0};           // Messages lost to a full ring
+  std::atomic<bool> orphaned_{false};          // Has the owner exited?
+  std::unique_ptr<uint8_t[]> buf_{new uint8_t[kSize]};
+
+  /// Reserve room for an entry, or return nullptr if the ring is full
+  uint8_t *reserve(uint64_t bytes) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t off = tail % kSize;
+    uint64_t pad = off + bytes > kSize ? kSize - off : 0;
+    if (tail + pad + bytes - head > kSize) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    if (pad > 0) {
+      // Entries don't wrap, so skip the end of the ring with a padding entry.
+      // NB: A tail too small for a header is skipped by the consumer anyway.
+      if (pad >= sizeof(log_entry_t)) {
+        log_entry_t e{pad, nullptr, nullptr};
+        std::memcpy(buf_.get() + off, &e, sizeof(e));
+      }
+      tail_.store(tail + pad, std::memory_order_release);
+      off = 0;
+    }
+    return buf_.get() + off;
+  }
+
+  /// Make a reserved entry visible to the consumer
+  void commit(uint64_t bytes) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + bytes,
+                std::memory_order_release);
+  }
+};
+
+/// @brief The asynchronous log backend: every thread's log ring, and the
+/// thread that formats and writes their messages
+/// @details
+/// The logger is never destroyed, so that threads (and static destructors)
+/// can log at any time.  At exit, it drains the rings, and from then on
+/// messages are written synchronously.
+class Logger {
+  std::mutex lock_;                               // Protects the lists
+  std::vector<std::shared_ptr<log_ring_t>> rings_; // Every thread's ring
+  std::vector<log_site_t *> sites_;               // Sites that have logged
+  std::mutex drain_lock_;                         // Only one consumer at once
+  std::atomic<bool> stopped_{false};              // Is the writer gone?
+  std::thread writer_;                            // Formats and writes
+
+  /// Format an entry (in its ring) into a line of output
+  static void format_entry(const log_entry_t &e, std::string &out) {
+    auto msg = e.decode_(e.site_->fmt_, (const uint8_t *)(&e + 1));
+    if (e.site_->level_ == LOG_DEBUG) {
+      out += std::format("[DEBUG] {} ({}:{})\n", msg, e.site_->file_,
+                         e.site_->line_);
+    } else {
+      out += std::format("[INFO] {}\n", msg);
+    }
+  }
+
+  /// Move every message out of every ring, and write them
+  ///
+  /// @return The number of messages written
+  uint64_t drain() {
+    std::lock_guard<std::mutex> guard(drain_lock_);
+    std::vector<std::shared_ptr<log_ring_t>> rings;
+    {
+      std::lock_guard<std::mutex> g(lock_);
+      rings = rings_;
+      // Forget rings whose threads exited, once they are empty
+      std::erase_if(rings_, [](auto &r) {
+        return r->orphaned_ && r->head_ == r->tail_;
+      });
+    }
+    std::string out;
+    uint64_t msgs = 0;
+    for (auto &r : rings) {
+      uint64_t head = r->head_.load(std::memory_order_relaxed);
+      uint64_t tail = r->tail_.load(std::memory_order_acquire);
+      while (head < tail) {
+        uint64_t off = head % log_ring_t::kSize;
+        if (log_ring_t::kSize - off < sizeof(log_entry_t)) {
+          head += log_ring_t::kSize - off; // A tail too small for a header
+          continue;
+        }
+        auto &e = *(const log_entry_t *)(r->buf_.get() + off);
+        if (e.site_ != nullptr) {
+          format_entry(e, out);
+          ++msgs;
+        }
+        head += e.bytes_;
+      }
+      r->head_.store(head, std::memory_order_release);
+      if (uint64_t d = r->dropped_.exchange(0)) {
+        out += std::format("[INFO] Log ring full: dropped {} messages\n", d);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> g(lock_);
+      for (auto s : sites_) {
+        if (uint64_t n = s->suppressed_.exchange(0)) {
+          out += std::format("[INFO] Rate limit: suppressed {} messages from "
+                             "{}:{}\n",
+                             n, s->file_, s->line_);
+        }
+      }
+    }
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      std::fflush(stdout);
+    }
+    return msgs;
+  }
+
+  /// The writer thread's loop
+  void run() {
+    while (!stopped_.load(std::memory_order_acquire)) {
+      if (drain() == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    }
+  }
+
+  Logger() {
+    writer_ = std::thread([this]() { run(); });
+    std::atexit([]() { instance().stop(); });
+  }
+
+public:
+  /// Return the logger, making it on first use
+  static Logger &instance() {
+    static Logger *logger = new Logger();
+    return *logger;
+  }
+
+  /// Report if messages are still written asynchronously
+  bool running() const { return !stopped_.load(std::memory_order_acquire); }
+
+  /// Return the calling thread's ring, making it on first use
+  log_ring_t &ring() {
+    /// @brief Marks a thread's ring as orphaned when the thread exits
+    struct holder_t {
+      std::shared_ptr<log_ring_t> ring_;
+      ~holder_t() {
+        if (ring_) {
+          ring_->orphaned_ = true;
+        }
+      }
+    };
+    thread_local holder_t holder;
+    if (!holder.ring_) {
+      holder.ring_ = std::make_shared<log_ring_t>();
+      std::lock_guard<std::mutex> g(lock_);
+      rings_.push_back(holder.ring_);
+    }
+    return *holder.ring_;
+  }
+
+  /// Remember a call site, so that its suppressed messages get reported
+  void add_site(log_site_t *site) {
+    if (!site->registered_.exchange(true)) {
+      std::lock_guard<std::mutex> g(lock_);
+      sites_.push_back(site);
+    }
+  }
+
+  /// Write every message that has been logged so far
+  void flush() { drain(); }
+
+  /// Stop the writer thread, and write what remains.  Later messages are
+  /// written synchronously.
+  void stop() {
+    if (!stopped_.exchange(true)) {
+      writer_.join();
+    }
+    drain();
+  }
+};
+
+/// Write a message synchronously
+///
+/// @param site The call site
+/// @param msg  The formatted message
+inline void log_sync(const log_site_t &site, std::string_view msg) {
+  // NB: for thread-safety, we use printf
+  if (site.level_ == LOG_DEBUG) {
+    std::printf("[DEBUG] %.*s (%s:%u)\n", (int)msg.length(), msg.data(),
+                site.file_, site.line_);
+  } else {
+    std::printf("[INFO] %.*s\n", (int)msg.length(), msg.data());
+  }
+  std::fflush(stdout);
+}
+
+/// Log a message from a call site.  Encodable arguments are copied into the
+/// calling thread's ring, to be formatted by the writer thread; otherwise the
+/// message is formatted here, and its text is copied.
+///
+/// @param site The call site (whose fmt_ is the same literal as `fmt`)
+/// @param fmt  The format string, which is checked at compile time
+/// @param args The arguments
+template <typename... Args>
+void log(log_site_t &site, std::format_string<Args...> fmt, Args &&...args) {
+  if (!site.admit()) {
+    return;
+  }
+  auto &logger = Logger::instance();
+  if (!logger.running()) {
+    log_sync(site, std::format(fmt, std::forward<Args>(args)...));
+    return;
+  }
+  logger.add_site(&site);
+  // Copy an entry into the ring (unless it is full), or report that it is too
+  // big for the ring
+  auto append = [&](auto decode, uint64_t arg_bytes, auto &&encode) {
+    uint64_t bytes = (sizeof(log_entry_t) + arg_bytes + 7) & ~7ULL;
+    if (bytes > log_ring_t::kMaxEntry) {
+      return false;
+    }
+    auto &r = logger.ring();
+    if (auto p = r.reserve(bytes)) {
+      log_entry_t e{bytes, &site, decode};
+      std::memcpy(p, &e, sizeof(e));
+      encode(p + sizeof(e));
+      r.commit(bytes);
+    }
+    return true;
+  };
+  if constexpr ((log_arg<std::decay_t<Args>>::kEncodable && ...)) {
+    uint64_t bytes = (log_arg<std::decay_t<Args>>::size(args) + ... + 0);
+    auto encode = [&]([[maybe_unused]] uint8_t *p) {
+      (log_arg<std::decay_t<Args>>::put(p, args), ...);
+    };
+    if (append(&log_decode<std::decay_t<Args>...>, bytes, encode)) {
+      return;
+    }
+    log_sync(site, std::format(fmt, std::forward<Args>(args)...));
+  } else {
+    auto msg = std::format(fmt, std::forward<Args>(args)...);
+    if (!append(&log_decode_formatted, log_str_arg::size(msg),
+                [&](uint8_t *p) { log_str_arg::put(p, msg); })) {
+      log_sync(site, msg);
+    }
+  }
+}
+} // namespace internal
+
+/// Change which messages get logged, at runtime
+///
+/// @param level The least important level to log
+inline void set_log_level(LogLevel level) { internal::log_level_ = level; }
+
+/// Limit how many messages per second each call site may log, at runtime.
+/// Messages over the limit are dropped, and their number reported.
+///
+/// @param per_sec The limit, or 0 for no limit
+inline void set_log_rate_limit(uint64_t per_sec) {
+  internal::log_rate_limit_ = per_sec;
+}
+
+/// Turn the value of --log-level into a LogLevel
+///
+/// @param name One of DEBUG, INFO, or NONE
+/// @return The LogLevel
+inline LogLevel to_log_level(const std::string &name) {
+  return name == "NONE" ? LOG_NONE : name == "INFO" ? LOG_INFO : LOG_DEBUG;
+}
+
+/// Report if messages of a level are logged
+inline bool log_enabled(int level) {
+  return level >= internal::log_level_.load(std::memory_order_relaxed);
+}
+
+/// Write every message that has been logged so far (e.g., before exiting)
+inline void log_flush() { internal::Logger::instance().flush(); }
+} // namespace remus
@@ -20,17 +20,23 @@ constexpr const char *SEGS_PER_MN = "--segs-per-mn";
 constexpr const char *FIRST_CN_ID = "--first-cn-id";
 /// The node-id of the last node that performs computations.
 constexpr const char *LAST_CN_ID = "--last-cn-id";
-/// Each compute node should have qp-lanes number of connections to
+/// Each compute thread should have qp-lanes number of connections to
 /// each memory node.
 constexpr const char *QP_LANES = "--qp-lanes";
 /// The QP scheduling policy to use for choosing which
 /// connection to use for a given operation. Options are: 
-/// MOD, ONE_TO_ONE, RAND, RR. 
+/// MOD, ONE_TO_ONE, RAND, RR, LEAST_LOADED, P2C. 
 constexpr const char *QP_SCHED_POL = "--qp-sched-pol";
 /// The allocation policy for ComputeThreads to use when
 /// choosing which Segment to allocate from. Options are:
 /// RAND, GLOBAL-RR, GLOBAL-MOD, LOCAL-RR, LOCAL-MOD.
 constexpr const char *ALLOC_POL = "--alloc-pol";
+/// The size, in bytes, of the chunks from which a ComputeThread carves small
+/// allocations.  0 means every allocation is reserved from a Segment directly.
+constexpr const char *ALLOC_CHUNK_SIZE = "--alloc-chunk-size";
+/// The number of free blocks of each size class that a ComputeThread keeps for
+/// itself before it returns the rest to their Segments' free stacks.
+constexpr const char *ALLOC_CACHE_BLOCKS = "--alloc-cache-blocks";
 /// The number of threads to run on each compute node
 constexpr const char *CN_THREADS = "--cn-threads";
 /// The maximum number of concurrent messages that a thread can
@@ -43,6 +49,45 @@ constexpr const char *CN_THREAD_BUFSZ = "--cn-thread-bufsz";
 /// concurrently. This is the number of write operations that can be
 /// performed in a row before the thread must wait for a completion.
 constexpr const char *CN_WRS_PER_SEQ = "--cn-wrs-per-seq";
+/// The number of writes that WriteUnsignaled() posts on a QP for each one
+/// that requests a completion.  Twice this must fit in the QP's send queue.
+constexpr const char *CN_SIGNAL_EVERY = "--cn-signal-every";
+/// The size, in bytes, of the chunks that BulkRead() and BulkWrite() split an
+/// object into, to stripe it across lanes.
+constexpr const char *CN_BULK_CHUNK = "--cn-bulk-chunk";
+/// The most chunks of one BulkRead() or BulkWrite() that may be in flight.
+constexpr const char *CN_BULK_WINDOW = "--cn-bulk-window";
+/// The largest write, in bytes, that a ComputeThread will send inline (i.e.,
+/// copied into the work request instead of DMA-read from a staging buffer).
+/// Compute nodes request this much inline capacity for every QP.
+constexpr const char *MAX_INLINE = "--max-inline";
+/// Measure the latency of every operation, and print each ComputeThread's
+/// metrics when it shuts down.
+constexpr const char *METRICS = "--metrics";
+/// How compute nodes reach memory nodes: over RDMA verbs, or through an
+/// emulation of one-sided verbs over shared memory, for machines without an
+/// RNIC (all nodes must then run on the same host).
+constexpr const char *TRANSPORT = "--transport";
+/// The latency, in nanoseconds, that the shared-memory transport adds before
+/// a completion becomes visible.
+constexpr const char *SHM_LATENCY_NS = "--shm-latency-ns";
+/// The kind of pages that back Segments: auto (2MB huge pages when enough are
+/// free), 4k, 2m, 1g, or thp (transparent huge pages).
+constexpr const char *SEG_PAGE_SIZE = "--seg-page-size";
+/// The size, in bytes, of each compute node's cache of objects read with
+/// CachedRead().  0 disables the cache.
+constexpr const char *CN_CACHE_SIZE = "--cn-cache-size";
+/// The NUMA node whose memory backs Segments: "none" (no placement), "auto"
+/// (the RNIC's node), or a node number.
+constexpr const char *NUMA_NODE = "--numa-node";
+/// The CPUs to pin threads to, in cpulist format (e.g., "0-7,16-23").
+/// ComputeThread i runs on the (i mod n)th CPU of the list, and a MemoryNode's
+/// threads run on the last one.  Empty disables pinning.
+constexpr const char *CPU_LIST = "--cpu-list";
+/// The least important messages to log: DEBUG (if compiled in), INFO, or NONE
+constexpr const char *LOG_LEVEL = "--log-level";
+/// The most messages per second to log from each call site.  0 is no limit.
+constexpr const char *LOG_RATE_LIMIT = "--log-rate-limit";
 /// The command-line option for requesting help
 constexpr const char *HELP = "--help";
 
@@ -73,12 +118,14 @@ inline auto ARGS = {
     U64_ARG(LAST_MN_ID,
             "The node-id of the last node that hosts memory segments."),
     U64_ARG_OPT(QP_LANES,
-                "Each compute node should have qp-lanes connections to "
+                "Each compute thread should have qp-lanes connections to "
                 "each memory node.",
                 2),
     ENUM_ARG_OPT(QP_SCHED_POL,
-                 "How to choose which qp to use: RAND, RR, or MOD", "RAND",
-                 {"RAND", "RR", "MOD", "ONE_TO_ONE"}),
+                 "How to choose which qp to use: RAND, RR, MOD, ONE_TO_ONE, "
+                 "LEAST_LOADED, or P2C (the less loaded of two random qps)",
+                 "RAND",
+                 {"RAND", "RR", "MOD", "ONE_TO_ONE", "LEAST_LOADED", "P2C"}),
     U64_ARG(MN_PORT,
             "The port that memory nodes should use to wait for "
             "connections during the initialization phase."),
@@ -93,6 +140,14 @@ inline auto ARGS = {
                  "RAND, GLOBAL-RR, GLOBAL-MOD, LOCAL-RR, LOCAL-MOD",
                  "GLOBAL-RR",
                  {"RAND", "GLOBAL-RR", "GLOBAL-MOD", "LOCAL-RR", "LOCAL-MOD"}),
+    U64_ARG_OPT(ALLOC_CHUNK_SIZE,
+                "The size (in bytes) of the chunks from which a thread carves "
+                "small allocations.  0 disables chunked allocation.",
+                1 << 16),
+    U64_ARG_OPT(ALLOC_CACHE_BLOCKS,
+                "The number of free blocks per size class that a thread keeps "
+                "before returning the rest to their Segments.",
+                256),
     U64_ARG_OPT(CN_OPS_PER_THREAD,
                 "The maximum number of concurrent messages that a thread can "
                 "issue without waiting on a completion.",
@@ -101,5 +156,54 @@ inline auto ARGS = {
                 "The number of sequential operations that a thread can perform "
                 "concurrently.",
                 16),
+    U64_ARG_OPT(CN_SIGNAL_EVERY,
+                "The number of unsignaled writes per QP for each signaled "
+                "one.",
+                64),
+    U64_ARG_OPT(CN_BULK_CHUNK,
+                "The size (in bytes) of each chunk of a bulk read or write.",
+                1 << 16),
+    U64_ARG_OPT(CN_BULK_WINDOW,
+                "The most chunks of a bulk read or write in flight at once.",
+                8),
+    U64_ARG_OPT(MAX_INLINE,
+                "The largest write (in bytes) to send inline.  0 disables "
+                "inline writes.",
+                64),
+    BOOL_ARG_OPT(METRICS,
+                 "Measure operation latencies, and print per-thread metrics "
+                 "at shutdown."),
+    ENUM_ARG_OPT(TRANSPORT,
+                 "How to reach memory nodes: RDMA, or SHM (shared memory on "
+                 "one host, for testing without an RNIC)",
+                 "RDMA", {"RDMA", "SHM"}),
+    U64_ARG_OPT(SHM_LATENCY_NS,
+                "With --transport SHM, the delay (in ns) before each "
+                "completion is visible.",
+                0),
+    ENUM_ARG_OPT(SEG_PAGE_SIZE,
+                 "The pages that back Segments: auto, 4k, 2m, 1g, or thp.  "
+                 "Huge pages fall back to smaller ones if too few are free.",
+                 "auto", {"auto", "4k", "2m", "1g", "thp"}),
+    U64_ARG_OPT(CN_CACHE_SIZE,
+                "The size (in bytes) of each compute node's cache for "
+                "CachedRead().  0 disables the cache.",
+                0),
+    STR_ARG_OPT(NUMA_NODE,
+                "The NUMA node for Segments: none, auto (the RNIC's node), or "
+                "a node number.",
+                "none"),
+    STR_ARG_OPT(CPU_LIST,
+                "The CPUs (e.g., 0-7,16-23) to pin ComputeThreads to, in "
+                "order.  MemoryNode threads use the last one.  Empty disables "
+                "pinning.",
+                ""),
+    ENUM_ARG_OPT(LOG_LEVEL,
+                 "The least important messages to log: DEBUG, INFO, or NONE",
+                 "DEBUG", {"DEBUG", "INFO", "NONE"}),
+    U64_ARG_OPT(LOG_RATE_LIMIT,
+                "The most messages per second to log from each line of code.  "
+                "0 disables the limit.",
+                0),
     BOOL_ARG_OPT(HELP, "Print this help message")};
 }  // namespace remus
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <chrono>
 #include <cstring>
@@ -8,6 +9,7 @@
 #include <memory>
 #include <mutex>
 #include <netdb.h>
+#include <poll.h>
 #include <rdma/rdma_cma.h>
 #include <string>
 #include <thread>
@@ -18,7 +20,9 @@
 #include "cli.h"
 #include "connection.h"
 #include "logging.h"
+#include "numa.h"
 #include "rdma_ops.h"
+#include "read_cache.h"
 #include "ring.h"
 #include "util.h"
 
@@ -30,16 +34,27 @@ constexpr uint32_t connect_backoff_min_us = 100;
 /// Maximum microseconds for exponential backoff
 constexpr uint32_t connect_backoff_max_us = 5000000;
 
+/// Maximum milliseconds to wait for a connection event before checking again
+constexpr int connect_poll_max_ms = 100;
+
+/// A function that returns the CQ that a new QP's sends should complete to,
+/// given the device context that the QP will be created on
+using send_cq_fn = std::function<ibv_cq *(ibv_context *)>;
+
 /// Common code for creating and initializing an endpoint
 ///
 /// TODO: This documentation should give an intuition about the way we configure
 ///       endpoints (i.e., any non-hard-coded config stuff)
 ///
-/// @param address  The address that will be connected to
-/// @param port     The port to connect to
+/// @param address     The address that will be connected to
+/// @param port        The port to connect to
+/// @param max_inline  The inline data capacity to request for the QP
+/// @param send_cq     Produces the CQ for the QP's sends
 ///
 /// @return A connection/id that has been configured properly
-inline rdma_cm_id *initialize_ep(std::string_view address, uint16_t port) {
+inline rdma_cm_id *initialize_ep(std::string_view address, uint16_t port,
+                                 uint32_t max_inline,
+                                 const send_cq_fn &send_cq) {
   // Compute the info for the node we're connecting to
   auto port_str = std::to_string(htons(port));
   rdma_addrinfo hints, *resolved = nullptr;
@@ -59,131 +74,257 @@ inline rdma_cm_id *initialize_ep(std::string_view address, uint16_t port) {
     REMUS_FATAL("rdma_getaddrinfo(): {}", gai_strerror(err));
   }
 
-  // Start making a connection
-  ibv_qp_init_attr init_attr = make_default_qp_init_attrs();
+  // Start making a connection.
+  //
+  // NB: The QP is created separately from the endpoint, because its sends must
+  //     complete to a CQ that we provide, and that CQ has to be on the device
+  //     that the endpoint resolved to.  rdma_cm still makes the receive CQ.
   rdma_cm_id *id = nullptr;
-  auto err = rdma_create_ep(&id, resolved, nullptr, &init_attr);
+  auto err = rdma_create_ep(&id, resolved, nullptr, nullptr);
   rdma_freeaddrinfo(resolved);
   if (err) {
     REMUS_FATAL("compute node rdma_create_ep(): {}", strerror(errno));
   }
+  ibv_qp_init_attr init_attr = make_default_qp_init_attrs(max_inline);
+  init_attr.send_cq = send_cq(id->verbs);
+  if (rdma_create_qp(id, nullptr, &init_attr) != 0) {
+    REMUS_FATAL("compute node rdma_create_qp(): {} (is {} {} too big for this "
+                "device?)",
+                strerror(errno), MAX_INLINE, max_inline);
+  }
   return id;
 }
 
-/// Connect to a remote memory node.  It is an error to use this to create a
-/// Loopback connection.  Terminates the program on any error.
+/// Return seg's registration with pd, registering it first if no earlier
+/// connection has used pd
 ///
-/// @param my_id    The id of this (compute) node
-/// @param mn_id    The id of the memory node
-/// @param mn_addr  The address of the memory node
-/// @param port     The port to connect to
-/// @param seg      TODO: Document this
-/// @param mrs      TODO: Document this
+/// NB: rdma_cm gives every endpoint on a device the same default PD, so this
+///     keeps the number of registrations from growing with the number of QPs.
 ///
-/// @return A connection object for the new connection
-inline Connection *connect_remote(uint32_t my_id, uint32_t mn_id,
-                                  std::string_view mn_addr, uint16_t port,
-                                  internal::Segment &seg,
-                                  std::vector<internal::ibv_mr_ptr> &mrs) {
-  uint32_t backoff_us_ = 0;
-  while (true) {
-    // TODO: Need a one-line comment here explaining this block of code
-    rdma_cm_id *id = initialize_ep(mn_addr, port);
-    auto mr = seg.registerWithPd(id->pd);
-    RDMA_CM_ASSERT(rdma_post_recv, id, nullptr, seg.raw(), seg.capacity(),
-                   mr.get());
-    mrs.push_back(std::move(mr));
-
-    // Migrate the new endpoint to a nonblocking event channel and do more
-    // config
-    auto *event_channel = rdma_create_event_channel();
-    make_nonblocking(event_channel->fd);
-    if (rdma_migrate_id(id, event_channel) != 0) {
-      REMUS_FATAL("rdma_migrate_id(): {}", strerror(errno));
+/// @param seg  The segment to register
+/// @param mrs  The registrations made so far
+/// @param pd   The protection domain of the new connection
+///
+/// @return The registration of seg with pd
+inline ibv_mr *register_once(internal::Segment &seg,
+                             std::vector<internal::ibv_mr_ptr> &mrs,
+                             ibv_pd *pd) {
+  for (auto &mr : mrs) {
+    if (mr->pd == pd) {
+      return mr.get();
     }
+  }
+  mrs.push_back(seg.registerWithPd(pd));
+  return mrs.back().get();
+}
 
-    // Set the QP ACK timeout
-    uint8_t timeout = 12; // Example timeout value
-    if (rdma_set_option(id, RDMA_OPTION_ID, RDMA_OPTION_ID_ACK_TIMEOUT,
-                        &timeout, sizeof(timeout)) != 0) {
-      REMUS_FATAL("rdma_set_option(): {}", strerror(errno));
-    }
+/// @brief One of the connections that connect_remote_all() establishes
+struct pending_conn_t {
+  uint32_t mn_id_ = 0;       // The id of the memory node
+  std::string mn_addr_;      // The address of the memory node
+  send_cq_fn send_cq_;       // Produces the CQ for the QP's sends
+  size_t recv_offset_ = 0;   // Where in the Segment the rkeys are received
+  rdma_cm_id *id_ = nullptr; // The endpoint, while it is connecting
+  uint32_t backoff_us_ = 0;  // The backoff after the latest rejection
+  std::chrono::steady_clock::time_point retry_at_; // When to try again
+  Connection *conn_ = nullptr; // The connection, once it is established
+};
 
-    // TODO: These values feel like they need more documentation
-    rdma_conn_param conn_param;
-    std::memset(&conn_param, 0, sizeof(conn_param));
-    conn_param.private_data = &my_id;
-    conn_param.private_data_len = sizeof(my_id);
-    conn_param.retry_count = 255;
-    conn_param.rnr_retry_count = 7;
-    conn_param.responder_resources = 8;
-    conn_param.initiator_depth = 8;
-    if (rdma_connect(id, &conn_param) != 0) {
-      REMUS_FATAL("rdma_connect(): {}", strerror(errno));
-    }
+/// Start connecting a pending connection: make its endpoint, post the receive
+/// for the memory node's rkeys, and send the connection request
+///
+/// @param my_id      The id of this (compute) node
+/// @param pc         The connection
+/// @param port       The port to connect to
+/// @param seg        The Segment that the rkeys are received into
+/// @param recv_len   The size of pc's receive buffer in seg
+/// @param mrs        The registrations of seg made so far
+/// @param max_inline The inline data capacity to request for the QP
+/// @param channel    The event channel that reports the connection's progress
+inline void start_connect(const uint32_t &my_id, pending_conn_t &pc,
+                          uint16_t port, internal::Segment &seg,
+                          size_t recv_len,
+                          std::vector<internal::ibv_mr_ptr> &mrs,
+                          uint32_t max_inline, rdma_event_channel *channel) {
+  rdma_cm_id *id = initialize_ep(pc.mn_addr_, port, max_inline, pc.send_cq_);
+  auto mr = register_once(seg, mrs, id->pd);
+  RDMA_CM_ASSERT(rdma_post_recv, id, nullptr, seg.raw() + pc.recv_offset_,
+                 recv_len, mr);
 
-    // It takes a few events before the channel is ready to use, so we need an
-    // event loop here, to receive events and move through a set of transitions
-    while (true) {
-      // Poll until we get an event
-      rdma_cm_event *event;
-      auto result = rdma_get_cm_event(id->channel, &event);
-      while (result < 0 && errno == EAGAIN) {
-        result = rdma_get_cm_event(id->channel, &event);
-      }
+  // Move the endpoint to the shared, nonblocking event channel
+  if (rdma_migrate_id(id, channel) != 0) {
+    REMUS_FATAL("rdma_migrate_id(): {}", strerror(errno));
+  }
 
-      // Save the event and ack it
-      auto cm_event = event->event;
-      if (rdma_ack_cm_event(event) != 0) {
-        REMUS_FATAL("rdma_ack_cm_event(): {}", strerror(errno));
-      }
+  // Set the QP ACK timeout
+  uint8_t timeout = 12; // Example timeout value
+  if (rdma_set_option(id, RDMA_OPTION_ID, RDMA_OPTION_ID_ACK_TIMEOUT, &timeout,
+                      sizeof(timeout)) != 0) {
+    REMUS_FATAL("rdma_set_option(): {}", strerror(errno));
+  }
 
-      // On an "established" event, we can make and save the connection
-      if (cm_event == RDMA_CM_EVENT_ESTABLISHED) {
-        make_sync(event_channel->fd);
-        make_nonblocking(id->recv_cq->channel->fd);
-        make_nonblocking(id->send_cq->channel->fd);
+  // TODO: These values feel like they need more documentation
+  //
+  // NB: rdma_connect() copies the private data, so it can be on the stack
+  rdma_conn_param conn_param;
+  std::memset(&conn_param, 0, sizeof(conn_param));
+  conn_param.private_data = &my_id;
+  conn_param.private_data_len = sizeof(my_id);
+  conn_param.retry_count = 255;
+  conn_param.rnr_retry_count = 7;
+  conn_param.responder_resources = 8;
+  conn_param.initiator_depth = 8;
+  if (rdma_connect(id, &conn_param) != 0) {
+    REMUS_FATAL("rdma_connect(): {}", strerror(errno));
+  }
+  pc.id_ = id;
+}
 
-        // Make and return the connection
-        return new Connection(my_id, mn_id, id);
-      }
+/// Connect to remote memory nodes, with every connection in flight at once.
+/// It is an error to use this to create a Loopback connection.  Terminates
+/// the program on any error.
+///
+/// All of the endpoints report their progress on one nonblocking event
+/// channel, and this runs the event loop for all of them.  A connection that
+/// is rejected (e.g., because its memory node is not listening yet) is retried
+/// after an exponential backoff, without holding up the others.  While there
+/// is nothing to do, the loop sleeps in poll() on the channel.  Once a
+/// connection is established, its endpoint moves to an event channel of its
+/// own, which the Connection owns.
+///
+/// @param my_id      The id of this (compute) node
+/// @param port       The port to connect to
+/// @param conns      The connections to make.  Each one's conn_ is set.
+/// @param seg        The Segment that the rkeys are received into
+/// @param recv_len   The size of each connection's receive buffer in seg
+/// @param mrs        The registrations of seg made so far
+/// @param max_inline The inline data capacity to request for the QPs
+///
+/// @return The number of connection attempts that were rejected and retried
+inline uint64_t connect_remote_all(uint32_t my_id, uint16_t port,
+                                   std::vector<pending_conn_t> &conns,
+                                   internal::Segment &seg, size_t recv_len,
+                                   std::vector<internal::ibv_mr_ptr> &mrs,
+                                   uint32_t max_inline) {
+  auto *channel = rdma_create_event_channel();
+  if (channel == nullptr) {
+    REMUS_FATAL("rdma_create_event_channel(): {}", strerror(errno));
+  }
+  make_nonblocking(channel->fd);
 
-      // On an ADDR_RESOLVED, we just ack (which we did above)
-      else if (cm_event == RDMA_CM_EVENT_ADDR_RESOLVED) {
-      }
+  // Send every connection request before waiting for any of them
+  std::unordered_map<rdma_cm_id *, size_t> by_id;
+  for (size_t i = 0; i < conns.size(); ++i) {
+    start_connect(my_id, conns[i], port, seg, recv_len, mrs, max_inline,
+                  channel);
+    by_id[conns[i].id_] = i;
+  }
 
-      // If we get a REJECTED, cleanup, backoff, try it all again
-      else if (cm_event == RDMA_CM_EVENT_REJECTED) {
-        rdma_destroy_ep(id);
-        rdma_destroy_event_channel(event_channel);
-        backoff_us_ = backoff_us_ > 0
-                          ? std::min((backoff_us_ + (100 * my_id)) * 2,
-                                     connect_backoff_max_us)
-                          : connect_backoff_min_us;
-        std::this_thread::sleep_for(std::chrono::microseconds(backoff_us_));
-        break;
+  // It takes a few events before each endpoint is ready to use, so run an
+  // event loop that moves all of them through their transitions
+  uint64_t established = 0, retries = 0;
+  std::vector<size_t> backing_off; // Rejected connections, to retry
+  while (established < conns.size()) {
+    rdma_cm_event *event;
+    if (rdma_get_cm_event(channel, &event) != 0) {
+      if (errno != EAGAIN) {
+        REMUS_FATAL("rdma_get_cm_event(): {}", strerror(errno));
       }
+      // With no events to handle, retry any connection whose backoff is over
+      auto now = std::chrono::steady_clock::now();
+      auto wake = now + std::chrono::milliseconds(connect_poll_max_ms);
+      for (size_t j = 0; j < backing_off.size();) {
+        auto &pc = conns[backing_off[j]];
+        if (now < pc.retry_at_) {
+          wake = std::min(wake, pc.retry_at_);
+          ++j;
+          continue;
+        }
+        start_connect(my_id, pc, port, seg, recv_len, mrs, max_inline,
+                      channel);
+        by_id[pc.id_] = backing_off[j];
+        backing_off[j] = backing_off.back();
+        backing_off.pop_back();
+      }
+      // Then sleep until an event arrives, or the next backoff is over
+      // (rounded up to a whole millisecond)
+      auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+      pollfd pfd{channel->fd, POLLIN, 0};
+      if (poll(&pfd, 1, (int)timeout.count()) < 0 && errno != EINTR) {
+        REMUS_FATAL("poll(): {}", strerror(errno));
+      }
+      continue;
+    }
 
-      // Otherwise fail
-      else {
-        REMUS_FATAL("Got unexpected event: {}", rdma_event_str(cm_event));
+    // Save the event and ack it
+    rdma_cm_id *id = event->id;
+    auto cm_event = event->event;
+    if (rdma_ack_cm_event(event) != 0) {
+      REMUS_FATAL("rdma_ack_cm_event(): {}", strerror(errno));
+    }
+    auto it = by_id.find(id);
+    REMUS_ASSERT(it != by_id.end(), "Got {} for an unknown endpoint",
+                 rdma_event_str(cm_event));
+    auto &pc = conns[it->second];
+
+    // On an "established" event, we can make and save the connection
+    if (cm_event == RDMA_CM_EVENT_ESTABLISHED) {
+      // NB: The Connection destroys the endpoint's channel, so give it one of
+      //     its own.  A new channel is blocking, like the Connection expects.
+      //     The send CQ is not rdma_cm's, and has no channel.
+      by_id.erase(it);
+      if (rdma_migrate_id(id, rdma_create_event_channel()) != 0) {
+        REMUS_FATAL("rdma_migrate_id(): {}", strerror(errno));
       }
+      make_nonblocking(id->recv_cq->channel->fd);
+      pc.id_ = nullptr;
+      pc.conn_ = new Connection(my_id, pc.mn_id_, id);
+      ++established;
+    }
+
+    // On an ADDR_RESOLVED, we just ack (which we did above)
+    else if (cm_event == RDMA_CM_EVENT_ADDR_RESOLVED) {
+    }
+
+    // If we get a REJECTED, clean up, and try again after a backoff
+    else if (cm_event == RDMA_CM_EVENT_REJECTED) {
+      by_id.erase(it);
+      rdma_destroy_ep(id);
+      pc.id_ = nullptr;
+      pc.backoff_us_ = pc.backoff_us_ > 0
+                           ? std::min((pc.backoff_us_ + (100 * my_id)) * 2,
+                                      connect_backoff_max_us)
+                           : connect_backoff_min_us;
+      pc.retry_at_ = std::chrono::steady_clock::now() +
+                     std::chrono::microseconds(pc.backoff_us_);
+      backing_off.push_back(&pc - conns.data());
+      ++retries;
+    }
+
+    // Otherwise fail
+    else {
+      REMUS_FATAL("Got unexpected event: {}", rdma_event_str(cm_event));
     }
   }
+  rdma_destroy_event_channel(channel);
+  return retries;
 }
 
 /// Create a connection to the local device.  It is an error to use this to
 /// create a Remote connection.  Terminates the program on any error.
 ///
-/// @param my_id    The id of this (compute) node
-/// @param address  The address of this (also memory) node
-/// @param port     The port to connect to
+/// @param my_id      The id of this (compute) node
+/// @param address    The address of this (also memory) node
+/// @param port       The port to connect to
+/// @param max_inline The inline data capacity to request for the QP
+/// @param send_cq    Produces the CQ for the QP's sends
 ///
 /// @return A connection object for the new connection
 inline Connection *connect_loopback(uint32_t my_id, std::string_view address,
-                                    uint16_t port) {
+                                    uint16_t port, uint32_t max_inline,
+                                    const send_cq_fn &send_cq) {
   // Do the initial endpoint configuration
-  rdma_cm_id *id = initialize_ep(address, port);
+  rdma_cm_id *id = initialize_ep(address, port, max_inline, send_cq);
 
   // Query the ports to find one that is available and appropriate
   ibv_device_attr dev_attr;
@@ -287,7 +428,6 @@ inline Connection *connect_loopback(uint32_t my_id, std::string_view address,
     REMUS_FATAL("ibv_modify_qp(): {}", strerror(errno));
   }
   make_nonblocking(id->recv_cq->channel->fd);
-  make_nonblocking(id->send_cq->channel->fd);
 
   // Make and return the connection
   return new Connection(my_id, my_id, id);
@@ -321,15 +461,60 @@ class ComputeNode {
   const MachineInfo self_;                // This node's id and address
   std::vector<internal::ibv_mr_ptr> mrs_; // MRs for seg_
   const uint64_t num_threads_;            // Number of threads to support
+  const uint64_t qp_lanes_;               // QPs per thread per MemoryNode
   const uint64_t thread_bufsz_;           // Segment size for each thread
   internal::Segment seg_;                 // The segment shared by the threads
   std::atomic<uint64_t> threads_;         // Number of registered threads
+  std::vector<int> cpus_;                 // The CPUs to pin threads to
 
   using conn_map = std::unordered_map<uint16_t, std::vector<conn_info>>;
   using rkey_map = std::unordered_map<uint64_t, uint32_t>;
 
+  /// One completion queue per ComputeThread, shared by all of that thread's
+  /// QPs, so that a thread never polls (or steals) another thread's
+  /// completions, and one poll can retire completions from many MemoryNodes.
+  ///
+  /// NB: This must be declared before node_connections_, so that the QPs are
+  ///     destroyed before the CQs they use.
+  std::vector<internal::ibv_cq_ptr> thread_cqs_;
+
+  /// Is this node using the SHM transport instead of RDMA?
+  const bool shm_;
+
+  /// Under the SHM transport, each thread's completion queue (in place of
+  /// thread_cqs_), the memory that the connections can reach, and the
+  /// mappings of remote MemoryNodes' Segments that back that memory
+  std::vector<internal::ShmCq> shm_cqs_;
+  internal::ShmRegions shm_regions_;
+  std::vector<std::unique_ptr<internal::Segment>> shm_segs_;
+
+  /// The cache that CachedRead() uses, shared by this node's threads (or null,
+  /// if --cn-cache-size is 0)
+  std::unique_ptr<internal::ReadCache> read_cache_;
+
+  /// The RPC buffers: for each MemoryNode and thread, kRpcSlots to send from
+  /// and kRpcSlots to receive into, and their registrations
+  std::unique_ptr<internal::Segment> rpc_seg_;
+  std::vector<internal::ibv_mr_ptr> rpc_mrs_;
+
+  /// Under the SHM transport, the RPC channels of this node's threads
+  std::vector<std::unique_ptr<internal::Segment>> shm_rpc_chans_;
+
+  /// The RPC handlers of a co-located MemoryNode, which are run directly,
+  /// since a loopback QP has no MemoryNode at its other end
+  const internal::RpcServer *local_rpc_ = nullptr;
+
+  /// Can ComputeThreads use CPU atomics on a co-located MemoryNode's memory?
+  /// Only if they are atomic with respect to the RDMA atomics that other
+  /// nodes issue to it: under the SHM transport (whose "RNIC" is the CPU), or
+  /// if the RNIC reports IBV_ATOMIC_GLOB.
+  bool local_atomics_ = false;
+
   /// A map of all of the connections we have for each node
   ///
+  /// NB: Each thread has its own set of QP_LANES connections to each node.
+  ///     Thread t's connection on lane l is at index (t * qp_lanes_ + l).
+  ///
   /// TODO: Since connections are only to memory nodes, and memory node indices
   ///       start at 0 and are contiguous, this could just be a vector of
   ///       vectors.  Is that worth it, or should we leave "good enough" alone?
@@ -386,6 +571,69 @@ class ComputeNode {
         conn_info{std::unique_ptr<internal::Connection>(conn), lkey});
   }
 
+  /// Return thread tid's completion queue, creating it on verbs if this is the
+  /// thread's first connection
+  ///
+  /// NB: A thread's QPs all complete to one CQ, so they must all be on the
+  ///     same device.
+  ///
+  /// @param tid    The thread whose CQ is needed
+  /// @param verbs  The device context of the QP that will use the CQ
+  /// @return The CQ
+  ibv_cq *thread_cq(uint64_t tid, ibv_context *verbs) {
+    auto &cq = thread_cqs_[tid];
+    if (!cq) {
+      ibv_device_attr dev_attr;
+      if (ibv_query_device(verbs, &dev_attr) != 0) {
+        REMUS_FATAL("ibv_query_device(): {}", strerror(errno));
+      }
+      // Size for the worst case: every one of the thread's QPs has a full send
+      // queue of signaled requests
+      uint64_t mns =
+          args_->uget(remus::LAST_MN_ID) - args_->uget(remus::FIRST_MN_ID) + 1;
+      int cqe = std::min<uint64_t>(dev_attr.max_cqe,
+                                   internal::kMaxWr * qp_lanes_ * mns);
+      cq.reset(ibv_create_cq(verbs, cqe, nullptr, nullptr, 0));
+      if (!cq) {
+        REMUS_FATAL("ibv_create_cq(): {}", strerror(errno));
+      }
+    }
+    REMUS_ASSERT(cq->context == verbs,
+                 "All of thread {}'s connections must use the same device",
+                 tid);
+    return cq.get();
+  }
+
+  /// Make every thread's SHM transport connections to a MemoryNode whose
+  /// Segments are already in shm_regions_, and save its regions
+  ///
+  /// @param node_id  The id of the MemoryNode
+  /// @param ris      The MemoryNode's Segments
+  void connect_shm(uint16_t node_id,
+                   const std::vector<internal::RegionInfo> &ris) {
+    for (uint64_t t = 0; t < num_threads_; ++t) {
+      for (uint64_t i = 0; i < qp_lanes_; ++i) {
+        // NB: There is no registration, so the lkey is never checked
+        save_conn(node_id,
+                  new internal::Connection(self_.id, node_id, &shm_cqs_[t],
+                                           &shm_regions_,
+                                           args_->uget(remus::MAX_INLINE)),
+                  0);
+      }
+      // RPCs go over lane 0, through a channel that the MemoryNode made
+      shm_rpc_chans_.push_back(std::make_unique<internal::Segment>(
+          internal::kShmRpcChannelSize,
+          internal::shm_rpc_name(args_->uget(remus::MN_PORT), node_id,
+                                 self_.id, t),
+          false));
+      auto slots = (internal::shm_rpc_slot_t *)shm_rpc_chans_.back()->raw();
+      rpc_conn(node_id, t)->rpc_attach(slots + internal::kRpcSlots, slots);
+    }
+    for (auto &r : ris) {
+      save_region(node_id, r.raddr, r.rkey);
+    }
+  }
+
   /// Save the rkey for a given node/region pair
   ///
   /// @param node_id  TODO
@@ -416,19 +664,77 @@ class ComputeNode {
   }
 
 public:
-  /// Op counters for each lane
+  /// The number of operations in flight on each QP (see lane_ops()), which
+  /// bounds each send queue, and which load-aware QpSchedPolicies consult
+  std::vector<internal::lane_counter_t> lane_op_counters_;
+
+  /// Return the op counters of thread tid's lanes to a MemoryNode
   ///
-  /// TODO: This documentation isn't descriptive.  What's this really for?
-  std::vector<std::atomic<size_t>> lane_op_counters_;
+  /// NB: A thread's lanes to consecutive MemoryNodes are num_threads_ *
+  ///     qp_lanes_ counters apart.
+  ///
+  /// @param mn_id  The id of the MemoryNode
+  /// @param tid    The id of the ComputeThread
+  /// @return The counter of lane 0, which is followed by the other lanes'
+  internal::lane_counter_t *lane_ops(uint16_t mn_id, uint64_t tid) {
+    uint64_t mn_idx = mn_id - args_->uget(remus::FIRST_MN_ID);
+    return &lane_op_counters_[(mn_idx * num_threads_ + tid) * qp_lanes_];
+  }
+
+  /// @brief The node-local half of the control barrier
+  /// @details
+  /// The ComputeThreads of this node combine their arrivals here, so that only
+  /// the last of them arrives at the barrier in MemoryNode 0.  The rest spin
+  /// on gen_, which that thread advances once the whole barrier is done.
+  struct local_barrier_t {
+    alignas(64) std::atomic<uint64_t> arrived_{0}; // Arrivals in this phase
+    alignas(64) std::atomic<uint64_t> gen_{0};     // Completed phases
+  };
+  local_barrier_t local_barrier_;
+
+  /// Return this node's read cache, or nullptr if it has none
+  internal::ReadCache *read_cache() { return read_cache_.get(); }
+
+  /// Return the connection that a thread sends its RPCs to a MemoryNode on
+  ///
+  /// @param mn_id  The id of the MemoryNode
+  /// @param tid    The id of the calling ComputeThread
+  internal::Connection *rpc_conn(uint16_t mn_id, uint64_t tid) {
+    return node_connections_[mn_id][tid * qp_lanes_].conn_.get();
+  }
+
+  /// Return the kRpcSlots buffers that a thread builds its RPC batches to a
+  /// MemoryNode in (its receive buffers follow them)
+  ///
+  /// @param mn_id  The id of the MemoryNode
+  /// @param tid    The id of the calling ComputeThread
+  uint8_t *rpc_bufs(uint16_t mn_id, uint64_t tid) {
+    uint64_t mn_idx = mn_id - args_->uget(remus::FIRST_MN_ID);
+    uint64_t idx = mn_idx * num_threads_ + tid;
+    return rpc_seg_->raw() +
+           idx * 2 * internal::kRpcSlots * internal::kRpcBufSize;
+  }
+
+  /// Return the RPC handlers of a co-located MemoryNode, if connect_local()
+  /// was given them
+  const internal::RpcServer *local_rpc() const { return local_rpc_; }
+
+  /// Report if ComputeThreads may use CPU atomics on a co-located MemoryNode's
+  /// memory, instead of loopback RDMA atomics
+  bool local_atomics() const { return local_atomics_; }
+
+  /// Report if this node uses the SHM transport instead of RDMA
+  bool shm() const { return shm_; }
 
   /// Return a connection and lkey for interacting with an rdma_ptr
   ///
   /// @param ptr_raw  TODO
-  /// @param idx      TODO
+  /// @param tid      The id of the calling ComputeThread
+  /// @param lane     The lane to use, among the thread's connections
   /// @return TODO
-  conn_info &get_conn(uint64_t ptr_raw, uint64_t idx) {
+  conn_info &get_conn(uint64_t ptr_raw, uint64_t tid, uint64_t lane) {
     uint64_t node_id = ptr_raw >> 48 & 0xFFFF;
-    return node_connections_[node_id].at(idx);
+    return node_connections_[node_id][tid * qp_lanes_ + lane];
   }
 
   /// Return the rkey for a node/segment pair
@@ -448,18 +754,66 @@ public:
   /// @param args The command-line arguments to the program
   ComputeNode(const MachineInfo &self, std::shared_ptr<remus::ArgMap> args)
       : self_(self), num_threads_(args->uget(remus::CN_THREADS)),
-        thread_bufsz_(1ULL << args->uget(remus::CN_THREAD_BUFSZ)),
-        seg_(
-            (1ULL << (64 - __builtin_clzll(num_threads_ * thread_bufsz_ - 1)))),
-        threads_(0), seg_mask_((1ULL << args->uget(remus::SEG_SIZE)) - 1),
-        args_(args), lane_op_counters_(args->uget(remus::QP_LANES)) {
+        qp_lanes_(args->uget(remus::QP_LANES)), thread_bufsz_(1ULL << args->uget(remus::CN_THREAD_BUFSZ)),
+        seg_((1ULL << (64 - __builtin_clzll(num_threads_ * thread_bufsz_ - 1))),
+             internal::to_page_size(args->sget(remus::SEG_PAGE_SIZE))),
+        threads_(0), thread_cqs_(num_threads_),
+        shm_(args->sget(remus::TRANSPORT) == "SHM"),
+        shm_cqs_(shm_ ? num_threads_ : 0,
+                 internal::ShmCq(args->uget(remus::SHM_LATENCY_NS))),
+        seg_mask_((1ULL << args->uget(remus::SEG_SIZE)) - 1),
+        args_(args),
+        lane_op_counters_((args->uget(remus::LAST_MN_ID) -
+                           args->uget(remus::FIRST_MN_ID) + 1) *
+                          num_threads_ * qp_lanes_) {
+    set_log_level(to_log_level(args->sget(remus::LOG_LEVEL)));
+    set_log_rate_limit(args->uget(remus::LOG_RATE_LIMIT));
     REMUS_INFO("Node {}: Configuring Compute Node", args->uget(remus::NODE_ID));
+    if (args->uget(remus::CN_CACHE_SIZE) > 0) {
+      read_cache_ = std::make_unique<internal::ReadCache>(
+          args->uget(remus::CN_CACHE_SIZE));
+    }
+    // Place each thread's part of seg_ on its CPU's socket, or else on the
+    // --numa-node.  This must precede the registrations, which touch seg_.
+    //
+    // NB: Placement is by whole (huge) pages, so when a page holds several
+    //     threads' parts, they all go where the first of them wants.
+    cpus_ = internal::parse_cpu_list(args->sget(remus::CPU_LIST));
+    int numa_node = internal::numa_node_arg(args->sget(remus::NUMA_NODE));
+    auto thread_node = [&](uint64_t t) {
+      int cpu = thread_cpu(t);
+      int node = cpu < 0 ? -1 : internal::cpu_numa_node(cpu);
+      return node < 0 ? numa_node : node;
+    };
+    uint64_t unit = std::min(std::max(thread_bufsz_, seg_.placement_size()),
+                             seg_.capacity());
+    uint64_t per_unit = unit / thread_bufsz_;
+    for (uint64_t t = 0; t < num_threads_; t += per_unit) {
+      int node = thread_node(t);
+      uint64_t last = std::min(t + per_unit, num_threads_) - 1;
+      for (uint64_t u = t + 1; u <= last; ++u) {
+        if (thread_node(u) != node) {
+          REMUS_INFO("Threads {}-{} share {} pages, so their buffers are all "
+                     "on NUMA node {}",
+                     t, last, seg_.page_size_name(), node);
+          break;
+        }
+      }
+      if (!internal::numa_bind(seg_.raw() + t * thread_bufsz_, unit, node)) {
+        REMUS_INFO("The buffers of threads {}-{} are not placed", t, last);
+      }
+    }
+    seg_.prefault();
     // Initialize the seg map
     uint64_t m0 = args->uget(remus::FIRST_MN_ID);
     uint64_t mn = args->uget(remus::LAST_MN_ID);
     for (uint64_t i = m0; i <= mn; ++i) {
       segs_[i] = std::vector<seg_t>();
     }
+    uint64_t rpc_bytes = (mn - m0 + 1) * num_threads_ * 2 *
+                         internal::kRpcSlots * internal::kRpcBufSize;
+    rpc_seg_ = std::make_unique<internal::Segment>(
+        1ULL << (64 - __builtin_clzll(rpc_bytes - 1)));
   }
 
   /// TODO: Do we need a proper dtor, or is connection map cleanup automatic?
@@ -470,27 +824,65 @@ public:
   ///
   /// @param memnodes     TODO
   /// @param local_rkeys  TODO
+  /// @param local_rpc    The MemoryNode's RPC handlers (see
+  ///                     MemoryNode::rpc_server()), which RPCs to it run
+  ///                     directly, without RDMA.  Without them, such RPCs are
+  ///                     sent over the loopback QPs, like RPCs to a remote
+  ///                     MemoryNode.
   void connect_local(std::vector<MachineInfo> &memnodes,
-                     std::vector<internal::RegionInfo> local_rkeys) {
-    uint64_t qp_lanes = args_->uget(remus::QP_LANES);
+                     std::vector<internal::RegionInfo> local_rkeys,
+                     const internal::RpcServer *local_rpc = nullptr) {
+    auto t0 = std::chrono::steady_clock::now();
+    local_rpc_ = local_rpc;
     uint32_t port = args_->uget(remus::MN_PORT);
 
     for (auto &p : memnodes) {
       if (p.id == self_.id) {
-        for (uint64_t i = 0; i < qp_lanes; ++i) {
-          // Connect, then register the big segment with that connection
-          REMUS_INFO("Connecting to localhost {}:{} (id = {})", p.address, port,
-                     p.id);
-          auto conn = internal::connect_loopback(self_.id, self_.address, port);
-          mrs_.push_back(seg_.registerWithPd(conn->pd()));
-
-          // Save the connection and the regions
-          auto lkey = mrs_.back()->lkey;
-          save_conn(p.id, conn, lkey);
+        REMUS_INFO("Connecting to localhost {}:{} (id = {}) with {} QPs",
+                   p.address, port, p.id, num_threads_ * qp_lanes_);
+        if (shm_) {
+          // The MemoryNode's Segments are already mapped, at their raddrs
           for (auto &r : local_rkeys) {
-            save_region(p.id, r.raddr, r.rkey);
+            shm_regions_.add(r.raddr, (uint8_t *)r.raddr, seg_mask_ + 1,
+                             r.rkey);
           }
+          connect_shm(p.id, local_rkeys);
+          local_atomics_ = true;
+          continue;
         }
+        for (uint64_t t = 0; t < num_threads_; ++t) {
+          for (uint64_t i = 0; i < qp_lanes_; ++i) {
+            // Connect, then register the big segment with that connection
+            auto conn = internal::connect_loopback(
+                self_.id, self_.address, port, args_->uget(remus::MAX_INLINE),
+                [&, t](ibv_context *verbs) { return thread_cq(t, verbs); });
+            auto lkey = internal::register_once(seg_, mrs_, conn->pd())->lkey;
+            if (t == 0 && i == 0) {
+              local_atomics_ = internal::atomics_glob(conn->pd()->context);
+              if (!local_atomics_) {
+                REMUS_INFO("The RNIC's atomics are not coherent with the "
+                           "CPU's, so local atomics use the loopback QPs");
+              }
+            }
+
+            // Save the connection and the regions
+            save_conn(p.id, conn, lkey);
+            for (auto &r : local_rkeys) {
+              save_region(p.id, r.raddr, r.rkey);
+            }
+          }
+          if (local_rpc_ == nullptr) {
+            auto conn = rpc_conn(p.id, t);
+            auto mr = internal::register_once(*rpc_seg_, rpc_mrs_, conn->pd());
+            conn->rpc_attach(rpc_bufs(p.id, t) +
+                                 internal::kRpcSlots * internal::kRpcBufSize,
+                             mr->lkey);
+          }
+        }
+        REMUS_INFO("Node {}: Connected to localhost in {:.1f} ms", self_.id,
+                   std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - t0)
+                       .count());
       }
     }
   }
@@ -498,35 +890,110 @@ public:
   /// Connect to all the remote memory nodes, save the QPs that are created, and
   /// get the memory regions and rkeys at each memory node
   ///
+  /// NB: Every QP to every memory node is connected at once, and then the
+  ///     rkeys are received on each of them.  A report of where the time went
+  ///     is logged at the end.
+  ///
   /// @param memnodes TODO
   void connect_remote(std::vector<MachineInfo> &memnodes) {
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) {
+      return std::chrono::duration<double, std::milli>(d).count();
+    };
+    auto t0 = clock::now();
+
     // Extract relevant information from Args map
-    uint64_t qp_lanes = args_->uget(remus::QP_LANES);
     uint32_t port = args_->uget(remus::MN_PORT);
 
+    std::vector<internal::pending_conn_t> pending;
+    uint64_t remotes = 0;
     for (const auto &p : memnodes) {
       if (p.id != self_.id) {
-        for (uint64_t i = 0; i < qp_lanes; ++i) {
-          // Connect, then register the big segment with that connection
-          REMUS_INFO("Connecting to remote machine {}:{} (id = {}) from {}",
-                     p.address, port, p.id, self_.id);
-          auto conn = internal::connect_remote(self_.id, p.id, p.address, port,
-                                               seg_, mrs_);
-
-          // Get the RegionInfo vector
-          auto got = conn->template DeliverVec<internal::RegionInfo>(seg_);
-          if (got.status.t != remus::Ok) {
-            REMUS_FATAL("{}", got.status.message.value());
+        ++remotes;
+        REMUS_INFO("Connecting to remote machine {}:{} (id = {}) from {} with "
+                   "{} QPs",
+                   p.address, port, p.id, self_.id, num_threads_ * qp_lanes_);
+        if (shm_) {
+          // Wait for the MemoryNode to publish its Segments, then map them
+          uint64_t seg_size = 0;
+          auto ris = internal::await_shm_dir(
+              internal::shm_dir_name(port, p.id), seg_size);
+          for (uint64_t i = 0; i < ris.size(); ++i) {
+            shm_segs_.push_back(std::make_unique<internal::Segment>(
+                seg_size, internal::shm_seg_name(port, p.id, i), false));
+            shm_regions_.add(ris[i].raddr, shm_segs_.back()->raw(), seg_size,
+                             ris[i].rkey);
+          }
+          connect_shm(p.id, ris);
+          continue;
+        }
+        // NB: The order of pending matches the order of node_connections_
+        for (uint64_t t = 0; t < num_threads_; ++t) {
+          for (uint64_t i = 0; i < qp_lanes_; ++i) {
+            internal::pending_conn_t pc;
+            pc.mn_id_ = p.id;
+            pc.mn_addr_ = p.address;
+            pc.send_cq_ = [&, t](ibv_context *verbs) {
+              return thread_cq(t, verbs);
+            };
+            pending.push_back(std::move(pc));
           }
-
-          // Save the connection and the regions
-          auto lkey = mrs_.back()->lkey;
-          save_conn(p.id, conn, lkey);
-          for (auto &r : got.val.value())
-            save_region(p.id, r.raddr, r.rkey);
         }
       }
     }
+    if (pending.empty()) {
+      REMUS_INFO("Node {}: Connected to {} remote MemoryNodes in {:.1f} ms",
+                 self_.id, remotes, ms(clock::now() - t0));
+      return;
+    }
+
+    // Give each connection its own part of seg_ to receive its rkeys into
+    size_t recv_len = (seg_.capacity() / pending.size()) & ~63ULL;
+    REMUS_ASSERT(recv_len >= args_->uget(remus::SEGS_PER_MN) *
+                                 sizeof(internal::RegionInfo),
+                 "Not enough Segment space to receive rkeys on {} QPs",
+                 pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+      pending[i].recv_offset_ = i * recv_len;
+    }
+
+    // Connect everything, then get the RegionInfo vector on each connection
+    auto retries = internal::connect_remote_all(
+        self_.id, port, pending, seg_, recv_len, mrs_,
+        args_->uget(remus::MAX_INLINE));
+    auto t1 = clock::now();
+    for (auto &pc : pending) {
+      auto conn = pc.conn_;
+      auto got = conn->template DeliverVec<internal::RegionInfo>(
+          seg_, pc.recv_offset_);
+      if (got.status.t != remus::Ok) {
+        REMUS_FATAL("{}", got.status.message.value());
+      }
+
+      // Save the connection and the regions
+      auto lkey = internal::register_once(seg_, mrs_, conn->pd())->lkey;
+      save_conn(pc.mn_id_, conn, lkey);
+      for (auto &r : got.val.value())
+        save_region(pc.mn_id_, r.raddr, r.rkey);
+    }
+    // Now that the rkeys are in, the RPC receives can be posted
+    for (const auto &p : memnodes) {
+      if (p.id == self_.id) {
+        continue;
+      }
+      for (uint64_t t = 0; t < num_threads_; ++t) {
+        auto conn = rpc_conn(p.id, t);
+        auto mr = internal::register_once(*rpc_seg_, rpc_mrs_, conn->pd());
+        conn->rpc_attach(rpc_bufs(p.id, t) +
+                             internal::kRpcSlots * internal::kRpcBufSize,
+                         mr->lkey);
+      }
+    }
+    auto t2 = clock::now();
+    REMUS_INFO("Node {}: Connected {} QPs to {} remote MemoryNodes in {:.1f} "
+               "ms (handshakes {:.1f} ms with {} retries, rkeys {:.1f} ms)",
+               self_.id, pending.size(), remotes, ms(t2 - t0), ms(t1 - t0),
+               retries, ms(t2 - t1));
   }
 
   /// Register a thread by giving it a buffer and a unique, zero-based Id
@@ -543,6 +1010,14 @@ public:
     return {id, res};
   }
 
+  /// Report the CPU that a ComputeThread should run on
+  ///
+  /// @param tid The id of the ComputeThread
+  /// @return The CPU, or -1 if threads are not pinned (no --cpu-list)
+  int thread_cpu(uint64_t tid) const {
+    return cpus_.empty() ? -1 : cpus_[tid % cpus_.size()];
+  }
+
   /// Report the starting address of the requested Segment
   ///
   /// @param mn_id  TODO
@@ -2,22 +2,33 @@
 
 #include <immintrin.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <coroutine>
+#include <cstring>
+#include <functional>
 #include <list>
 #include <memory>
+#include <optional>
+#include <span>
+#include <sys/uio.h>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "cfg.h"
 #include "compute_node.h"
 #include "connection.h"
 #include "logging.h"
+#include "metrics.h"
 #include "mn_alloc_pol.h"
 #include "qp_sched_pol.h"
 #include "rdma_ops.h"
 #include "rdma_ptr.h"
+#include "read_cache.h"
 #include "ring.h"
+#include "rpc.h"
 #include "util.h"
 
 namespace remus::internal {
@@ -29,6 +40,14 @@ namespace remus::internal {
 /// blocks. It is somewhat amenable to type-preservation, because there is
 /// some room in object headers that a synchronization mechanism can use for
 /// metadata.
+///
+/// Freed blocks of up to ALLOC_MED_THRESH bytes are cached by the thread that
+/// freed them.  Past ALLOC_CACHE_BLOCKS blocks per size class, the oldest ones
+/// go back to a lock-free (Treiber) stack in the ControlBlock of the Segment
+/// they came from, where any thread can take them.  A free stack's head is a
+/// tagged word: a block's offset within the Segment in the low bits, and a
+/// version in the high bits, so that a CAS cannot succeed on a stale head.
+/// Each free block holds the offset of the next one in its first word.
 class BumpAllocator {
   const uint64_t seg_size_; // Size of Segments at each MemoryNode
 
@@ -38,6 +57,34 @@ class BumpAllocator {
   /// A list of "really big" free blocks of memory, as <size, address> pairs
   std::vector<std::pair<uint64_t, uintptr_t>> free_blocks_;
 
+  /// The part of a chunk that has not been handed out yet
+  struct chunk_t {
+    uintptr_t next_ = 0; // The next block to hand out
+    uintptr_t end_ = 0;  // The end of the last whole block in the chunk
+  };
+
+  /// The chunk that each size class is currently carving blocks from
+  std::unordered_map<uint64_t, chunk_t> chunks_;
+
+  /// The size of the chunks to reserve from Segments (0 for no chunks)
+  const uint64_t chunk_size_;
+
+  /// The rest of a free stack that this thread took, and has not handed out
+  struct free_chain_t {
+    uintptr_t seg_ = 0;  // The Segment the blocks are in
+    uint64_t next_ = 0;  // The offset of the next block, or 0 if none are left
+    uint64_t skip_ = 0;  // Misses to serve without looking at a free stack
+  };
+
+  /// The free stack that each size class is currently taking blocks from
+  std::unordered_map<uint64_t, free_chain_t> free_chains_;
+
+  /// The most free blocks of each size class to keep for this thread
+  const uint64_t cache_blocks_;
+
+  /// The number of low bits of a free stack head that hold an offset
+  static constexpr uint64_t FREE_OFFSET_BITS = 40;
+
   /// Requests at or below this size will be rounded to the nearest 64 bytes
   static constexpr uint64_t ALLOC_SMALL_THRESH = 1024;
 
@@ -76,6 +123,11 @@ public:
   /// The policy for deciding with Segment to use when performing an Alloc
   internal::MnAllocPolicy mn_alloc_pol_;
 
+  /// The same policy, but with its own cursor, for picking the Segment whose
+  /// free stack to take.  Probing free stacks must not move mn_alloc_pol_, or
+  /// failed probes would skew where fresh allocations land.
+  internal::MnAllocPolicy recycle_pol_;
+
   /// Compute the desired size for an allocation
   ///
   /// TODO: The following warning is probably a MAJOR BUG
@@ -113,6 +165,80 @@ public:
       std::function<std::atomic<uint64_t> &(uint64_t, uint64_t)> hint_locator,
       std::function<uint64_t(rdma_ptr<uint64_t>, uint64_t)> faa,
       std::function<void(rdma_ptr<uint64_t>, uint64_t)> writer) {
+    uint64_t ptr = reserve_global(size, seg_locator, hint_locator, faa);
+    // This is a fresh allocation, so set the size and zero the padding
+    writer(rdma_ptr<uint64_t>(ptr + offsetof(header_t, size_)), size);
+    writer(rdma_ptr<uint64_t>(ptr + offsetof(header_t, padding_)), 0);
+    return ptr + HEADER_SIZE;
+  }
+
+  /// Try to carve a region of memory out of this thread's chunk for its size
+  /// class, reserving and formatting a new chunk if the current one is used up
+  ///
+  /// NB: A chunk comes from a single Segment, so the allocation policy picks a
+  ///     Segment per chunk, not per allocation.
+  ///
+  /// @param size The desired size of the region.  This should be computed via
+  ///             compute_size(), so it includes the header
+  /// @param seg_locator  A lambda for getting the base of a Segment
+  /// @param hint_locator A lambda for getting the hint for a Segment
+  /// @param faa          A lambda for doing an RDMA fetch-and-add
+  /// @param formatter    A lambda that writes the header of every block in a
+  ///                     fresh chunk, given the chunk, its size, and the
+  ///                     size of its blocks
+  ///
+  /// @return A region of memory, or none if size classes of this size are not
+  ///         carved from chunks
+  std::optional<uintptr_t> try_allocate_chunk(
+      std::size_t size, std::function<uint64_t(uint64_t, uint64_t)> seg_locator,
+      std::function<std::atomic<uint64_t> &(uint64_t, uint64_t)> hint_locator,
+      std::function<uint64_t(rdma_ptr<uint64_t>, uint64_t)> faa,
+      std::function<void(uintptr_t, uint64_t, uint64_t)> formatter) {
+    if (size > ALLOC_MED_THRESH || size > chunk_size_) {
+      return {};
+    }
+    auto &chunk = chunks_[size];
+    if (chunk.next_ + size > chunk.end_) {
+      uintptr_t base = reserve_global(chunk_size_, seg_locator, hint_locator,
+                                      faa);
+      formatter(base, chunk_size_, size);
+      chunk.next_ = base;
+      chunk.end_ = base + chunk_size_ / size * size;
+    }
+    uintptr_t ptr = chunk.next_;
+    chunk.next_ += size;
+    return ptr + HEADER_SIZE;
+  }
+
+  /// Write the header of every block in a fresh chunk into a local image of the
+  /// chunk, so that a single write can format the whole chunk
+  ///
+  /// @param image      A zeroed local buffer of chunk_size bytes
+  /// @param chunk_size The size of the chunk
+  /// @param size       The size of the chunk's blocks, including the header
+  static void format_chunk(uint8_t *image, uint64_t chunk_size,
+                           uint64_t size) {
+    for (uint64_t off = 0; off + size <= chunk_size; off += size) {
+      auto header = (header_t *)(image + off);
+      header->size_.store(size, std::memory_order_relaxed);
+      header->padding_.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  /// Reserve a fresh region of memory from one of the slabs, without writing
+  /// its header
+  ///
+  /// @param size The desired size of the region, including any headers
+  /// @param seg_locator  A lambda for getting the base of a Segment
+  /// @param hint_locator A lambda for getting the hint for a Segment
+  /// @param faa          A lambda for doing an RDMA fetch-and-add
+  ///
+  /// @return The start of the region
+  uintptr_t reserve_global(
+      std::size_t size, std::function<uint64_t(uint64_t, uint64_t)> seg_locator,
+      std::function<std::atomic<uint64_t> &(uint64_t, uint64_t)> hint_locator,
+      std::function<uint64_t(rdma_ptr<uint64_t>, uint64_t)> faa) {
     while (true) {
       // Get a MemoryNode and Segment on which to try to allocate
       //
@@ -143,15 +269,12 @@ public:
       do {
       } while ((curr_hint <= new_hint) &&
                !hint.compare_exchange_strong(curr_hint, new_hint));
-      // This is a fresh allocation, so set the size and zero the padding
-      uint64_t ptr = base + offset;
-      writer(rdma_ptr<uint64_t>(ptr + offsetof(header_t, size_)), size);
-      writer(rdma_ptr<uint64_t>(ptr + offsetof(header_t, padding_)), 0);
-      return ptr + HEADER_SIZE;
+      return base + offset;
     }
     REMUS_FATAL("Out of memory"); // This is actually unreachable
   }
 
+public:
   /// Try to allocate from a freelist
   ///
   /// @param size The desired size of the region.  This should be computed via
@@ -187,10 +310,128 @@ public:
         freelist.pop_back();
         return ptr + HEADER_SIZE;
       }
+      // Then try the rest of the current chunk, which is already formatted
+      auto &chunk = chunks_[size];
+      if (chunk.next_ + size <= chunk.end_) {
+        uintptr_t ptr = chunk.next_;
+        chunk.next_ += size;
+        return ptr + HEADER_SIZE;
+      }
     }
     return {};
   }
 
+  /// Report if blocks of a size are recycled through free stacks
+  ///
+  /// @param size The size of the block, including the header
+  bool recyclable(uint64_t size) {
+    return calculate_slabclass(size) <= ALLOC_MED_THRESH;
+  }
+
+  /// Compute the index of a (recyclable) size class among the free stacks
+  ///
+  /// @param slabclass The size class
+  static constexpr size_t class_index(uint64_t slabclass) {
+    return slabclass <= ALLOC_SMALL_THRESH ? slabclass / 64 - 1
+                                           : slabclass / 1024 + 14;
+  }
+
+  /// Compute the Segment that a block is in
+  ///
+  /// @param block The (raw) address of the block
+  uintptr_t seg_of(uintptr_t block) { return block & ~(seg_size_ - 1); }
+
+  /// Compute the address of a Segment's free stack for a size
+  ///
+  /// @param seg  The (raw) base address of the Segment
+  /// @param size The size of the block, including the header
+  uintptr_t free_stack(uintptr_t seg, uint64_t size) {
+    return seg + offsetof(ControlBlock, free_stacks_) +
+           class_index(calculate_slabclass(size)) * sizeof(uint64_t);
+  }
+
+  /// Extract the offset of the top block from a free stack head
+  ///
+  /// @param head The free stack head
+  static uint64_t head_offset(uint64_t head) {
+    return head & ((1ULL << FREE_OFFSET_BITS) - 1);
+  }
+
+  /// Make the free stack head that replaces `head`, given the offset of the
+  /// new top block (0 for an empty stack)
+  ///
+  /// @param head   The free stack head being replaced
+  /// @param offset The offset of the new top block
+  static uint64_t next_head(uint64_t head, uint64_t offset) {
+    return (((head >> FREE_OFFSET_BITS) + 1) << FREE_OFFSET_BITS) | offset;
+  }
+
+  /// Get the free stack that a size class is taking blocks from
+  ///
+  /// @param size The size of the block, including the header
+  free_chain_t &free_chain(uint64_t size) {
+    return free_chains_[calculate_slabclass(size)];
+  }
+
+  /// Note that a size class found a free stack empty.  Stacks only grow when
+  /// some thread's cache overflows, which takes at least cache_blocks_ frees,
+  /// so the class's next cache_blocks_ misses skip the stacks rather than
+  /// paying a remote read to find them empty again.
+  ///
+  /// @param size The size of the block, including the header
+  void free_stack_empty(uint64_t size) {
+    free_chain(size).skip_ = cache_blocks_;
+  }
+
+  /// Take the oldest cached blocks of a size class, if the cache is over its
+  /// limit, so that they can be returned to their Segments
+  ///
+  /// @param size The size of the block, including the header
+  /// @return The blocks (addresses of their headers) to return, if any
+  std::vector<uint64_t> take_overflow(uint64_t size) {
+    std::vector<uint64_t> overflow;
+    uint64_t slabclass = calculate_slabclass(size);
+    if (slabclass > ALLOC_MED_THRESH) [[unlikely]] {
+      return overflow;
+    }
+    auto &freelist = freelists_[slabclass];
+    if (freelist.size() > cache_blocks_) {
+      // Keep the newest half of the cache, since those are likely to be hot
+      auto keep = cache_blocks_ / 2;
+      auto end = freelist.end() - keep;
+      overflow.assign(freelist.begin(), end);
+      freelist.erase(freelist.begin(), end);
+    }
+    return overflow;
+  }
+
+  /// Take every cached block of a size class, including the rest of its chunk,
+  /// so that they can be returned to their Segments
+  ///
+  /// @param slabclass The size class
+  /// @return The blocks (addresses of their headers) to return
+  std::vector<uint64_t> take_cached(uint64_t slabclass) {
+    std::vector<uint64_t> cached;
+    cached.swap(freelists_[slabclass]);
+    auto &chunk = chunks_[slabclass];
+    for (; chunk.next_ + slabclass <= chunk.end_; chunk.next_ += slabclass) {
+      cached.push_back(chunk.next_);
+    }
+    return cached;
+  }
+
+  /// Report every recyclable size class
+  static std::vector<uint64_t> size_classes() {
+    std::vector<uint64_t> classes;
+    for (uint64_t i = 64; i <= ALLOC_SMALL_THRESH; i += 64) {
+      classes.push_back(i);
+    }
+    for (uint64_t i = 2048; i <= ALLOC_MED_THRESH; i += 1024) {
+      classes.push_back(i);
+    }
+    return classes;
+  }
+
   /// Reclaim by putting the pointer into the appropriate freelist
   ///
   /// @warning This assumes the caller read the size from ptr
@@ -222,7 +463,15 @@ public:
   ///
   /// @param args The arguments to the program
   BumpAllocator(std::shared_ptr<ArgMap> args)
-      : seg_size_(1ULL << args->uget(SEG_SIZE)), mn_alloc_pol_(args) {
+      : seg_size_(1ULL << args->uget(SEG_SIZE)),
+        chunk_size_(args->uget(ALLOC_CHUNK_SIZE)),
+        cache_blocks_(args->uget(ALLOC_CACHE_BLOCKS)), mn_alloc_pol_(args),
+        recycle_pol_(args) {
+    REMUS_ASSERT(args->uget(SEG_SIZE) <= FREE_OFFSET_BITS,
+                 "{} can be at most {}, for the free stacks", SEG_SIZE,
+                 FREE_OFFSET_BITS);
+    static_assert(class_index(ALLOC_MED_THRESH) + 1 == kNumSizeClasses,
+                  "ControlBlock needs one free stack per size class");
     // initialize freelists
     //
     // TODO:  Reclaim() assumes they're not initialized, and initializes them
@@ -240,8 +489,6 @@ public:
 
 namespace remus {
 ///
-/// TODO: Need to implement the metrics
-///
 /// TODO: Check destructors and documentation
 ///
 /// TODO: [ys] all rdma ops can be called with any possible interleaving,
@@ -250,6 +497,20 @@ namespace remus {
 /// TODO: ComputeThread has a ton of sub-classes in it.  Why?  What purpose do
 ///       they serve?
 
+/// @brief A word and a version, which DoubleCompareAndSwap() updates as a unit
+/// @details
+/// RDMA atomics are only 8 bytes, so a 16-byte CAS is emulated: the low bit of
+/// version_ is a lock that the updater holds while it writes val_.  Hence
+/// versions must be even, and every update must change the version.
+///
+/// @tparam T The type of the word (e.g., an rdma_ptr)
+template <typename T>
+  requires(sizeof(T) == 8)
+struct alignas(16) versioned_word_t {
+  T val_;            // The word
+  uint64_t version_; // Its version (even, unless an update is in progress)
+};
+
 /// @brief A ComputeThread is a thread that can perform RDMA operations
 /// @details
 /// ComputeThread is a per-node object that, once configured, provides all of
@@ -289,6 +550,10 @@ protected:
     /// @return A pointer to the std::atomic<int> counter at index idx_
     std::atomic<int> *val() { return &ct_->op_counters_[idx_]; }
 
+    /// @brief Returns the work request slot associated with this op_counter
+    /// @return A reference to the send_wr_slot_t at index idx_
+    internal::send_wr_slot_t &slot() { return ct_->send_wr_slots_[idx_]; }
+
     /// @brief Destructs the op_counter_t object
     ~op_counter_t() {
       ///       REMUS_DEBUG("Debug: ~op_counter_t idx = {}", idx_);
@@ -345,7 +610,8 @@ protected:
     ComputeThread *const ct_; // Pointer to the parent ComputeThread
     const size_t size_;       // Size of the allocated buffer in bytes
     const size_t align_;      // Alignment of the buffer in bytes
-    uint8_t *buf_;            // Pointer to the acquired buffer from ring_buf_t
+    uint8_t *buf_;            // Pointer to the acquired buffer from the ring
+    uint64_t idx_;            // The buffer's slot in the ring
 
     /// @brief Constructs a staging_buf_t object
     /// @param ct The ComputeThread this staging_buf_t is associated with
@@ -353,28 +619,26 @@ protected:
     /// @param align The alignment of the buffer in bytes
     staging_buf_t(ComputeThread *const ct, const size_t size,
                   const size_t align)
-        : ct_(ct), size_(size), align_(align),
-          buf_(ring_buf_t::acquire(
-              ct_->staging_buf_, ct_->staging_buf_end, ct_->staging_buf_start,
-              ct_->staging_buf_size_, ct_->staging_buf_allocations_, size_,
-              align_)) {}
+        : ct_(ct), size_(size), align_(align) {
+      auto res = ct_->acquire_staging(size_, align_);
+      buf_ = res.buf_;
+      idx_ = res.idx_;
+    }
 
     /// @brief Returns a pointer to the staging buffer
     /// @return A pointer to the staging buffer
     uint8_t *val() {
       REMUS_ASSERT(buf_, "staging buf is not enough");
-      REMUS_ASSERT(buf_ >= ct_->staging_buf_ &&
-                       buf_ + size_ <=
-                           ct_->staging_buf_ + ct_->staging_buf_size_,
+      REMUS_ASSERT(ct_->staging_ring_.contains(buf_, size_),
                    "Staging buf out of range");
       return buf_;
     }
 
     /// @brief Destructs the staging_buf_t object
     ~staging_buf_t() {
-      ring_buf_t::release(buf_, ct_->staging_buf_allocations_,
-                          ct_->staging_buf_start, ct_->staging_buf_,
-                          ct_->staging_buf_size_);
+      if (buf_) {
+        ct_->staging_ring_.release(idx_);
+      }
     }
   };
 
@@ -384,35 +648,34 @@ protected:
     ComputeThread *const ct_; // Pointer to the parent ComputeThread
     const size_t size_;       // Size of the allocated buffer in bytes
     const size_t align_;      // Alignment of the buffer in bytes
-    uint8_t *buf_;            // Pointer to the acquired buffer from ring_buf_t
+    uint8_t *buf_;            // Pointer to the acquired buffer from the ring
+    uint64_t idx_;            // The buffer's slot in the ring
 
     /// @brief Constructs a seq_staging_buf_t object
     /// @param ct The Co mputeThread this staging_buf_t is associated with
     /// @param size The size of the buffer to acquire in bytes
     /// @param align The alignment of the buffer in bytes
     seq_staging_buf_t(ComputeThread *ct, const size_t size, const size_t align)
-        : ct_(ct), size_(size), align_(align),
-          buf_(ring_buf_t::acquire(
-              ct_->staging_buf_, ct_->staging_buf_end, ct_->staging_buf_start,
-              ct_->staging_buf_size_, ct_->staging_buf_allocations_, size_,
-              align_)) {}
+        : ct_(ct), size_(size), align_(align) {
+      auto res = ct_->acquire_staging(size_, align_);
+      buf_ = res.buf_;
+      idx_ = res.idx_;
+    }
 
     /// @brief Returns a pointer to the staging buffer
     /// @return A pointer to the staging buffer
     uint8_t *val() {
       REMUS_ASSERT(buf_, "seq staging buf is not enough");
-      REMUS_ASSERT(buf_ >= ct_->staging_buf_ &&
-                       buf_ + size_ <=
-                           ct_->staging_buf_ + ct_->staging_buf_size_,
+      REMUS_ASSERT(ct_->staging_ring_.contains(buf_, size_),
                    "Staging buf out of range");
       return buf_;
     }
 
     /// @brief Destructs the staging_buf_t object
     ~seq_staging_buf_t() {
-      ring_buf_t::release(buf_, ct_->staging_buf_allocations_,
-                          ct_->staging_buf_start, ct_->staging_buf_,
-                          ct_->staging_buf_size_);
+      if (buf_) {
+        ct_->staging_ring_.release(idx_);
+      }
     }
   };
 
@@ -421,7 +684,8 @@ protected:
     ComputeThread *const ct_; // Pointer to the parent ComputeThread
     const size_t size_;       // Size of the allocated buffer
     const size_t align_;      // Alignment of the buffer
-    uint8_t *buf_;            // Pointer to the acquired buffer from ring_buf_t
+    uint8_t *buf_;            // Pointer to the acquired buffer from the ring
+    uint64_t idx_;            // The buffer's slot in the ring
 
     /// @brief Constructs a cached_buf_t object to acquire a buffer from the
     /// right buffer
@@ -431,18 +695,18 @@ protected:
     /// @param al The alignment of the buffer in bytes
     cached_buf_t(ComputeThread *const parent_ct, const size_t sz,
                  const size_t al)
-        : ct_(parent_ct), size_(sz), align_(al),
-          buf_(ring_buf_t::acquire(
-              parent_ct->cached_buf_, parent_ct->cached_buf_end,
-              parent_ct->cached_buf_start, parent_ct->cached_buf_size_,
-              parent_ct->cached_buf_allocations_, sz, al)) {}
+        : ct_(parent_ct), size_(sz), align_(al) {
+      auto res = ct_->cached_ring_.acquire(size_, align_);
+      buf_ = res.buf_;
+      idx_ = res.idx_;
+    }
 
     /// @brief Constructs a cached_buf_t object by moving from another
     /// cached_buf_t
     /// @param other The other cached_buf_t to move from
     cached_buf_t(cached_buf_t &&other) noexcept
         : ct_(other.ct_), size_(other.size_), align_(other.align_),
-          buf_(other.buf_) {
+          buf_(other.buf_), idx_(other.idx_) {
       other.buf_ =
           nullptr; // Critical: Moved-from object no longer owns the buffer
     }
@@ -450,9 +714,7 @@ protected:
     /// @brief Destructs the cached_buf_t object
     ~cached_buf_t() {
       if (buf_) {
-        ring_buf_t::release(buf_, ct_->cached_buf_allocations_,
-                            ct_->cached_buf_start, ct_->cached_buf_,
-                            ct_->cached_buf_size_);
+        ct_->cached_ring_.release(idx_);
       }
     }
 
@@ -462,9 +724,7 @@ protected:
       REMUS_ASSERT(buf_, "cached_buf_t::val() called on a null buffer "
                          "(moved-from or failed acquire?)");
       if (buf_) { // Only assert range if buf is not null
-        REMUS_ASSERT(buf_ >= ct_->cached_buf_ &&
-                         buf_ + size_ <=
-                             ct_->cached_buf_ + ct_->cached_buf_size_,
+        REMUS_ASSERT(ct_->cached_ring_.contains(buf_, size_),
                      "Cached buf out of range");
       }
       return buf_;
@@ -480,23 +740,24 @@ protected:
       if (this != &other) {
         // Release current resource, if any and owned
         if (buf_) {
-          ring_buf_t::release(buf_, ct_->cached_buf_allocations_,
-                              ct_->cached_buf_start, ct_->cached_buf_,
-                              ct_->cached_buf_size_);
+          ct_->cached_ring_.release(idx_);
         }
         buf_ = other.buf_;
+        idx_ = other.idx_;
         other.buf_ = nullptr;
       }
       return *this;
     }
   };
 
-  /// @brief A ComputeThead's staging buffer allocations map
-  std::unordered_map<uint8_t *, ring_buf_t::buf_allocation_t>
-      staging_buf_allocations_;
-  /// @brief A ComputeThread's cached buffer allocations map
-  std::unordered_map<uint8_t *, ring_buf_t::buf_allocation_t>
-      cached_buf_allocations_;
+  /// @brief The most staging (or cached) buffers a ComputeThread may hold at
+  /// once
+  static constexpr size_t kMaxLiveBufs = 1 << 12;
+
+  /// @brief A ComputeThread's staging buffer manager
+  flat_ring_buf_t staging_ring_;
+  /// @brief A ComputeThread's cached buffer manager
+  flat_ring_buf_t cached_ring_;
   /// @brief A ComputeThread's staging buffer manager
   std::unordered_map<uint8_t *, cached_buf_t> cached_buf_manager_;
 
@@ -510,25 +771,55 @@ protected:
   ///
   /// TODO: Add underscore to end of field names
   struct Lane {
-    const uint32_t lane_idx;                            // TODO
-    std::vector<std::atomic<size_t>> &lane_op_counters; // TODO
+    const uint32_t lane_idx;                      // TODO
+    internal::lane_counter_t *lane_op_counters; // The thread's lanes to the MN
+    uint64_t wrs_ = 0; // The work requests that this Lane counts on the lane
 
     /// @brief Constructs a Lane object, which represents an single RDMA channel
     /// @param lane_idx The index of the lane in the vector of lanes
-    /// @param lane_op_counters_ A reference to the vector of operation counters
-    Lane(const uint32_t lane_idx,
-         std::vector<std::atomic<size_t>> &lane_op_counters_)
+    /// @param lane_op_counters_ The op counters of the thread's lanes to the
+    ///                          MemoryNode (see ComputeNode::lane_ops())
+    /// @param wrs The number of work requests to count on the lane
+    Lane(const uint32_t lane_idx, internal::lane_counter_t *lane_op_counters_,
+         uint64_t wrs = 1)
         : lane_idx(lane_idx), lane_op_counters(lane_op_counters_) {
-      if (lane_op_counters[lane_idx].fetch_add((uint64_t)1) + 1 >=
+      add(wrs);
+    }
+
+    /// @brief Count more work requests on the lane, until the Lane is
+    /// destroyed (or drop() is called)
+    /// @param wrs The number of work requests
+    void add(uint64_t wrs) {
+      if (lane_op_counters[lane_idx].ops_.fetch_add(wrs) + wrs >=
           remus::internal::kMaxWr) {
         REMUS_FATAL("lane_op_counters[{}] is greater than kMaxWr = {}, please "
                     "increase kMaxWr",
                     lane_idx, remus::internal::kMaxWr);
       }
+      wrs_ += wrs;
+    }
+
+    /// @brief Stop counting work requests that have completed
+    /// @param wrs The number of work requests
+    void drop(uint64_t wrs) {
+      lane_op_counters[lane_idx].ops_.fetch_sub(wrs);
+      wrs_ -= wrs;
+    }
+
+    /// @brief Returns the number of work requests that can still be counted
+    /// on a lane
+    /// @param lane_op_counters The op counters of the thread's lanes to a
+    ///                         MemoryNode
+    /// @param lane_idx The index of the lane
+    static uint64_t room(const internal::lane_counter_t *lane_op_counters,
+                         uint32_t lane_idx) {
+      uint64_t ops = lane_op_counters[lane_idx].ops_.load();
+      uint64_t max = remus::internal::kMaxWr - 1;
+      return ops >= max ? 0 : max - ops;
     }
 
     /// @brief Returns the operation counter for this lane
-    ~Lane() { lane_op_counters[lane_idx].fetch_sub((uint64_t)1); }
+    ~Lane() { lane_op_counters[lane_idx].ops_.fetch_sub(wrs_); }
   };
 
   /// @brief A seq_send_wrs_t is a collection of send work requests for a
@@ -536,9 +827,14 @@ protected:
   struct seq_send_wrs_t {
     /// @brief A send work request for a specific operation,
     /// containing the work request and scatter-gather entry
+    ///
+    /// NB: These point into the send_wr_slots_ of the op_counter that this
+    ///     sequence holds for the operation, so they live until the sequence
+    ///     is erased.
     struct send_wr_t {
-      std::shared_ptr<ibv_send_wr> wr;
-      std::shared_ptr<ibv_sge> sge;
+      ibv_send_wr *wr;
+      ibv_sge *sge;
+      uint8_t *result; // Where a value-returning op lands, or nullptr
     };
     bool posted = false;
     std::unique_ptr<seq_idx_t> seq_idx;
@@ -564,20 +860,13 @@ protected:
   std::vector<uint64_t> seq_op_counter_start;
   std::vector<uint64_t> seq_op_counter_end;
   std::vector<std::unordered_map<uint32_t, seq_send_wrs_t>> seq_send_wrs;
+  /// Preallocated work requests, one per op_counter slot
+  std::vector<internal::send_wr_slot_t> send_wr_slots_;
 
   /// The policy for deciding which QP to use when connecting to a MemoryNode
   internal::QpSchedPolicy qp_sched_pol_;
   internal::BumpAllocator allocator; // The allocator
 
-  uint64_t staging_buf_size_;
-  uint64_t cached_buf_size_;
-  uint8_t *staging_buf_start;
-  uint8_t *staging_buf_end;
-  uint8_t *cached_buf_start;
-  uint8_t *cached_buf_end;
-  uint8_t *staging_buf_;
-  uint8_t *cached_buf_;
-
 public:
   /// Construct a ComputeThread
   ///
@@ -596,33 +885,73 @@ public:
                                        ring_counter_t::State::AVAILABLE)),
         seq_op_counter_start(args->uget(CN_OPS_PER_THREAD), 0),
         seq_op_counter_end(args->uget(CN_OPS_PER_THREAD), 0),
-        seq_send_wrs(args->uget(CN_OPS_PER_THREAD)), qp_sched_pol_(args),
-        allocator(args) {
+        seq_send_wrs(args->uget(CN_OPS_PER_THREAD)),
+        send_wr_slots_(args->uget(CN_OPS_PER_THREAD)), qp_sched_pol_(args),
+        allocator(args), metrics_(args->bget(METRICS)) {
     // TODO:  This would be much simpler if we could extract id_ from an
     //        initializer.  Consider switching to a factory?
     auto registration = compute_node_->register_thread();
     id_ = registration.first;
     auto seg_size_ = 1ULL << (args->uget(CN_THREAD_BUFSZ));
     auto seg_slice_ = registration.second;
-    staging_buf_size_ = seg_size_ >> 1;
-    staging_buf_ = seg_slice_;
-    staging_buf_start = staging_buf_;
-    staging_buf_end = staging_buf_start;
-    cached_buf_size_ = seg_size_ >> 1;
-    cached_buf_ = seg_slice_ + staging_buf_size_;
-    cached_buf_start = cached_buf_;
-    cached_buf_end = cached_buf_start;
+    // The first half of the slice is for staging, the second for caching
+    staging_ring_ = flat_ring_buf_t(seg_slice_, seg_size_ >> 1, kMaxLiveBufs);
+    cached_ring_ = flat_ring_buf_t(seg_slice_ + (seg_size_ >> 1),
+                                   seg_size_ >> 1, kMaxLiveBufs);
     REMUS_INFO("Created thread #{}", id_);
+    signal_every_ = args_->uget(CN_SIGNAL_EVERY);
+    bulk_chunk_ = args_->uget(CN_BULK_CHUNK);
+    REMUS_ASSERT(bulk_chunk_ > 0 && bulk_chunk_ <= UINT32_MAX,
+                 "{} must be between 1 and {}", CN_BULK_CHUNK, UINT32_MAX);
+    auto window = args_->uget(CN_BULK_WINDOW);
+    REMUS_ASSERT(window > 0 && 2 * window < (uint64_t)internal::kMaxWr,
+                 "{} must be between 1 and {}", CN_BULK_WINDOW,
+                 (internal::kMaxWr - 1) / 2);
+    bulk_chunks_ = std::vector<bulk_chunk_t>(window);
+    REMUS_ASSERT(signal_every_ > 0 &&
+                     2 * signal_every_ < (uint64_t)internal::kMaxWr,
+                 "{} must be between 1 and {}", CN_SIGNAL_EVERY,
+                 (internal::kMaxWr - 1) / 2);
 
     // Select the scheduling policies to use
     qp_sched_pol_.set_policy(
         internal::QpSchedPolicy::to_policy(args_->sget(QP_SCHED_POL)), id_);
+    qp_sched_pol_.set_loads(
+        compute_node_->lane_ops(args_->uget(FIRST_MN_ID), id_),
+        args_->uget(CN_THREADS) * args_->uget(QP_LANES));
     allocator.mn_alloc_pol_.set_policy(
         internal::MnAllocPolicy::to_policy(args->sget(ALLOC_POL)), args_, id_);
+    allocator.recycle_pol_.set_policy(
+        internal::MnAllocPolicy::to_policy(args->sget(ALLOC_POL)), args_, id_);
+
+    // Find where this thread's RPCs to each MemoryNode go
+    uint64_t m0 = args_->uget(FIRST_MN_ID), mn = args_->uget(LAST_MN_ID);
+    rpc_chans_ = std::vector<rpc_chan_t>(mn - m0 + 1);
+    for (uint64_t i = m0; i <= mn; ++i) {
+      auto &ch = rpc_chans_[i - m0];
+      ch.mn_id_ = i;
+      ch.conn_ = compute_node_->rpc_conn(i, id_);
+      ch.conn_ = ch.conn_->has_rpc() ? ch.conn_ : nullptr;
+      ch.bufs_ = compute_node_->rpc_bufs(i, id_);
+    }
   }
 
+  /// @brief Pin the calling thread to this ComputeThread's CPU
+  /// @details
+  /// A ComputeThread is usually constructed on one thread and used on another,
+  /// so the thread that uses it should call this before doing anything else.
+  /// Its buffers were placed on that CPU's NUMA node.  Without a --cpu-list,
+  /// this does nothing.
+  void pin() { internal::pin_thread(compute_node_->thread_cpu(id_)); }
+
   /// @brief Destructor for ComputeThread
   ~ComputeThread() {
+    // Finish this thread's writes, so that their staging buffers are released
+    Flush();
+    // Finish this thread's RPCs, so that no response arrives after it is gone
+    rpc_drain();
+    // Give back this thread's free blocks, so that other threads can use them
+    return_all_free_blocks();
     // send shutdown to all memory nodes's first segment's control block's
     // control_flag_
     for (uint64_t i = 0;
@@ -633,6 +962,9 @@ public:
       FetchAndAdd(control_flag, 1);
     }
     REMUS_ASSERT(no_leak_detected(), "Leak detected");
+    if (args_->bget(METRICS)) {
+      REMUS_INFO("ComputeThread {} metrics:\n{}", id_, metrics_.to_string());
+    }
     REMUS_INFO("ComputeThread {} shutdown", id_);
   }
 
@@ -644,21 +976,33 @@ public:
   /// @tparam T The type of the object to read
   /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
   /// @param fence If true, a fence is issued after the read operation
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the read is done locally without RDMA
   /// @return The object read from the RDMA heap
-  template <typename T> T Read(rdma_ptr<T> ptr, bool fence = true) {
+  template <typename T>
+  T Read(rdma_ptr<T> ptr, bool fence = true, bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      T val;
+      local_read(&val, ptr.address(), sizeof(T));
+      metrics_.count(Metrics::READ, sizeof(T));
+      return val;
+    }
     /// Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
     auto staging_buf = staging_buf_t(this, sizeof(T), alignof(T)).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
     internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
                          op_counter, sizeof(T), true, fence);
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::READ, t0, sizeof(T));
     return *(T *)staging_buf;
   }
 
@@ -672,21 +1016,104 @@ public:
   /// @param seg A pointer to the segment where the data will be read into
   /// @param fence If true, a fence is issued after the read operation
   /// @param size The size of the object to read, defaults to sizeof(T)
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the read is done locally without RDMA
   template <typename T>
   void Read(rdma_ptr<T> ptr, T *seg, bool fence = true,
-            size_t size = sizeof(T)) {
+            size_t size = sizeof(T), bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      local_read(seg, ptr.address(), size);
+      metrics_.count(Metrics::READ, size);
+      return;
+    }
     /// Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     uint32_t rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
     internal::ReadConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
                          op_counter, size, true, fence);
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::READ, t0, size);
+  }
+
+  /// @brief Read a fixed-sized object, using the ComputeNode's read cache
+  /// @details
+  /// An IMMUTABLE object is read from the RDMA heap once, and then served from
+  /// the cache until it is evicted.  A VERSIONED object keeps a seqlock-style
+  /// version in its first 8 bytes: writers make it odd before changing the
+  /// object, and then make it a new even value.  A cached copy is only used if
+  /// an 8-byte read of the remote version matches it.  Otherwise, the object
+  /// is read again, until its version is even and unchanged by the time the
+  /// read finishes, and then re-cached.  Without a cache (--cn-cache-size 0),
+  /// this is just Read().
+  /// @tparam mode How the cached copy may be reused
+  /// @tparam T    The type of the object to read
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @return The object
+  template <CacheMode mode = IMMUTABLE, typename T>
+  T CachedRead(rdma_ptr<T> ptr) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "CachedRead() copies objects as bytes");
+    auto cache = compute_node_->read_cache();
+    if (cache == nullptr) {
+      return Read(ptr);
+    }
+    auto &cm = metrics_.cache();
+    T val;
+    uint64_t version = 0;
+    if constexpr (mode == IMMUTABLE) {
+      if (cache->get(ptr.raw(), &val, sizeof(T), version)) {
+        ++cm.hits_;
+        cm.bytes_saved_ += sizeof(T);
+        return val;
+      }
+      ++cm.misses_;
+      val = Read(ptr);
+      cache->put(ptr.raw(), &val, sizeof(T), 0);
+      return val;
+    } else {
+      static_assert(sizeof(T) >= sizeof(uint64_t),
+                    "A VERSIONED object starts with an 8-byte version");
+      if (cache->get(ptr.raw(), &val, sizeof(T), version)) {
+        if (Read(rdma_ptr<uint64_t>(ptr.raw())) == version) {
+          ++cm.hits_;
+          cm.bytes_saved_ += sizeof(T) - sizeof(uint64_t);
+          return val;
+        }
+        ++cm.stale_;
+      } else {
+        ++cm.misses_;
+      }
+      // NB: An RDMA read is not atomic, so a copy is only good if no update
+      //     was in progress or happened while the object was being read
+      while (true) {
+        val = Read(ptr);
+        std::memcpy(&version, &val, sizeof(version));
+        if ((version & 1) == 0 &&
+            Read(rdma_ptr<uint64_t>(ptr.raw())) == version) {
+          break;
+        }
+        metrics_.retry(Metrics::READ);
+      }
+      cache->put(ptr.raw(), &val, sizeof(T), version);
+      return val;
+    }
+  }
+
+  /// @brief Drop an object from the ComputeNode's read cache (e.g., before
+  /// reclaiming it)
+  /// @param ptr The rdma_ptr of the object
+  template <typename T> void Uncache(rdma_ptr<T> ptr) {
+    if (auto cache = compute_node_->read_cache()) {
+      cache->erase(ptr.raw());
+    }
   }
 
   /// @brief Write a fixed-sized object to the RDMA heap
@@ -701,26 +1128,32 @@ public:
   void Write(rdma_ptr<T> ptr, const T &val, bool fence = true,
              size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), &val, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), &val, size, fence);
+      metrics_.count(Metrics::WRITE, size);
       return;
     }
     // Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
-    auto staging_buf = staging_buf_t(this, size, alignof(T)).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                          op_counter, size, true, fence);
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
+    // Small writes are copied into the work request, so they need no staging
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(send_wr, sge, ptr, (const uint8_t *)&val,
+                                  rkey, op_counter, size, true, fence);
+    } else {
+      auto staging_buf = staging_buf_t(this, size, alignof(T)).val();
+      internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey,
+                            ci.lkey_, op_counter, size, true, fence);
+    }
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::WRITE, t0, size);
   }
 
   /// @brief An alternative version of Write that allows writing directly into a
@@ -738,49 +1171,270 @@ public:
   void Write(rdma_ptr<T> ptr, T *seg, bool fence = true,
              size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), seg, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), seg, size, fence);
+      metrics_.count(Metrics::WRITE, size);
       return;
     }
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                          op_counter, size, true, fence);
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(send_wr, sge, ptr, (const uint8_t *)seg,
+                                  rkey, op_counter, size, true, fence);
+    } else {
+      internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
+                            op_counter, size, true, fence);
+    }
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::WRITE, t0, size);
+  }
+
+  /// @brief Post a write to the RDMA heap, without waiting for it to finish
+  /// @details
+  /// Only every CN_SIGNAL_EVERY-th of these writes on a QP requests a
+  /// completion.  Since an RC QP completes its requests in order, that
+  /// completion reclaims the send queue slots and staging buffers of all the
+  /// writes before it.  Until Flush() returns, the write may not be visible,
+  /// not even to this thread's other operations, which may use other QPs.
+  /// @tparam T The type of the object to write
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param val The value to write (copied before this returns)
+  /// @param fence If true, the write waits for the QP's earlier operations
+  /// @param size The size of the object to write, defaults to sizeof(T)
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the write is done locally without RDMA
+  template <typename T>
+  void WriteUnsignaled(rdma_ptr<T> ptr, const T &val, bool fence = false,
+                       size_t size = sizeof(T), bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      local_write(ptr.address(), &val, size, fence);
+      metrics_.count(Metrics::WRITE, size);
+      return;
+    }
+    auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
+    auto rkey = compute_node_->get_rkey(ptr.raw());
+    auto conn = ci.conn_.get();
+    ibv_send_wr send_wr;
+    ibv_sge sge;
+    // Small writes are copied into the work request, so they need no staging.
+    // Otherwise, the staging buffer lives until a later completion covers it.
+    uint8_t *staging_buf = nullptr;
+    uint64_t staging_idx = 0;
+    if (size > conn->max_inline()) {
+      auto res = acquire_staging(size, alignof(T));
+      REMUS_ASSERT(res.buf_, "staging buf is not enough");
+      staging_buf = res.buf_;
+      staging_idx = res.idx_;
+    }
+    auto &q = unsignaled_[conn];
+    if (!q.lane_) {
+      q.lane_.emplace(lane.lane_idx, lane.lane_op_counters, 0);
+    }
+    make_room(lane.lane_op_counters, lane.lane_idx, 2);
+    // The write stays counted on its lane until a completion covers it
+    q.lane_->add(1);
+    bool signal = ++q.posted_ == signal_every_;
+    if (signal) {
+      // Keep at most two signals' worth of writes in the send queue
+      unsignaled_retire(conn, q);
+    }
+    if (staging_buf == nullptr) {
+      internal::WriteInlineConfig(send_wr, sge, ptr, (const uint8_t *)&val,
+                                  rkey, &q.ack_, size, signal, fence);
+    } else {
+      q.held_.push_back(staging_idx);
+      internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey,
+                            ci.lkey_, &q.ack_, size, signal, fence);
+    }
+    q.last_ = ptr.raw();
+    q.rkey_ = rkey;
+    if (signal) {
+      unsignaled_signal(conn, q, send_wr);
+    } else {
+      conn->send_onesided(&send_wr);
+    }
+    metrics_.count(Metrics::WRITE, size);
+  }
+
+  /// @brief Wait for every write that WriteUnsignaled() has posted
+  /// @details
+  /// On each QP with writes that no completion covers yet, this posts a
+  /// signaled zero-byte write behind them, and waits for it.
+  void Flush() {
+    for (auto &[conn, q] : unsignaled_) {
+      if (q.posted_ > 0) {
+        unsignaled_retire(conn, q);
+        ibv_send_wr send_wr{};
+        send_wr.wr_id = (uint64_t)&q.ack_;
+        send_wr.opcode = IBV_WR_RDMA_WRITE;
+        send_wr.send_flags = IBV_SEND_SIGNALED;
+        send_wr.wr.rdma.remote_addr = rdma_ptr<uint8_t>(q.last_).address();
+        send_wr.wr.rdma.rkey = q.rkey_;
+        q.lane_->add(1);
+        ++q.posted_;
+        unsignaled_signal(conn, q, send_wr);
+      }
+      unsignaled_retire(conn, q);
+    }
+  }
+
+  /// @brief Read one contiguous range of the RDMA heap into several local
+  /// buffers, in order
+  /// @details
+  /// The buffers become the scatter-gather list of one work request, or of
+  /// several if there are more than the device allows in one READ.  A buffer
+  /// outside this thread's registered memory (i.e., not from local_allocate())
+  /// is read into a staging buffer first, and then copied out.
+  /// @tparam T The type of the remote object
+  /// @param ptr The rdma_ptr pointing to the first byte of the range
+  /// @param iov The local buffers, whose lengths add up to the range's size
+  /// @param fence If true, a fence is issued before the read
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the read is done locally without RDMA
+  template <typename T>
+  void ReadV(rdma_ptr<T> ptr, std::span<const iovec> iov, bool fence = true,
+             bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      size_t off = 0;
+      for (auto &v : iov) {
+        local_read(v.iov_base, ptr.address() + off, v.iov_len);
+        off += v.iov_len;
+      }
+      metrics_.count(Metrics::READ, off);
+      return;
+    }
+    vectored(ptr, iov, IBV_WR_RDMA_READ, fence);
+  }
+
+  /// @brief Write several local buffers, in order, to one contiguous range of
+  /// the RDMA heap
+  /// @details
+  /// The buffers become the scatter-gather list of one work request, or of
+  /// several if there are more than kMaxSge of them, so a record whose parts
+  /// live in separate buffers needs neither a copy nor a write per part.  A
+  /// buffer outside this thread's registered memory (i.e., not from
+  /// local_allocate()) is copied into a staging buffer first.
+  /// @tparam T The type of the remote object
+  /// @param ptr The rdma_ptr pointing to the first byte of the range
+  /// @param iov The local buffers, whose lengths add up to the range's size
+  /// @param fence If true, a fence is issued before the write
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the write is done locally without RDMA
+  template <typename T>
+  void WriteV(rdma_ptr<T> ptr, std::span<const iovec> iov, bool fence = true,
+              bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      size_t off = 0;
+      for (size_t i = 0; i < iov.size(); ++i) {
+        // Only the last piece needs the fence
+        local_write(ptr.address() + off, iov[i].iov_base, iov[i].iov_len,
+                    fence && i + 1 == iov.size());
+        off += iov[i].iov_len;
+      }
+      metrics_.count(Metrics::WRITE, off);
+      return;
+    }
+    vectored(ptr, iov, IBV_WR_RDMA_WRITE, fence);
+  }
+
+  /// @brief Read a large object into local memory, in chunks that are
+  /// striped across every lane to its MemoryNode
+  /// @details
+  /// The object is split into CN_BULK_CHUNK-byte chunks.  Chunk i goes on lane
+  /// (i mod QP_LANES), and at most CN_BULK_WINDOW chunks are in flight at
+  /// once.  If `seg` is in this thread's registered memory (i.e., from
+  /// local_allocate()), the chunks land in it directly.  Otherwise, each
+  /// chunk is read into a staging buffer and then copied out, and the window
+  /// shrinks to what fits in the staging buffer.
+  /// @tparam T The type of the object to read
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param seg Where to put the object
+  /// @param size The size of the object, defaults to sizeof(T)
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the read is done locally without RDMA
+  template <typename T>
+  void BulkRead(rdma_ptr<T> ptr, T *seg, size_t size = sizeof(T),
+                bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      local_read(seg, ptr.address(), size);
+      metrics_.count(Metrics::READ, size);
+      return;
+    }
+    bulk(ptr, (uint8_t *)seg, size, IBV_WR_RDMA_READ);
+  }
+
+  /// @brief Write a large object from local memory, in chunks that are
+  /// striped across every lane to its MemoryNode
+  /// @details
+  /// The chunks, window and staging are as in BulkRead().
+  /// @tparam T The type of the object to write
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param seg The object
+  /// @param size The size of the object, defaults to sizeof(T)
+  /// @param local_copy If true and the address is local to the machine,
+  ///                   the write is done locally without RDMA
+  template <typename T>
+  void BulkWrite(rdma_ptr<T> ptr, const T *seg, size_t size = sizeof(T),
+                 bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      local_write(ptr.address(), seg, size, true);
+      metrics_.count(Metrics::WRITE, size);
+      return;
+    }
+    bulk(ptr, (uint8_t *)seg, size, IBV_WR_RDMA_WRITE);
   }
+
   /// @brief Perform a CompareAndSwap on the RDMA heap
   /// @tparam T The type of the object to compare and swap
   /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
   /// @param expected The expected value to compare against
   /// @param swap The value to swap in if the expected value matches
   /// @param fence If true, a fence is issued after the compare and swap
+  /// @param local_copy If true, the address is local to the machine, and the
+  ///                   CPU's atomics are coherent with the RNIC's, the CAS is
+  ///                   done locally without RDMA
   /// @return The CAS result of type T
   template <typename T>
     requires(sizeof(T) <= 8)
-  T CompareAndSwap(rdma_ptr<T> ptr, T expected, T swap, bool fence = true) {
+  T CompareAndSwap(rdma_ptr<T> ptr, T expected, T swap, bool fence = true,
+                   bool local_copy = true) {
+    if (local_copy && is_local_atomic(ptr)) {
+      T old = local_cas(ptr, expected, swap);
+      metrics_.count(Metrics::CAS, sizeof(T));
+      if (old != expected) {
+        metrics_.retry(Metrics::CAS);
+      }
+      return old;
+    }
     // Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
     auto staging_buf = staging_buf_t(this, sizeof(T), alignof(T)).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
     internal::CompareAndSwapConfig(send_wr, sge, ptr, (uint64_t)expected,
                                    (uint64_t)swap, (uint64_t *)staging_buf,
                                    rkey, ci.lkey_, op_counter, true, fence);
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::CAS, t0, sizeof(T));
+    if (*(T *)staging_buf != expected) {
+      metrics_.retry(Metrics::CAS);
+    }
     return *(T *)staging_buf;
   }
 
@@ -789,104 +1443,669 @@ public:
   /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
   /// @param add The value to add to the object
   /// @param fence If true, a fence is issued after the fetch and add
+  /// @param local_copy If true, the address is local to the machine, and the
+  ///                   CPU's atomics are coherent with the RNIC's, the FAA is
+  ///                   done locally without RDMA
   /// @return The value before the addition of type T
   template <typename T>
     requires(sizeof(T) <= 8)
-  T FetchAndAdd(rdma_ptr<T> ptr, uint64_t add, bool fence = true) {
+  T FetchAndAdd(rdma_ptr<T> ptr, uint64_t add, bool fence = true,
+                bool local_copy = true) {
+    if (local_copy && is_local_atomic(ptr)) {
+      metrics_.count(Metrics::FAA, sizeof(T));
+      return local_faa(ptr, add);
+    }
     // Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
     auto staging_buf = staging_buf_t(this, sizeof(T), alignof(T)).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
+    auto &send_wr = op.slot().wr_;
+    auto &sge = op.slot().sge_;
     internal::FetchAndAddConfig(send_wr, sge, ptr, add, (uint64_t *)staging_buf,
                                 rkey, ci.lkey_, op_counter, true, fence);
+    auto t0 = metrics_.start();
     internal::Post(send_wr, ci.conn_.get(), op_counter);
     internal::Poll(ci.conn_.get(), op_counter, ptr);
+    metrics_.record(Metrics::FAA, t0, sizeof(T));
     return *(T *)staging_buf;
   }
 
-  /// NB: ensure all ptrs in seq belong to the same memory segment
+  /// @brief Perform a CompareAndSwap that only compares and swaps some bits
+  /// @details
+  /// The word changes to (word & ~swap_mask) | (swap & swap_mask) if the bits
+  /// in compare_mask match `expected`.  Bits outside of compare_mask may change
+  /// concurrently without making this fail.  RNICs without masked atomics (and
+  /// the verbs API in general) can't do this in one operation, so it is a CAS
+  /// loop: `expected` (all of it) is the first guess at the word, so a good
+  /// guess saves a round trip.
+  ///
+  /// @tparam T The type of the word
+  /// @param ptr          The rdma_ptr pointing to the word in the RDMA heap
+  /// @param expected     The bits to compare against (and a guess at the rest)
+  /// @param compare_mask The bits of the word that must match `expected`
+  /// @param swap         The bits to swap in
+  /// @param swap_mask    The bits of the word to replace with `swap`
+  /// @param fence        If true, each CAS is fenced
+  /// @return The value of the word that the decision was based on.  It
+  ///         succeeded iff that value matches `expected` under compare_mask.
   template <typename T>
-  std::optional<std::vector<T>> ReadSeq(rdma_ptr<T> ptr, bool signal = false,
-                                        bool fence = false) {
-    auto coro_idx =
-        0; // because we don't support more than one top level coroutine
-    auto seq_idx = find_seq_idx(ptr, coro_idx);
-    auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
-    auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto staging_buf_ptr =
-        std::make_unique<seq_staging_buf_t>(this, sizeof(T), alignof(T));
-    auto staging_buf = staging_buf_ptr->val();
-    REMUS_ASSERT(staging_buf != nullptr,
-                 "Staging buffer is not enough, increase the staging buffers "
-                 "or reduce the number of requests");
-    seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
-        std::move(staging_buf_ptr));
-    auto op_counter_ptr = std::make_unique<op_counter_t>(this);
-    auto op_counter = op_counter_ptr->val();
-    seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
-        std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
-    if (!signal) {
-      internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
-                           nullptr, sizeof(T), signal, fence);
-      return std::nullopt;
+    requires(sizeof(T) == 8)
+  T MaskedCompareAndSwap(rdma_ptr<T> ptr, T expected, uint64_t compare_mask,
+                         T swap, uint64_t swap_mask, bool fence = true) {
+    auto wptr = rdma_ptr<uint64_t>(ptr.raw());
+    uint64_t exp, swp;
+    std::memcpy(&exp, &expected, sizeof(T));
+    std::memcpy(&swp, &swap, sizeof(T));
+    uint64_t cur = exp;
+    while (((cur ^ exp) & compare_mask) == 0) {
+      uint64_t next = (cur & ~swap_mask) | (swp & swap_mask);
+      uint64_t old = CompareAndSwap(wptr, cur, next, fence);
+      if (old == cur) {
+        break;
+      }
+      cur = old;
     }
-    link_seq_send_wrs(seq_idx, coro_idx);
-    internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
-                         op_counter, sizeof(T), signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
-                   ci.conn_.get(), op_counter);
-    seq_send_wrs[coro_idx][seq_idx].posted = true;
-    std::vector<T> result;
-    internal::Poll(ci.conn_.get(), op_counter, ptr);
-    get_seq_op_result<T>(seq_idx, coro_idx, result);
-    seq_send_wrs[coro_idx].erase(seq_idx);
-    return result;
+    T res;
+    std::memcpy(&res, &cur, sizeof(T));
+    return res;
   }
 
-  // this is a special version that allows read to seg.
-  /// NB: Although this can be used interleaved with other read/write_seq
-  /// operations, results of read by calling this function won't be in the
-  /// result vector.
+  /// @brief Perform a FetchAndAdd within one bit-field of a word, so that a
+  /// carry out of the field is dropped instead of changing the next field
+  /// @details
+  /// If the field is the word's most significant bits, the RNIC's FetchAndAdd
+  /// already does this.  Otherwise it is a CAS loop (see MaskedCompareAndSwap).
+  ///
+  /// @tparam T The type of the word
+  /// @param ptr        The rdma_ptr pointing to the word in the RDMA heap
+  /// @param add        The value to add, already shifted into the field
+  /// @param field_mask The (contiguous) bits of the field
+  /// @param fence      If true, each operation is fenced
+  /// @return The value of the word before the addition
   template <typename T>
-  std::optional<std::vector<T>> ReadSeq(rdma_ptr<T> ptr, T *seg,
+    requires(sizeof(T) == 8)
+  T MaskedFetchAndAdd(rdma_ptr<T> ptr, uint64_t add, uint64_t field_mask,
+                      bool fence = true) {
+    REMUS_ASSERT(field_mask != 0 && (add & ~field_mask) == 0,
+                 "The addend 0x{:x} is not within the field 0x{:x}", add,
+                 field_mask);
+    uint64_t low = field_mask & -field_mask;
+    REMUS_ASSERT(((field_mask + low) & field_mask) == 0,
+                 "The field 0x{:x} is not contiguous", field_mask);
+    auto wptr = rdma_ptr<uint64_t>(ptr.raw());
+    uint64_t cur;
+    if (field_mask + low == 0) {
+      cur = FetchAndAdd(wptr, add, fence); // The carry leaves the word
+    } else {
+      cur = Read(wptr);
+      while (true) {
+        uint64_t next = (cur & ~field_mask) | (((cur & field_mask) + add) &
+                                               field_mask);
+        uint64_t old = CompareAndSwap(wptr, cur, next, fence);
+        if (old == cur) {
+          break;
+        }
+        cur = old;
+      }
+    }
+    T res;
+    std::memcpy(&res, &cur, sizeof(T));
+    return res;
+  }
+
+  /// @brief Read a versioned_word_t consistently, waiting out any update that
+  /// is in progress
+  /// @details
+  /// An RDMA read of 16 bytes is not guaranteed to be atomic, so this is a
+  /// seqlock read: the version is read before and after the pair, and the pair
+  /// is only used if all three versions agree and are even.  (Re-reading the
+  /// version only afterwards is not enough: val_ precedes version_, so a whole
+  /// update can land between the two halves of the pair's read.)
+  ///
+  /// @tparam T The type of the word
+  /// @param ptr The rdma_ptr pointing to the pair in the RDMA heap
+  /// @return The word and its version
+  template <typename T>
+  versioned_word_t<T> DoubleRead(rdma_ptr<versioned_word_t<T>> ptr) {
+    auto vptr = rdma_ptr<uint64_t>(ptr.raw() +
+                                   offsetof(versioned_word_t<T>, version_));
+    while (true) {
+      auto before = Read(vptr);
+      if ((before & 1) == 0) {
+        auto v = Read(ptr);
+        if (v.version_ == before && Read(vptr) == before) {
+          return v;
+        }
+      }
+      metrics_.retry(Metrics::READ);
+    }
+  }
+
+  /// @brief Emulate a 16-byte CompareAndSwap of a word and its version
+  /// @details
+  /// The version is locked with a CAS (which is where concurrent updates
+  /// conflict), the word is checked and written, and then the new version is
+  /// written, which unlocks it.  So all updates to the pair must use this, and
+  /// readers must use DoubleRead().
+  ///
+  /// NB: This costs 4 round trips, not 1.  A thread that fails while holding
+  ///     the lock leaves the pair locked.
+  ///
+  /// @tparam T The type of the word
+  /// @param ptr      The rdma_ptr pointing to the pair in the RDMA heap
+  /// @param expected The pair to compare against.  On failure, it is updated
+  ///                 to the current pair, like std::atomic::compare_exchange.
+  /// @param desired  The pair to swap in.  Its version must be even, and must
+  ///                 differ from expected's.
+  /// @return true if the pair was swapped
+  template <typename T>
+  bool DoubleCompareAndSwap(rdma_ptr<versioned_word_t<T>> ptr,
+                            versioned_word_t<T> &expected,
+                            const versioned_word_t<T> &desired) {
+    REMUS_ASSERT(((expected.version_ | desired.version_) & 1) == 0 &&
+                     expected.version_ != desired.version_,
+                 "Versions must be even, and must change on each update");
+    auto wptr = rdma_ptr<T>(ptr.raw() + offsetof(versioned_word_t<T>, val_));
+    auto vptr = rdma_ptr<uint64_t>(ptr.raw() +
+                                   offsetof(versioned_word_t<T>, version_));
+    if (CompareAndSwap(vptr, expected.version_, expected.version_ | 1) !=
+        expected.version_) {
+      expected = DoubleRead(ptr);
+      return false;
+    }
+    T cur = Read(wptr);
+    if (std::memcmp(&cur, &expected.val_, sizeof(T)) != 0) {
+      Write(vptr, expected.version_); // Unlock, unchanged
+      expected.val_ = cur;
+      return false;
+    }
+    Write(wptr, desired.val_);
+    Write(vptr, desired.version_);
+    return true;
+  }
+
+  /// @brief A builder for one round of one-sided operations to any MemoryNodes
+  /// @details
+  /// Unlike ReadSeq/WriteSeq, whose operations must all target one memory
+  /// segment, a Batch accepts any mix of Read, Write, CompareAndSwap and
+  /// FetchAndAdd, to any MemoryNode.  As for single operations, the QP
+  /// scheduling policy picks a lane for each operation, and operations are
+  /// grouped into one chain per connection (i.e., per node and lane).
+  /// Execute() posts each chain with a single doorbell, signals only the last
+  /// work request of each chain, and then polls the thread's completion queue
+  /// until every chain has completed.  So a round costs one post and one
+  /// completion per connection it uses, regardless of how many operations it
+  /// contains.
+  ///
+  /// Every operation is counted on its lane.  If a chain would outgrow the
+  /// room left in its QP's send queue, its operations so far are posted and
+  /// waited for when the next one is added, so a round may hold more
+  /// operations than kMaxWr.
+  ///
+  /// Results of Read, CompareAndSwap and FetchAndAdd are copied to their `out`
+  /// pointers before Execute() returns.  A Batch can be reused once Execute()
+  /// returns.
+  ///
+  /// With `local_copy`, operations on a co-located MemoryNode are done by the
+  /// CPU as they are added, and their results are ready at once.  They are
+  /// only done so when the CPU's atomics are coherent with the RNIC's, since
+  /// otherwise the atomics would use the loopback QPs, and the CPU's reads and
+  /// writes could pass them.
+  ///
+  /// NB: Operations within a chain follow the usual QP ordering rules (use
+  ///     `fence` where needed).  There is no ordering among chains, and unless
+  ///     the policy always picks the same lane (e.g., MOD), unfenced operations
+  ///     on one node may be in different chains.  A fenced operation is in the
+  ///     chain of the operation on its node that was added just before it.
+  ///
+  /// NB: A Batch holds its lanes and staging buffers from the first operation
+  ///     until Execute(), so it should not be left half-built.
+  class Batch {
+    /// The operations headed for one connection, linked in the order added
+    struct chain_t {
+      uint64_t node_;               // The MemoryNode this chain goes to
+      std::unique_ptr<Lane> lane_;  // The lane (and thus QP), which counts
+                                    // the chain's operations
+      internal::Connection *conn_;  // The connection for that lane
+      uint32_t lkey_;               // The lkey for local buffers
+      ibv_send_wr *head_;           // The first request in the chain
+      ibv_send_wr *tail_;           // The last request in the chain
+      size_t last_op_;              // The round's index of its last operation
+    };
+
+    /// A staged result, and where to copy it once the batch completes
+    struct result_t {
+      uint8_t *src_; // The staging buffer that the RNIC fills
+      void *dst_;    // The caller's destination
+      size_t size_;  // The number of bytes to copy
+    };
+
+    ComputeThread *const ct_; // The ComputeThread that issues this batch
+    const size_t max_ops_;    // The most operations one round may hold
+    const bool local_copy_;   // Are co-located operations done by the CPU?
+    size_t local_ops_ = 0;    // The operations of this round done by the CPU
+
+    /// The work requests, one per operation.
+    ///
+    /// NB: This is reserved up front and never grows, since chains (and
+    ///     inline payloads) point into it.
+    std::vector<internal::send_wr_slot_t> slots_;
+    std::vector<chain_t> chains_; // One chain per connection in use
+    std::vector<std::unique_ptr<staging_buf_t>> staging_bufs_;
+    std::vector<result_t> results_;
+
+    /// Return the chain for the next operation on ptr.  A fenced operation
+    /// joins the chain of the previous operation on ptr's MemoryNode, so that
+    /// the fence orders it after that operation.  Otherwise, the QP
+    /// scheduling policy picks a lane to the MemoryNode, and the chain for
+    /// that (MemoryNode, lane) is created on first use.  The operation is
+    /// counted on the lane.  If the lane's send queue has no room for it, the
+    /// chain's earlier operations are posted and waited for first.
+    template <typename T> chain_t &chain_for(rdma_ptr<T> ptr, bool fence) {
+      auto lanes = ct_->compute_node_->lane_ops(ptr.id(), ct_->id_);
+      chain_t *chain = nullptr;
+      if (fence) {
+        for (auto &c : chains_) {
+          if (c.node_ == ptr.id() &&
+              (chain == nullptr || c.last_op_ > chain->last_op_)) {
+            chain = &c;
+          }
+        }
+      }
+      if (chain == nullptr) {
+        auto lane_idx = ct_->qp_sched_pol_.get_lane_idx(ptr.id());
+        for (auto &c : chains_) {
+          if (c.node_ == ptr.id() && c.lane_->lane_idx == lane_idx) {
+            chain = &c;
+            break;
+          }
+        }
+        if (chain == nullptr) {
+          auto &ci =
+              ct_->compute_node_->get_conn(ptr.raw(), ct_->id_, lane_idx);
+          chains_.push_back(chain_t{
+              ptr.id(), std::make_unique<Lane>(lane_idx, lanes, 0),
+              ci.conn_.get(), ci.lkey_, nullptr, nullptr, 0});
+          chain = &chains_.back();
+        }
+      }
+      auto lane_idx = chain->lane_->lane_idx;
+      if (Lane::room(lanes, lane_idx) == 0 && chain->head_ != nullptr) {
+        drain(*chain);
+      }
+      ct_->make_room(lanes, lane_idx, 1);
+      chain->lane_->add(1);
+      chain->last_op_ = slots_.size();
+      return *chain;
+    }
+
+    /// Post a chain's operations so far and wait for them, which frees their
+    /// slots in the QP's send queue.  Their results are copied out by
+    /// Execute(), as usual.
+    void drain(chain_t &chain) {
+      auto op = op_counter_t(ct_);
+      auto ack = op.val();
+      chain.tail_->wr_id = (uint64_t)ack;
+      chain.tail_->send_flags |= IBV_SEND_SIGNALED;
+      internal::Post(*chain.head_, chain.conn_, ack);
+      internal::Poll(chain.conn_, ack,
+                     rdma_ptr<uint8_t>((uint16_t)chain.node_, 0ul));
+      chain.lane_->drop(chain.lane_->wrs_);
+      chain.head_ = nullptr;
+      chain.tail_ = nullptr;
+    }
+
+    /// Claim the work request for the next operation
+    internal::send_wr_slot_t &next_slot() {
+      check_full();
+      return slots_.emplace_back();
+    }
+
+    /// Make sure that the round can take another operation
+    void check_full() {
+      REMUS_ASSERT(size() < max_ops_,
+                   "Batch is full ({} ops), execute it or make a larger one",
+                   max_ops_);
+    }
+
+    /// Report if the CPU should do an operation on ptr, and if so, count it
+    template <typename T> bool local(rdma_ptr<T> ptr, size_t bytes) {
+      if (!local_copy_ || !ct_->is_local_atomic(ptr)) {
+        return false;
+      }
+      check_full();
+      ++local_ops_;
+      ct_->metrics_.count(Metrics::BATCH, bytes);
+      return true;
+    }
+
+    /// Claim a staging buffer that lives until the batch completes
+    uint8_t *stage(size_t size, size_t align) {
+      staging_bufs_.push_back(
+          std::make_unique<staging_buf_t>(ct_, size, align));
+      return staging_bufs_.back()->val();
+    }
+
+    /// Append a configured work request to the end of a chain
+    void link(chain_t &chain, internal::send_wr_slot_t &slot) {
+      slot.wr_.next = nullptr;
+      if (chain.tail_ == nullptr) {
+        chain.head_ = &slot.wr_;
+      } else {
+        chain.tail_->next = &slot.wr_;
+      }
+      chain.tail_ = &slot.wr_;
+    }
+
+    /// Release everything that the last round held
+    void clear() {
+      local_ops_ = 0;
+      slots_.clear();
+      chains_.clear();
+      staging_bufs_.clear();
+      results_.clear();
+    }
+
+  public:
+    /// @brief Construct an empty Batch
+    /// @param ct The ComputeThread that will issue the batch
+    /// @param max_ops The most operations that one round may hold
+    /// @param local_copy If true, operations on a co-located MemoryNode are
+    ///                   done without RDMA, when its atomics allow
+    Batch(ComputeThread *ct, size_t max_ops, bool local_copy)
+        : ct_(ct), max_ops_(max_ops), local_copy_(local_copy) {
+      slots_.reserve(max_ops_);
+    }
+
+    /// @brief Add a read of a fixed-sized object
+    /// @tparam T The type of the object to read
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param out Where to put the object, once the batch completes
+    /// @param fence If true, the read waits for prior reads/atomics in its
+    ///              chain
+    /// @param size The size of the object to read, defaults to sizeof(T)
+    template <typename T>
+    void Read(rdma_ptr<T> ptr, T *out, bool fence = false,
+              size_t size = sizeof(T)) {
+      if (local(ptr, size)) {
+        ct_->local_read(out, ptr.address(), size);
+        return;
+      }
+      auto &chain = chain_for(ptr, fence);
+      auto &slot = next_slot();
+      auto staging_buf = stage(size, alignof(T));
+      internal::ReadConfig(slot.wr_, slot.sge_, ptr, staging_buf,
+                           ct_->compute_node_->get_rkey(ptr.raw()),
+                           chain.lkey_, nullptr, size, false, fence);
+      link(chain, slot);
+      results_.push_back({staging_buf, out, size});
+    }
+
+    /// @brief Add a write of a fixed-sized object
+    /// @details
+    /// `val` is copied before this returns (into the work request if it is
+    /// small enough to send inline, otherwise into a staging buffer).
+    /// @tparam T The type of the object to write
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param val The value to write to the RDMA heap
+    /// @param fence If true, the write waits for prior reads/atomics in its
+    ///              chain
+    /// @param size The size of the object to write, defaults to sizeof(T)
+    template <typename T>
+    void Write(rdma_ptr<T> ptr, const T &val, bool fence = false,
+               size_t size = sizeof(T)) {
+      if (local(ptr, size)) {
+        ct_->local_write(ptr.address(), &val, size, fence);
+        return;
+      }
+      auto &chain = chain_for(ptr, fence);
+      auto &slot = next_slot();
+      auto rkey = ct_->compute_node_->get_rkey(ptr.raw());
+      if (size <= std::min<size_t>(chain.conn_->max_inline(),
+                                   sizeof(slot.inline_data_))) {
+        std::memcpy(slot.inline_data_, &val, size);
+        internal::WriteInlineConfig(slot.wr_, slot.sge_, ptr,
+                                    slot.inline_data_, rkey, nullptr, size,
+                                    false, fence);
+      } else {
+        internal::WriteConfig(slot.wr_, slot.sge_, ptr, val,
+                              stage(size, alignof(T)), rkey, chain.lkey_,
+                              nullptr, size, false, fence);
+      }
+      link(chain, slot);
+    }
+
+    /// @brief Add a zero-copy write from a segment
+    /// @details `seg` must stay unchanged until the batch completes.
+    /// @tparam T The type of the object to write
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param seg A pointer to the (local) data to write
+    /// @param fence If true, the write waits for prior reads/atomics in its
+    ///              chain
+    /// @param size The size of the object to write, defaults to sizeof(T)
+    template <typename T>
+    void Write(rdma_ptr<T> ptr, T *seg, bool fence = false,
+               size_t size = sizeof(T)) {
+      if (local(ptr, size)) {
+        ct_->local_write(ptr.address(), seg, size, fence);
+        return;
+      }
+      auto &chain = chain_for(ptr, fence);
+      auto &slot = next_slot();
+      auto rkey = ct_->compute_node_->get_rkey(ptr.raw());
+      if (size <= chain.conn_->max_inline()) {
+        internal::WriteInlineConfig(slot.wr_, slot.sge_, ptr,
+                                    (const uint8_t *)seg, rkey, nullptr, size,
+                                    false, fence);
+      } else {
+        internal::WriteConfig(slot.wr_, slot.sge_, ptr, (uint8_t *)seg, rkey,
+                              chain.lkey_, nullptr, size, false, fence);
+      }
+      link(chain, slot);
+    }
+
+    /// @brief Add a CompareAndSwap
+    /// @tparam T The type of the object to compare and swap
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param expected The expected value to compare against
+    /// @param swap The value to swap in if the expected value matches
+    /// @param out Where to put the prior value once the batch completes, or
+    ///            nullptr to discard it
+    /// @param fence If true, the CAS waits for prior reads/atomics in its chain
+    template <typename T>
+      requires(sizeof(T) <= 8)
+    void CompareAndSwap(rdma_ptr<T> ptr, T expected, T swap, T *out = nullptr,
+                        bool fence = false) {
+      if (local(ptr, sizeof(T))) {
+        T old = ct_->local_cas(ptr, expected, swap);
+        if (out != nullptr) {
+          *out = old;
+        }
+        return;
+      }
+      auto &chain = chain_for(ptr, fence);
+      auto &slot = next_slot();
+      auto staging_buf = stage(sizeof(uint64_t), alignof(uint64_t));
+      internal::CompareAndSwapConfig(
+          slot.wr_, slot.sge_, ptr, (uint64_t)expected, (uint64_t)swap,
+          (uint64_t *)staging_buf, ct_->compute_node_->get_rkey(ptr.raw()),
+          chain.lkey_, nullptr, false, fence);
+      link(chain, slot);
+      if (out != nullptr) {
+        results_.push_back({staging_buf, out, sizeof(T)});
+      }
+    }
+
+    /// @brief Add a FetchAndAdd
+    /// @tparam T The type of the object to fetch and add
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param add The value to add to the object
+    /// @param out Where to put the prior value once the batch completes, or
+    ///            nullptr to discard it
+    /// @param fence If true, the FAA waits for prior reads/atomics in its chain
+    template <typename T>
+      requires(sizeof(T) <= 8)
+    void FetchAndAdd(rdma_ptr<T> ptr, uint64_t add, T *out = nullptr,
+                     bool fence = false) {
+      if (local(ptr, sizeof(T))) {
+        T old = ct_->local_faa(ptr, add);
+        if (out != nullptr) {
+          *out = old;
+        }
+        return;
+      }
+      auto &chain = chain_for(ptr, fence);
+      auto &slot = next_slot();
+      auto staging_buf = stage(sizeof(uint64_t), alignof(uint64_t));
+      internal::FetchAndAddConfig(slot.wr_, slot.sge_, ptr, add,
+                                  (uint64_t *)staging_buf,
+                                  ct_->compute_node_->get_rkey(ptr.raw()),
+                                  chain.lkey_, nullptr, false, fence);
+      link(chain, slot);
+      if (out != nullptr) {
+        results_.push_back({staging_buf, out, sizeof(T)});
+      }
+    }
+
+    /// @brief The number of operations in the current round
+    size_t size() const { return slots_.size() + local_ops_; }
+
+    /// @brief Post every chain, and wait for all of them to complete
+    void Execute() {
+      if (chains_.empty()) {
+        clear();
+        return;
+      }
+      // One op_counter covers the whole batch: each chain signals only its
+      // last request, and each of those completions decrements it once
+      auto op = op_counter_t(ct_);
+      auto ack = op.val();
+      for (auto &c : chains_) {
+        c.tail_->wr_id = (uint64_t)ack;
+        c.tail_->send_flags |= IBV_SEND_SIGNALED;
+      }
+      *ack = chains_.size();
+      auto t0 = ct_->metrics_.start();
+      for (auto &c : chains_) {
+        c.conn_->send_onesided(c.head_);
+      }
+      // NB: All of this thread's connections share its completion queue, so
+      //     polling through any one of them retires every chain
+      internal::Poll(chains_.front().conn_, ack,
+                     rdma_ptr<uint8_t>((uint16_t)chains_.front().node_, 0ul));
+      uint64_t bytes = 0;
+      for (auto &slot : slots_) {
+        bytes += slot.sge_.length;
+      }
+      ct_->metrics_.record(Metrics::BATCH, t0, bytes, slots_.size());
+      for (auto &r : results_) {
+        std::memcpy(r.dst_, r.src_, r.size_);
+      }
+      clear();
+    }
+  };
+
+  /// @brief Start a Batch of one-sided operations
+  /// @param max_ops The most operations one round of the batch may hold.  If
+  ///                0, use CN_WRS_PER_SEQ.
+  /// @param local_copy If true, operations on a co-located MemoryNode are done
+  ///                   without RDMA, when its atomics allow (see Batch)
+  /// @return An empty Batch that issues its operations from this thread
+  Batch batch(size_t max_ops = 0, bool local_copy = true) {
+    return Batch(this, max_ops == 0 ? args_->uget(CN_WRS_PER_SEQ) : max_ops,
+                 local_copy);
+  }
+
+  /// NB: ensure all ptrs in seq belong to the same memory segment
+  template <typename T>
+  std::optional<std::vector<T>> ReadSeq(rdma_ptr<T> ptr, bool signal = false,
+                                        bool fence = false) {
+    auto coro_idx =
+        0; // because we don't support more than one top level coroutine
+    auto seq_idx = find_seq_idx(ptr, coro_idx);
+    auto &ci = compute_node_->get_conn(
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+    auto rkey = compute_node_->get_rkey(ptr.raw());
+    auto staging_buf_ptr =
+        std::make_unique<seq_staging_buf_t>(this, sizeof(T), alignof(T));
+    auto staging_buf = staging_buf_ptr->val();
+    REMUS_ASSERT(staging_buf != nullptr,
+                 "Staging buffer is not enough, increase the staging buffers "
+                 "or reduce the number of requests");
+    seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
+        std::move(staging_buf_ptr));
+    auto op_counter_ptr = std::make_unique<op_counter_t>(this);
+    auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
+    seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
+        std::move(op_counter_ptr));
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, staging_buf});
+    if (!signal) {
+      internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
+                           nullptr, sizeof(T), signal, fence);
+      metrics_.count(Metrics::SEQ, sizeof(T));
+      return std::nullopt;
+    }
+    link_seq_send_wrs(seq_idx, coro_idx);
+    internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
+                         op_counter, sizeof(T), signal, fence);
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+                   ci.conn_.get(), op_counter);
+    seq_send_wrs[coro_idx][seq_idx].posted = true;
+    std::vector<T> result;
+    internal::Poll(ci.conn_.get(), op_counter, ptr);
+    get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, sizeof(T));
+    seq_send_wrs[coro_idx].erase(seq_idx);
+    return result;
+  }
+
+  // this is a special version that allows read to seg.
+  /// NB: Although this can be used interleaved with other read/write_seq
+  /// operations, results of read by calling this function won't be in the
+  /// result vector.
+  template <typename T>
+  std::optional<std::vector<T>> ReadSeq(rdma_ptr<T> ptr, T *seg,
                                         bool signal = false, bool fence = false,
                                         size_t size = sizeof(T)) {
     /// Use the scheduling policy to select the next connection
     auto coro_idx = 0;
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     uint32_t rkey = compute_node_->get_rkey(ptr.raw());
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, nullptr});
     if (!signal) {
       internal::ReadConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
                            nullptr, size, signal, fence);
+      metrics_.count(Metrics::SEQ, size);
       return std::nullopt;
     }
     link_seq_send_wrs(seq_idx, coro_idx);
     internal::ReadConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
     internal::Poll(ci.conn_.get(), op_counter, ptr);
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     return result;
   }
@@ -898,48 +2117,58 @@ public:
            bool fence = false, size_t size = sizeof(T),
            bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), &val, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), &val, size, fence);
+      metrics_.count(Metrics::SEQ, size);
       return std::nullopt;
     }
     auto coro_idx =
         0; // because we don't support more than one top level coroutine
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto staging_buf_ptr =
-        std::make_unique<seq_staging_buf_t>(this, sizeof(T), alignof(T));
-    auto staging_buf = staging_buf_ptr->val();
-    REMUS_ASSERT(staging_buf != nullptr,
-                 "Staging buffer is not enough, increase the staging buffers "
-                 "or reduce the number of requests");
-    seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
-        std::move(staging_buf_ptr));
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &slot = op_counter_ptr->slot();
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&slot.wr_, &slot.sge_, nullptr});
+    if (signal) {
+      link_seq_send_wrs(seq_idx, coro_idx);
+    }
+    auto ack = signal ? op_counter : nullptr;
+    // Small writes are kept in the work request's slot until the sequence is
+    // posted, and then copied into the request, so they need no staging
+    if (size <= std::min<size_t>(ci.conn_->max_inline(),
+                                 sizeof(slot.inline_data_))) {
+      std::memcpy(slot.inline_data_, &val, size);
+      internal::WriteInlineConfig(slot.wr_, slot.sge_, ptr, slot.inline_data_,
+                                  rkey, ack, size, signal, fence);
+    } else {
+      auto staging_buf_ptr =
+          std::make_unique<seq_staging_buf_t>(this, sizeof(T), alignof(T));
+      auto staging_buf = staging_buf_ptr->val();
+      REMUS_ASSERT(staging_buf != nullptr,
+                   "Staging buffer is not enough, increase the staging buffers "
+                   "or reduce the number of requests");
+      seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
+          std::move(staging_buf_ptr));
+      internal::WriteConfig(slot.wr_, slot.sge_, ptr, val, staging_buf, rkey,
+                            ci.lkey_, ack, size, signal, fence);
+    }
     if (!signal) {
-      internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                            nullptr, sizeof(T), signal, fence);
+      metrics_.count(Metrics::SEQ, size);
       return std::nullopt;
     }
-    link_seq_send_wrs(seq_idx, coro_idx);
-    internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
     internal::Poll(ci.conn_.get(), op_counter, ptr);
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     return result;
   }
@@ -950,40 +2179,47 @@ public:
   WriteSeq(rdma_ptr<T> ptr, T *seg, bool signal = false, bool fence = false,
            size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), seg, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), seg, size, fence);
+      metrics_.count(Metrics::SEQ, size);
       return std::nullopt;
     }
     auto coro_idx =
         0; // because we don't support more than one top level coroutine
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
-    if (!signal) {
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, nullptr});
+    if (signal) {
+      link_seq_send_wrs(seq_idx, coro_idx);
+    }
+    auto ack = signal ? op_counter : nullptr;
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(send_wr, sge, ptr, (const uint8_t *)seg, rkey,
+                                  ack, size, signal, fence);
+    } else {
       internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                            nullptr, size, signal, fence);
+                            ack, size, signal, fence);
+    }
+    if (!signal) {
+      metrics_.count(Metrics::SEQ, size);
       return std::nullopt;
     }
-    link_seq_send_wrs(seq_idx, coro_idx);
-    internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
     internal::Poll(ci.conn_.get(), op_counter, ptr);
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     return result;
   }
@@ -993,59 +2229,862 @@ public:
     return ptr.id() == node_id;
   }
 
+  /// @brief Write to memory on this machine, in place of an RDMA write
+  /// @details
+  /// An aligned word is stored atomically, so that it does not tear against
+  /// concurrent atomics.  Under RDMA, every cache line that the write touches
+  /// is then flushed, so that the RNIC reads the new value; the SHM transport
+  /// has no RNIC, so it skips the flush.
+  /// @param addr The (local) address to write to
+  /// @param src The bytes to write
+  /// @param size The number of bytes to write
+  /// @param fence If true, the write is ordered before later stores
+  void local_write(uint64_t addr, const void *src, size_t size, bool fence) {
+    if (size == sizeof(uint64_t) && addr % sizeof(uint64_t) == 0) {
+      uint64_t word;
+      std::memcpy(&word, src, sizeof(word));
+      std::atomic_ref<uint64_t>(*(uint64_t *)addr)
+          .store(word, std::memory_order_release);
+    } else {
+      std::memcpy((void *)addr, src, size);
+    }
+    if (!compute_node_->shm()) {
+      for (uint64_t line = addr & ~63ULL; line < addr + size; line += 64) {
+        _mm_clflush((void *)line);
+      }
+    }
+    if (fence) {
+      _mm_sfence();
+    }
+  }
+
+  /// @brief Read from memory on this machine, in place of an RDMA read
+  /// @details
+  /// An aligned word is loaded atomically, so that it does not tear against
+  /// concurrent atomics.  The CPU's caches are coherent with RDMA writes, so
+  /// nothing needs to be invalidated first.
+  /// @param dst Where to put the bytes
+  /// @param addr The (local) address to read from
+  /// @param size The number of bytes to read
+  void local_read(void *dst, uint64_t addr, size_t size) {
+    if (size == sizeof(uint64_t) && addr % sizeof(uint64_t) == 0) {
+      uint64_t word = std::atomic_ref<uint64_t>(*(uint64_t *)addr)
+                          .load(std::memory_order_acquire);
+      std::memcpy(dst, &word, sizeof(word));
+    } else {
+      std::memcpy(dst, (const void *)addr, size);
+    }
+  }
+
+  /// @brief Determine if an atomic on a rdma_ptr can use the CPU's atomics
+  template <class T> bool is_local_atomic(rdma_ptr<T> ptr) {
+    return is_local(ptr) && compute_node_->local_atomics();
+  }
+
+  /// @brief CompareAndSwap a word on this machine, in place of an RDMA CAS
+  /// @details
+  /// Like an RDMA CAS, this compares and swaps the whole word, which must be
+  /// 8-byte aligned.
+  /// @param ptr The (local) rdma_ptr of the word
+  /// @param expected The expected value to compare against
+  /// @param swap The value to swap in if the expected value matches
+  /// @return The value before the operation
+  template <typename T> T local_cas(rdma_ptr<T> ptr, T expected, T swap) {
+    REMUS_ASSERT(ptr.address() % sizeof(uint64_t) == 0,
+                 "CompareAndSwap on unaligned address 0x{:x}", ptr.address());
+    uint64_t word = (uint64_t)expected;
+    std::atomic_ref<uint64_t>(*(uint64_t *)ptr.address())
+        .compare_exchange_strong(word, (uint64_t)swap);
+    T old;
+    std::memcpy(&old, &word, sizeof(T));
+    return old;
+  }
+
+  /// @brief FetchAndAdd a word on this machine, in place of an RDMA FAA
+  /// @details
+  /// Like an RDMA FAA, this adds to the whole word, which must be 8-byte
+  /// aligned.
+  /// @param ptr The (local) rdma_ptr of the word
+  /// @param add The value to add to the word
+  /// @return The value before the addition
+  template <typename T> T local_faa(rdma_ptr<T> ptr, uint64_t add) {
+    REMUS_ASSERT(ptr.address() % sizeof(uint64_t) == 0,
+                 "FetchAndAdd on unaligned address 0x{:x}", ptr.address());
+    uint64_t word =
+        std::atomic_ref<uint64_t>(*(uint64_t *)ptr.address()).fetch_add(add);
+    T old;
+    std::memcpy(&old, &word, sizeof(T));
+    return old;
+  }
+
   /// @brief Extract the segment id from a rdma_ptr
   template <typename T> uint64_t seg_id(rdma_ptr<T> ptr) {
     return ptr.raw() >> args_->uget(SEG_SIZE);
   }
 
-  /// @brief  Arrive at the global barrier in Segment 0 of MemoryNode 0
+  /// @brief What a thread needs to finish a barrier that it arrived at
+  struct barrier_token_t {
+    uint64_t gen_;   // The node-local phase that the thread arrived in
+    bool leader_;    // Did this thread arrive remotely, for its whole node?
+    uint64_t sense_; // The remote sense that ends the phase (leader only)
+    bool last_;      // Was this thread the last to arrive overall?
+  };
+
+  /// @brief Arrive at the global barrier, without waiting for it
+  /// @details
+  /// The barrier is hierarchical.  The threads of a ComputeNode count their
+  /// arrivals with a local atomic, and only the last of them does an RDMA FAA
+  /// on the barrier word in Segment 0 of MemoryNode 0, for the whole node.
+  /// So each phase costs one FAA per node, rather than one per thread.
+  ///
+  /// Between arrive_barrier() and wait_barrier(), a thread may do work that
+  /// does not depend on the other threads having arrived.
+  ///
+  /// NB: All CN_THREADS threads of every ComputeNode must arrive, and each
+  ///     thread must wait_barrier() before it arrives again.
+  ///
   /// @param total_threads The total number of threads that will arrive at the
   /// barrier
-  /// @return True if this thread was the last to arrive, false otherwise
-  bool arrive_control_barrier(int total_threads) {
+  /// @return The token to pass to wait_barrier()
+  barrier_token_t arrive_barrier(uint64_t total_threads) {
+    auto &local = compute_node_->local_barrier_;
+    // NB: Use the configured count, since sibling ComputeThreads may not all
+    //     be registered yet
+    uint64_t local_threads = args_->uget(CN_THREADS);
+    barrier_token_t token{local.gen_.load(std::memory_order_acquire), false,
+                          0, false};
+    if (local.arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 <
+        local_threads) {
+      return token;
+    }
+    // This node's last arrival resets the local count (no thread can arrive
+    // again until gen_ advances), and arrives remotely for the whole node.
+    // The count is in the high bits of the barrier word, and the low bit is
+    // the "sense" of the current phase.
+    local.arrived_.store(0, std::memory_order_relaxed);
+    token.leader_ = true;
     auto barrier =
         rdma_ptr<uint64_t>(compute_node_->get_seg_start(0, 0) +
                            offsetof(internal::ControlBlock, barrier_));
-    // Arrive via a simple increment, use low bit to get the next "sense"
-    auto was = FetchAndAdd(barrier, 2);
-    uint64_t new_sense = 1 - (was & 1);
-    // If the preceding FAA was the last one, reset the barrier, otherwise spin
-    if ((was >> 1) == (total_threads - 1)) {
-      Write(barrier, new_sense);
-      return true;
+    auto was = FetchAndAdd(barrier, 2 * local_threads);
+    token.sense_ = 1 - (was & 1);
+    REMUS_ASSERT((was >> 1) + local_threads <= total_threads,
+                 "More than {} threads arrived at the barrier", total_threads);
+    // If this was the last arrival, reset the barrier, which releases the
+    // other nodes
+    if ((was >> 1) + local_threads == total_threads) {
+      Write(barrier, token.sense_);
+      token.last_ = true;
     }
-    while ((Read(barrier) & 1) != new_sense) {
+    return token;
+  }
+
+  /// @brief Wait for every thread to arrive at the barrier
+  /// @details
+  /// Only a node's leader reads the remote barrier word, with an exponential
+  /// backoff between reads.  The other threads of the node spin on a local
+  /// atomic, which the leader advances.
+  ///
+  /// @param token The token that arrive_barrier() returned
+  void wait_barrier(const barrier_token_t &token) {
+    auto &local = compute_node_->local_barrier_;
+    if (!token.leader_) {
+      while (local.gen_.load(std::memory_order_acquire) == token.gen_) {
+        _mm_pause();
+      }
+      return;
+    }
+    if (!token.last_) {
+      auto barrier =
+          rdma_ptr<uint64_t>(compute_node_->get_seg_start(0, 0) +
+                             offsetof(internal::ControlBlock, barrier_));
+      // NB: Back off between reads, so that the leaders do not flood MemoryNode
+      //     0's NIC while the other nodes are still arriving
+      constexpr uint64_t kMaxPauses = 1024;
+      uint64_t pauses = 1;
+      while ((Read(barrier) & 1) != token.sense_) {
+        for (uint64_t i = 0; i < pauses; ++i) {
+          _mm_pause();
+        }
+        pauses = std::min(pauses * 2, kMaxPauses);
+      }
+    }
+    local.gen_.fetch_add(1, std::memory_order_release);
+  }
+
+  /// @brief  Arrive at the global barrier in Segment 0 of MemoryNode 0, and
+  /// wait for every other thread to arrive
+  /// @param total_threads The total number of threads that will arrive at the
+  /// barrier
+  /// @return True if this thread was the last to arrive, false otherwise
+  bool arrive_control_barrier(int total_threads) {
+    auto token = arrive_barrier(total_threads);
+    wait_barrier(token);
+    return token.last_;
+  }
+
+protected:
+  /// @brief An RPC batch to one MemoryNode
+  /// @details
+  /// A batch is OPEN while requests are added to it, SENT until its response
+  /// batch arrives, and then DONE until every result has been claimed (or
+  /// dropped).  Then it is FREE to be reused, and gen_ changes, so that a
+  /// stale rpc_result_t cannot claim from the new batch.
+  struct rpc_batch_t {
+    enum state_t { FREE, OPEN, SENT, DONE };
+    state_t state_ = FREE;       // Where the batch is in its lifetime
+    uint64_t gen_ = 0;           // The number of times it has been opened
+    uint32_t bytes_ = 0;         // The size of the request batch
+    uint32_t resp_bytes_ = 0;    // The most that the responses can take
+    uint32_t unclaimed_ = 0;     // The results that are not yet claimed
+    uint64_t t0_ = 0;            // When it was sent
+    std::atomic<int> ack_{0};    // The completion of its send
+    std::vector<uint32_t> ops_;  // The handler of each request
+    std::vector<uint32_t> offs_; // Where each response starts in resp_
+    std::vector<uint8_t> resp_;  // The response batch
+  };
+
+  /// @brief This thread's RPC state for one MemoryNode
+  /// @details
+  /// Batch i is built in send buffer i, so there are never more than
+  /// kRpcSlots batches in flight, which is how many receives each side has.
+  struct rpc_chan_t {
+    uint16_t mn_id_ = 0;                   // The MemoryNode
+    internal::Connection *conn_ = nullptr; // The connection, or null if the
+                                           // handlers are run directly
+    uint8_t *bufs_ = nullptr;              // The kRpcSlots send buffers
+    int open_ = -1;                        // The OPEN batch, if any
+    std::array<rpc_batch_t, internal::kRpcSlots> batches_;
+  };
+
+  /// The RPC state for each MemoryNode, indexed by (id - FIRST_MN_ID)
+  std::vector<rpc_chan_t> rpc_chans_;
+
+  /// Find the RPC state for a MemoryNode
+  rpc_chan_t &rpc_chan(uint16_t mn_id) {
+    uint64_t idx = mn_id - rpc_chans_[0].mn_id_;
+    REMUS_ASSERT(idx < rpc_chans_.size(), "{} is not a MemoryNode", mn_id);
+    return rpc_chans_[idx];
+  }
+
+  /// Open a batch, waiting for an in-flight batch to finish if necessary
+  rpc_batch_t &rpc_open(rpc_chan_t &ch) {
+    while (true) {
+      bool sent = false;
+      for (uint32_t i = 0; i < internal::kRpcSlots; ++i) {
+        auto &b = ch.batches_[i];
+        if (b.state_ == rpc_batch_t::FREE) {
+          // NB: The send buffer may still be in use until the send completes
+          if (ch.conn_ != nullptr) {
+            internal::Poll(ch.conn_, &b.ack_, rdma_ptr<uint8_t>());
+          }
+          b.state_ = rpc_batch_t::OPEN;
+          ++b.gen_;
+          b.bytes_ = b.resp_bytes_ = sizeof(internal::rpc_batch_hdr_t);
+          b.unclaimed_ = 0;
+          b.ops_.clear();
+          ch.open_ = i;
+          return b;
+        }
+        sent |= b.state_ == rpc_batch_t::SENT;
+      }
+      REMUS_ASSERT(sent,
+                   "All {} RPC batches to MemoryNode {} have unclaimed results",
+                   internal::kRpcSlots, ch.mn_id_);
+      rpc_progress(ch);
+    }
+  }
+
+  /// Send the OPEN batch (or, without a connection, run it directly)
+  void rpc_send(rpc_chan_t &ch) {
+    auto &b = ch.batches_[ch.open_];
+    auto buf = ch.bufs_ + ch.open_ * internal::kRpcBufSize;
+    internal::rpc_batch_hdr_t hdr{(uint32_t)b.ops_.size(), b.bytes_,
+                                  (uint32_t)ch.open_, 0};
+    std::memcpy(buf, &hdr, sizeof(hdr));
+    ch.open_ = -1;
+    b.state_ = rpc_batch_t::SENT;
+    b.t0_ = metrics_.start();
+    if (ch.conn_ == nullptr) {
+      auto server = compute_node_->local_rpc();
+      REMUS_ASSERT(server != nullptr,
+                   "No RPC path to co-located MemoryNode {}: pass its "
+                   "rpc_server() to connect_local()",
+                   ch.mn_id_);
+      b.resp_.resize(internal::kRpcMaxBatch);
+      b.resp_.resize(server->serve(buf, b.bytes_, b.resp_.data()));
+      rpc_complete(ch, b);
+      return;
+    }
+    b.ack_ = 1;
+    ch.conn_->rpc_send(buf, b.bytes_, &b.ack_);
+  }
+
+  /// Index a batch's responses, once they have arrived
+  void rpc_complete(rpc_chan_t &ch, rpc_batch_t &b) {
+    b.offs_.clear();
+    uint32_t pos = sizeof(internal::rpc_batch_hdr_t);
+    for (size_t i = 0; i < b.ops_.size(); ++i) {
+      internal::rpc_msg_hdr_t m;
+      std::memcpy(&m, b.resp_.data() + pos, sizeof(m));
+      b.offs_.push_back(pos);
+      pos += internal::rpc_msg_bytes(m.len_);
+    }
+    REMUS_ASSERT(pos == b.resp_.size(), "Malformed RPC response from {}",
+                 ch.mn_id_);
+    metrics_.record(Metrics::RPC, b.t0_, b.bytes_ + b.resp_.size(),
+                    b.ops_.size());
+    b.state_ = b.unclaimed_ == 0 ? rpc_batch_t::FREE : rpc_batch_t::DONE;
+  }
+
+  /// Receive any response batches that have arrived from a MemoryNode, and
+  /// retire the completions of sends
+  void rpc_progress(rpc_chan_t &ch) {
+    uint32_t slot, len;
+    const uint8_t *msg;
+    while (ch.conn_->rpc_recv(slot, msg, len)) {
+      internal::rpc_batch_hdr_t hdr;
+      std::memcpy(&hdr, msg, sizeof(hdr));
+      REMUS_ASSERT(hdr.tag_ < internal::kRpcSlots &&
+                       ch.batches_[hdr.tag_].state_ == rpc_batch_t::SENT,
+                   "Unexpected RPC response from {}", ch.mn_id_);
+      auto &b = ch.batches_[hdr.tag_];
+      b.resp_.assign(msg, msg + len);
+      ch.conn_->rpc_repost(slot);
+      rpc_complete(ch, b);
+    }
+    internal::PollBatch(ch.conn_, rdma_ptr<uint8_t>());
+  }
+
+  /// Find a result's batch, checking that it has not been reused
+  rpc_batch_t &rpc_batch(uint16_t mn_id, uint32_t batch, uint64_t gen) {
+    auto &b = rpc_chan(mn_id).batches_[batch];
+    REMUS_ASSERT(b.gen_ == gen && b.state_ != rpc_batch_t::FREE,
+                 "RPC result used after its batch was reused");
+    return b;
+  }
+
+  /// Make progress on a result's batch, sending it if it is OPEN
+  ///
+  /// @return true if the batch's responses have arrived
+  bool rpc_ready(uint16_t mn_id, uint32_t batch, uint64_t gen) {
+    auto &ch = rpc_chan(mn_id);
+    auto &b = rpc_batch(mn_id, batch, gen);
+    if (b.state_ == rpc_batch_t::OPEN) {
+      rpc_send(ch);
+    }
+    if (b.state_ == rpc_batch_t::SENT) {
+      rpc_progress(ch);
+    }
+    return b.state_ == rpc_batch_t::DONE;
+  }
+
+  /// Wait for a result's batch to finish
+  void rpc_wait(uint16_t mn_id, uint32_t batch, uint64_t gen) {
+    while (!rpc_ready(mn_id, batch, gen)) {
+    }
+  }
+
+  /// Give up on a result, without claiming it
+  void rpc_release(uint16_t mn_id, uint32_t batch, uint64_t gen) {
+    auto &b = rpc_batch(mn_id, batch, gen);
+    if (--b.unclaimed_ == 0 && b.state_ == rpc_batch_t::DONE) {
+      b.state_ = rpc_batch_t::FREE;
+    }
+  }
+
+  /// Wait for a result, copy it out, and release it
+  void rpc_claim(uint16_t mn_id, uint32_t batch, uint64_t gen, uint32_t idx,
+                 void *out, uint32_t size) {
+    rpc_wait(mn_id, batch, gen);
+    auto &b = rpc_batch(mn_id, batch, gen);
+    internal::rpc_msg_hdr_t m;
+    std::memcpy(&m, b.resp_.data() + b.offs_[idx], sizeof(m));
+    REMUS_ASSERT(m.op_ != internal::kRpcNoHandler,
+                 "MemoryNode {} has no RPC handler {}", mn_id, b.ops_[idx]);
+    REMUS_ASSERT(m.len_ == size, "RPC {} returned {} bytes, not {}",
+                 b.ops_[idx], m.len_, size);
+    std::memcpy(out, b.resp_.data() + b.offs_[idx] + sizeof(m), size);
+    rpc_release(mn_id, batch, gen);
+  }
+
+  /// Send every OPEN batch, and wait for every batch in flight
+  void rpc_drain() {
+    for (auto &ch : rpc_chans_) {
+      if (ch.open_ >= 0) {
+        rpc_send(ch);
+      }
+      for (auto &b : ch.batches_) {
+        while (b.state_ == rpc_batch_t::SENT) {
+          rpc_progress(ch);
+        }
+        if (ch.conn_ != nullptr) {
+          internal::Poll(ch.conn_, &b.ack_, rdma_ptr<uint8_t>());
+        }
+      }
+    }
+  }
+
+  /// Park a coroutine that co_awaits an RPC result, if a scheduler is running
+  /// it (see SimpleAsyncComputeThread).  False means that nothing will resume
+  /// it, so it must wait by polling.
+  std::function<bool(uint16_t, uint32_t, uint64_t, std::coroutine_handle<>)>
+      rpc_park_;
+
+private:
+  /// @brief This thread's WriteUnsignaled() state for one QP
+  /// @details
+  /// held_ has the staging buffers of the writes since the last signaled one.
+  /// When a signaled write is posted, they (and its own) move to retiring_,
+  /// and are released once ack_ reaches zero.  Likewise, lane_ counts every
+  /// write that is still in the send queue, and the retiring_wrs_ of them
+  /// that ack_ covers are dropped with it.
+  struct unsignaled_qp_t {
+    std::atomic<int> ack_{0};        // The in-flight signaled write, if any
+    uint64_t posted_ = 0;            // Writes posted since the last signal
+    uint64_t last_ = 0;              // The raw rdma_ptr of the last write
+    uint32_t rkey_ = 0;              // The rkey of the last write
+    std::vector<uint64_t> held_;     // Staging buffers of unsignaled writes
+    std::vector<uint64_t> retiring_; // Staging buffers that ack_ covers
+    std::optional<Lane> lane_;       // The QP's lane
+    uint64_t retiring_wrs_ = 0;      // The writes that ack_ covers
+  };
+
+  /// The WriteUnsignaled() state of each QP that this thread has used for it
+  std::unordered_map<internal::Connection *, unsignaled_qp_t> unsignaled_;
+
+  /// The number of unsignaled writes per signaled one (CN_SIGNAL_EVERY)
+  uint64_t signal_every_;
+
+  /// Wait for a QP's in-flight signaled write, and release what it covers
+  void unsignaled_retire(internal::Connection *conn, unsignaled_qp_t &q) {
+    internal::Poll(conn, &q.ack_, rdma_ptr<uint8_t>(q.last_));
+    for (auto idx : q.retiring_) {
+      staging_ring_.release(idx);
+    }
+    q.retiring_.clear();
+    if (q.retiring_wrs_ > 0) {
+      q.lane_->drop(q.retiring_wrs_);
+      q.retiring_wrs_ = 0;
+    }
+  }
+
+  /// Post a QP's signaled write, once the previous one has been retired
+  void unsignaled_signal(internal::Connection *conn, unsignaled_qp_t &q,
+                         ibv_send_wr &send_wr) {
+    internal::Post(send_wr, conn, &q.ack_);
+    q.retiring_wrs_ = q.posted_;
+    q.posted_ = 0;
+    q.retiring_.swap(q.held_);
+  }
+
+  /// Make room for `wrs` more work requests on a lane, by finishing this
+  /// thread's unsignaled writes if the lane is too full for them
+  void make_room(internal::lane_counter_t *lanes, uint32_t lane_idx,
+                 uint64_t wrs) {
+    if (Lane::room(lanes, lane_idx) < wrs && !unsignaled_.empty()) {
+      Flush();
+    }
+  }
+
+  /// @brief Acquire a staging buffer
+  /// @details
+  /// WriteUnsignaled() holds its writes' staging buffers until a completion
+  /// covers them, so if the ring is full, this finishes those writes (which
+  /// releases their buffers) and tries again.
+  flat_ring_buf_t::acquired_t acquire_staging(size_t size, size_t align) {
+    auto res = staging_ring_.acquire(size, align);
+    if (res.buf_ == nullptr && !unsignaled_.empty()) {
+      Flush();
+      res = staging_ring_.acquire(size, align);
+    }
+    return res;
+  }
+
+  /// Report if a local buffer is in this thread's registered memory
+  bool registered(const void *buf, size_t size) const {
+    return staging_ring_.contains((const uint8_t *)buf, size) ||
+           cached_ring_.contains((const uint8_t *)buf, size);
+  }
+
+  /// @brief One chunk of a BulkRead() or BulkWrite() that is in flight
+  struct bulk_chunk_t {
+    std::atomic<int> ack_{0};               // The chunk's completion
+    std::optional<Lane> lane_;              // The lane it is on
+    internal::Connection *conn_ = nullptr;  // The lane's connection
+    uint8_t *local_ = nullptr;              // Its place in the local object
+    uint64_t len_ = 0;                      // Its size
+    uint8_t *staging_ = nullptr;            // Its staging buffer, if any
+    uint64_t staging_idx_ = 0;              // The staging buffer's slot
+  };
+
+  /// The window of BulkRead() and BulkWrite().  Chunk i uses slot
+  /// (i mod CN_BULK_WINDOW).
+  std::vector<bulk_chunk_t> bulk_chunks_;
+
+  /// The size of the chunks of BulkRead() and BulkWrite() (CN_BULK_CHUNK)
+  uint64_t bulk_chunk_;
+
+  /// Perform BulkRead() or BulkWrite()
+  template <typename T>
+  void bulk(rdma_ptr<T> ptr, uint8_t *buf, size_t size, ibv_wr_opcode opcode) {
+    bool read = opcode == IBV_WR_RDMA_READ;
+    bool staged = !registered(buf, size);
+    auto rkey = compute_node_->get_rkey(ptr.raw());
+    uint64_t lanes = args_->uget(QP_LANES), window = bulk_chunks_.size();
+    uint64_t chunks = (size + bulk_chunk_ - 1) / bulk_chunk_, oldest = 0;
+    // Wait for the oldest chunk in flight, and give back what it holds
+    auto retire = [&]() {
+      auto &c = bulk_chunks_[oldest++ % window];
+      internal::Poll(c.conn_, &c.ack_, ptr);
+      if (c.staging_ != nullptr) {
+        if (read) {
+          std::memcpy(c.local_, c.staging_, c.len_);
+        }
+        staging_ring_.release(c.staging_idx_);
+        c.staging_ = nullptr;
+      }
+      c.lane_.reset();
+    };
+    auto t0 = metrics_.start();
+    for (uint64_t i = 0; i < chunks; ++i) {
+      if (i - oldest == window) {
+        retire();
+      }
+      auto &c = bulk_chunks_[i % window];
+      uint64_t off = i * bulk_chunk_;
+      c.local_ = buf + off;
+      c.len_ = std::min<uint64_t>(bulk_chunk_, size - off);
+      auto *src = c.local_;
+      if (staged) {
+        auto res = acquire_staging(c.len_, 64);
+        while (res.buf_ == nullptr && oldest < i) {
+          retire();
+          res = acquire_staging(c.len_, 64);
+        }
+        REMUS_ASSERT(res.buf_, "staging buf is not enough for a {}-byte chunk",
+                     c.len_);
+        c.staging_ = src = res.buf_;
+        c.staging_idx_ = res.idx_;
+        if (!read) {
+          std::memcpy(src, c.local_, c.len_);
+        }
+      }
+      make_room(compute_node_->lane_ops(ptr.id(), id_), i % lanes, 1);
+      c.lane_.emplace(i % lanes, compute_node_->lane_ops(ptr.id(), id_));
+      auto &ci = compute_node_->get_conn(ptr.raw(), id_, i % lanes);
+      c.conn_ = ci.conn_.get();
+      ibv_sge sge{(uint64_t)src, (uint32_t)c.len_, ci.lkey_};
+      ibv_send_wr send_wr;
+      internal::VectorConfig(send_wr, &sge, 1, opcode, ptr.address() + off,
+                             rkey, &c.ack_, true, false);
+      internal::Post(send_wr, c.conn_, &c.ack_);
+    }
+    while (oldest < chunks) {
+      retire();
+    }
+    metrics_.record(read ? Metrics::READ : Metrics::WRITE, t0, size);
+  }
+
+  /// Perform ReadV() or WriteV().  The work requests are linked into one
+  /// chain, which is posted with a single doorbell.  Each work request but the
+  /// last is unsignaled: the QP completes them in order, so the last one's
+  /// completion means that they are all done.
+  template <typename T>
+  void vectored(rdma_ptr<T> ptr, std::span<const iovec> iov,
+                ibv_wr_opcode opcode, bool fence) {
+    if (iov.empty()) {
+      return;
+    }
+    bool read = opcode == IBV_WR_RDMA_READ;
+    size_t total = 0, staged = 0;
+    for (auto &v : iov) {
+      total += v.iov_len;
+      if (!registered(v.iov_base, v.iov_len)) {
+        staged += (v.iov_len + 7) & ~7ULL;
+      }
+    }
+    auto lane_idx = qp_sched_pol_.get_lane_idx(ptr.id());
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane_idx);
+    auto conn = ci.conn_.get();
+    // NB: Devices often allow fewer SGEs in a READ than in a WRITE
+    int max_sge = read ? conn->max_sge_rd() : internal::kMaxSge;
+    uint64_t wrs = (iov.size() + max_sge - 1) / max_sge;
+    REMUS_ASSERT(wrs < (size_t)internal::kMaxWr / 2,
+                 "{} buffers is too many for one vectored op", iov.size());
+    std::optional<staging_buf_t> staging;
+    uint8_t *stage = nullptr;
+    if (staged > 0) {
+      staging.emplace(this, staged, 8);
+      stage = staging->val();
+    }
+    make_room(compute_node_->lane_ops(ptr.id(), id_), lane_idx, wrs);
+    auto lane = Lane{lane_idx, compute_node_->lane_ops(ptr.id(), id_), wrs};
+    auto rkey = compute_node_->get_rkey(ptr.raw());
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    std::vector<ibv_send_wr> chain(wrs);
+    std::vector<ibv_sge> sges(iov.size());
+    ibv_sge *first = sges.data();
+    int num_sge = 0;
+    uint64_t raddr = ptr.address(), chunk = 0, off = 0, wr = 0;
+    auto t0 = metrics_.start();
+    for (size_t i = 0; i < iov.size(); ++i) {
+      auto *buf = (uint8_t *)iov[i].iov_base;
+      auto len = iov[i].iov_len;
+      if (len > 0) {
+        if (!registered(buf, len)) {
+          if (!read) {
+            std::memcpy(stage + off, buf, len);
+          }
+          buf = stage + off;
+          off += (len + 7) & ~7ULL;
+        }
+        first[num_sge++] = ibv_sge{(uint64_t)buf, (uint32_t)len, ci.lkey_};
+        chunk += len;
+      }
+      bool last = i + 1 == iov.size();
+      if (last || num_sge == max_sge) {
+        // Only the first request needs the fence
+        internal::VectorConfig(chain[wr], first, num_sge, opcode, raddr, rkey,
+                               op_counter, last, fence);
+        if (wr > 0) {
+          chain[wr - 1].next = &chain[wr];
+        }
+        fence = false;
+        ++wr;
+        first += num_sge;
+        raddr += chunk;
+        chunk = 0;
+        num_sge = 0;
+      }
+    }
+    internal::Post(chain[0], conn, op_counter);
+    internal::Poll(conn, op_counter, ptr);
+    metrics_.record(read ? Metrics::READ : Metrics::WRITE, t0, total);
+    if (read && staged > 0) {
+      off = 0;
+      for (auto &v : iov) {
+        if (v.iov_len > 0 && !registered(v.iov_base, v.iov_len)) {
+          std::memcpy(v.iov_base, stage + off, v.iov_len);
+          off += (v.iov_len + 7) & ~7ULL;
+        }
+      }
+    }
+  }
+
+public:
+  /// @brief The eventual result of an RPC
+  /// @details
+  /// An rpc_result_t can be polled with ready(), waited for with get(), or
+  /// co_awaited.  ready() and get() send an RPC that is still in an OPEN batch
+  /// first.  A co_await in a coroutine that SimpleAsyncComputeThread::Run() is
+  /// running parks it instead, so that the other coroutines keep running (and
+  /// keep adding to the batch), and Run() sends the batch and resumes the
+  /// coroutine once the responses arrive.  Anywhere else, co_await waits like
+  /// get().  A result that is destroyed without get() is dropped.
+  ///
+  /// NB: Results hold their batches until they are claimed, so claim them
+  ///     promptly.
+  ///
+  /// @tparam Resp The type of the response
+  template <typename Resp> class rpc_result_t {
+    ComputeThread *ct_; // The thread that issued the RPC, or null once claimed
+    uint16_t mn_id_;    // The MemoryNode
+    uint32_t batch_;    // The batch that carries the RPC
+    uint64_t gen_;      // The generation of the batch
+    uint32_t idx_;      // The RPC's position in the batch
+
+  public:
+    rpc_result_t(ComputeThread *ct, uint16_t mn_id, uint32_t batch,
+                 uint64_t gen, uint32_t idx)
+        : ct_(ct), mn_id_(mn_id), batch_(batch), gen_(gen), idx_(idx) {}
+
+    /// Forbid copying results, since only one can claim the response
+    rpc_result_t(const rpc_result_t &) = delete;
+
+    /// It's OK to move a result
+    rpc_result_t(rpc_result_t &&o) noexcept
+        : ct_(o.ct_), mn_id_(o.mn_id_), batch_(o.batch_), gen_(o.gen_),
+          idx_(o.idx_) {
+      o.ct_ = nullptr;
+    }
+
+    /// Drop the result, if it was not claimed
+    ~rpc_result_t() {
+      if (ct_ != nullptr) {
+        ct_->rpc_release(mn_id_, batch_, gen_);
+      }
+    }
+
+    /// Report if the response has arrived, without blocking
+    bool ready() {
+      REMUS_ASSERT(ct_ != nullptr, "RPC result was already claimed");
+      return ct_->rpc_ready(mn_id_, batch_, gen_);
+    }
+
+    /// Wait for the response, and claim it
+    Resp get() {
+      REMUS_ASSERT(ct_ != nullptr, "RPC result was already claimed");
+      Resp r;
+      ct_->rpc_claim(mn_id_, batch_, gen_, idx_, &r, sizeof(Resp));
+      ct_ = nullptr;
+      return r;
+    }
+
+    /// There is no need to wait if the response already arrived
+    ///
+    /// NB: This does not send an OPEN batch, so that it can still grow
+    bool await_ready() {
+      REMUS_ASSERT(ct_ != nullptr, "RPC result was already claimed");
+      return ct_->rpc_batch(mn_id_, batch_, gen_).state_ ==
+             rpc_batch_t::DONE;
+    }
+
+    /// Park the coroutine until Run() sees the response, or else poll for it
+    bool await_suspend(std::coroutine_handle<> h) {
+      if (ct_->rpc_park_ && ct_->rpc_park_(mn_id_, batch_, gen_, h)) {
+        return true;
+      }
+      ct_->rpc_wait(mn_id_, batch_, gen_);
+      return false;
+    }
+
+    /// Claim the response
+    Resp await_resume() { return get(); }
+  };
+
+  /// @brief Call an RPC handler at a MemoryNode
+  /// @details
+  /// The request joins this thread's OPEN batch to that MemoryNode, which is
+  /// sent when it is full, when any of its results is waited for, or on
+  /// RpcFlush().  So a thread can issue many RPCs, and then claim their
+  /// results, and only pay for a round trip per batch.
+  ///
+  /// @tparam Resp The type of the handler's response
+  /// @tparam Req  The type of the handler's request
+  /// @param mn_id The MemoryNode whose handler to call
+  /// @param op    The id of the handler (see MemoryNode::RegisterRpc())
+  /// @param req   The request
+  /// @return The eventual result
+  template <typename Resp, typename Req>
+  rpc_result_t<Resp> Rpc(uint16_t mn_id, uint32_t op, const Req &req) {
+    static_assert(std::is_trivially_copyable_v<Req> &&
+                      std::is_trivially_copyable_v<Resp>,
+                  "RPC requests and responses are sent as bytes");
+    constexpr uint32_t req_bytes = internal::rpc_msg_bytes(sizeof(Req));
+    constexpr uint32_t resp_bytes = internal::rpc_msg_bytes(sizeof(Resp));
+    static_assert(sizeof(internal::rpc_batch_hdr_t) + req_bytes <=
+                          internal::kRpcMaxBatch &&
+                      sizeof(internal::rpc_batch_hdr_t) + resp_bytes <=
+                          internal::kRpcMaxBatch,
+                  "RPC messages must fit in a batch");
+    auto &ch = rpc_chan(mn_id);
+    if (ch.open_ >= 0) {
+      auto &b = ch.batches_[ch.open_];
+      if (b.bytes_ + req_bytes > internal::kRpcMaxBatch ||
+          b.resp_bytes_ + resp_bytes > internal::kRpcMaxBatch) {
+        rpc_send(ch);
+      }
+    }
+    auto &b = ch.open_ >= 0 ? ch.batches_[ch.open_] : rpc_open(ch);
+    auto msg = ch.bufs_ + ch.open_ * internal::kRpcBufSize + b.bytes_;
+    internal::rpc_msg_hdr_t hdr{op, sizeof(Req)};
+    std::memcpy(msg, &hdr, sizeof(hdr));
+    std::memcpy(msg + sizeof(hdr), &req, sizeof(Req));
+    b.bytes_ += req_bytes;
+    b.resp_bytes_ += resp_bytes;
+    b.ops_.push_back(op);
+    ++b.unclaimed_;
+    return rpc_result_t<Resp>(this, mn_id, ch.open_, b.gen_,
+                              b.ops_.size() - 1);
+  }
+
+  /// @brief Send every RPC batch that is still being built
+  void RpcFlush() {
+    for (auto &ch : rpc_chans_) {
+      if (ch.open_ >= 0) {
+        rpc_send(ch);
+      }
     }
-    return true;
   }
 
   /// @brief Allocate a region of n * sizeof(T) bytes.  This will use the memory
   /// allocation policy to choose a memory node from which to allocate.
+  /// @details
+  /// The sources are tried from cheapest to dearest: this thread's cached
+  /// blocks and the rest of its current chunk (no RDMA), then a Segment's
+  /// free stack (skipped for a while once one is found empty), then a fresh
+  /// chunk, and finally the Segment itself.
   /// @tparam T The type of the object to allocate
   /// @param n The number of elements to allocate, defaults to 1
   /// @return An rdma_ptr<T> pointing to the allocated memory, or an empty
   template <typename T> rdma_ptr<T> allocate(std::size_t n = 1) {
     auto size = allocator.compute_size<T>(n);
+    auto &counts = metrics_.alloc();
     auto local = allocator.try_allocate_local(size);
-    if (local.has_value())
+    if (local.has_value()) {
+      ++counts.local_;
       return rdma_ptr<T>(local.value());
+    }
+    auto recycled = try_allocate_recycled(size);
+    if (recycled.has_value()) {
+      ++counts.recycled_;
+      return rdma_ptr<T>(recycled.value());
+    }
     // TODO:  The use of four lambdas here is really icky, this should be
     //        refactored at some point.
+    auto seg_locator = [&](uint64_t mn_id, uint64_t seg_id) {
+      return compute_node_->get_seg_start(mn_id, seg_id);
+    };
+    auto hint_locator = [&](uint64_t mn_id,
+                            uint64_t seg_id) -> std::atomic<uint64_t> & {
+      return compute_node_->get_alloc_hint(mn_id, seg_id);
+    };
+    auto faa = [&](rdma_ptr<uint64_t> ptr, uint64_t val) {
+      return FetchAndAdd(ptr, val);
+    };
+    auto chunked = allocator.try_allocate_chunk(
+        size, seg_locator, hint_locator, faa,
+        [&](uintptr_t chunk, uint64_t chunk_size, uint64_t block_size) {
+          format_chunk(chunk, chunk_size, block_size);
+        });
+    if (chunked.has_value()) {
+      ++counts.chunk_;
+      return rdma_ptr<T>(chunked.value());
+    }
+    ++counts.global_;
     auto global = allocator.try_allocate_global(
-        size,
-        [&](uint64_t mn_id, uint64_t seg_id) {
-          return compute_node_->get_seg_start(mn_id, seg_id);
-        },
-        [&](uint64_t mn_id, uint64_t seg_id) -> std::atomic<uint64_t> & {
-          return compute_node_->get_alloc_hint(mn_id, seg_id);
-        },
-        [&](rdma_ptr<uint64_t> ptr, uint64_t val) {
-          return FetchAndAdd(ptr, val);
-        },
+        size, seg_locator, hint_locator, faa,
         [&](rdma_ptr<uint64_t> ptr, uint64_t val) { return Write(ptr, val); });
     return rdma_ptr<T>(global);
   }
 
+  /// @brief Write the headers of every block in a fresh allocation chunk
+  /// @details
+  /// The headers are laid out in a local image of the chunk, which is written
+  /// with a single RDMA write.  If there is no room for the image, each header
+  /// is written separately instead.
+  ///
+  /// @param chunk The start of the chunk in the RDMA heap
+  /// @param chunk_size The size of the chunk
+  /// @param block_size The size of the chunk's blocks, including the header
+  void format_chunk(uintptr_t chunk, uint64_t chunk_size,
+                    uint64_t block_size) {
+    auto image = local_allocate<uint8_t>(chunk_size);
+    if (image != nullptr) {
+      std::memset(image, 0, chunk_size);
+      internal::BumpAllocator::format_chunk(image, chunk_size, block_size);
+      Write(rdma_ptr<uint8_t>(chunk), image, true, chunk_size);
+      local_deallocate(image);
+      return;
+    }
+    for (uint64_t off = 0; off + block_size <= chunk_size; off += block_size) {
+      Write(rdma_ptr<uint64_t>(chunk + off), block_size);
+      Write(rdma_ptr<uint64_t>(chunk + off + sizeof(uint64_t)), (uint64_t)0);
+    }
+  }
+
   /// @brief Deallocate a region of memory, so it can be used again.
   /// @tparam T The type of the object to deallocate
   /// @param ptr The rdma_ptr<T> pointing to the memory to deallocate
@@ -1053,10 +3092,168 @@ public:
   template <typename T> bool deallocate(rdma_ptr<T> ptr) {
     auto size = Read<uint64_t>(
         rdma_ptr<uint64_t>(ptr.raw() - internal::BumpAllocator::HEADER_SIZE));
-    allocator.reclaim(ptr, size);
+    recycle(ptr, size);
     return true;
   }
 
+  /// @brief Deallocate a region of memory whose size the caller knows, without
+  /// reading its header
+  /// @tparam T The type of the object to deallocate
+  /// @param ptr The rdma_ptr<T> pointing to the memory to deallocate
+  /// @param n The number of elements that were allocated
+  /// @return True if the deallocation was successful, false otherwise
+  template <typename T> bool deallocate(rdma_ptr<T> ptr, std::size_t n) {
+    recycle(ptr, allocator.compute_size<T>(n));
+    return true;
+  }
+
+private:
+  /// @brief Cache a freed block, and return this thread's oldest cached blocks
+  /// of its size class to their Segments if the cache is over its limit
+  /// @param ptr The rdma_ptr<T> pointing to the freed memory
+  /// @param size The size of the block, including the header
+  template <typename T> void recycle(rdma_ptr<T> ptr, uint64_t size) {
+    ++metrics_.alloc().frees_;
+    allocator.reclaim(ptr, size);
+    auto overflow = allocator.take_overflow(size);
+    if (!overflow.empty()) {
+      return_free_blocks(overflow, size);
+    }
+  }
+
+  /// @brief Push free blocks onto the free stacks of their Segments
+  /// @details
+  /// The blocks are sorted so that each Segment gets one chain of blocks,
+  /// split into chains of at most CN_WRS_PER_SEQ blocks so that each chain can
+  /// be linked with a single Batch.
+  ///
+  /// @param blocks The blocks (addresses of their headers) to push
+  /// @param size The size of the blocks, including the header
+  void return_free_blocks(std::vector<uint64_t> &blocks, uint64_t size) {
+    std::sort(blocks.begin(), blocks.end());
+    auto max_chain = args_->uget(CN_WRS_PER_SEQ);
+    size_t first = 0;
+    while (first < blocks.size()) {
+      auto seg = allocator.seg_of(blocks[first]);
+      size_t last = first + 1;
+      while (last < blocks.size() && last - first < max_chain &&
+             allocator.seg_of(blocks[last]) == seg) {
+        ++last;
+      }
+      push_free_chain(blocks.data() + first, last - first, size);
+      first = last;
+    }
+  }
+
+  /// @brief Push a chain of free blocks from one Segment onto its free stack
+  /// @details
+  /// The blocks are linked to each other with one Batch, and then the last one
+  /// is linked to the top of the stack and the stack head is swung to the
+  /// first one.  Only those last two steps repeat if the CAS fails.
+  ///
+  /// @param blocks The blocks (addresses of their headers) to push
+  /// @param num_blocks The number of blocks (at most CN_WRS_PER_SEQ)
+  /// @param size The size of the blocks, including the header
+  void push_free_chain(const uint64_t *blocks, size_t num_blocks,
+                       uint64_t size) {
+    using internal::BumpAllocator;
+    auto seg = allocator.seg_of(blocks[0]);
+    auto next_of = [&](size_t i) {
+      return rdma_ptr<uint64_t>(blocks[i] + BumpAllocator::HEADER_SIZE);
+    };
+    if (num_blocks > 1) {
+      auto b = batch(num_blocks - 1);
+      for (size_t i = 0; i + 1 < num_blocks; ++i) {
+        b.Write<uint64_t>(next_of(i), blocks[i + 1] - seg);
+      }
+      b.Execute();
+    }
+    auto head_ptr = rdma_ptr<uint64_t>(allocator.free_stack(seg, size));
+    auto head = Read(head_ptr);
+    while (true) {
+      Write(next_of(num_blocks - 1), BumpAllocator::head_offset(head));
+      auto new_head = BumpAllocator::next_head(head, blocks[0] - seg);
+      auto was = CompareAndSwap(head_ptr, head, new_head);
+      if (was == head) {
+        return;
+      }
+      head = was;
+    }
+  }
+
+  /// @brief Take every block on a Segment's free stack for a size class
+  /// @param seg The base of the Segment
+  /// @param size The size of the blocks, including the header
+  /// @return The offset of the first block in the Segment (0 if none)
+  uint64_t take_free_stack(uintptr_t seg, uint64_t size) {
+    using internal::BumpAllocator;
+    auto head_ptr = rdma_ptr<uint64_t>(allocator.free_stack(seg, size));
+    auto head = Read(head_ptr);
+    while (BumpAllocator::head_offset(head) != 0) {
+      auto was =
+          CompareAndSwap(head_ptr, head, BumpAllocator::next_head(head, 0));
+      if (was == head) {
+        return BumpAllocator::head_offset(head);
+      }
+      head = was;
+    }
+    return 0;
+  }
+
+  /// @brief Try to reuse a block that some thread returned to a Segment
+  /// @details
+  /// A size class takes the whole free stack of one Segment at a time, and
+  /// then hands out its blocks one by one (each costs a Read of the block's
+  /// link to the next one).  When that chain runs out, a copy of the
+  /// allocation policy, with its own cursor, picks the Segment whose free
+  /// stack to take next.  If that stack is
+  /// empty, the class's next few misses do not look (see free_stack_empty()).
+  ///
+  /// @param size The size of the block, including the header
+  /// @return A region of memory, or none if the free stack was empty
+  std::optional<uintptr_t> try_allocate_recycled(uint64_t size) {
+    using internal::BumpAllocator;
+    if (!allocator.recyclable(size)) {
+      return {};
+    }
+    auto &chain = allocator.free_chain(size);
+    if (chain.next_ == 0) {
+      if (chain.skip_ > 0) {
+        --chain.skip_;
+        return {};
+      }
+      auto [mn_id, seg_id] = allocator.recycle_pol_.get_mn_seg();
+      auto seg = compute_node_->get_seg_start(mn_id, seg_id);
+      auto first = take_free_stack(seg, size);
+      if (first == 0) {
+        allocator.free_stack_empty(size);
+        return {};
+      }
+      chain = {seg, first};
+    }
+    uintptr_t block = chain.seg_ + chain.next_;
+    chain.next_ = Read(rdma_ptr<uint64_t>(block + BumpAllocator::HEADER_SIZE));
+    return block + BumpAllocator::HEADER_SIZE;
+  }
+
+  /// @brief Return every block that this thread has cached, or taken from a
+  /// free stack without handing out, to the free stacks of their Segments
+  void return_all_free_blocks() {
+    using internal::BumpAllocator;
+    for (auto slabclass : BumpAllocator::size_classes()) {
+      auto blocks = allocator.take_cached(slabclass);
+      auto &chain = allocator.free_chain(slabclass);
+      while (chain.next_ != 0) {
+        uintptr_t block = chain.seg_ + chain.next_;
+        blocks.push_back(block);
+        chain.next_ =
+            Read(rdma_ptr<uint64_t>(block + BumpAllocator::HEADER_SIZE));
+      }
+      return_free_blocks(blocks, slabclass);
+    }
+  }
+
+public:
   /// @brief Only allocates memory in local memory seg_slice_, n means n bytes
   /// FOR T
   /// @tparam T The type of the object to allocate
@@ -1066,11 +3263,11 @@ public:
     size_t n_bytes = sizeof(T) * num_elements;
     auto temp_obj_owner =
         std::make_unique<cached_buf_t>(this, n_bytes, alignof(T));
-    uint8_t *key_buf_ptr = temp_obj_owner->val();
-
-    if (!key_buf_ptr) {
+    // NB: val() asserts that the buffer is not null, so check it directly
+    if (!temp_obj_owner->buf_) {
       return nullptr;
     }
+    uint8_t *key_buf_ptr = temp_obj_owner->val();
 
     auto [iterator, success] = cached_buf_manager_.emplace(
         std::piecewise_construct, std::forward_as_tuple(key_buf_ptr),
@@ -1168,66 +3365,44 @@ public:
     scheduled_reclamations.clear();
   }
 
-  /// @brief A count of metrics.  For now, we keep it really simple, but we
-  /// probably want histograms and other fine-grained details at some point.
-  struct {
-    /// @brief A metric for the number of operations and bytes written
-    struct metric_t {
-      size_t ops;
-      size_t bytes;
-      metric_t() : ops(0), bytes(0) {}
-    };
-    metric_t write{};
-    metric_t read{};
-    uint64_t faa{0};
-    uint64_t cas{0};
-  } metrics_;
+  /// @brief This thread's operation counts and latencies.  Merge the metrics_
+  /// of every thread (see Metrics::merge()) to report on a whole run.
+  Metrics metrics_;
 
   /// @brief Check for memory leaks in the RDMA heap
   /// @return True if no leaks are detected, false otherwise
   bool inline no_leak_detected() {
-    const auto coro_idx = 0;
     REMUS_ASSERT(op_counter_start == op_counter_end,
                  "Leak detected, op_counter_start = {}, op_counter_end = {}",
                  op_counter_start, op_counter_end);
-    REMUS_ASSERT(
-        seq_op_counter_start[coro_idx] == seq_op_counter_end[coro_idx],
-        "Leak detected, seq_op_counter_start = {}, seq_op_counter_end = {}",
-        seq_op_counter_start[coro_idx], seq_op_counter_end[coro_idx]);
-    REMUS_ASSERT(seq_send_wrs[coro_idx].empty(),
-                 "Leak detected, seq_send_wrs[{}] is not empty", coro_idx);
-    // For the global staging buffer
-    REMUS_ASSERT(staging_buf_start == staging_buf_end,
-                 "Leak detected in global staging buffer, start = {}, end = {}",
-                 (void *)staging_buf_start, (void *)staging_buf_end);
-    // check the allocations map if it's the primary tracking mechanism
-    // REMUS_ASSERT(staging_buf_allocations_.empty(),
-    //             "Leak detected, staging_buf_allocations_ is not empty, size =
-    //             {}", staging_buf_allocations_.size());
-    if (!staging_buf_allocations_.empty()) {
-      for (auto &[key, value] : staging_buf_allocations_) {
-        REMUS_INFO("staging_buf_allocations is not empty, key = {}, in_use = "
-                   "{}, next_available_addr = {}",
-                   (void *)key, (uint64_t)value.in_use,
-                   (void *)value.next_available_addr);
-      }
+    for (size_t coro_idx = 0; coro_idx < seq_send_wrs.size(); ++coro_idx) {
+      REMUS_ASSERT(seq_op_counter_start[coro_idx] ==
+                       seq_op_counter_end[coro_idx],
+                   "Leak detected, seq_op_counter_start[{}] = {}, "
+                   "seq_op_counter_end[{}] = {}",
+                   coro_idx, seq_op_counter_start[coro_idx], coro_idx,
+                   seq_op_counter_end[coro_idx]);
+      REMUS_ASSERT(seq_send_wrs[coro_idx].empty(),
+                   "Leak detected, seq_send_wrs[{}] is not empty", coro_idx);
     }
-
+    // For the global staging buffer
+    REMUS_ASSERT(staging_ring_.empty(),
+                 "Leak detected in global staging buffer, {} buffers live",
+                 staging_ring_.live());
     // For the global cached buffer
-    REMUS_ASSERT(cached_buf_start == cached_buf_end,
-                 "Leak detected in global cached buffer, start = {}, end = {}",
-                 (void *)cached_buf_start, (void *)cached_buf_end);
-    // check the allocations map
-    REMUS_ASSERT(
-        cached_buf_allocations_.empty(),
-        "Leak detected, cached_buf_allocations is not empty, size = {}",
-        cached_buf_allocations_.size());
-    // check the lane_op_counters_
-    for (auto &v : compute_node_->lane_op_counters_) {
-      REMUS_ASSERT(v.load() == 0,
-                   "Leak detected, lane_op_counters_ is not 0, value = "
-                   "{}",
-                   v.load());
+    REMUS_ASSERT(cached_ring_.empty(),
+                 "Leak detected in global cached buffer, {} buffers live",
+                 cached_ring_.live());
+    // check this thread's lane_op_counters_
+    for (uint64_t mn = args_->uget(FIRST_MN_ID); mn <= args_->uget(LAST_MN_ID);
+         ++mn) {
+      auto lanes = compute_node_->lane_ops(mn, id_);
+      for (uint64_t i = 0; i < args_->uget(QP_LANES); ++i) {
+        REMUS_ASSERT(lanes[i].ops_.load() == 0,
+                     "Leak detected, lane_op_counters_ is not 0, value = "
+                     "{}",
+                     lanes[i].ops_.load());
+      }
     }
     return true;
   }
@@ -1240,7 +3415,7 @@ protected:
     for (uint64_t i = 0;
          i < seq_send_wrs[coro_idx][seq_idx].send_wrs.size() - 1; i++) {
       seq_send_wrs[coro_idx][seq_idx].send_wrs[i].wr->next =
-          seq_send_wrs[coro_idx][seq_idx].send_wrs[i + 1].wr.get();
+          seq_send_wrs[coro_idx][seq_idx].send_wrs[i + 1].wr;
     }
     seq_send_wrs[coro_idx][seq_idx].send_wrs.back().wr->next = nullptr;
   }
@@ -1252,18 +3427,12 @@ protected:
   template <typename T>
   inline void get_seq_op_result(uint32_t seq_idx, uint32_t coro_idx,
                                 std::vector<T> &result) {
-    for (size_t i = 0; i < seq_send_wrs[coro_idx][seq_idx].staging_bufs.size();
-         i++) {
-      if (seq_send_wrs[coro_idx][seq_idx].send_wrs[i].wr->opcode !=
-          IBV_WR_RDMA_WRITE) {
-        result.push_back(
-            *(T *)seq_send_wrs[coro_idx][seq_idx].staging_bufs[i]->val());
+    // NB: Only ops that staged their result are reported.  Writes, and reads
+    //     directly into a caller's segment, have nothing to report.
+    for (auto &wr : seq_send_wrs[coro_idx][seq_idx].send_wrs) {
+      if (wr.result != nullptr) {
+        result.push_back(*(T *)wr.result);
       }
-      REMUS_DEBUG("release {} from seq_send_wrs[{}][{}]",
-                  (uint64_t)(uint8_t *)seq_send_wrs[coro_idx][seq_idx]
-                      .staging_bufs[i]
-                      ->val(),
-                  coro_idx, seq_idx);
     }
   }
   /// @brief
@@ -1304,8 +3473,9 @@ protected:
     auto seq_idx_ptr = std::make_unique<seq_idx_t>(this, coro_idx);
     seq_idx = seq_idx_ptr->val();
     seq_send_wrs[coro_idx][seq_idx].seq_idx = std::move(seq_idx_ptr);
-    auto lane_ptr = std::make_unique<Lane>(qp_sched_pol_.get_lane_idx(ptr.id()),
-                                           compute_node_->lane_op_counters_);
+    auto lane_ptr = std::make_unique<Lane>(
+        qp_sched_pol_.get_lane_idx(ptr.id()),
+        compute_node_->lane_ops(ptr.id(), id_));
     seq_send_wrs[coro_idx][seq_idx].lane = std::move(lane_ptr);
     REMUS_DEBUG("seq_send_wrs is empty, add a new seq_idx = {}, lane_idx = {}",
                 seq_idx, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <atomic>
 #include <cstddef>
@@ -12,7 +13,9 @@
 #include <rdma/rdma_verbs.h>
 #include <span>
 
+#include "rpc.h"
 #include "segment.h"
+#include "shm_transport.h"
 #include "util.h"
 
 namespace remus::internal {
@@ -32,10 +35,46 @@ namespace remus::internal {
 /// connection allows two-sided operations between those machines.  This is
 /// realized in our design by a Connection only having public methods to send,
 /// receive, post one-sided requests, and poll for completions.
+///
+/// Under the SHM transport, a Connection has no id_.  Instead, it executes
+/// one-sided requests directly on shared memory, and completes them to its
+/// thread's ShmCq.  Since everything above send_onesided() and poll_cq() is
+/// unchanged, ComputeThreads run the same code under either transport.
+///
+/// A Connection can also carry RPC batches (see rpc.h), once rpc_attach() has
+/// given it receive buffers.  Over RDMA, batches are SENDs into pre-posted
+/// receives.  Under SHM, they go through a pair of shared-memory rings that
+/// behave the same way.
  
 class Connection {
   rdma_cm_id *id_;         // Pointer to the QP for sends/receives
   const bool is_loopback_; // Track if this is a Loopback (self) connection
+  uint32_t max_inline_;    // The QP's actual inline data capacity, in bytes
+  int max_sge_rd_;         // The most SGEs that an RDMA READ may have
+  ShmCq *shm_cq_ = nullptr;                 // The CQ, under the SHM transport
+  const ShmRegions *shm_regions_ = nullptr; // The reachable memory, under SHM
+
+  uint8_t *rpc_bufs_ = nullptr;       // The RPC receive buffers, under RDMA
+  uint32_t rpc_lkey_ = 0;             // The lkey of all RPC buffers
+  shm_rpc_slot_t *rpc_in_ = nullptr;  // The ring RPCs arrive on, under SHM
+  shm_rpc_slot_t *rpc_out_ = nullptr; // The ring RPCs are sent on, under SHM
+  uint64_t rpc_in_pos_ = 0;           // The next slot of rpc_in_ to receive
+  uint64_t rpc_out_pos_ = 0;          // The next slot of rpc_out_ to send on
+
+  /// Post the RPC receive buffer `slot`, under RDMA
+  void rpc_post_recv(uint32_t slot) {
+    ibv_sge sge;
+    sge.addr = reinterpret_cast<uint64_t>(rpc_bufs_ + slot * kRpcBufSize);
+    sge.length = kRpcBufSize;
+    sge.lkey = rpc_lkey_;
+    ibv_recv_wr wr;
+    std::memset(&wr, 0, sizeof(wr));
+    wr.wr_id = slot;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    ibv_recv_wr *bad = nullptr;
+    RDMA_CM_ASSERT(ibv_post_recv, id_->qp, &wr, &bad);
+  }
 
   /// Internal method for sending a Message (byte array) over RDMA as a
   /// two-sided operation.
@@ -116,9 +155,11 @@ class Connection {
   ///
   /// TODO: Move to rdma_ops.h?
   ///
-  /// @param seg TODO
+  /// @param seg    TODO
+  /// @param offset Where in seg the receive buffer starts
   /// @return TODO
-  remus::StatusVal<std::vector<uint8_t>> TryDeliverMessage(Segment &seg) {
+  remus::StatusVal<std::vector<uint8_t>> TryDeliverMessage(Segment &seg,
+                                                           size_t offset) {
     ibv_wc wc;
     auto ret = rdma_get_recv_comp(id_, &wc);
     if (ret < 0 && errno != EAGAIN) {
@@ -133,7 +174,7 @@ class Connection {
         return {{remus::Aborted, "QP in error state"}, {}};
       case IBV_WC_SUCCESS: {
         // Prepare the response.
-        std::span<uint8_t> recv_span{seg.raw(), wc.byte_len};
+        std::span<uint8_t> recv_span{seg.raw() + offset, wc.byte_len};
         remus::StatusVal<std::vector<uint8_t>> res = {
             remus::Status::Ok(), std::make_optional(std::vector<uint8_t>(
                                      recv_span.begin(), recv_span.end()))};
@@ -153,11 +194,13 @@ class Connection {
   /// TODO: Move to rdma_ops.h?
   ///
   /// @tparam T TODO
-  /// @param seg TODO
+  /// @param seg    TODO
+  /// @param offset Where in seg the receive buffer starts
   /// @return TODO
   template <typename T>
-  remus::StatusVal<std::vector<T>> TryDeliverVec(Segment &seg) {
-    remus::StatusVal<std::vector<uint8_t>> msg_or = TryDeliverMessage(seg);
+  remus::StatusVal<std::vector<T>> TryDeliverVec(Segment &seg, size_t offset) {
+    remus::StatusVal<std::vector<uint8_t>> msg_or =
+        TryDeliverMessage(seg, offset);
     if (msg_or.status.t == remus::Ok) {
       std::vector<T> vec(msg_or.val.value().size() / sizeof(T));
       std::memcpy(vec.data(), msg_or.val.value().data(),
@@ -174,7 +217,33 @@ public:
   /// @param dst_id
   /// @param channel_id
   Connection(uint32_t src_id, uint32_t dst_id, rdma_cm_id *channel_id)
-      : id_(channel_id), is_loopback_(src_id == dst_id) {}
+      : id_(channel_id), is_loopback_(src_id == dst_id), max_inline_(0),
+        max_sge_rd_(1) {
+    // NB: The device may round the requested inline capacity up, so ask the
+    //     QP what it actually got
+    ibv_qp_attr attr;
+    ibv_qp_init_attr init_attr;
+    if (ibv_query_qp(id_->qp, &attr, IBV_QP_CAP, &init_attr) == 0) {
+      max_inline_ = attr.cap.max_inline_data;
+    }
+    // NB: READs are limited by max_sge_rd, which is often below max_send_sge
+    ibv_device_attr dev_attr;
+    if (ibv_query_device(id_->verbs, &dev_attr) == 0) {
+      max_sge_rd_ = std::clamp(dev_attr.max_sge_rd, 1, kMaxSge);
+    }
+  }
+
+  /// Construct a connection object for the SHM transport
+  ///
+  /// @param src_id     The id of this (compute) node
+  /// @param dst_id     The id of the memory node
+  /// @param cq         The CQ of the thread that will use this Connection
+  /// @param regions    The memory that requests may access
+  /// @param max_inline The largest write to treat as inline
+  Connection(uint32_t src_id, uint32_t dst_id, ShmCq *cq,
+             const ShmRegions *regions, uint32_t max_inline)
+      : id_(nullptr), is_loopback_(src_id == dst_id), max_inline_(max_inline),
+        max_sge_rd_(kMaxSge), shm_cq_(cq), shm_regions_(regions) {}
 
   Connection(const Connection &) = delete;
   Connection(Connection &&c) = delete;
@@ -200,19 +269,26 @@ public:
   /// TODO: Rename to receive_vec?
   ///
   /// @tparam T TODO
-  /// @param seg TODO
+  /// @param seg    TODO
+  /// @param offset Where in seg the receive buffer starts (i.e., where the
+  ///               receive was posted)
   /// @return TODO
   template <typename T>
-  remus::StatusVal<std::vector<T>> DeliverVec(Segment &seg) {
-    auto p = this->TryDeliverVec<T>(seg);
+  remus::StatusVal<std::vector<T>> DeliverVec(Segment &seg, size_t offset = 0) {
+    auto p = this->TryDeliverVec<T>(seg, offset);
     while (p.status.t == remus::Unavailable) {
-      p = this->TryDeliverVec<T>(seg);
+      p = this->TryDeliverVec<T>(seg, offset);
     }
     return p;
   }
 
   /// TODO
   ~Connection() {
+    // An SHM connection has no rdma_cm state to tear down
+    if (id_ == nullptr) {
+      return;
+    }
+
     // A loopback connection is made manually, so we do not need to deal with
     // the regular `rdma_cm` handling. Similarly, we avoid destroying the event
     // channel below since it is destroyed along with the id.
@@ -245,6 +321,10 @@ public:
   ///
   /// @param send_wr_ TODO
   void send_onesided(ibv_send_wr *send_wr) {
+    if (shm_cq_ != nullptr) {
+      shm_execute(send_wr, *shm_regions_, *shm_cq_);
+      return;
+    }
     ibv_send_wr *bad = nullptr;
     RDMA_CM_ASSERT(ibv_post_send, id_->qp, send_wr, &bad);
   }
@@ -252,14 +332,134 @@ public:
   /// Poll to see if anything new arrived on the completion queue.  This
   /// encapsulates so that id_ can be private.
   ///
+  /// NB: We go through the QP, because id_->send_cq is only set when rdma_cm
+  ///     created the CQ.  A ComputeNode's QPs use their thread's CQ instead.
+  ///
   /// @param num
   /// @param wc
   /// @return
   int poll_cq(int num, ibv_wc *wc) {
-    return ibv_poll_cq(id_->send_cq, num, wc);
+    if (shm_cq_ != nullptr) {
+      return shm_cq_->poll(num, wc);
+    }
+    return ibv_poll_cq(id_->qp->send_cq, num, wc);
+  }
+
+  /// Make this Connection able to receive RPC batches over RDMA, by posting
+  /// kRpcSlots receives
+  ///
+  /// NB: The Connection must not have any other receives outstanding, or they
+  ///     would be mistaken for RPC batches.
+  ///
+  /// @param bufs kRpcSlots receive buffers of kRpcBufSize bytes each
+  /// @param lkey The lkey of bufs, and of every buffer that rpc_send() sends
+  void rpc_attach(uint8_t *bufs, uint32_t lkey) {
+    rpc_bufs_ = bufs;
+    rpc_lkey_ = lkey;
+    for (uint32_t i = 0; i < kRpcSlots; ++i) {
+      rpc_post_recv(i);
+    }
+  }
+
+  /// Make this Connection able to send and receive RPC batches under SHM
+  ///
+  /// @param in   The ring that batches arrive on
+  /// @param out  The ring that batches are sent on
+  void rpc_attach(shm_rpc_slot_t *in, shm_rpc_slot_t *out) {
+    rpc_in_ = in;
+    rpc_out_ = out;
+  }
+
+  /// Report if this Connection can carry RPC batches
+  bool has_rpc() const { return rpc_bufs_ != nullptr || rpc_in_ != nullptr; }
+
+  /// Send an RPC batch.  Its completion decrements `ack`, like a one-sided
+  /// request's.
+  ///
+  /// NB: The caller must not have more than kRpcSlots batches in flight, so
+  ///     that the peer always has a receive posted.
+  ///
+  /// @param msg  The batch, in memory that rpc_lkey_ covers (under RDMA)
+  /// @param len  The size of the batch
+  /// @param ack  The counter to decrement when the send completes
+  void rpc_send(const uint8_t *msg, uint32_t len, std::atomic<int> *ack) {
+    REMUS_ASSERT(len <= kRpcMaxBatch, "RPC batch of {} bytes is too big", len);
+    if (rpc_out_ != nullptr) {
+      auto &slot = rpc_out_[rpc_out_pos_++ % kRpcSlots];
+      REMUS_ASSERT(slot.full_.load(std::memory_order_acquire) == 0,
+                   "RPC peer has no free receive buffer");
+      std::memcpy(slot.data_, msg, len);
+      slot.len_ = len;
+      slot.full_.store(1, std::memory_order_release);
+      shm_cq_->push((uint64_t)ack);
+      return;
+    }
+    ibv_sge sge;
+    sge.addr = reinterpret_cast<uint64_t>(msg);
+    sge.length = len;
+    sge.lkey = rpc_lkey_;
+    ibv_send_wr wr;
+    std::memset(&wr, 0, sizeof(wr));
+    wr.wr_id = (uint64_t)ack;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_SEND;
+    wr.send_flags = IBV_SEND_SIGNALED | (len <= max_inline_ ? IBV_SEND_INLINE
+                                                             : 0);
+    ibv_send_wr *bad = nullptr;
+    RDMA_CM_ASSERT(ibv_post_send, id_->qp, &wr, &bad);
+  }
+
+  /// Check for the next RPC batch to arrive, without blocking.  The batch
+  /// stays valid until rpc_repost(slot).
+  ///
+  /// @param slot Set to the receive buffer that holds the batch
+  /// @param msg  Set to the batch
+  /// @param len  Set to the size of the batch
+  /// @return true if a batch arrived
+  bool rpc_recv(uint32_t &slot, const uint8_t *&msg, uint32_t &len) {
+    if (rpc_in_ != nullptr) {
+      slot = rpc_in_pos_ % kRpcSlots;
+      if (rpc_in_[slot].full_.load(std::memory_order_acquire) == 0) {
+        return false;
+      }
+      msg = rpc_in_[slot].data_;
+      len = rpc_in_[slot].len_;
+      return true;
+    }
+    ibv_wc wc;
+    int n = ibv_poll_cq(id_->qp->recv_cq, 1, &wc);
+    if (n == 0 || (n < 0 && errno == EAGAIN)) {
+      return false;
+    }
+    REMUS_ASSERT(n > 0, "ibv_poll_cq(): {}", strerror(errno));
+    REMUS_ASSERT(wc.status == IBV_WC_SUCCESS, "RPC receive failed: {}",
+                 ibv_wc_status_str(wc.status));
+    slot = wc.wr_id;
+    msg = rpc_bufs_ + slot * kRpcBufSize;
+    len = wc.byte_len;
+    return true;
+  }
+
+  /// Give a receive buffer back, once its batch has been consumed
+  ///
+  /// @param slot The slot that rpc_recv() reported
+  void rpc_repost(uint32_t slot) {
+    if (rpc_in_ != nullptr) {
+      rpc_in_[slot].full_.store(0, std::memory_order_release);
+      ++rpc_in_pos_;
+      return;
+    }
+    rpc_post_recv(slot);
   }
 
   /// Return the protection domain associated with this Connection
-  ibv_pd *pd() { return id_->pd; }
+  ibv_pd *pd() { return id_ == nullptr ? nullptr : id_->pd; }
+
+  /// Return the largest payload that can be written inline on this Connection
+  uint32_t max_inline() const { return max_inline_; }
+
+  /// Return the most SGEs that an RDMA READ on this Connection may have
+  int max_sge_rd() const { return max_sge_rd_; }
 };
 } // namespace remus::internal
\ No newline at end of file
@@ -0,0 +1,486 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+
+#include "compute_thread.h"
+#include "logging.h"
+#include "rdma_ptr.h"
+
+namespace remus {
+
+namespace internal {
+/// Mix the bits of a key (the MurmurHash3 finalizer), so that consecutive keys
+/// land in unrelated buckets
+///
+/// @param k The key to hash
+/// @return The hash of k
+inline uint64_t hash64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb3f99fd7c66bULL;
+  k ^= k >> 33;
+  return k;
+}
+} // namespace internal
+
+/// @brief A hash map that lives in the RDMA heap, and is shared by every
+/// ComputeThread in the system
+/// @details
+/// The map is an array of cache-line sized buckets, split into partitions.
+/// Each partition is a separate allocation, so the MnAllocPolicy (e.g.,
+/// GLOBAL-RR) spreads the partitions across MemoryNodes and Segments.  A small
+/// directory, which New() returns, records where the partitions are.
+///
+/// A bucket is a header word, three key/value slots, and a trailer word:
+/// - Lookups read the key's home bucket with one RDMA read.  The header and
+///   trailer hold the same version when the bucket is not being modified, so
+///   a reader that sees them match (and the bucket unlocked) has a consistent
+///   bucket.  Otherwise, it reads again.
+/// - Inserts, updates and removes lock the home bucket with a CAS on its
+///   header, write the slots and the trailer (with the next version), and
+///   then write the header, which unlocks the bucket.
+/// - A key whose home bucket is full goes in one of the next kMaxProbe - 1
+///   buckets.  The home bucket's header records the span of buckets after it
+///   that hold its keys, and a lookup that misses in the home bucket reads
+///   the whole span with one more RDMA read.  Every change to a key is made
+///   while holding its home bucket's lock.
+///
+/// Keys must be trivially copyable and at most 8 bytes.  Values of at most 8
+/// bytes are stored in the slot.  Larger values are stored out of place, in
+/// their own allocation, and the slot holds an rdma_ptr to them, so a lookup
+/// of a large value takes a second read.
+///
+/// NB: Out-of-place values are immutable.  An update allocates a new value,
+///     and hands the old one to SchedReclaim(), since a concurrent lookup may
+///     still read it.  Call ReclaimDeferred() once no lookup can be in flight.
+///
+/// NB: The consistency check assumes that an RNIC writes (and reads) a bucket
+///     in increasing address order, as FaRM does.  The RDMA spec does not
+///     promise this, but commodity RNICs do it.
+///
+/// A HashMap object is a per-thread handle: make one in every thread that
+/// uses the map, from the rdma_ptr that New() returned.
+template <typename K, typename V> class HashMap {
+  static_assert(std::is_trivially_copyable_v<K> && sizeof(K) <= 8,
+                "HashMap keys must be trivially copyable and at most 8 bytes");
+  static_assert(std::is_trivially_copyable_v<V>,
+                "HashMap values must be trivially copyable");
+
+public:
+  /// The number of slots in a bucket
+  static constexpr uint64_t kSlots = 3;
+
+  /// The number of buckets that a key may be stored in, starting at its home
+  static constexpr uint64_t kMaxProbe = 32;
+
+  /// The largest number of partitions a map can have
+  static constexpr uint64_t kMaxParts = 64;
+
+  /// Are values stored in their slots (true), or out of place (false)?
+  static constexpr bool kInline = sizeof(V) <= sizeof(uint64_t);
+
+  /// @brief A key and its value (or the raw rdma_ptr to its value)
+  struct slot_t {
+    uint64_t key_;
+    uint64_t val_;
+  };
+
+  /// @brief The part of a bucket that a writer writes before unlocking it
+  struct body_t {
+    slot_t slots_[kSlots]; // The key/value pairs
+    uint64_t version_;     // The version, as of the last complete write
+  };
+
+  /// @brief A cache-line sized bucket
+  struct alignas(64) bucket_t {
+    uint64_t header_; // Lock and valid bits, the span, and the version
+    body_t body_;     // The slots and the trailer
+  };
+  static_assert(sizeof(bucket_t) == 64, "A bucket must be one cache line");
+
+  /// @brief The directory, which says where the partitions are
+  struct dir_t {
+    uint64_t num_buckets_;      // The number of home buckets
+    uint64_t part_buckets_;     // The number of home buckets per partition
+    uint64_t num_parts_;        // The number of partitions
+    uint64_t parts_[kMaxParts]; // The (raw) first bucket of each partition
+  };
+
+private:
+  /// The bits of a bucket header
+  static constexpr uint64_t kLocked = 1;       // A writer holds the bucket
+  static constexpr uint64_t kValidShift = 1;   // Which slots hold keys
+  static constexpr uint64_t kSpanShift = 4;    // Later buckets with home keys
+  static constexpr uint64_t kSpanMask = 31;    // (5 bits, < kMaxProbe)
+  static constexpr uint64_t kVersionShift = 9; // The version
+  static_assert(kMaxProbe - 1 <= kSpanMask, "A span must fit in its bits");
+
+  /// The number of buckets that New() zeroes with each Write
+  static constexpr uint64_t kZeroBuckets = 64;
+
+  ComputeThread *ct_; // The thread that this handle issues operations through
+  dir_t dir_;         // A copy of the directory
+
+  /// Report if slot i of a bucket with header h holds a key
+  static bool valid(uint64_t h, uint64_t i) {
+    return (h >> (kValidShift + i)) & 1;
+  }
+
+  /// Report the number of buckets after a home bucket with header h that may
+  /// hold its keys
+  static uint64_t span(uint64_t h) { return (h >> kSpanShift) & kSpanMask; }
+
+  /// Report if a bucket that was read in one operation is consistent
+  static bool stable(const bucket_t &b) {
+    return !(b.header_ & kLocked) &&
+           (b.header_ >> kVersionShift) == b.body_.version_;
+  }
+
+  /// Turn a key into the word that a slot stores
+  static uint64_t encode(const K &key) {
+    uint64_t w = 0;
+    std::memcpy(&w, &key, sizeof(K));
+    return w;
+  }
+
+  /// Find the home bucket of a key
+  rdma_ptr<bucket_t> home(uint64_t kw) const {
+    uint64_t idx = internal::hash64(kw) % dir_.num_buckets_;
+    uint64_t part = idx / dir_.part_buckets_;
+    return rdma_ptr<bucket_t>(dir_.parts_[part]) + idx % dir_.part_buckets_;
+  }
+
+  /// Read a bucket until the read sees a consistent version of it
+  bucket_t read_stable(rdma_ptr<bucket_t> b) {
+    while (true) {
+      auto bucket = ct_->Read<bucket_t>(b);
+      if (stable(bucket)) {
+        return bucket;
+      }
+    }
+  }
+
+  /// Find the slot that holds a key, or -1
+  static int find(const bucket_t &b, uint64_t kw) {
+    for (uint64_t i = 0; i < kSlots; ++i) {
+      if (valid(b.header_, i) && b.body_.slots_[i].key_ == kw) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /// Find an empty slot, or -1
+  static int find_free(const bucket_t &b) {
+    for (uint64_t i = 0; i < kSlots; ++i) {
+      if (!valid(b.header_, i)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /// Lock a bucket, if it has not changed since `bucket` was read from it
+  ///
+  /// @param b      The bucket
+  /// @param bucket The bucket's contents, as last read
+  /// @return true if the bucket is now locked
+  bool try_lock(rdma_ptr<bucket_t> b, const bucket_t &bucket) {
+    uint64_t h = bucket.header_;
+    return ct_->CompareAndSwap<uint64_t>(rdma_ptr<uint64_t>(b.raw()), h,
+                                         h | kLocked) == h;
+  }
+
+  /// Lock a bucket
+  ///
+  /// @param b      The bucket
+  /// @param bucket Set to the bucket's contents when it was locked
+  void lock(rdma_ptr<bucket_t> b, bucket_t &bucket) {
+    do {
+      bucket = read_stable(b);
+    } while (!try_lock(b, bucket));
+  }
+
+  /// Write a locked bucket's new contents, and unlock it with the next version
+  ///
+  /// @param b      The bucket
+  /// @param bucket The new contents, with the header that was read before the
+  ///               bucket was locked (plus any changed flags)
+  void unlock(rdma_ptr<bucket_t> b, bucket_t &bucket) {
+    uint64_t version = (bucket.header_ >> kVersionShift) + 1;
+    bucket.body_.version_ = version;
+    ct_->Write<body_t>(rdma_ptr<body_t>(b.raw() + sizeof(uint64_t)),
+                       bucket.body_);
+    uint64_t flags = bucket.header_ & ((1ULL << kVersionShift) - 1);
+    bucket.header_ = (version << kVersionShift) | (flags & ~kLocked);
+    ct_->Write<uint64_t>(rdma_ptr<uint64_t>(b.raw()), bucket.header_);
+  }
+
+  /// Unlock a bucket that was not changed
+  ///
+  /// @param b      The bucket
+  /// @param header The header that the bucket had before it was locked
+  void unlock_unchanged(rdma_ptr<bucket_t> b, uint64_t header) {
+    ct_->Write<uint64_t>(rdma_ptr<uint64_t>(b.raw()), header);
+  }
+
+  /// Turn a value into the word that a slot stores, allocating it out of place
+  /// if it is too big
+  uint64_t store(const V &val) {
+    if constexpr (kInline) {
+      uint64_t w = 0;
+      std::memcpy(&w, &val, sizeof(V));
+      return w;
+    } else {
+      auto ptr = ct_->allocate<V>();
+      ct_->Write<V>(ptr, val);
+      return ptr.raw();
+    }
+  }
+
+  /// Turn the word that a slot stores into a value
+  V load(uint64_t w) {
+    if constexpr (kInline) {
+      V val;
+      std::memcpy(&val, &w, sizeof(V));
+      return val;
+    } else {
+      return ct_->Read<V>(rdma_ptr<V>(w));
+    }
+  }
+
+  /// Retire an out-of-place value that a slot no longer references
+  void retire(uint64_t w) {
+    if constexpr (!kInline) {
+      ct_->SchedReclaim((V *)w);
+    }
+  }
+
+  /// Find a key in the buckets after its home bucket
+  ///
+  /// NB: The buckets are read with one RDMA read, and any that were being
+  ///     modified are read again, one at a time.  The read goes into a
+  ///     short-lived thread buffer, since a long-lived one would keep the
+  ///     thread's buffer ring from wrapping.
+  ///
+  /// @param hb     The key's home bucket
+  /// @param h      The home bucket's header
+  /// @param kw     The key
+  /// @param bucket Set to a consistent copy of the bucket that holds the key
+  /// @return The distance from hb to the bucket that holds the key, or 0 if
+  ///         the key is not there
+  uint64_t find_in_span(rdma_ptr<bucket_t> hb, uint64_t h, uint64_t kw,
+                        bucket_t &bucket) {
+    uint64_t n = span(h);
+    if (n == 0) {
+      return 0;
+    }
+    auto buf = ct_->local_allocate<bucket_t>(n);
+    REMUS_ASSERT(buf != nullptr,
+                 "Not enough thread buffer for a HashMap, increase {}",
+                 CN_THREAD_BUFSZ);
+    ct_->Read<bucket_t>(hb + 1, buf, true, n * sizeof(bucket_t));
+    uint64_t found = 0;
+    for (uint64_t p = 1; p <= n && found == 0; ++p) {
+      bucket = stable(buf[p - 1]) ? buf[p - 1] : read_stable(hb + p);
+      found = find(bucket, kw) >= 0 ? p : 0;
+    }
+    ct_->local_deallocate(buf);
+    return found;
+  }
+
+  /// Lock the bucket that holds a key (with its home bucket locked first),
+  /// let `fn` change the key's slot, and write the bucket back
+  ///
+  /// @param kw The key
+  /// @param fn Called with the locked bucket and the index of the key's slot
+  /// @return false if the key is not in the map
+  template <typename F> bool modify(uint64_t kw, F &&fn) {
+    auto hb = home(kw);
+    bucket_t hbucket;
+    lock(hb, hbucket);
+    uint64_t h = hbucket.header_;
+    int i = find(hbucket, kw);
+    if (i >= 0) {
+      fn(hbucket, i);
+      unlock(hb, hbucket);
+      return true;
+    }
+    // NB: While the home bucket is locked, the key cannot move, so it is safe
+    //     to find it before locking the bucket that it is in
+    bucket_t bucket;
+    uint64_t p = find_in_span(hb, h, kw, bucket);
+    if (p > 0) {
+      lock(hb + p, bucket);
+      fn(bucket, find(bucket, kw));
+      unlock(hb + p, bucket);
+    }
+    unlock_unchanged(hb, h);
+    return p > 0;
+  }
+
+public:
+  /// Make a new, empty map in the RDMA heap
+  ///
+  /// @param ct        The thread that allocates and initializes the map
+  /// @param capacity  The number of keys the map must hold
+  /// @param num_parts The number of partitions to split the buckets into
+  ///                  (e.g., the total number of Segments)
+  /// @return The directory, from which every thread can make a HashMap
+  static rdma_ptr<dir_t> New(ComputeThread *ct, uint64_t capacity,
+                             uint64_t num_parts) {
+    REMUS_ASSERT(num_parts > 0 && num_parts <= kMaxParts,
+                 "A HashMap needs between 1 and {} partitions", kMaxParts);
+    // Size for a load of 1/2 of the slots, so that runs of full buckets stay
+    // much shorter than kMaxProbe
+    uint64_t buckets = std::max<uint64_t>(1, (capacity * 2) / kSlots + 1);
+    dir_t dir{};
+    dir.part_buckets_ = (buckets + num_parts - 1) / num_parts;
+    dir.num_parts_ = num_parts;
+    dir.num_buckets_ = dir.part_buckets_ * num_parts;
+
+    // NB: Each partition has kMaxProbe - 1 extra buckets, so probing never
+    //     wraps around (which also keeps the lock order acyclic), and one
+    //     more, so that the buckets can be aligned to a cache line
+    uint64_t part_len = dir.part_buckets_ + kMaxProbe;
+    auto zeros = ct->local_allocate<bucket_t>(kZeroBuckets);
+    REMUS_ASSERT(zeros != nullptr,
+                 "Not enough thread buffer to zero {} buckets, increase {}",
+                 kZeroBuckets, CN_THREAD_BUFSZ);
+    std::memset((void *)zeros, 0, kZeroBuckets * sizeof(bucket_t));
+    for (uint64_t i = 0; i < num_parts; ++i) {
+      auto raw = ct->allocate<bucket_t>(part_len).raw();
+      auto aligned = (raw + sizeof(bucket_t) - 1) & ~(sizeof(bucket_t) - 1);
+      dir.parts_[i] = aligned;
+      for (uint64_t j = 0; j < part_len - 1; j += kZeroBuckets) {
+        uint64_t n = std::min(kZeroBuckets, part_len - 1 - j);
+        ct->Write<bucket_t>(rdma_ptr<bucket_t>(aligned) + j, zeros, true,
+                            n * sizeof(bucket_t));
+      }
+    }
+    ct->local_deallocate(zeros);
+    auto ptr = ct->allocate<dir_t>();
+    ct->Write<dir_t>(ptr, dir);
+    return ptr;
+  }
+
+  /// Make a handle for a map, through which a thread can use it
+  ///
+  /// @param ct   The thread that will use this handle
+  /// @param dir  The directory that New() returned
+  HashMap(ComputeThread *ct, rdma_ptr<dir_t> dir)
+      : ct_(ct), dir_(ct->Read<dir_t>(dir)) {}
+
+  /// Look up a key
+  ///
+  /// @param key The key
+  /// @return The key's value, or nullopt if it is not in the map
+  std::optional<V> Get(const K &key) {
+    uint64_t kw = encode(key);
+    auto hb = home(kw);
+    auto bucket = read_stable(hb);
+    int i = find(bucket, kw);
+    if (i >= 0) {
+      return load(bucket.body_.slots_[i].val_);
+    }
+    bucket_t next;
+    if (find_in_span(hb, bucket.header_, kw, next) > 0) {
+      return load(next.body_.slots_[find(next, kw)].val_);
+    }
+    return std::nullopt;
+  }
+
+  /// Insert a key, if it is not already in the map
+  ///
+  /// @param key The key
+  /// @param val The value
+  /// @return true if the key was inserted, false if it was already present
+  bool Insert(const K &key, const V &val) {
+    uint64_t kw = encode(key);
+    auto hb = home(kw);
+    bucket_t hbucket;
+    lock(hb, hbucket);
+    uint64_t h = hbucket.header_;
+
+    // With the home bucket locked, no other thread can insert or remove this
+    // key, so check that it is not present
+    bucket_t bucket;
+    if (find(hbucket, kw) >= 0 || find_in_span(hb, h, kw, bucket) > 0) {
+      unlock_unchanged(hb, h);
+      return false;
+    }
+
+    // Prefer the home bucket, so that a lookup takes one read
+    slot_t slot{kw, store(val)};
+    int i = find_free(hbucket);
+    if (i >= 0) {
+      hbucket.body_.slots_[i] = slot;
+      hbucket.header_ |= 1ULL << (kValidShift + i);
+      unlock(hb, hbucket);
+      return true;
+    }
+    for (uint64_t p = 1; p < kMaxProbe; ++p) {
+      auto b = hb + p;
+      int j;
+      do {
+        bucket = read_stable(b);
+        j = find_free(bucket);
+      } while (j >= 0 && !try_lock(b, bucket));
+      if (j < 0) {
+        continue;
+      }
+      bucket.body_.slots_[j] = slot;
+      bucket.header_ |= 1ULL << (kValidShift + j);
+      unlock(b, bucket);
+      if (p > span(h)) {
+        hbucket.header_ &= ~(kSpanMask << kSpanShift);
+        hbucket.header_ |= p << kSpanShift;
+      }
+      unlock(hb, hbucket);
+      return true;
+    }
+    unlock_unchanged(hb, h);
+    REMUS_FATAL("HashMap is full: no free slot within {} buckets of key {}",
+                kMaxProbe, kw);
+  }
+
+  /// Change the value of a key that is in the map
+  ///
+  /// @param key The key
+  /// @param val The new value
+  /// @return true if the key was updated, false if it was not present
+  bool Update(const K &key, const V &val) {
+    uint64_t kw = encode(key);
+    uint64_t w = store(val);
+    bool found = modify(kw, [&](bucket_t &bucket, int i) {
+      retire(bucket.body_.slots_[i].val_);
+      bucket.body_.slots_[i].val_ = w;
+    });
+    if constexpr (!kInline) {
+      if (!found) {
+        ct_->deallocate(rdma_ptr<V>(w)); // No one else has seen it
+      }
+    }
+    return found;
+  }
+
+  /// Remove a key from the map
+  ///
+  /// NB: The home bucket's span is not shrunk, since other keys may still be
+  ///     at its end.
+  ///
+  /// @param key The key
+  /// @return true if the key was removed, false if it was not present
+  bool Remove(const K &key) {
+    return modify(encode(key), [&](bucket_t &bucket, int i) {
+      retire(bucket.body_.slots_[i].val_);
+      bucket.header_ &= ~(1ULL << (kValidShift + i));
+    });
+  }
+};
+} // namespace remus
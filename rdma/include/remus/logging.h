@@ -8,6 +8,8 @@
 #include <string>
 #include <string_view>
 
+#include "async_log.h"
+
 namespace remus {
 
 /// @brief An enum to track the type of status
@@ -73,43 +75,36 @@ namespace remus {
 #define REMUS_LOG_LEVEL DEBUG
 #endif
 
-/// Print a message
-///
-/// @param msg The message to print
-///
-inline void print_debug(std::string_view msg, const char *file, uint32_t line) {
-  // NB: for thread-safety, we use printf
-  std::printf("[DEBUG] %.*s (%s:%u)\n", (int)msg.length(), msg.data(), file,
-              line);
-  std::fflush(stdout);
-}
-/// Print an info message
-///
-/// @param msg The message to print
-inline void print_info(std::string_view msg) {
-  // NB: for thread-safety, we use printf
-  std::printf("[INFO] %.*s\n", (int)msg.length(), msg.data());
-  std::fflush(stdout);
-}
-/// Print a fatal message
+/// Print a fatal message, after every message that was logged before it
 ///
 /// @param msg The message to print
 inline void print_fatal(std::string_view msg) {
+  log_flush();
   // NB: for thread-safety, we use printf
   std::printf("[FATAL] %.*s\n", (int)msg.length(), msg.data());
   std::fflush(stdout);
 }
 
-/// Print a debug message only if REMUS_DEBUG_MSGS is defined
+/// Log a message from this call site, if its level is enabled.  The hot path
+/// only copies the arguments into a per-thread ring (see async_log.h).
+#define REMUS_LOG_AT(level, fmt, ...)                                        \
+  do {                                                                       \
+    static remus::internal::log_site_t remus_log_site_{level, fmt, __FILE__, \
+                                                       __LINE__};            \
+    if (remus::log_enabled(level)) {                                         \
+      remus::internal::log(remus_log_site_, fmt __VA_OPT__(, ) __VA_ARGS__); \
+    }                                                                        \
+  } while (0)
+
+/// Log a debug message, only if REMUS_LOG_LEVEL is DEBUG
 #if REMUS_LOG_LEVEL == DEBUG
-#define REMUS_DEBUG(...) \
-  remus::print_debug(std::format(__VA_ARGS__), __FILE__, __LINE__)
+#define REMUS_DEBUG(...) REMUS_LOG_AT(remus::LOG_DEBUG, __VA_ARGS__)
 #else
 #define REMUS_DEBUG(...)
 #endif
 
-/// Print an information message
-#define REMUS_INFO(...) remus::print_info(std::format(__VA_ARGS__))
+/// Log an information message
+#define REMUS_INFO(...) REMUS_LOG_AT(remus::LOG_INFO, __VA_ARGS__)
 
 /// Terminate with a message on a fatal error
 #define REMUS_FATAL(...)                          \
@@ -3,14 +3,18 @@
 #include <rdma/rdma_cma.h>
 
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <thread>
 
 #include "cfg.h"
 #include "connection.h"
 #include "logging.h"
+#include "numa.h"
 #include "rdma_ops.h"
 #include "rdma_ptr.h"
+#include "rpc.h"
 #include "util.h"
 
 namespace remus {
@@ -41,6 +45,14 @@ namespace remus {
 /// listening id is performed by a separate thread, so that a co-located Compute
 /// Node context can try to connect to remote machines while receiving
 /// connections from those same machines.
+///
+/// With `--transport SHM`, there is no RNIC: each Segment is a POSIX shared
+/// memory object, and instead of Sending rkeys, the MemoryNode publishes them
+/// in a shared memory "directory" that ComputeNodes on the same host can read.
+///
+/// A MemoryNode can also serve RPCs: handlers registered with RegisterRpc()
+/// before init_done() are run by a poller thread, on batches of requests that
+/// arrive in receive buffers that are posted on every connection.
 class MemoryNode {
   // TODO: Why protected?  Do we extend MemoryNode?
  protected:
@@ -52,6 +64,7 @@ class MemoryNode {
   struct IdContext {
     uint32_t machine_id_;         // The connected machine's id
     rdma_conn_param conn_param_;  // Private data to send during config
+    internal::Connection *conn_;  // The connection, to Send rkeys on
 
     /// Extract the machine id from a context object
     ///
@@ -82,6 +95,13 @@ class MemoryNode {
   MachineInfo self_;                              // This machine's id/addr
   std::vector<ConnPtr> conns_;                    // All open connections
   std::vector<SegInfo> segs_;                     // The RDMA heaps
+  int numa_node_ = -1;  // The NUMA node of the Segments' memory (-1 for any)
+  int cpu_ = -1;        // The CPU that this node's threads run on (-1 for any)
+
+  /// When construction started, and how long each startup phase took
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::duration seg_time_{};    // Making the Segments
+  std::chrono::steady_clock::duration listen_time_{}; // Until all connected
 
   /// A segment that is registered with the RNIC in a manner that allows limited
   /// send() calls.
@@ -93,6 +113,80 @@ class MemoryNode {
   internal::Segment send_seg_;
   internal::ibv_mr_ptr mr_;  // MemoryRegistration for send_seg_
 
+  /// @brief A connection that the RPC poller serves
+  struct rpc_ep_t {
+    internal::Connection *conn_;  // The connection
+    uint8_t *send_bufs_;          // Where responses are built, one per slot
+    std::atomic<int> ack_{0};     // Responses whose sends have not completed
+
+    rpc_ep_t(internal::Connection *conn, uint8_t *send_bufs)
+        : conn_(conn), send_bufs_(send_bufs) {}
+  };
+
+  internal::RpcServer rpc_server_;  // The RPC handlers
+  std::deque<rpc_ep_t> rpc_eps_;    // Every connection that RPCs arrive on
+  std::thread rpc_poller_;          // The thread that serves RPCs
+  std::atomic<bool> rpc_stop_{false};  // Tells rpc_poller_ to stop
+
+  /// The RPC buffers of the connections: for each, kRpcSlots to send from and
+  /// kRpcSlots to receive into (under SHM, only the first kRpcSlots are used)
+  std::unique_ptr<internal::Segment> rpc_seg_;
+  internal::ibv_mr_ptr rpc_mr_;  // MemoryRegistration for rpc_seg_
+
+  /// Under the SHM transport, the RPC channel of every ComputeThread, and the
+  /// completion queue for the sends of responses
+  std::vector<std::unique_ptr<internal::Segment>> rpc_chans_;
+  internal::ShmCq rpc_cq_{0};
+
+  /// Make the Segment that holds the RPC buffers of `conns` connections
+  void make_rpc_seg(uint64_t conns) {
+    uint64_t bytes = std::max<uint64_t>(conns, 1) * 2 * internal::kRpcSlots *
+                     internal::kRpcBufSize;
+    rpc_seg_ = std::make_unique<internal::Segment>(
+        1ULL << (64 - __builtin_clzll(bytes - 1)));
+  }
+
+  /// The main loop of the RPC poller: serve every batch that arrives on any
+  /// connection, until the MemoryNode shuts down
+  ///
+  /// NB: A receive is reposted before its response is sent, so a client that
+  ///     sends a new batch once it has a response always finds a receive.
+  void serve_rpcs() {
+    while (!rpc_stop_.load(std::memory_order_relaxed)) {
+      bool idle = true;
+      for (auto &ep : rpc_eps_) {
+        uint32_t slot, len;
+        const uint8_t *msg;
+        while (ep.conn_->rpc_recv(slot, msg, len)) {
+          auto resp = ep.send_bufs_ + slot * internal::kRpcBufSize;
+          auto n = rpc_server_.serve(msg, len, resp);
+          ep.conn_->rpc_repost(slot);
+          ep.ack_.fetch_add(1);
+          ep.conn_->rpc_send(resp, n, &ep.ack_);
+          idle = false;
+        }
+        if (ep.ack_ > 0) {
+          internal::PollBatch(ep.conn_, rdma_ptr<uint8_t>());
+        }
+      }
+      if (idle) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /// Start the RPC poller, if there are handlers for it to run
+  void start_rpc_poller() {
+    if (!rpc_server_.empty()) {
+      REMUS_INFO("MemoryNode {} serving RPCs on {} connections", self_.id,
+                 rpc_eps_.size());
+      rpc_poller_ = std::thread([this]() {
+        internal::pin_thread(cpu_);
+        serve_rpcs();
+      });
+    }
+  }
+
   /// The main loop run by the listening thread.  Polls for new events on the
   /// listening endpoint and handles them.  This typically means receiving new
   /// connections, configuring the new endpoints, and then putting them into
@@ -129,9 +223,10 @@ class MemoryNode {
           break;
 
         case RDMA_CM_EVENT_ESTABLISHED:
-          // Once the connection is fully established, we just ack it, and then
-          // it's ready for use.
+          // Once the connection is fully established, the ComputeNode is
+          // ready to receive our rkeys
           rdma_ack_cm_event(event);
+          on_established(id);
           break;
 
         case RDMA_CM_EVENT_DISCONNECTED:
@@ -192,7 +287,7 @@ class MemoryNode {
     // associated with this id so that we can reference it later.
     //
     // TODO: This config should be double-checked
-    auto context = new IdContext{machine_id, {}};
+    auto context = new IdContext{machine_id, {}, nullptr};
     context->conn_param_.private_data = &context->machine_id_;
     context->conn_param_.private_data_len = sizeof(context->machine_id_);
     context->conn_param_.rnr_retry_count = 7;  // Retry forever
@@ -203,9 +298,15 @@ class MemoryNode {
     internal::make_nonblocking(id->recv_cq->channel->fd);
     internal::make_nonblocking(id->send_cq->channel->fd);
 
-    // Save the connection and ack it
+    // Save the connection, and post its RPC receives before it can be used
     auto conn = new internal::Connection(self_.id, machine_id, id);
+    context->conn_ = conn;
     conns_.emplace_back(conn);
+    auto bufs = rpc_seg_->raw() +
+                rpc_eps_.size() * 2 * internal::kRpcSlots * internal::kRpcBufSize;
+    conn->rpc_attach(bufs + internal::kRpcSlots * internal::kRpcBufSize,
+                     rpc_mr_->lkey);
+    rpc_eps_.emplace_back(conn, bufs);
 
     ret = rdma_accept(id,
                       machine_id == self_.id ? nullptr : &context->conn_param_);
@@ -214,7 +315,16 @@ class MemoryNode {
 
     // TODO: We're not checking for errors on this ack?!?
     rdma_ack_cm_event(event);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  /// Handler to run when an accepted connection is established: Send the
+  /// rkeys to the ComputeNode.
+  ///
+  /// NB: The ComputeNode posts its receive before it connects, so the Send
+  ///     cannot arrive early, and its completion means the ComputeNode has
+  ///     the rkeys.  Once every connection's Send is done, startup is done.
+  void on_established(rdma_cm_id *id) {
+    auto conn = reinterpret_cast<IdContext *>(id->context)->conn_;
     // TODO:  Should Send have fail-stop semantics instead of returning a status
     //        that needs to be checked?
     auto status = conn->Send(ris_, send_seg_, mr_.get());
@@ -241,6 +351,56 @@ class MemoryNode {
     // ... And don't forget to remove node_id from conns_
   }
   const uint64_t total_threads_;
+  const bool shm_;  // Is this node using the SHM transport instead of RDMA?
+
+  /// Under the SHM transport, make the Segments from shared memory objects,
+  /// and publish their RegionInfo for ComputeNodes to find.  There is no
+  /// listening endpoint, and no registration.
+  ///
+  /// @param num_segs       The number of Segments to make
+  /// @param seg_size_bits  The log_2 of the size of each Segment
+  /// @param c0             The id of the first ComputeNode
+  /// @param cn_last        The id of the last ComputeNode
+  /// @param threads        The number of ComputeThreads per ComputeNode
+  void init_shm(uint64_t num_segs, uint64_t seg_size_bits, uint64_t c0,
+                uint64_t cn_last, uint64_t threads) {
+    for (uint64_t i = 0; i < num_segs; ++i) {
+      auto seg = std::make_unique<internal::Segment>(
+          1ULL << seg_size_bits, internal::shm_seg_name(port_, self_.id, i),
+          true);
+      internal::numa_bind(seg->raw(), seg->capacity(), numa_node_);
+      new ((internal::ControlBlock *)(seg->raw()))
+          internal::ControlBlock(1ULL << seg_size_bits);
+      ris_.emplace_back((uintptr_t)seg->raw(),
+                        internal::shm_rkey(self_.id, i));
+      segs_.emplace_back(SegInfo{std::move(seg), nullptr});
+    }
+    REMUS_INFO("Shared Segments:");
+    for (auto ri : ris_) {
+      REMUS_INFO("  0x{:x} (rk=0x{:x})", ri.raddr, ri.rkey);
+    }
+    // Make every ComputeThread's RPC channel before publishing, since that is
+    // what tells ComputeNodes that they may open them.  Responses are built in
+    // one set of buffers, because sending copies them into the channel.
+    make_rpc_seg(1);
+    for (uint64_t cn = c0; cn <= cn_last; ++cn) {
+      for (uint64_t t = 0; t < threads; ++t) {
+        rpc_chans_.push_back(std::make_unique<internal::Segment>(
+            internal::kShmRpcChannelSize,
+            internal::shm_rpc_name(port_, self_.id, cn, t), true));
+        auto slots = (internal::shm_rpc_slot_t *)rpc_chans_.back()->raw();
+        auto conn = new internal::Connection(self_.id, cn, &rpc_cq_, nullptr,
+                                             0);
+        conn->rpc_attach(slots, slots + internal::kRpcSlots);
+        conns_.emplace_back(conn);
+        rpc_eps_.emplace_back(conn, rpc_seg_->raw());
+      }
+    }
+    internal::publish_shm_dir(internal::shm_dir_name(port_, self_.id), ris_,
+                              1ULL << seg_size_bits);
+    REMUS_INFO("MemoryNode {} published its Segments over shared memory",
+               self_.id);
+  }
 
  public:
   /// TODO: Need to make sure all fields get reclaimed/destructed properly
@@ -250,7 +410,17 @@ class MemoryNode {
     while (cb_ptr->control_flag_.load() != total_threads_) {
       std::this_thread::yield();
     }
+    // NB: Every ComputeThread waits for its RPCs before it arrives above
+    if (rpc_poller_.joinable()) {
+      rpc_stop_ = true;
+      rpc_poller_.join();
+    }
     REMUS_INFO("MemoryNode shutdown");
+    if (shm_) {
+      // NB: The Segments unlink their own shared memory objects
+      shm_unlink(internal::shm_dir_name(port_, self_.id).c_str());
+      return;
+    }
     sleep(3);
   }
 
@@ -263,23 +433,39 @@ class MemoryNode {
                       std::shared_ptr<remus::ArgMap> args)
       : self_(self),
         conns_(),
+        start_(std::chrono::steady_clock::now()),
         send_seg_(1 << 20),
         total_threads_(args->uget(remus::CN_THREADS) *
                        (args->uget(remus::LAST_CN_ID) -
-                        args->uget(remus::FIRST_CN_ID) + 1)) {
+                        args->uget(remus::FIRST_CN_ID) + 1)),
+        shm_(args->sget(remus::TRANSPORT) == "SHM") {
+    set_log_level(to_log_level(args->sget(remus::LOG_LEVEL)));
+    set_log_rate_limit(args->uget(remus::LOG_RATE_LIMIT));
     int id = args->uget(remus::NODE_ID);
     uint64_t num_segs = args->uget(remus::SEGS_PER_MN);
     uint64_t seg_size_bits = args->uget(remus::SEG_SIZE);
     REMUS_INFO("Node {}: Configuring Memory Node ({} segments at 2^{}B each)",
                id, num_segs, seg_size_bits);
 
+    auto cpus = internal::parse_cpu_list(args->sget(remus::CPU_LIST));
+    cpu_ = cpus.empty() ? -1 : cpus.back();
+
+    if (shm_) {
+      port_ = args->uget(remus::MN_PORT);
+      numa_node_ = internal::numa_node_arg(args->sget(remus::NUMA_NODE));
+      init_shm(num_segs, seg_size_bits, args->uget(remus::FIRST_CN_ID),
+               args->uget(remus::LAST_CN_ID), args->uget(remus::CN_THREADS));
+      return;
+    }
+
     // How many non-localhost compute nodes are there?
     int c0 = args->uget(remus::FIRST_CN_ID);
     int cn = args->uget(remus::LAST_CN_ID);
     uint32_t cns = cn - c0 + 1;
     if (id >= c0 && id <= cn) cns--;
+    // Every thread of every compute node has its own QP_LANES connections
     uint32_t qlw = args->uget(remus::QP_LANES);
-    remaining_conns_ = cns * qlw;
+    remaining_conns_ = cns * qlw * args->uget(remus::CN_THREADS);
 
     // Make the listening endpoint, and register the sending segment with it
     uint16_t port = args->uget(remus::MN_PORT);
@@ -287,16 +473,31 @@ class MemoryNode {
     REMUS_ASSERT(listen_id_->pd != nullptr, "Error creating protection domain");
     mr_ = send_seg_.registerWithPd(listen_id_->pd);
 
+    // Place the Segments' memory before anything touches it, preferably on the
+    // RNIC's socket, so that its DMAs don't cross the socket interconnect
+    numa_node_ = internal::numa_node_arg(
+        args->sget(remus::NUMA_NODE),
+        listen_id_->verbs == nullptr ? nullptr : listen_id_->verbs->device);
+    make_rpc_seg(remaining_conns_);
+    internal::numa_bind(rpc_seg_->raw(), rpc_seg_->capacity(), numa_node_);
+    rpc_mr_ = rpc_seg_->registerWithPd(listen_id_->pd);
+
     // Construct the memory pools, configure their control region, and register
     // them with the listening endpoint
     for (uint64_t i = 0; i < num_segs; ++i) {
-      auto seg = std::make_unique<internal::Segment>(1ULL << seg_size_bits);
+      auto seg = std::make_unique<internal::Segment>(
+          1ULL << seg_size_bits,
+          internal::to_page_size(args->sget(remus::SEG_PAGE_SIZE)));
+      internal::numa_bind(seg->raw(), seg->capacity(), numa_node_);
+      seg->prefault();
       new ((internal::ControlBlock *)(seg->raw()))
           internal::ControlBlock(1ULL << seg_size_bits);
       auto mr = seg->registerWithPd(listen_id_->pd);
       segs_.emplace_back(SegInfo{std::move(seg), std::move(mr)});
     }
 
+    seg_time_ = std::chrono::steady_clock::now() - start_;
+
     // Prepare the RegionInfo for this node
     //
     // NB:  We could be more efficient if we constructed the ris in a segment,
@@ -329,7 +530,11 @@ class MemoryNode {
         reinterpret_cast<sockaddr_in *>(rdma_get_local_addr(listen_id_))
             ->sin_addr));
     port_ = rdma_get_src_port(listen_id_);
-    runner_ = std::thread([&]() { handle_connections(); });
+    runner_ = std::thread([&]() {
+      internal::pin_thread(cpu_);
+      handle_connections();
+      listen_time_ = std::chrono::steady_clock::now() - start_ - seg_time_;
+    });
   }
 
   /// Return a vector with the RegionInfo for this MemoryNode.  This is a
@@ -338,6 +543,9 @@ class MemoryNode {
   /// for use over the loopback in the standard way (i.e., it can't connect to
   /// itself and do a Send/Recv).
   std::vector<internal::RegionInfo> get_local_rkeys() {
+    if (shm_) {
+      return ris_;
+    }
     std::vector<internal::RegionInfo> res;
     for (auto &p : segs_)
       res.push_back(
@@ -345,19 +553,47 @@ class MemoryNode {
     return res;
   }
 
-  /// Stop listening for new connections, and terminate the listening thread
+  /// Stop listening for new connections, terminate the listening thread, and
+  /// report where the startup time went
   ///
-  /// NB: This blocks the caller until the listening thread has been joined
+  /// NB: This blocks the caller until the listening thread has been joined,
+  ///     which happens once every ComputeNode has received its rkeys
   void init_done() {
+    if (shm_) {
+      start_rpc_poller();
+      return; // There is no listening thread
+    }
     REMUS_INFO("Stopping listening thread...");
     runner_.join();
     rdma_destroy_ep(listen_id_);
-    // TODO: if not sleep, other compute threads can't write to it, need figure
-    // out why
-    sleep(1);
-    // TODO:  If the barrier also had a "half barrier", where threads could
-    //        increment but not wait, then we could use it to ACK when this can
-    //        finally stop
+    auto ms = [](std::chrono::steady_clock::duration d) {
+      return std::chrono::duration<double, std::milli>(d).count();
+    };
+    REMUS_INFO("MemoryNode {}: Started in {:.1f} ms (Segments {:.1f} ms, "
+               "{} connections {:.1f} ms)",
+               self_.id, ms(std::chrono::steady_clock::now() - start_),
+               ms(seg_time_), conns_.size(), ms(listen_time_));
+    start_rpc_poller();
+  }
+
+  /// Register an RPC handler.  Handlers must be registered before init_done(),
+  /// which starts the thread that runs them.
+  ///
+  /// NB: Handlers must be thread-safe (see internal::RpcServer).
+  ///
+  /// @tparam Req   The type of the handler's requests
+  /// @tparam Resp  The type of the handler's responses
+  /// @param id     The id that clients call the handler by
+  /// @param fn     A callable that takes a const Req& and returns a Resp
+  template <typename Req, typename Resp, typename F>
+  void RegisterRpc(uint32_t id, F &&fn) {
+    REMUS_ASSERT(!rpc_poller_.joinable(),
+                 "RPC handlers must be registered before init_done()");
+    rpc_server_.template add<Req, Resp>(id, std::forward<F>(fn));
   }
+
+  /// Return this node's RPC handlers, so that a co-located ComputeNode can run
+  /// them directly (see ComputeNode::connect_local())
+  const internal::RpcServer *rpc_server() const { return &rpc_server_; }
 };
 }  // namespace remus
\ No newline at end of file
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <string>
+
+namespace remus {
+
+/// @brief A log-bucketed latency histogram, in the style of HdrHistogram
+/// @details
+/// Values below 2^kSubBits get a bucket each.  Above that, every power of two
+/// is split into 2^kSubBits equal buckets, so a bucket's width is at most
+/// 1/2^kSubBits (about 6%) of the values in it.  Recording a value is a bit
+/// scan and an increment, so it is cheap enough for every operation.
+class histogram_t {
+  /// The number of bits of each value, below its leading 1, that pick a bucket
+  static constexpr uint64_t kSubBits = 4;
+
+  /// The number of buckets per power of two
+  static constexpr uint64_t kSubBuckets = 1ULL << kSubBits;
+
+  /// The total number of buckets, enough for any 64-bit value
+  static constexpr uint64_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+  std::array<uint64_t, kBuckets> buckets_{}; // The count in each bucket
+  uint64_t count_ = 0;                       // The number of values recorded
+  uint64_t sum_ = 0;                         // The sum of the values
+  uint64_t max_ = 0;                         // The largest value recorded
+
+  /// Compute the bucket that holds a value
+  static uint64_t bucket_of(uint64_t v) {
+    if (v < kSubBuckets) {
+      return v;
+    }
+    uint64_t msb = 63 - std::countl_zero(v);
+    uint64_t shift = msb - kSubBits;
+    return (shift + 1) * kSubBuckets + ((v >> shift) & (kSubBuckets - 1));
+  }
+
+  /// Compute the largest value that a bucket holds
+  static uint64_t highest_in(uint64_t bucket) {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    uint64_t shift = bucket / kSubBuckets - 1;
+    uint64_t sub = bucket % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+  }
+
+public:
+  /// Record one value
+  void record(uint64_t v) {
+    ++buckets_[bucket_of(v)];
+    ++count_;
+    sum_ += v;
+    max_ = std::max(max_, v);
+  }
+
+  /// Add every value recorded in `other` to this histogram
+  void merge(const histogram_t &other) {
+    for (uint64_t i = 0; i < kBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  /// Report the value at or below which a fraction `q` (in [0, 1]) of the
+  /// recorded values fall.  The result is the top of the bucket that holds
+  /// that value, so it overstates by at most one bucket width.
+  uint64_t percentile(double q) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * count_ + 0.5));
+    uint64_t seen = 0;
+    for (uint64_t i = 0; i < kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(highest_in(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  /// Report the number of values recorded
+  uint64_t count() const { return count_; }
+
+  /// Report the mean of the values recorded
+  double mean() const { return count_ == 0 ? 0 : (double)sum_ / count_; }
+
+  /// Report the largest value recorded
+  uint64_t max() const { return max_; }
+};
+
+namespace internal {
+/// Report the number of timestamp counter ticks per nanosecond.  The first
+/// call calibrates the counter against steady_clock, which takes ~10ms.
+inline double tsc_per_ns() {
+  static const double ratio = [] {
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = __rdtsc();
+    std::chrono::nanoseconds elapsed{0};
+    while (elapsed < std::chrono::milliseconds(10)) {
+      elapsed = std::chrono::steady_clock::now() - t0;
+    }
+    return (double)(__rdtsc() - c0) / elapsed.count();
+  }();
+  return ratio;
+}
+} // namespace internal
+
+/// @brief The counters and latencies of one kind of operation
+struct op_metrics_t {
+  uint64_t ops_ = 0;     // The number of operations
+  uint64_t bytes_ = 0;   // The number of bytes they moved
+  uint64_t retries_ = 0; // The number that must be retried (e.g., failed CAS)
+  histogram_t latency_;  // Their latencies, in timestamp counter ticks
+
+  /// Add the counts and latencies of `other` to these
+  void merge(const op_metrics_t &other) {
+    ops_ += other.ops_;
+    bytes_ += other.bytes_;
+    retries_ += other.retries_;
+    latency_.merge(other.latency_);
+  }
+};
+
+/// @brief Per-thread counters and latency histograms for every kind of RDMA
+/// operation, and for the allocator
+/// @details
+/// Every ComputeThread has its own Metrics, so recording needs no
+/// synchronization.  Counters are always kept.  Latencies are only measured
+/// (with rdtsc) when --metrics is given.  When the threads are done, merge()
+/// their Metrics into one, and then dump it with to_string() or to_json().
+///
+/// NB: A Seq or Batch round is one latency sample, but each of its operations
+///     is counted in ops_.
+class Metrics {
+public:
+  /// The kinds of operations that are measured separately
+  enum op_t { READ, WRITE, CAS, FAA, SEQ, BATCH, ASYNC, RPC, NUM_OP_TYPES };
+
+  /// The names of the kinds of operations, for dumps
+  static constexpr const char *kOpNames[NUM_OP_TYPES] = {
+      "read", "write", "cas", "faa", "seq", "batch", "async", "rpc"};
+
+  /// @brief How the allocator satisfied allocations
+  struct alloc_metrics_t {
+    uint64_t local_ = 0;    // From this thread's freelists or chunks
+    uint64_t recycled_ = 0; // From a Segment's free stack
+    uint64_t chunk_ = 0;    // From a freshly reserved chunk
+    uint64_t global_ = 0;   // Directly from a Segment
+    uint64_t frees_ = 0;    // The number of deallocations
+  };
+
+  /// @brief How CachedRead() fared
+  struct cache_metrics_t {
+    uint64_t hits_ = 0;        // Served from the cache
+    uint64_t misses_ = 0;      // Not in the cache
+    uint64_t stale_ = 0;       // In the cache, but with an old version
+    uint64_t bytes_saved_ = 0; // Bytes that hits did not have to read
+  };
+
+private:
+  bool timed_ = false;                           // Are latencies measured?
+  std::array<op_metrics_t, NUM_OP_TYPES> ops_{}; // The per-kind metrics
+  alloc_metrics_t alloc_{};                      // The allocator metrics
+  cache_metrics_t cache_{};                      // The read cache metrics
+
+public:
+  /// Construct an empty Metrics
+  ///
+  /// @param timed If true, record operation latencies
+  explicit Metrics(bool timed = false) : timed_(timed) {}
+
+  /// Start timing an operation
+  ///
+  /// @return A timestamp to pass to record(), or 0 if latencies are off
+  uint64_t start() const { return timed_ ? __rdtsc() : 0; }
+
+  /// Count an operation, and record its latency if it was timed
+  ///
+  /// @param op    The kind of operation
+  /// @param start The result of the start() call before the operation
+  /// @param bytes The number of bytes the operation moved
+  /// @param ops   The number of operations (e.g., in a Seq round)
+  void record(op_t op, uint64_t start, uint64_t bytes, uint64_t ops = 1) {
+    auto &m = ops_[op];
+    m.ops_ += ops;
+    m.bytes_ += bytes;
+    if (start != 0) {
+      m.latency_.record(__rdtsc() - start);
+    }
+  }
+
+  /// Count an operation that will be issued later, as part of a round
+  ///
+  /// @param op    The kind of operation
+  /// @param bytes The number of bytes the operation moves
+  void count(op_t op, uint64_t bytes) {
+    ++ops_[op].ops_;
+    ops_[op].bytes_ += bytes;
+  }
+
+  /// Count an operation whose outcome means that it must be retried
+  void retry(op_t op) { ++ops_[op].retries_; }
+
+  /// Report the metrics of one kind of operation
+  const op_metrics_t &op(op_t op) const { return ops_[op]; }
+
+  /// Report the allocator metrics (and let the allocator update them)
+  alloc_metrics_t &alloc() { return alloc_; }
+  const alloc_metrics_t &alloc() const { return alloc_; }
+
+  /// Report the read cache metrics (and let CachedRead() update them)
+  cache_metrics_t &cache() { return cache_; }
+  const cache_metrics_t &cache() const { return cache_; }
+
+  /// Add every count and latency of `other` into this Metrics
+  void merge(const Metrics &other) {
+    timed_ |= other.timed_;
+    for (int i = 0; i < NUM_OP_TYPES; ++i) {
+      ops_[i].merge(other.ops_[i]);
+    }
+    alloc_.local_ += other.alloc_.local_;
+    alloc_.recycled_ += other.alloc_.recycled_;
+    alloc_.chunk_ += other.alloc_.chunk_;
+    alloc_.global_ += other.alloc_.global_;
+    alloc_.frees_ += other.alloc_.frees_;
+    cache_.hits_ += other.cache_.hits_;
+    cache_.misses_ += other.cache_.misses_;
+    cache_.stale_ += other.cache_.stale_;
+    cache_.bytes_saved_ += other.cache_.bytes_saved_;
+  }
+
+  /// Produce a human-readable table, with latencies in nanoseconds
+  std::string to_string() const {
+    std::string out = std::format(
+        "{:>6} {:>12} {:>14} {:>9} {:>10} {:>10} {:>10} {:>10}\n", "op", "ops",
+        "bytes", "retries", "p50(ns)", "p99(ns)", "p999(ns)", "max(ns)");
+    for (int i = 0; i < NUM_OP_TYPES; ++i) {
+      auto &m = ops_[i];
+      if (m.ops_ == 0) {
+        continue;
+      }
+      out += std::format(
+          "{:>6} {:>12} {:>14} {:>9} {:>10.0f} {:>10.0f} {:>10.0f} {:>10.0f}\n",
+          kOpNames[i], m.ops_, m.bytes_, m.retries_, ns(m.latency_, 0.5),
+          ns(m.latency_, 0.99), ns(m.latency_, 0.999),
+          ns(m.latency_, 1.0));
+    }
+    out += std::format("alloc: {} local, {} recycled, {} chunk, {} global, "
+                       "{} frees",
+                       alloc_.local_, alloc_.recycled_, alloc_.chunk_,
+                       alloc_.global_, alloc_.frees_);
+    if (cache_.hits_ + cache_.misses_ + cache_.stale_ > 0) {
+      out += std::format("\ncache: {} hits, {} misses, {} stale, {} bytes "
+                         "saved",
+                         cache_.hits_, cache_.misses_, cache_.stale_,
+                         cache_.bytes_saved_);
+    }
+    return out;
+  }
+
+  /// Produce a JSON object, with latencies in nanoseconds
+  std::string to_json() const {
+    std::string out = "{";
+    for (int i = 0; i < NUM_OP_TYPES; ++i) {
+      auto &m = ops_[i];
+      out += std::format(
+          "\"{}\":{{\"ops\":{},\"bytes\":{},\"retries\":{},\"samples\":{},"
+          "\"mean_ns\":{:.1f},\"p50_ns\":{:.1f},\"p99_ns\":{:.1f},"
+          "\"p999_ns\":{:.1f},\"max_ns\":{:.1f}}},",
+          kOpNames[i], m.ops_, m.bytes_, m.retries_, m.latency_.count(),
+          timed_ ? m.latency_.mean() / internal::tsc_per_ns() : 0.0,
+          ns(m.latency_, 0.5), ns(m.latency_, 0.99), ns(m.latency_, 0.999),
+          ns(m.latency_, 1.0));
+    }
+    out += std::format("\"alloc\":{{\"local\":{},\"recycled\":{},\"chunk\":{},"
+                       "\"global\":{},\"frees\":{}}},",
+                       alloc_.local_, alloc_.recycled_, alloc_.chunk_,
+                       alloc_.global_, alloc_.frees_);
+    out += std::format("\"cache\":{{\"hits\":{},\"misses\":{},\"stale\":{},"
+                       "\"bytes_saved\":{}}}}}",
+                       cache_.hits_, cache_.misses_, cache_.stale_,
+                       cache_.bytes_saved_);
+    return out;
+  }
+
+private:
+  /// Convert a percentile of a histogram of ticks to nanoseconds
+  double ns(const histogram_t &h, double q) const {
+    return timed_ ? h.percentile(q) / internal::tsc_per_ns() : 0.0;
+  }
+};
+} // namespace remus
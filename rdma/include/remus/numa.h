@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include <infiniband/verbs.h>
+
+#include "logging.h"
+
+namespace remus::internal {
+
+/// The mbind() policy that only allows pages from the given nodes.
+///
+/// NB: We make the syscall ourselves (see numa_bind()), so that remus does not
+///     need to link against libnuma just for this constant.
+constexpr int kMpolBind = 2;
+
+/// Parse a list of CPUs in the kernel's cpulist format (e.g., "0-3,8,10-11")
+///
+/// @param list The list.  An empty list has no CPUs.
+/// @return The CPUs, in the order that they appear in the list
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    int lo, hi;
+    auto dash = range.find('-');
+    try {
+      lo = std::stoi(range.substr(0, dash));
+      hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+    } catch (std::exception &) {
+      REMUS_FATAL("Invalid CPU list: {}", list);
+    }
+    REMUS_ASSERT(lo >= 0 && lo <= hi, "Invalid CPU range: {}", range);
+    for (int c = lo; c <= hi; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+/// Report the NUMA node that a CPU belongs to
+///
+/// @param cpu The CPU
+/// @return The NUMA node, or -1 if it can't be found (e.g., no NUMA support)
+inline int cpu_numa_node(int cpu) {
+  std::error_code ec;
+  std::filesystem::directory_iterator it(
+      "/sys/devices/system/cpu/cpu" + std::to_string(cpu), ec);
+  for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+    auto name = it->path().filename().string();
+    if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+        std::isdigit((unsigned char)name[4])) {
+      return std::stoi(name.substr(4));
+    }
+  }
+  return -1;
+}
+
+/// Report the NUMA node that an RDMA device is attached to
+///
+/// @param dev The device, or nullptr for the first device on this host
+/// @return The NUMA node, or -1 if it can't be found (e.g., no device, or a
+///         single-socket host)
+inline int rnic_numa_node(ibv_device *dev = nullptr) {
+  ibv_device **list = nullptr;
+  if (dev == nullptr) {
+    list = ibv_get_device_list(nullptr);
+    dev = list == nullptr ? nullptr : list[0];
+  }
+  int node = -1;
+  if (dev != nullptr) {
+    std::ifstream file(std::string(dev->ibdev_path) + "/device/numa_node");
+    if (!(file >> node)) {
+      node = -1;
+    }
+  }
+  if (list != nullptr) {
+    ibv_free_device_list(list);
+  }
+  return node;
+}
+
+/// Turn the value of --numa-node into a NUMA node
+///
+/// @param arg The value: "none", "auto" (the RNIC's node), or a node number
+/// @param dev The RNIC, or nullptr for the first one on this host
+/// @return The NUMA node, or -1 for no placement
+inline int numa_node_arg(const std::string &arg, ibv_device *dev = nullptr) {
+  if (arg == "none") {
+    return -1;
+  }
+  if (arg == "auto") {
+    int node = rnic_numa_node(dev);
+    if (node < 0) {
+      REMUS_INFO("No NUMA node found for the RNIC; memory is not placed");
+    }
+    return node;
+  }
+  int node = -1;
+  try {
+    node = std::stoi(arg);
+  } catch (std::exception &) {
+  }
+  REMUS_ASSERT(node >= 0 && std::filesystem::exists(
+                                "/sys/devices/system/node/node" + arg),
+               "Invalid NUMA node: {}", arg);
+  return node;
+}
+
+/// Require the pages of a region of memory to come from one NUMA node.  This
+/// must happen before the pages are first touched (or registered with an RNIC,
+/// which touches them).  Failure only costs performance, so it is reported,
+/// not fatal.
+///
+/// NB: The region must cover whole pages of its mapping, which for hugetlbfs
+///     memory means whole huge pages.
+///
+/// @param addr The start of the region (page-aligned)
+/// @param len  The size of the region
+/// @param node The NUMA node, or -1 to do nothing
+/// @return False if the pages could not be bound
+inline bool numa_bind(void *addr, uint64_t len, int node) {
+  if (node < 0) {
+    return true;
+  }
+  constexpr uint64_t kBits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(node / kBits + 1, 0);
+  mask[node / kBits] = 1UL << (node % kBits);
+  // NB: The kernel reads one bit fewer than maxnode, hence the + 1
+  if (syscall(SYS_mbind, addr, len, kMpolBind, mask.data(),
+              mask.size() * kBits + 1, 0) != 0) {
+    REMUS_INFO("mbind() of 0x{:x} bytes at {} to NUMA node {}: {}", len, addr,
+               node, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/// Pin the calling thread to one CPU
+///
+/// @param cpu The CPU, or -1 to do nothing
+inline void pin_thread(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  REMUS_ASSERT(ret == 0, "pthread_setaffinity_np({}): {}", cpu, strerror(ret));
+}
+} // namespace remus::internal
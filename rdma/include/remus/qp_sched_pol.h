@@ -22,7 +22,10 @@ public:
   /// An enum for tracking which policy was configured at start-up time
   ///
   /// TODO: Document each option
-  enum Policy { NONE, MOD, RR, RAND, ONE_TO_ONE };
+  ///
+  /// LEAST_LOADED picks the lane with the fewest operations in flight
+  /// (breaking ties round-robin), and P2C the less loaded of two random lanes.
+  enum Policy { NONE, MOD, RR, RAND, ONE_TO_ONE, LEAST_LOADED, P2C };
 
   /// Convert a string (such as what would be in an ArgMap) into a Policy
   ///
@@ -37,6 +40,10 @@ public:
       return RAND;
     } else if (policy == "RR") {
       return RR;
+    } else if (policy == "LEAST_LOADED") {
+      return LEAST_LOADED;
+    } else if (policy == "P2C") {
+      return P2C;
     }
     REMUS_FATAL("Invalid QpSchedPolicy {}", policy);
   }
@@ -48,6 +55,15 @@ private:
   const uint32_t num_threads_;   // The number of ComputeThreads per ComputeNode
   uint32_t last_lane_;           // The last lane we took
   std::vector<uint32_t> per_mn_; // Independent tracking for each MemoryNode
+  const lane_counter_t *loads_;  // The op counters of lane 0 to the first MN
+  uint64_t first_mn_;            // The id of the first MemoryNode
+  uint64_t loads_stride_;        // The distance between MNs' lanes in loads_
+
+  /// Return the number of operations in flight on a lane to a MemoryNode
+  size_t load(uint32_t mn, uint32_t lane) const {
+    return loads_[(mn - first_mn_) * loads_stride_ + lane].ops_.load(
+        std::memory_order_relaxed);
+  }
 
 public:
   /// Construct a QpSchedPolicy with the default ("none") policy, which always
@@ -56,7 +72,8 @@ public:
   /// @param args The arguments to the program
   QpSchedPolicy(std::shared_ptr<remus::ArgMap> args)
       : policy_(NONE), num_lanes_(args->uget(QP_LANES)),
-        num_threads_(args->uget(CN_THREADS)), last_lane_(0) {
+        num_threads_(args->uget(CN_THREADS)), last_lane_(0), loads_(nullptr),
+        first_mn_(args->uget(FIRST_MN_ID)), loads_stride_(0) {
     // Initialize the per_mn_ counters, so we can switch freely among policies
     for (uint64_t i = 0; i <= args->uget(remus::LAST_MN_ID); ++i) {
       per_mn_.push_back(prng_.rand() % num_lanes_);
@@ -80,11 +97,29 @@ public:
       last_lane_ = 0;
     } else if (policy_ == RAND || policy == RR) {
       // No config needed
+    } else if (policy_ == LEAST_LOADED || policy_ == P2C) {
+      // Needs set_loads()
     } else {
       REMUS_FATAL("Unrecognized QpSchedPol {}", (uint32_t)policy_);
     }
   }
 
+  /// Give the load-aware policies the op counters of the calling thread's
+  /// lanes (see ComputeNode::lane_ops())
+  ///
+  /// NB: Each thread has its own QPs, so a lane's load is what the thread
+  ///     itself has in that QP's send queue: unsignaled writes, Batch chains,
+  ///     and async ops in flight.  A thread that only issues blocking ops has
+  ///     at most one in flight, so then LEAST_LOADED acts like RR, and P2C
+  ///     like RAND.
+  ///
+  /// @param loads  The counter of lane 0 to the first MemoryNode
+  /// @param stride The distance between consecutive MemoryNodes' lanes
+  void set_loads(const lane_counter_t *loads, uint64_t stride) {
+    loads_ = loads;
+    loads_stride_ = stride;
+  }
+
   /// Use the previously selected QP_SCHED_POL to decide on the index for the
   /// next Connection to use.
   ///
@@ -95,6 +130,22 @@ public:
       return (per_mn_[mn] = (++per_mn_[mn]) % num_lanes_);
     } else if (policy_ == RAND) {
       last_lane_ = prng_.rand() % num_lanes_;
+    } else if (policy_ == LEAST_LOADED) {
+      // Start after the last pick, so that ties rotate among the lanes
+      uint32_t best = (per_mn_[mn] + 1) % num_lanes_;
+      size_t best_load = load(mn, best);
+      for (uint32_t i = 1; i < num_lanes_ && best_load > 0; ++i) {
+        uint32_t lane = (per_mn_[mn] + 1 + i) % num_lanes_;
+        size_t l = load(mn, lane);
+        if (l < best_load) {
+          best = lane;
+          best_load = l;
+        }
+      }
+      return (per_mn_[mn] = best);
+    } else if (policy_ == P2C) {
+      uint32_t a = prng_.rand() % num_lanes_, b = prng_.rand() % num_lanes_;
+      return load(mn, b) < load(mn, a) ? b : a;
     }
     return last_lane_;
   }
@@ -11,6 +11,24 @@
 // TODO:  We might need a better way of polling the completion queue
 namespace remus::internal {
 
+/// @brief The work request and scatter-gather entry for one RDMA operation
+/// @details
+/// Each ComputeThread keeps one of these per op_counter slot, so that issuing
+/// an operation never touches the heap.  They are cache-line aligned so that
+/// adjacent slots never share a line.
+///
+/// NB: The verbs library copies the work request when it is posted, so a slot
+///     only needs to stay reserved until the (last) Post that references it.
+struct alignas(64) send_wr_slot_t {
+  ibv_send_wr wr_; // The work request
+  ibv_sge sge_;    // The work request's single scatter-gather entry
+
+  /// Room for the payload of a small, inlined write whose source might not
+  /// outlive the call that configured it (i.e., WriteSeq).  This fits in the
+  /// padding that alignas(64) would otherwise waste.
+  uint8_t inline_data_[32];
+};
+
 /// utility function for configuring a one-sided read over RDMA
 ///
 /// @tparam T TODO
@@ -26,23 +44,24 @@ namespace remus::internal {
 /// @param fence
 template <typename T>
 inline void
-ReadConfig(std::shared_ptr<ibv_send_wr> send_wr, std::shared_ptr<ibv_sge> sge,
-           rdma_ptr<T> ptr, uint8_t *seg, int32_t rkey, int32_t lkey,
-           std::atomic<int> *ack, size_t size, bool signal, bool fence) {
+ReadConfig(ibv_send_wr &send_wr, ibv_sge &sge, rdma_ptr<T> ptr, uint8_t *seg,
+           int32_t rkey, int32_t lkey, std::atomic<int> *ack, size_t size,
+           bool signal, bool fence) {
   T *local = (T *)seg;
 
-  sge->addr = reinterpret_cast<uint64_t>(local);
-  sge->length = size;
-  sge->lkey = lkey;
+  sge.addr = reinterpret_cast<uint64_t>(local);
+  sge.length = size;
+  sge.lkey = lkey;
 
-  send_wr->wr_id = (uint64_t)ack;
-  send_wr->num_sge = 1;
-  send_wr->sg_list = sge.get();
-  send_wr->opcode = IBV_WR_RDMA_READ;
-  send_wr->send_flags =
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_RDMA_READ;
+  send_wr.send_flags =
       (fence ? IBV_SEND_FENCE : 0) | (signal ? IBV_SEND_SIGNALED : 0);
-  send_wr->wr.rdma.remote_addr = ptr.address();
-  send_wr->wr.rdma.rkey = rkey;
+  send_wr.wr.rdma.remote_addr = ptr.address();
+  send_wr.wr.rdma.rkey = rkey;
 }
 
 /// utility function for configuring a one-sided write over RDMA
@@ -60,8 +79,7 @@ ReadConfig(std::shared_ptr<ibv_send_wr> send_wr, std::shared_ptr<ibv_sge> sge,
 /// @param signal
 /// @param fence
 template <typename T>
-inline void WriteConfig(std::shared_ptr<ibv_send_wr> send_wr,
-                        std::shared_ptr<ibv_sge> sge, rdma_ptr<T> ptr,
+inline void WriteConfig(ibv_send_wr &send_wr, ibv_sge &sge, rdma_ptr<T> ptr,
                         const T &val, uint8_t *seg, int32_t rkey, int32_t lkey,
                         std::atomic<int> *ack, size_t size, bool signal,
                         bool fence) {
@@ -71,18 +89,19 @@ inline void WriteConfig(std::shared_ptr<ibv_send_wr> send_wr,
   // TODO: Is this memset really necessary?  Maybe for gaps in structs?
   std::memset(local, 0, size);
   *local = val;
-  sge->addr = reinterpret_cast<uint64_t>(local);
-  sge->length = size;
-  sge->lkey = lkey;
+  sge.addr = reinterpret_cast<uint64_t>(local);
+  sge.length = size;
+  sge.lkey = lkey;
 
-  send_wr->wr_id = (uint64_t)ack;
-  send_wr->num_sge = 1;
-  send_wr->sg_list = sge.get();
-  send_wr->opcode = IBV_WR_RDMA_WRITE;
-  send_wr->send_flags =
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_RDMA_WRITE;
+  send_wr.send_flags =
       (signal ? IBV_SEND_SIGNALED : 0) | (fence ? IBV_SEND_FENCE : 0);
-  send_wr->wr.rdma.remote_addr = ptr.address();
-  send_wr->wr.rdma.rkey = rkey;
+  send_wr.wr.rdma.remote_addr = ptr.address();
+  send_wr.wr.rdma.rkey = rkey;
 }
 
 /// utility function for configuring a one-sided write over RDMA, but seg is
@@ -100,24 +119,90 @@ inline void WriteConfig(std::shared_ptr<ibv_send_wr> send_wr,
 /// @param signal
 /// @param fence
 template <typename T>
-void WriteConfig(std::shared_ptr<ibv_send_wr> send_wr,
-                 std::shared_ptr<ibv_sge> sge, rdma_ptr<T> ptr, uint8_t *seg,
-                 int32_t rkey, int32_t lkey, std::atomic<int> *ack, size_t size,
-                 bool signal, bool fence) {
+void WriteConfig(ibv_send_wr &send_wr, ibv_sge &sge, rdma_ptr<T> ptr,
+                 uint8_t *seg, int32_t rkey, int32_t lkey, std::atomic<int> *ack,
+                 size_t size, bool signal, bool fence) {
   T *local = (T *)seg;
   REMUS_ASSERT((uint64_t)local != ptr.address(), "WTF");
-  sge->addr = reinterpret_cast<uint64_t>(local);
-  sge->length = size;
-  sge->lkey = lkey;
+  sge.addr = reinterpret_cast<uint64_t>(local);
+  sge.length = size;
+  sge.lkey = lkey;
 
-  send_wr->wr_id = (uint64_t)ack;
-  send_wr->num_sge = 1;
-  send_wr->sg_list = sge.get();
-  send_wr->opcode = IBV_WR_RDMA_WRITE;
-  send_wr->send_flags =
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_RDMA_WRITE;
+  send_wr.send_flags =
       (signal ? IBV_SEND_SIGNALED : 0) | (fence ? IBV_SEND_FENCE : 0);
-  send_wr->wr.rdma.remote_addr = ptr.address();
-  send_wr->wr.rdma.rkey = rkey;
+  send_wr.wr.rdma.remote_addr = ptr.address();
+  send_wr.wr.rdma.rkey = rkey;
+}
+
+/// utility function for configuring a one-sided write over RDMA whose payload
+/// is copied into the work request when it is posted (IBV_SEND_INLINE)
+///
+/// NB: Since the RNIC never DMA-reads `src`, it need not be registered, and it
+///     only needs to stay valid until the request is posted.  The caller must
+///     ensure that `size` does not exceed the QP's max_inline_data.
+///
+/// @tparam T
+/// @param send_wr
+/// @param sge
+/// @param ptr
+/// @param src
+/// @param rkey
+/// @param ack
+/// @param size
+/// @param signal
+/// @param fence
+template <typename T>
+inline void WriteInlineConfig(ibv_send_wr &send_wr, ibv_sge &sge,
+                              rdma_ptr<T> ptr, const uint8_t *src, int32_t rkey,
+                              std::atomic<int> *ack, size_t size, bool signal,
+                              bool fence) {
+  sge.addr = reinterpret_cast<uint64_t>(src);
+  sge.length = size;
+  sge.lkey = 0; // NB: Ignored for inline data
+
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_RDMA_WRITE;
+  send_wr.send_flags = IBV_SEND_INLINE | (signal ? IBV_SEND_SIGNALED : 0) |
+                       (fence ? IBV_SEND_FENCE : 0);
+  send_wr.wr.rdma.remote_addr = ptr.address();
+  send_wr.wr.rdma.rkey = rkey;
+}
+
+/// utility function for configuring a one-sided read or write over RDMA
+/// between one contiguous remote range and several local buffers, in order
+///
+/// NB: The verbs library copies the scatter-gather list when the request is
+///     posted, so `sges` only needs to live until then.
+///
+/// @param send_wr  The work request to configure
+/// @param sges     The scatter-gather entries (local buffers), in order
+/// @param num_sge  The number of entries, at most the QP's max_send_sge
+/// @param opcode   IBV_WR_RDMA_READ or IBV_WR_RDMA_WRITE
+/// @param raddr    The remote address of the first byte
+/// @param rkey     The rkey of the remote range
+/// @param ack      The op counter to decrement when the request completes
+/// @param signal   If true, the request generates a completion
+/// @param fence    If true, the request waits for earlier requests
+inline void VectorConfig(ibv_send_wr &send_wr, ibv_sge *sges, int num_sge,
+                         ibv_wr_opcode opcode, uint64_t raddr, int32_t rkey,
+                         std::atomic<int> *ack, bool signal, bool fence) {
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = num_sge;
+  send_wr.sg_list = sges;
+  send_wr.opcode = opcode;
+  send_wr.send_flags =
+      (signal ? IBV_SEND_SIGNALED : 0) | (fence ? IBV_SEND_FENCE : 0);
+  send_wr.wr.rdma.remote_addr = raddr;
+  send_wr.wr.rdma.rkey = rkey;
 }
 
 /// utility function for configuring a one-sided compare and swap over RDMA
@@ -136,27 +221,27 @@ void WriteConfig(std::shared_ptr<ibv_send_wr> send_wr,
 /// @param fence
 template <typename T>
   requires(sizeof(T) <= 8)
-inline void CompareAndSwapConfig(std::shared_ptr<ibv_send_wr> send_wr,
-                                 std::shared_ptr<ibv_sge> sge, rdma_ptr<T> ptr,
-                                 uint64_t expected, uint64_t swap,
+inline void CompareAndSwapConfig(ibv_send_wr &send_wr, ibv_sge &sge,
+                                 rdma_ptr<T> ptr, uint64_t expected, uint64_t swap,
                                  uint64_t *prev_, int32_t rkey, int32_t lkey,
                                  std::atomic<int> *ack, bool signal,
                                  bool fence) {
 
-  sge->addr = reinterpret_cast<uint64_t>(prev_);
-  sge->length = sizeof(uint64_t);
-  sge->lkey = lkey;
+  sge.addr = reinterpret_cast<uint64_t>(prev_);
+  sge.length = sizeof(uint64_t);
+  sge.lkey = lkey;
 
-  send_wr->wr_id = (uint64_t)ack;
-  send_wr->num_sge = 1;
-  send_wr->sg_list = sge.get();
-  send_wr->opcode = IBV_WR_ATOMIC_CMP_AND_SWP;
-  send_wr->send_flags =
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_ATOMIC_CMP_AND_SWP;
+  send_wr.send_flags =
       (signal ? IBV_SEND_SIGNALED : 0) | (fence ? IBV_SEND_FENCE : 0);
-  send_wr->wr.atomic.remote_addr = ptr.address();
-  send_wr->wr.atomic.rkey = rkey;
-  send_wr->wr.atomic.compare_add = expected;
-  send_wr->wr.atomic.swap = swap;
+  send_wr.wr.atomic.remote_addr = ptr.address();
+  send_wr.wr.atomic.rkey = rkey;
+  send_wr.wr.atomic.compare_add = expected;
+  send_wr.wr.atomic.swap = swap;
 }
 
 /// utility function for configuring a one-sided fetch and add over RDMA
@@ -174,24 +259,24 @@ inline void CompareAndSwapConfig(std::shared_ptr<ibv_send_wr> send_wr,
 /// @param fence
 template <typename T>
   requires(sizeof(T) <= 8)
-inline void FetchAndAddConfig(std::shared_ptr<ibv_send_wr> send_wr,
-                              std::shared_ptr<ibv_sge> sge, rdma_ptr<T> ptr,
-                              uint64_t add, uint64_t *prev, int32_t rkey,
+inline void FetchAndAddConfig(ibv_send_wr &send_wr, ibv_sge &sge,
+                              rdma_ptr<T> ptr, uint64_t add, uint64_t *prev, int32_t rkey,
                               int32_t lkey, std::atomic<int> *ack, bool signal,
                               bool fence) {
-  sge->addr = reinterpret_cast<uint64_t>(prev);
-  sge->length = sizeof(uint64_t);
-  sge->lkey = lkey;
+  sge.addr = reinterpret_cast<uint64_t>(prev);
+  sge.length = sizeof(uint64_t);
+  sge.lkey = lkey;
 
-  send_wr->wr_id = (uint64_t)ack;
-  send_wr->num_sge = 1;
-  send_wr->sg_list = sge.get();
-  send_wr->opcode = IBV_WR_ATOMIC_FETCH_AND_ADD;
-  send_wr->send_flags =
+  send_wr = ibv_send_wr{};
+  send_wr.wr_id = (uint64_t)ack;
+  send_wr.num_sge = 1;
+  send_wr.sg_list = &sge;
+  send_wr.opcode = IBV_WR_ATOMIC_FETCH_AND_ADD;
+  send_wr.send_flags =
       (signal ? IBV_SEND_SIGNALED : 0) | (fence ? IBV_SEND_FENCE : 0);
-  send_wr->wr.atomic.remote_addr = ptr.address();
-  send_wr->wr.atomic.rkey = rkey;
-  send_wr->wr.atomic.compare_add = add;
+  send_wr.wr.atomic.remote_addr = ptr.address();
+  send_wr.wr.atomic.rkey = rkey;
+  send_wr.wr.atomic.compare_add = add;
 }
 
 /// utility function for performing a one-sided read over RDMA
@@ -199,10 +284,56 @@ inline void FetchAndAddConfig(std::shared_ptr<ibv_send_wr> send_wr,
 /// @param send_wr
 /// @param conn
 /// @param ack
-inline void Post(std::shared_ptr<ibv_send_wr> send_wr, Connection *conn,
-          std::atomic<int> *ack) {
+inline void Post(ibv_send_wr &send_wr, Connection *conn,
+                 std::atomic<int> *ack) {
   *ack = 1;
-  conn->send_onesided(send_wr.get());
+  conn->send_onesided(&send_wr);
+}
+
+/// utility function for retiring a batch of completions from the completion
+/// queue: each completion's wr_id is the op counter of the request that it
+/// completes, so it is decremented.
+///
+/// NB: Each ComputeThread's QPs share one completion queue, so a single call
+///     can retire completions for several of the thread's requests, to any
+///     MemoryNode, whatever `ack` they belong to.
+///
+/// @tparam T
+/// @tparam F
+/// @param conn
+/// @param ptr  The pointer to report if a completion failed
+/// @param on_done Called with each op counter that this call brings to zero
+/// @return The number of completions retired
+template <typename T, typename F>
+inline int PollBatch(Connection *conn, rdma_ptr<T> ptr, F &&on_done) {
+  ibv_wc wcs[kMaxPollBatch];
+  int poll = conn->poll_cq(kMaxPollBatch, wcs);
+  if (poll == 0 || (poll < 0 && errno == EAGAIN))
+    return 0;
+  REMUS_ASSERT(poll > 0, "ibv_poll_cq(): {} @ {}", strerror(errno),
+               format_rdma_ptr(ptr));
+  for (int i = 0; i < poll; ++i) {
+    REMUS_ASSERT(wcs[i].status == IBV_WC_SUCCESS, "ibv_poll_cq(): {} @ {}",
+                 ibv_wc_status_str(wcs[i].status), format_rdma_ptr(ptr));
+    auto ack = (std::atomic<int> *)wcs[i].wr_id;
+    int old = ack->fetch_sub(1);
+    REMUS_ASSERT(old >= 1, "Broken synchronization");
+    if (old == 1) {
+      on_done(ack);
+    }
+  }
+  return poll;
+}
+
+/// utility function for retiring a batch of completions from the completion
+/// queue, when nobody needs to know which op counters reached zero
+///
+/// @tparam T
+/// @param conn
+/// @param ptr  The pointer to report if a completion failed
+/// @return The number of completions retired
+template <typename T> inline int PollBatch(Connection *conn, rdma_ptr<T> ptr) {
+  return PollBatch(conn, ptr, [](std::atomic<int> *) {});
 }
 
 /// utility function for polling the completion queue
@@ -214,20 +345,8 @@ inline void Post(std::shared_ptr<ibv_send_wr> send_wr, Connection *conn,
 template <typename T>
 inline void Poll(Connection *conn, std::atomic<int> *ack, rdma_ptr<T> ptr) {
   // Poll until we match on the condition
-  ibv_wc wc;
   while (*ack != 0) {
-    int poll = conn->poll_cq(1, &wc);
-    if (poll == 0 || (poll < 0 && errno == EAGAIN))
-      continue;
-    // TODO: Why doesn't write look for poll != 1, but this does?
-    if (poll != 1 || wc.status != IBV_WC_SUCCESS) {
-      REMUS_ASSERT(poll == 1 && wc.status == IBV_WC_SUCCESS,
-                   "ibv_poll_cq(): {} @ {}",
-                   (poll < 0 ? strerror(errno) : ibv_wc_status_str(wc.status)),
-                   format_rdma_ptr(ptr));
-    }
-    int old = ((std::atomic<int> *)wc.wr_id)->fetch_sub(1);
-    REMUS_ASSERT(old >= 1, "Broken synchronization");
+    PollBatch(conn, ptr);
   }
 }
 
@@ -237,24 +356,11 @@ inline void Poll(Connection *conn, std::atomic<int> *ack, rdma_ptr<T> ptr) {
 /// @param conn
 /// @param ack
 /// @param ptr
-/// @return
+/// @return True if the operation behind `ack` has completed
 template <typename T>
 bool PollAsync(Connection *conn, std::atomic<int> *ack, rdma_ptr<T> ptr) {
-  // Poll until we match on the condition
-  ibv_wc wc;
   if (*ack != 0) {
-    int poll = conn->poll_cq(1, &wc);
-    if (poll == 0 || (poll < 0 && errno == EAGAIN))
-      return false;
-    // TODO: Why doesn't write look for poll != 1, but this does?
-    if (poll != 1 || wc.status != IBV_WC_SUCCESS) {
-      REMUS_ASSERT(poll == 1 && wc.status == IBV_WC_SUCCESS,
-                   "ibv_poll_cq(): {} @ {}",
-                   (poll < 0 ? strerror(errno) : ibv_wc_status_str(wc.status)),
-                   format_rdma_ptr(ptr));
-    }
-    int old = ((std::atomic<int> *)wc.wr_id)->fetch_sub(1);
-    REMUS_ASSERT(old >= 1, "Broken synchronization");
+    PollBatch(conn, ptr);
     return false;
   }
   return true;
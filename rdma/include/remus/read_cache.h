@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace remus {
+
+/// @brief How CachedRead() may reuse a cached copy of an object
+enum CacheMode {
+  IMMUTABLE, // The object never changes, so a cached copy is always good
+  VERSIONED, // The object's first 8 bytes are a version, which writers make
+             // odd while they change the object, and then a new even value,
+             // so a cached copy is good while the remote version matches it
+};
+
+namespace internal {
+
+/// @brief A ComputeNode's cache of objects that its threads have read from the
+/// RDMA heap, keyed by their rdma_ptrs
+/// @details
+/// The cache is split into kShards shards, each with its own lock and an equal
+/// share of the byte budget, so threads rarely contend.  Within a shard,
+/// entries are evicted in CLOCK order: a hit sets an entry's reference bit,
+/// and the hand clears reference bits until it finds an entry without one.
+///
+/// The cache only stores bytes.  Deciding when a copy is still good (see
+/// CacheMode) is up to ComputeThread::CachedRead().
+class ReadCache {
+  /// The number of shards
+  static constexpr uint64_t kShards = 64;
+
+  /// @brief A cached object
+  struct entry_t {
+    uint64_t raw_;              // The object's rdma_ptr
+    uint64_t version_;          // The version, if the object is VERSIONED
+    bool ref_;                  // Was it used since the hand last passed?
+    std::vector<uint8_t> data_; // The object's bytes
+  };
+
+  /// @brief A part of the cache, with its own lock
+  struct alignas(64) shard_t {
+    std::mutex lock_;                          // Protects the other fields
+    std::unordered_map<uint64_t, size_t> idx_; // rdma_ptr -> entries_ index
+    std::vector<entry_t> entries_;             // The cached objects
+    size_t hand_ = 0;                          // The CLOCK hand
+    uint64_t bytes_ = 0;                       // The bytes in entries_
+
+    /// Remove entries_[i], by moving the last entry into its place
+    void remove(size_t i) {
+      bytes_ -= entries_[i].data_.size();
+      idx_.erase(entries_[i].raw_);
+      if (i != entries_.size() - 1) {
+        entries_[i] = std::move(entries_.back());
+        idx_[entries_[i].raw_] = i;
+      }
+      entries_.pop_back();
+    }
+  };
+
+  const uint64_t shard_bytes_; // The byte budget of each shard
+  shard_t shards_[kShards];    // The shards
+
+  /// Find the shard that caches an rdma_ptr
+  shard_t &shard(uint64_t raw) {
+    // NB: Fibonacci hashing, so that nearby objects land in different shards
+    return shards_[(raw * 0x9E3779B97F4A7C15ULL) >> 58];
+  }
+  static_assert(kShards == 64, "shard() picks a shard with the top 6 bits");
+
+public:
+  /// Construct an empty cache
+  ///
+  /// @param capacity The most bytes of objects to cache
+  explicit ReadCache(uint64_t capacity) : shard_bytes_(capacity / kShards) {}
+
+  /// Copy a cached object out of the cache
+  ///
+  /// @param raw     The object's rdma_ptr
+  /// @param out     Where to copy the object
+  /// @param size    The size of the object
+  /// @param version Set to the version that was cached with the object
+  /// @return true if the object was cached (with this size)
+  bool get(uint64_t raw, void *out, size_t size, uint64_t &version) {
+    auto &s = shard(raw);
+    std::lock_guard<std::mutex> guard(s.lock_);
+    auto it = s.idx_.find(raw);
+    if (it == s.idx_.end() || s.entries_[it->second].data_.size() != size) {
+      return false;
+    }
+    auto &e = s.entries_[it->second];
+    e.ref_ = true;
+    version = e.version_;
+    std::memcpy(out, e.data_.data(), size);
+    return true;
+  }
+
+  /// Cache an object, replacing any older copy, and evicting other objects to
+  /// make room.  Objects bigger than a shard are not cached.
+  ///
+  /// @param raw     The object's rdma_ptr
+  /// @param data    The object
+  /// @param size    The size of the object
+  /// @param version The object's version (ignored for IMMUTABLE objects)
+  void put(uint64_t raw, const void *data, size_t size, uint64_t version) {
+    if (size > shard_bytes_) {
+      return;
+    }
+    auto &s = shard(raw);
+    std::lock_guard<std::mutex> guard(s.lock_);
+    auto it = s.idx_.find(raw);
+    if (it != s.idx_.end()) {
+      s.remove(it->second);
+    }
+    while (s.bytes_ + size > shard_bytes_) {
+      size_t i = s.hand_ % s.entries_.size();
+      if (s.entries_[i].ref_) {
+        s.entries_[i].ref_ = false;
+        ++s.hand_;
+      } else {
+        s.remove(i); // The hand now points at the entry that moved into i
+      }
+    }
+    auto &e = s.entries_.emplace_back(entry_t{raw, version, false, {}});
+    e.data_.assign((const uint8_t *)data, (const uint8_t *)data + size);
+    s.idx_[raw] = s.entries_.size() - 1;
+    s.bytes_ += size;
+  }
+
+  /// Remove an object from the cache, if it is there
+  ///
+  /// @param raw The object's rdma_ptr
+  void erase(uint64_t raw) {
+    auto &s = shard(raw);
+    std::lock_guard<std::mutex> guard(s.lock_);
+    auto it = s.idx_.find(raw);
+    if (it != s.idx_.end()) {
+      s.remove(it->second);
+    }
+  }
+};
+} // namespace internal
+} // namespace remus
@@ -1,19 +1,26 @@
 #pragma once
 
 #include "Atomic.h"
+#include "async_log.h"
 #include "cfg.h"
 #include "cli.h"
 #include "compute_node.h"
 #include "compute_thread.h"
 #include "connection.h"
+#include "hash_map.h"
 #include "logging.h"
 #include "mem_node.h"
+#include "metrics.h"
 #include "mn_alloc_pol.h"
+#include "numa.h"
 #include "qp_sched_pol.h"
 #include "rdma_ops.h"
 #include "rdma_ptr.h"
+#include "read_cache.h"
 #include "ring.h"
+#include "rpc.h"
 #include "segment.h"
+#include "shm_transport.h"
 #include "simple_async_compute_thread.h"
 #include "simple_async_result.h"
 #include "util.h"
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "remus/logging.h"
 
@@ -58,6 +60,9 @@ struct ring_counter_t {
 
 /// @brief Manages allocation and deallocation of buffers in a ring buffer
 ///
+/// NB: ComputeThread now uses flat_ring_buf_t, which does the same job without
+///     a hash map.  This is kept as a baseline for benchmark/ring.cc.
+///
 /// TODO: This is an odd code pattern: all the methods are static?
 struct ring_buf_t {
   /// A struct to record the advance of the buf
@@ -206,4 +211,125 @@ struct ring_buf_t {
     }
   }
 };
-}  // namespace remus
\ No newline at end of file
+
+/// @brief A ring allocator for variable-sized, aligned buffers, with O(1)
+/// acquire and release, and no heap activity after construction
+/// @details
+/// Buffers are carved from a byte range in FIFO order, and each one is
+/// described by a slot in a fixed, power-of-two array.  Slots are claimed at
+/// the tail and reclaimed from the head.  A buffer may be released out of
+/// order: its slot is just marked free, and the head advances past it once
+/// every older buffer has been released too.  Alignment padding (and the
+/// unused end of the range when an allocation wraps) belongs to no slot, so it
+/// is reclaimed implicitly when the head moves past it.  Whenever the ring
+/// becomes empty, it resets to the front of the range, so that the next
+/// allocation has the whole range to work with.
+class flat_ring_buf_t {
+  /// @brief The descriptor for one buffer
+  struct slot_t {
+    size_t offset_; // The buffer's (aligned) offset in the range
+    bool in_use_;   // False once the buffer has been released
+  };
+
+  uint8_t *buf_ = nullptr;    // The start of the byte range
+  size_t size_ = 0;           // The size of the byte range
+  std::vector<slot_t> slots_; // The slot descriptors (power-of-two count)
+  uint64_t mask_ = 0;         // slots_.size() - 1
+  uint64_t head_ = 0;         // The (unwrapped) index of the oldest slot
+  uint64_t tail_ = 0;         // The (unwrapped) index of the next slot
+  size_t start_ = 0;          // Offset of the oldest buffer's first byte
+  size_t end_ = 0;            // Offset one past the newest buffer's last byte
+
+  /// Return the first offset at or after `offset` whose address is a multiple
+  /// of align, which must be a power of two
+  size_t align_up(size_t offset, size_t align) const {
+    auto addr = reinterpret_cast<uintptr_t>(buf_) + offset;
+    return ((addr + (align - 1)) & ~(align - 1)) -
+           reinterpret_cast<uintptr_t>(buf_);
+  }
+
+public:
+  /// @brief The result of acquire()
+  struct acquired_t {
+    uint8_t *buf_; // The buffer, or nullptr if there wasn't room
+    uint64_t idx_; // The slot to pass to release()
+  };
+
+  /// @brief Construct an empty, unusable ring (assign a real one before use)
+  flat_ring_buf_t() = default;
+
+  /// @brief Construct a ring over a byte range
+  /// @param buf The start of the byte range
+  /// @param size The size of the byte range
+  /// @param max_bufs The most buffers that may be live at once (rounded up to
+  ///                 a power of two)
+  flat_ring_buf_t(uint8_t *buf, size_t size, size_t max_bufs)
+      : buf_(buf), size_(size),
+        slots_(1ULL << (64 - __builtin_clzll(std::max<size_t>(max_bufs, 2) -
+                                             1))),
+        mask_(slots_.size() - 1) {}
+
+  /// @brief Allocate an aligned buffer
+  /// @param size The size of the buffer to allocate
+  /// @param align The alignment of the buffer, must be a power of two
+  /// @return The buffer and its slot, or a nullptr buffer if there is not
+  ///         enough contiguous space or no free slot
+  acquired_t acquire(size_t size, size_t align) {
+    if (tail_ - head_ == slots_.size()) {
+      return {nullptr, 0};
+    }
+    if (head_ == tail_) {
+      start_ = end_ = 0;
+    }
+    // While not wrapped, the live bytes are [start_, end_), and there is room
+    // after end_ and then before start_.  Once wrapped, the only room is
+    // [end_, start_).
+    //
+    // NB: Every buffer gets at least one byte, so that start_ == end_ always
+    //     means "full" rather than "empty".
+    size = std::max<size_t>(size, 1);
+    bool wrapped = head_ != tail_ && end_ <= start_;
+    size_t offset = align_up(end_, align);
+    if (wrapped) {
+      if (offset + size > start_) {
+        return {nullptr, 0};
+      }
+    } else if (offset + size > size_) {
+      // Wrap to the front.  The rest of the range goes unused until the head
+      // passes it.
+      offset = align_up(0, align);
+      if (head_ == tail_ ? offset + size > size_ : offset + size > start_) {
+        return {nullptr, 0};
+      }
+    }
+    slots_[tail_ & mask_] = {offset, true};
+    end_ = offset + size;
+    return {buf_ + offset, tail_++};
+  }
+
+  /// @brief Release a buffer
+  /// @param idx The slot that acquire() returned with the buffer
+  void release(uint64_t idx) {
+    REMUS_ASSERT(idx - head_ < tail_ - head_ && slots_[idx & mask_].in_use_,
+                 "ring buf slot {} not in use, can not release", idx);
+    slots_[idx & mask_].in_use_ = false;
+    while (head_ != tail_ && !slots_[head_ & mask_].in_use_) {
+      ++head_;
+    }
+    if (head_ != tail_) {
+      start_ = slots_[head_ & mask_].offset_;
+    }
+  }
+
+  /// @brief Check if every buffer has been released
+  bool empty() const { return head_ == tail_; }
+
+  /// @brief The number of buffers that have not been released
+  uint64_t live() const { return tail_ - head_; }
+
+  /// @brief Check if p lies within this ring's byte range
+  bool contains(const uint8_t *p, size_t size) const {
+    return p >= buf_ && p + size <= buf_ + size_;
+  }
+};
+}  // namespace remus
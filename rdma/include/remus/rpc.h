@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "logging.h"
+
+namespace remus::internal {
+
+/// The number of RPC batches that may be in flight on one connection.  Each
+/// side posts this many receives, so a sender that never has more batches in
+/// flight never finds its peer without a receive buffer.
+constexpr uint32_t kRpcSlots = 8;
+
+/// The size of each RPC send or receive buffer
+constexpr uint32_t kRpcBufSize = 4096;
+
+/// The largest RPC batch (request or response), in bytes.  Under the SHM
+/// transport, the first cache line of each buffer is the slot's header.
+constexpr uint32_t kRpcMaxBatch = kRpcBufSize - 64;
+
+/// The status of a response that succeeded
+constexpr uint32_t kRpcOk = 0;
+
+/// The status of a response to a request for a handler that does not exist
+constexpr uint32_t kRpcNoHandler = 1;
+
+/// @brief The header of an RPC batch
+/// @details
+/// A batch is a header, followed by `count_` messages.  A request batch and
+/// its response batch have the same count_ and tag_, and their messages are
+/// in the same order.
+struct rpc_batch_hdr_t {
+  uint32_t count_; // The number of messages
+  uint32_t bytes_; // The size of the batch, including this header
+  uint32_t tag_;   // Chosen by the client, to match a response to its request
+  uint32_t pad_;   // Unused
+};
+
+/// @brief The header of one RPC message within a batch
+/// @details
+/// The payload follows the header, and is padded to 8 bytes, so that the next
+/// header is aligned.
+struct rpc_msg_hdr_t {
+  uint32_t op_;  // The handler id (in a request) or status (in a response)
+  uint32_t len_; // The size of the payload
+};
+
+/// Report how many bytes a message with a `len`-byte payload takes in a batch
+constexpr uint32_t rpc_msg_bytes(uint32_t len) {
+  return sizeof(rpc_msg_hdr_t) + ((len + 7) & ~7U);
+}
+
+/// A raw RPC handler: it receives a request payload, writes a response of at
+/// most `cap` bytes to `resp`, and returns the size of the response
+using rpc_handler_t = std::function<uint32_t(const uint8_t *req, uint32_t len,
+                                             uint8_t *resp, uint32_t cap)>;
+
+/// @brief The RPC handlers of a MemoryNode, and the code that runs them
+/// @details
+/// Handlers are registered before the MemoryNode starts serving, so serve()
+/// needs no synchronization of its own.  However, a handler may run on the
+/// MemoryNode's poller thread and (for a co-located ComputeNode over RDMA) on
+/// ComputeThreads at the same time, so handlers must be thread-safe.
+class RpcServer {
+  std::vector<rpc_handler_t> handlers_; // The handlers, indexed by id
+
+public:
+  /// Register a handler for requests of type Req and responses of type Resp
+  ///
+  /// @param id The handler's id, which clients name in their requests
+  /// @param fn A callable that takes a const Req& and returns a Resp
+  template <typename Req, typename Resp, typename F>
+  void add(uint32_t id, F &&fn) {
+    static_assert(std::is_trivially_copyable_v<Req> &&
+                      std::is_trivially_copyable_v<Resp>,
+                  "RPC requests and responses are sent as bytes");
+    static_assert(rpc_msg_bytes(sizeof(Req)) + sizeof(rpc_batch_hdr_t) <=
+                          kRpcMaxBatch &&
+                      rpc_msg_bytes(sizeof(Resp)) + sizeof(rpc_batch_hdr_t) <=
+                          kRpcMaxBatch,
+                  "RPC messages must fit in a batch");
+    if (handlers_.size() <= id) {
+      handlers_.resize(id + 1);
+    }
+    REMUS_ASSERT(!handlers_[id], "RPC handler {} is already registered", id);
+    handlers_[id] = [fn = std::forward<F>(fn)](const uint8_t *req,
+                                               uint32_t len, uint8_t *resp,
+                                               uint32_t cap) -> uint32_t {
+      REMUS_ASSERT(len == sizeof(Req), "RPC request has {} bytes, not {}", len,
+                   sizeof(Req));
+      REMUS_ASSERT(cap >= sizeof(Resp), "No room for the RPC response");
+      Req r;
+      std::memcpy(&r, req, sizeof(Req));
+      Resp out = fn(r);
+      std::memcpy(resp, &out, sizeof(Resp));
+      return sizeof(Resp);
+    };
+  }
+
+  /// Report if any handlers are registered
+  bool empty() const { return handlers_.empty(); }
+
+  /// Run every request in a batch, and produce the response batch
+  ///
+  /// @param req  The request batch
+  /// @param len  The size of the request batch
+  /// @param resp Where to put the response batch (kRpcMaxBatch bytes)
+  /// @return The size of the response batch
+  uint32_t serve(const uint8_t *req, uint32_t len, uint8_t *resp) const {
+    rpc_batch_hdr_t in;
+    REMUS_ASSERT(len >= sizeof(in), "RPC batch of {} bytes is too short", len);
+    std::memcpy(&in, req, sizeof(in));
+    REMUS_ASSERT(in.bytes_ == len, "RPC batch has {} bytes, not {}", len,
+                 in.bytes_);
+    uint32_t pos = sizeof(in), out = sizeof(in);
+    for (uint32_t i = 0; i < in.count_; ++i) {
+      rpc_msg_hdr_t m;
+      std::memcpy(&m, req + pos, sizeof(m));
+      rpc_msg_hdr_t r{kRpcNoHandler, 0};
+      if (m.op_ < handlers_.size() && handlers_[m.op_]) {
+        r.op_ = kRpcOk;
+        r.len_ = handlers_[m.op_](req + pos + sizeof(m), m.len_,
+                                  resp + out + sizeof(r),
+                                  kRpcMaxBatch - out - sizeof(r));
+      }
+      std::memcpy(resp + out, &r, sizeof(r));
+      pos += rpc_msg_bytes(m.len_);
+      out += rpc_msg_bytes(r.len_);
+      REMUS_ASSERT(out <= kRpcMaxBatch, "RPC response batch is too big");
+    }
+    rpc_batch_hdr_t hdr{in.count_, out, in.tag_, 0};
+    std::memcpy(resp, &hdr, sizeof(hdr));
+    return out;
+  }
+};
+
+/// @brief One buffer of an RPC ring under the SHM transport
+/// @details
+/// The sender fills data_, sets len_, and then sets full_; the receiver clears
+/// full_ once it is done with the buffer.  Each direction of a channel is a
+/// ring of kRpcSlots of these, used in order, which is how receives are
+/// consumed on a real QP.
+struct shm_rpc_slot_t {
+  alignas(64) std::atomic<uint32_t> full_; // 1 while the buffer holds a batch
+  uint32_t len_;                           // The size of the batch
+  alignas(64) uint8_t data_[kRpcMaxBatch]; // The batch
+};
+static_assert(sizeof(shm_rpc_slot_t) == kRpcBufSize);
+
+/// The size of the shared memory object that holds one thread's RPC channel
+/// to one MemoryNode: a ring of requests, then a ring of responses
+constexpr uint64_t kShmRpcChannelSize = 2 * kRpcSlots * kRpcBufSize;
+
+/// Produce the name of the POSIX shared memory object for the RPC channel
+/// between a ComputeThread and a MemoryNode
+///
+/// @param port   The --mn-port of the run
+/// @param mn_id  The id of the MemoryNode
+/// @param cn_id  The id of the ComputeNode
+/// @param tid    The id of the ComputeThread within its ComputeNode
+/// @return The name, for shm_open()
+inline std::string shm_rpc_name(uint16_t port, uint32_t mn_id, uint32_t cn_id,
+                                uint64_t tid) {
+  return "/remus-" + std::to_string(port) + "-" + std::to_string(mn_id) +
+         "-rpc-" + std::to_string(cn_id) + "-" + std::to_string(tid);
+}
+} // namespace remus::internal
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <infiniband/verbs.h>
 #include <memory>
@@ -10,6 +14,7 @@
 #include <string>
 #include <sys/mman.h>
 #include <sys/param.h>
+#include <unistd.h>
 #include <variant>
 
 #include "logging.h"
@@ -19,6 +24,45 @@
 // 1. Should we be restricting sizes more?  Is 2^20 a reasonable minimum?
 // 2. Review documentation and destructors
 namespace remus::internal {
+/// @brief The kind of pages that back a Segment
+enum PageSize {
+  PAGE_AUTO, // 2MB huge pages if enough are free, else 4KB pages
+  PAGE_4K,   // Base pages
+  PAGE_2M,   // 2MB huge pages (hugetlbfs)
+  PAGE_1G,   // 1GB huge pages (hugetlbfs)
+  PAGE_THP,  // Base pages, with a request for transparent huge pages
+};
+
+/// Turn the value of --seg-page-size into a PageSize
+///
+/// @param name One of auto, 4k, 2m, 1g, or thp
+/// @return The PageSize
+inline PageSize to_page_size(const std::string &name) {
+  if (name == "4k") return PAGE_4K;
+  if (name == "2m") return PAGE_2M;
+  if (name == "1g") return PAGE_1G;
+  if (name == "thp") return PAGE_THP;
+  REMUS_ASSERT(name == "auto", "Invalid page size: {}", name);
+  return PAGE_AUTO;
+}
+
+/// Report how many huge pages of a given size are free and not yet reserved
+/// by another MAP_HUGETLB mapping, according to /sys/kernel/mm/hugepages
+///
+/// @param bytes The size of the huge pages
+/// @return The number of free pages (0 if the size is not supported)
+inline uint64_t free_huge_pages(uint64_t bytes) {
+  auto dir = "/sys/kernel/mm/hugepages/hugepages-" +
+             std::to_string(bytes >> 10) + "kB/";
+  std::ifstream free_file(dir + "free_hugepages");
+  std::ifstream resv_file(dir + "resv_hugepages");
+  uint64_t free = 0, resv = 0;
+  if (!(free_file >> free) || !(resv_file >> resv) || resv >= free) {
+    return 0;
+  }
+  return free - resv;
+}
+
 /// find_mmap_location Uses /proc/self/maps to find an aligned region of memory
 /// that is not currently mapped into the address space, so that it can be used
 /// for an RDMA segment.
@@ -106,9 +150,6 @@ class Segment {
   Segment &operator=(const Segment &) = delete; // No copy assignment operator
   Segment &operator=(Segment &&) = delete;      // No move assignment operator
 
-  /// The name of the Linux proc file that contains the number of huge pages
-  static constexpr char HUGE_PAGE_PATH[] = "/proc/sys/vm/nr_hugepages";
-
   /// The default flags we use when registering a memory region with RDMA.  In
   /// our usage scenarios, we pretty much want everything turned on.
   static constexpr int DEFAULT_ACCESS_MODE =
@@ -117,55 +158,127 @@ class Segment {
 
   const uint64_t capacity_; // Size of the memory segment
   uint8_t *raw_;            // Pointer to the raw memory segment
-  bool from_huge_;          // Was this allocated via huge pages?
+  uint64_t page_size_;      // The size of the pages that back this
+  bool from_huge_;          // Is it backed by hugetlbfs pages?
+  bool thp_ = false;        // Were transparent huge pages requested?
+  std::string shm_name_;    // The shared memory object that backs this, if any
+  bool shm_owner_ = false;  // Should the destructor unlink shm_name_?
 
-  /// Return the number of available Huge Pages, so we know if it's worth trying
-  /// to use them.
+  /// Pick the size of the hugetlbfs pages to back a Segment with.  A size is
+  /// only usable if the Segment is a multiple of it, and enough pages of that
+  /// size are free.  Otherwise, fall back to the next smaller size.
   ///
-  /// NB: This only works on Linux
-  ///
-  /// TODO: When the unit of allocation does not match the huge page size, this
-  ///       may not be valid.  The r320s on CloudLab don't have huge page
-  ///       support turned on, so it isn't really an issue for now, but
-  ///       eventually this is something we should work on.
-  static int GetNumHugePages() {
-    // NB: The file just contains a single int
-    std::ifstream file(HUGE_PAGE_PATH);
-    if (!file.is_open()) {
-      REMUS_DEBUG("Failed to open file: {}", HUGE_PAGE_PATH);
-      return 0;
-    }
-    int nr_huge_pages;
-    file >> nr_huge_pages;
-    if (file.fail()) {
-      REMUS_DEBUG("Failed to read nr_huge_pages");
-      return 0;
+  /// @param cap  The size of the Segment
+  /// @param want The requested PageSize
+  /// @return The page size, in bytes (4KB means no huge pages)
+  static uint64_t pick_page_size(uint64_t cap, PageSize want) {
+    constexpr uint64_t sizes[] = {1ULL << 30, 1ULL << 21};
+    uint64_t max = want == PAGE_1G ? 1ULL << 30
+                   : want == PAGE_2M || want == PAGE_AUTO ? 1ULL << 21
+                                                          : 4096;
+    for (auto sz : sizes) {
+      if (sz > max) {
+        continue;
+      }
+      if (cap % sz == 0 && free_huge_pages(sz) >= cap / sz) {
+        return sz;
+      }
+      if (want != PAGE_AUTO) {
+        REMUS_INFO("Can't back a 0x{:x}-byte Segment with {}MB pages (it is "
+                   "too small, or too few are free)",
+                   cap, sz >> 20);
+      }
     }
-    return nr_huge_pages;
+    return 4096;
   }
 
 public:
   /// Destruct by unmapping the region, using the capacity.
-  ~Segment() { munmap((void *)raw_, capacity_); }
+  ~Segment() {
+    munmap((void *)raw_, capacity_);
+    if (shm_owner_) {
+      shm_unlink(shm_name_.c_str());
+    }
+  }
 
   Segment(Segment &&) = default; // Default move constructor
 
   /// Construct a slab of RDMA memory by allocating a region of memory (from
-  /// huge pages if possible) and registering it with RDMA
+  /// huge pages if possible).  The pages are not touched, so that the caller
+  /// can still choose their NUMA placement; see prefault().
+  ///
+  /// NB: Large Segments on 4KB pages need many MTT entries in the RNIC, which
+  ///     its cache can't hold, so big heaps should use 2MB or 1GB pages.
   ///
   /// @param cap  The size (in bytes) of the region to allocate
-  Segment(uint64_t cap) : capacity_(cap) {
+  /// @param want The kind of pages to back it with
+  Segment(uint64_t cap, PageSize want = PAGE_AUTO) : capacity_(cap) {
+    page_size_ = pick_page_size(capacity_, want);
     // Get aligned memory via mmap
     auto hint = find_mmap_location((1UL << 35), capacity_);
-    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE;
-    if (GetNumHugePages() <= 0) {
-      from_huge_ = false;
-    } else {
-      from_huge_ = true;
-      flags = flags | MAP_HUGETLB;
+    int err = 0;
+    while (true) {
+      from_huge_ = page_size_ > 4096;
+      int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE;
+      if (from_huge_) {
+        flags |= MAP_HUGETLB | (__builtin_ctzll(page_size_) << MAP_HUGE_SHIFT);
+      }
+      raw_ = (uint8_t *)mmap((void *)hint.value(), capacity_,
+                             PROT_READ | PROT_WRITE, flags, -1, 0);
+      err = errno;
+      // NB: Other mappings may take the huge pages that pick_page_size() saw,
+      //     so PAGE_AUTO falls back to smaller pages instead of failing
+      if (((void *)raw_) != MAP_FAILED || !from_huge_ || want != PAGE_AUTO ||
+          err != ENOMEM) {
+        break;
+      }
+      uint64_t next =
+          page_size_ == (1ULL << 30) && capacity_ % (1ULL << 21) == 0
+              ? 1ULL << 21
+              : 4096;
+      REMUS_INFO("Too few {}MB pages for a 0x{:x}-byte Segment, falling back "
+                 "to {}KB pages",
+                 page_size_ >> 20, capacity_, next >> 10);
+      page_size_ = next;
     }
+    REMUS_ASSERT(((void *)raw_) != MAP_FAILED, "mmap failed: {}",
+                 strerror(err));
+    if (want == PAGE_THP) {
+      // NB: THP is best-effort: the kernel may still use base pages
+      thp_ = madvise(raw_, capacity_, MADV_HUGEPAGE) == 0;
+      if (!thp_) {
+        REMUS_INFO("madvise(MADV_HUGEPAGE): {}", strerror(errno));
+      }
+    }
+  }
+
+  /// Construct a slab of memory that is backed by a POSIX shared memory
+  /// object, so that other processes on this host can map it too.  This is how
+  /// the SHM transport makes a MemoryNode's Segments reachable.
+  ///
+  /// NB: The creator unlinks the object when its Segment is destructed.
+  ///
+  /// @param cap    The size (in bytes) of the region
+  /// @param name   The name of the shared memory object
+  /// @param create True to create the object, false to map an existing one
+  Segment(uint64_t cap, const std::string &name, bool create)
+      : capacity_(cap), page_size_(4096), from_huge_(false), shm_name_(name),
+        shm_owner_(create) {
+    if (create) {
+      shm_unlink(name.c_str()); // In case a previous run crashed
+    }
+    int fd = shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR,
+                      0600);
+    REMUS_ASSERT(fd >= 0, "shm_open({}): {}", name, strerror(errno));
+    if (create) {
+      int ret = ftruncate(fd, capacity_);
+      REMUS_ASSERT(ret == 0, "ftruncate(): {}", strerror(errno));
+    }
+    auto hint = find_mmap_location((1UL << 35), capacity_);
     raw_ = (uint8_t *)mmap((void *)hint.value(), capacity_,
-                           PROT_READ | PROT_WRITE, flags, -1, 0);
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
     REMUS_ASSERT(((void *)raw_) != MAP_FAILED, "mmap failed.");
   }
 
@@ -189,10 +302,41 @@ public:
                   strerror(errno))
     }
     REMUS_INFO("  Registered region 0x{:x} (length=0x{:x}) ({} pages)",
-               (uintptr_t)(raw_), capacity_, from_huge_ ? "2MB" : "4KB");
+               (uintptr_t)(raw_), capacity_, page_size_name());
     return ibv_mr_ptr(std::move(ptr));
   }
 
+  /// Fault in every page of this Segment now, instead of on first use (or
+  /// while registering it).  Call this after any NUMA placement.
+  ///
+  /// NB: The memory must not hold data yet, since the fallback writes zeroes.
+  void prefault() {
+    if (madvise(raw_, capacity_, MADV_POPULATE_WRITE) == 0) {
+      return;
+    }
+    // Older kernels lack MADV_POPULATE_WRITE, so touch each page instead
+    for (uint64_t off = 0; off < capacity_; off += page_size_) {
+      ((volatile uint8_t *)raw_)[off] = 0;
+    }
+  }
+
+  /// Describe the pages that back this Segment, for logging
+  std::string page_size_name() const {
+    if (page_size_ >= (1ULL << 30)) return "1GB";
+    if (page_size_ >= (1ULL << 21)) return "2MB";
+    return thp_ ? "4KB+THP" : "4KB";
+  }
+
+  /// Return the size of the pages that back this Segment
+  uint64_t page_size() const { return page_size_; }
+
+  /// Return the smallest aligned range that NUMA placement (see numa_bind())
+  /// can give its own node: a page, or a 2MB huge page if THP was requested,
+  /// since a smaller range would keep the kernel from using huge pages there
+  uint64_t placement_size() const {
+    return thp_ ? std::max<uint64_t>(page_size_, 1ULL << 21) : page_size_;
+  }
+
   /// Return the local address of the start of this Segment
   uint8_t *raw() const { return raw_; }
 
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <infiniband/verbs.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "logging.h"
+#include "util.h"
+
+namespace remus::internal {
+
+/// The largest number of Segments that one MemoryNode can publish over the
+/// shared-memory transport
+constexpr uint64_t kMaxShmSegs = 64;
+
+/// Produce the rkey of a MemoryNode's Segment under the shared-memory
+/// transport.  The MemoryNode id is part of the key, so that rkeys are unique
+/// across MemoryNodes, just as they (almost always) are with real RNICs.
+///
+/// @param mn_id    The id of the MemoryNode
+/// @param seg_idx  The index of the Segment at that MemoryNode
+/// @return The rkey
+inline uint32_t shm_rkey(uint32_t mn_id, uint32_t seg_idx) {
+  return (mn_id << 16) | (seg_idx + 1);
+}
+
+/// Produce the name of the POSIX shared memory object that backs a Segment.
+/// The port is part of the name, so that separate runs on one host (e.g.,
+/// tests) do not collide.
+///
+/// @param port     The --mn-port of the run
+/// @param mn_id    The id of the MemoryNode
+/// @param seg_idx  The index of the Segment at that MemoryNode
+/// @return The name, for shm_open()
+inline std::string shm_seg_name(uint16_t port, uint32_t mn_id,
+                                uint32_t seg_idx) {
+  return "/remus-" + std::to_string(port) + "-" + std::to_string(mn_id) + "-" +
+         std::to_string(seg_idx);
+}
+
+/// Produce the name of the POSIX shared memory object through which a
+/// MemoryNode publishes its RegionInfo
+///
+/// @param port     The --mn-port of the run
+/// @param mn_id    The id of the MemoryNode
+/// @return The name, for shm_open()
+inline std::string shm_dir_name(uint16_t port, uint32_t mn_id) {
+  return "/remus-" + std::to_string(port) + "-" + std::to_string(mn_id) +
+         "-regions";
+}
+
+/// @brief The directory that a MemoryNode publishes under the shared-memory
+/// transport, in place of the Send() that carries its rkeys over RDMA
+struct shm_dir_t {
+  std::atomic<uint64_t> ready_;     // 1 once the rest has been written
+  uint64_t num_segs_;               // The number of valid regions_
+  uint64_t seg_size_;               // The size of every Segment
+  RegionInfo regions_[kMaxShmSegs]; // The Segments, in order
+};
+
+/// Publish a MemoryNode's RegionInfo, replacing any directory that a previous
+/// run left behind
+///
+/// @param name     The name of the directory object
+/// @param ris      The MemoryNode's Segments
+/// @param seg_size The size of every Segment
+inline void publish_shm_dir(const std::string &name,
+                            const std::vector<RegionInfo> &ris,
+                            uint64_t seg_size) {
+  REMUS_ASSERT(ris.size() <= kMaxShmSegs,
+               "The SHM transport supports at most {} segments per node",
+               kMaxShmSegs);
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  REMUS_ASSERT(fd >= 0, "shm_open({}): {}", name, strerror(errno));
+  int ret = ftruncate(fd, sizeof(shm_dir_t));
+  REMUS_ASSERT(ret == 0, "ftruncate(): {}", strerror(errno));
+  auto *dir = (shm_dir_t *)mmap(nullptr, sizeof(shm_dir_t),
+                                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  REMUS_ASSERT(dir != MAP_FAILED, "mmap(): {}", strerror(errno));
+  close(fd);
+  dir->num_segs_ = ris.size();
+  dir->seg_size_ = seg_size;
+  std::copy(ris.begin(), ris.end(), dir->regions_);
+  dir->ready_.store(1, std::memory_order_release);
+  munmap(dir, sizeof(shm_dir_t));
+}
+
+/// Wait for a MemoryNode to publish its directory, then read it
+///
+/// NB: This is the shared-memory counterpart of connect_remote()'s retry loop:
+///     the MemoryNode may not have started yet, so we back off and retry.
+///
+/// @param name     The name of the directory object
+/// @param seg_size Set to the size of every Segment
+/// @return The MemoryNode's Segments
+inline std::vector<RegionInfo> await_shm_dir(const std::string &name,
+                                             uint64_t &seg_size) {
+  int fd;
+  uint32_t backoff_us = 100;
+  while ((fd = shm_open(name.c_str(), O_RDWR, 0)) < 0) {
+    REMUS_ASSERT(errno == ENOENT, "shm_open({}): {}", name, strerror(errno));
+    std::this_thread::sleep_for(std::chrono::microseconds(backoff_us));
+    backoff_us = std::min(backoff_us * 2, 100000u);
+  }
+  // NB: The object may not have been truncated to size yet
+  struct stat st;
+  while (fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(shm_dir_t)) {
+    std::this_thread::yield();
+  }
+  auto *dir = (shm_dir_t *)mmap(nullptr, sizeof(shm_dir_t), PROT_READ,
+                                MAP_SHARED, fd, 0);
+  REMUS_ASSERT(dir != MAP_FAILED, "mmap(): {}", strerror(errno));
+  close(fd);
+  while (dir->ready_.load(std::memory_order_acquire) == 0) {
+    std::this_thread::yield();
+  }
+  seg_size = dir->seg_size_;
+  std::vector<RegionInfo> res(dir->regions_, dir->regions_ + dir->num_segs_);
+  munmap(dir, sizeof(shm_dir_t));
+  return res;
+}
+
+/// @brief The memory regions that the shared-memory transport can reach, and
+/// how to translate their remote addresses into local ones
+/// @details
+/// This stands in for the RNIC's memory translation table: a work request
+/// names a remote address and an rkey, and the rkey selects the region (and
+/// bounds) that the address must fall in.  Regions are added during
+/// connection set-up, before any ComputeThread runs, so lookups need no
+/// synchronization.
+class ShmRegions {
+  /// A region: where it is remotely, where it is locally, and its size
+  struct region_t {
+    uint64_t raddr_; // The address that the owning MemoryNode uses
+    uint8_t *local_; // The address at which this process mapped it
+    uint64_t len_;   // The size of the region
+    uint32_t rkey_;  // The rkey that grants access to it
+  };
+
+  std::vector<region_t> regions_; // All reachable regions
+
+public:
+  /// Make a region reachable
+  ///
+  /// @param raddr  The address that the owning MemoryNode uses
+  /// @param local  The address at which this process mapped it
+  /// @param len    The size of the region
+  /// @param rkey   The rkey that grants access to it
+  void add(uint64_t raddr, uint8_t *local, uint64_t len, uint32_t rkey) {
+    regions_.push_back(region_t{raddr, local, len, rkey});
+  }
+
+  /// Translate a remote range to a local address, or crash if the rkey does
+  /// not grant access to it (as an RNIC would fail the request with
+  /// IBV_WC_REM_ACCESS_ERR)
+  ///
+  /// @param raddr  The remote address
+  /// @param rkey   The rkey of the request
+  /// @param len    The number of bytes accessed
+  /// @return The local address of raddr
+  uint8_t *translate(uint64_t raddr, uint32_t rkey, uint64_t len) const {
+    for (auto &r : regions_) {
+      if (r.rkey_ == rkey) {
+        REMUS_ASSERT(raddr >= r.raddr_ && raddr + len <= r.raddr_ + r.len_,
+                     "Access 0x{:x}+{} is outside the region of rkey 0x{:x}",
+                     raddr, len, rkey);
+        return r.local_ + (raddr - r.raddr_);
+      }
+    }
+    REMUS_FATAL("Unknown rkey 0x{:x}", rkey);
+  }
+};
+
+/// @brief A completion queue for the shared-memory transport
+/// @details
+/// Like a ComputeNode's real CQs, there is one per ComputeThread, and only
+/// that thread posts to it and polls it, so it needs no synchronization.  Each
+/// completion becomes visible `latency_ns` after its request was executed, to
+/// approximate the round trip of a real network.
+class ShmCq {
+  /// A completion, and when it may be polled
+  struct cqe_t {
+    uint64_t wr_id_; // The wr_id of the signaled request
+    uint64_t ready_; // The steady_clock time (ns) at which it is visible
+  };
+
+  std::deque<cqe_t> cqes_; // Completions, in the order they were made
+  uint64_t latency_ns_;    // The injected latency
+
+  /// Report the current steady_clock time, in nanoseconds
+  static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+public:
+  /// Construct an empty CQ
+  ///
+  /// @param latency_ns The delay before each completion is visible
+  explicit ShmCq(uint64_t latency_ns) : latency_ns_(latency_ns) {}
+
+  /// Add a completion for the request with id wr_id
+  void push(uint64_t wr_id) {
+    cqes_.push_back(cqe_t{wr_id, latency_ns_ ? now_ns() + latency_ns_ : 0});
+  }
+
+  /// Poll for up to num completions, like ibv_poll_cq()
+  ///
+  /// @param num  The size of wc
+  /// @param wc   The completions that were polled
+  /// @return The number of completions in wc
+  int poll(int num, ibv_wc *wc) {
+    int n = 0;
+    uint64_t now = latency_ns_ && !cqes_.empty() ? now_ns() : 0;
+    while (n < num && !cqes_.empty() && cqes_.front().ready_ <= now) {
+      std::memset(&wc[n], 0, sizeof(ibv_wc));
+      wc[n].wr_id = cqes_.front().wr_id_;
+      wc[n].status = IBV_WC_SUCCESS;
+      cqes_.pop_front();
+      ++n;
+    }
+    return n;
+  }
+};
+
+/// Execute a chain of one-sided work requests against shared memory, in
+/// order, the way an RNIC would execute them on an RC QP
+///
+/// NB: 8-byte aligned Reads and Writes use atomic loads and stores, so that
+///     they do not tear against concurrent CAS and FAA (which RDMA does not
+///     promise either, but every real RNIC provides).
+///
+/// @param wr       The first request of the chain
+/// @param regions  The regions that rkeys grant access to
+/// @param cq       The CQ for the completions of signaled requests
+inline void shm_execute(ibv_send_wr *wr, const ShmRegions &regions,
+                        ShmCq &cq) {
+  for (; wr != nullptr; wr = wr->next) {
+    switch (wr->opcode) {
+    case IBV_WR_RDMA_READ:
+    case IBV_WR_RDMA_WRITE: {
+      uint64_t raddr = wr->wr.rdma.remote_addr;
+      for (int i = 0; i < wr->num_sge; ++i) {
+        auto &sge = wr->sg_list[i];
+        auto *remote = regions.translate(raddr, wr->wr.rdma.rkey, sge.length);
+        auto *local = (uint8_t *)sge.addr;
+        bool word = sge.length == 8 && ((uintptr_t)remote & 7) == 0 &&
+                    ((uintptr_t)local & 7) == 0;
+        if (wr->opcode == IBV_WR_RDMA_READ && word) {
+          *(uint64_t *)local =
+              std::atomic_ref<uint64_t>(*(uint64_t *)remote).load();
+        } else if (wr->opcode == IBV_WR_RDMA_READ) {
+          std::memcpy(local, remote, sge.length);
+        } else if (word) {
+          std::atomic_ref<uint64_t>(*(uint64_t *)remote)
+              .store(*(uint64_t *)local);
+        } else {
+          std::memcpy(remote, local, sge.length);
+        }
+        raddr += sge.length;
+      }
+      break;
+    }
+    case IBV_WR_ATOMIC_CMP_AND_SWP:
+    case IBV_WR_ATOMIC_FETCH_AND_ADD: {
+      auto *remote = regions.translate(wr->wr.atomic.remote_addr,
+                                       wr->wr.atomic.rkey, sizeof(uint64_t));
+      REMUS_ASSERT(((uintptr_t)remote & 7) == 0,
+                   "Atomics must be 8-byte aligned");
+      std::atomic_ref<uint64_t> target(*(uint64_t *)remote);
+      uint64_t old = wr->wr.atomic.compare_add;
+      if (wr->opcode == IBV_WR_ATOMIC_CMP_AND_SWP) {
+        target.compare_exchange_strong(old, wr->wr.atomic.swap);
+      } else {
+        old = target.fetch_add(wr->wr.atomic.compare_add);
+      }
+      std::memcpy((void *)wr->sg_list[0].addr, &old, sizeof(old));
+      break;
+    }
+    default:
+      REMUS_FATAL("The SHM transport does not support opcode {}",
+                  (int)wr->opcode);
+    }
+    if (wr->send_flags & IBV_SEND_SIGNALED) {
+      cq.push(wr->wr_id);
+    }
+  }
+}
+} // namespace remus::internal
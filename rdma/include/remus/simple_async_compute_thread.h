@@ -1,5 +1,11 @@
 #pragma once
 
+#include <coroutine>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
 #include "remus/compute_thread.h"
 #include "remus/simple_async_result.h"
 
@@ -7,41 +13,175 @@ namespace remus {
 
 /// @brief A simple ComputeThread that uses coroutines to perform asynchronous
 /// operations
+/// @details
+/// The async operations can be resumed by hand, or a thread can Spawn() several
+/// top-level coroutines and Run() them.  Each spawned coroutine gets its own
+/// coro_idx, and so its own seq state, and Run() resumes a coroutine only once
+/// the op it is waiting on has completed.
+///
+/// Spawned coroutines can also co_await the ops returned by ReadAwait,
+/// WriteAwait, CompareAndSwapAwait and FetchAndAddAwait, and co_await Tasks
+/// that are built from them.  An awaited op records the awaiting coroutine in
+/// its op slot, and Run() resumes exactly that coroutine when the op's
+/// completion arrives.  Likewise, a coroutine that co_awaits an Rpc() result
+/// is parked on the result's batch, which Run() sends once every ready
+/// coroutine has had its turn, so that the RPCs of one round share a batch.
 class SimpleAsyncComputeThread : public ComputeThread {
+  /// @brief A top-level coroutine, and the op it is waiting on
+  struct task_t {
+    std::function<AsyncResultVoid()> fn_;  // Owns the coroutine's captures
+    std::optional<AsyncResultVoid> coro_;  // The coroutine, once it started
+    std::atomic<int> *parked_ = nullptr;   // The op counter it waits on
+  };
+
+  /// @brief What to resume once an op completes
+  struct waiter_t {
+    uint32_t coro_idx_ = 0;           // The task that is waiting
+    std::coroutine_handle<> handle_;  // The coroutine that co_awaits, if any
+  };
+
+  /// @brief A task that waits on an RPC batch
+  struct rpc_waiter_t {
+    waiter_t waiter_;  // What to resume
+    uint16_t mn_id_;   // The batch's MemoryNode
+    uint32_t batch_;   // The batch
+    uint64_t gen_;     // The batch's generation
+  };
+
+  /// One task per coro_idx.  NB: coro_idx 0 is never spawned, since it belongs
+  ///     to the code that runs outside of Run() (e.g., the blocking seq ops).
+  std::vector<task_t> tasks_;
+  std::vector<uint32_t> free_coros_;  // The coro_idxs that have no task
+  std::vector<waiter_t> ready_;       // What to resume in the next round
+  std::vector<waiter_t> resuming_;    // What is being resumed in this round
+  std::vector<waiter_t> op_waiters_;  // What waits on each op counter
+  std::vector<rpc_waiter_t> rpc_waiters_;  // What waits on RPC batches
+  std::atomic<int> rpc_parked_{1};  // The parked_ of tasks in rpc_waiters_
+  uint32_t coro_idx_ = 0;             // The coro_idx of the running task
+  bool scheduled_ = false;            // Is a spawned task running?
+  internal::Connection *poll_conn_ = nullptr;  // Any of this thread's QPs
+
  public:
   SimpleAsyncComputeThread(uint64_t id, std::shared_ptr<ComputeNode> cn,
                            std::shared_ptr<ArgMap> args)
-      : ComputeThread(id, cn, args) {}
+      : ComputeThread(id, cn, args),
+        tasks_(args->uget(CN_OPS_PER_THREAD)),
+        op_waiters_(args->uget(CN_OPS_PER_THREAD)) {
+    for (uint32_t i = tasks_.size() - 1; i > 0; --i) {
+      free_coros_.push_back(i);
+    }
+    ready_.reserve(tasks_.size());
+    resuming_.reserve(tasks_.size());
+    rpc_park_ = [this](uint16_t mn_id, uint32_t batch, uint64_t gen,
+                       std::coroutine_handle<> handle) {
+      if (!scheduled_) {
+        return false;
+      }
+      tasks_[coro_idx_].parked_ = &rpc_parked_;
+      rpc_waiters_.push_back({{coro_idx_, handle}, mn_id, batch, gen});
+      return true;
+    };
+  }
+
+  /// @brief Add a top-level coroutine to the thread's scheduler
+  /// @details
+  /// The coroutine does not start until Run() is called.  At most
+  /// CN_OPS_PER_THREAD - 1 coroutines can be live at once.
+  ///
+  /// NB: Spawned coroutines should only use the async operations.  A blocking
+  ///     operation would stall every other coroutine on the thread.
+  ///
+  /// @tparam F The type of the callable
+  /// @param fn A callable that returns an AsyncResultVoid or a Task<>.  It is
+  ///           kept alive until the coroutine finishes, so it may capture by
+  ///           value.
+  template <typename F>
+  void Spawn(F &&fn) {
+    REMUS_ASSERT(!free_coros_.empty(),
+                 "All {} coroutines are live, increase {}", tasks_.size() - 1,
+                 CN_OPS_PER_THREAD);
+    auto idx = free_coros_.back();
+    free_coros_.pop_back();
+    if constexpr (std::is_same_v<std::invoke_result_t<F &>, Task<>>) {
+      tasks_[idx].fn_ = [fn = std::forward<F>(fn)]() mutable
+          -> AsyncResultVoid { co_await fn(); };
+    } else {
+      tasks_[idx].fn_ = std::forward<F>(fn);
+    }
+    ready_.push_back({idx, {}});
+  }
+
+  /// @brief The number of coroutines that can be spawned at once
+  /// @return CN_OPS_PER_THREAD - 1
+  size_t max_spawned() const { return tasks_.size() - 1; }
+
+  /// @brief Run every spawned coroutine to completion
+  /// @details
+  /// Each round resumes the coroutines that are ready, makes progress on the
+  /// RPC batches that coroutines wait on, and then drains a batch of
+  /// completions from the thread's CQ.  A coroutine whose op completed (or
+  /// whose RPC response arrived) becomes ready for the next round.
+  void Run() {
+    while (free_coros_.size() < tasks_.size() - 1) {
+      resuming_.swap(ready_);
+      for (auto w : resuming_) {
+        step(w);
+      }
+      resuming_.clear();
+      progress_rpcs();
+      if (poll_conn_ == nullptr) {
+        continue;
+      }
+      auto polled = internal::PollBatch(
+          poll_conn_, rdma_ptr<uint8_t>(),
+          [this](std::atomic<int> *ack) { wake(ack); });
+      // NB: A completion that something else retired (e.g., a blocking op)
+      //     does not wake its owner, so check for them when there is no work
+      if (polled == 0 && ready_.empty()) {
+        for (auto &task : tasks_) {
+          if (task.parked_ != nullptr && *task.parked_ == 0) {
+            wake(task.parked_);
+          }
+        }
+      }
+    }
+  }
 
   /// @brief A simple asynchronous read operation
   /// @tparam T The type of the object read
   /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
   /// @param fence If true, a fence is issued after the read operation
+  /// @param local_copy If true, the read is performed locally if the pointer
+  /// is local
   /// @return An AsyncResult that will yield the object read from the RDMA heap
   template <typename T>
-  AsyncResult<T> ReadAsync(rdma_ptr<T> ptr, bool fence = false) {
+  AsyncResult<T> ReadAsync(rdma_ptr<T> ptr, bool fence = false,
+                           bool local_copy = true) {
+    if (local_copy && is_local(ptr)) {
+      T val;
+      local_read(&val, ptr.address(), sizeof(T));
+      metrics_.count(Metrics::ASYNC, sizeof(T));
+      co_return val;
+    }
     /// Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto counter = op_counter_t(this).val();
-    REMUS_ASSERT(counter != nullptr,
-                 "Counter is not enough, increase the number of "
-                 "counters or reduce the number of requests");
-
-    auto staging_buf = staging_buf_t(this, sizeof(T), alignof(T)).val();
-    REMUS_ASSERT(staging_buf != nullptr,
-                 "Staging buffer is not enough, increase the staging buffers "
-                 "or reduce the number of requests");
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
-                         counter, sizeof(T), true, fence);
-    internal::Post(send_wr, ci.conn_.get(), counter);
-    while (!internal::PollAsync(ci.conn_.get(), counter, ptr)) {
+    // NB: The buffer and the op counter are held until the op completes, so
+    //     that no other op can reuse them while this one is in flight
+    auto staging = staging_buf_t(this, sizeof(T), alignof(T));
+    auto staging_buf = staging.val();
+    auto op = op_counter_t(this);
+    auto counter = op.val();
+    internal::ReadConfig(op.slot().wr_, op.slot().sge_, ptr, staging_buf, rkey,
+                         ci.lkey_, counter, sizeof(T), true, fence);
+    auto t0 = metrics_.start();
+    internal::Post(op.slot().wr_, ci.conn_.get(), counter);
+    while (!op_done(ci.conn_.get(), counter, ptr)) {
       co_yield std::suspend_always();
     }
+    metrics_.record(Metrics::ASYNC, t0, sizeof(T));
     co_return *(T *)staging_buf;
   }
   /// @brief A sequential version of read that uses coroutine index coro_idx and
@@ -57,11 +197,10 @@ class SimpleAsyncComputeThread : public ComputeThread {
                                                           bool signal = false,
                                                           bool fence = false) {
     /// Use the scheduling policy to select the next connection
-    auto coro_idx =
-        0;  // because we don't support more than one top level coroutine
+    auto coro_idx = coro_idx_;
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
     auto staging_buf_ptr =
         std::make_unique<seq_staging_buf_t>(this, sizeof(T), alignof(T));
@@ -72,20 +211,22 @@ class SimpleAsyncComputeThread : public ComputeThread {
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     REMUS_DEBUG("Debug: finish create op_counter_ptr");
     auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
     REMUS_DEBUG("Debug: finish push op_counter");
     REMUS_ASSERT(staging_buf != nullptr,
                  "Staging buffer is not enough, increase the staging buffers "
                  "or reduce the number of requests");
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, staging_buf});
     REMUS_DEBUG("push {} to seq_send_wrs[{}][{}]",
                 (uint64_t)(uint8_t *)staging_buf, coro_idx, seq_idx);
     if (!signal) {
       internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
                            nullptr, sizeof(T), signal, fence);
+      metrics_.count(Metrics::SEQ, sizeof(T));
       co_return std::nullopt;
     }
     link_seq_send_wrs(seq_idx, coro_idx);
@@ -93,14 +234,16 @@ class SimpleAsyncComputeThread : public ComputeThread {
 
     internal::ReadConfig(send_wr, sge, ptr, staging_buf, rkey, ci.lkey_,
                          op_counter, sizeof(T), signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, sizeof(T));
     REMUS_DEBUG("Debug: erase seq_idx = {}", seq_idx);
     seq_send_wrs[coro_idx].erase(seq_idx);
     co_return result;
@@ -124,34 +267,38 @@ class SimpleAsyncComputeThread : public ComputeThread {
       rdma_ptr<T> ptr, T *seg, bool signal = false, bool fence = false,
       size_t size = sizeof(T)) {
     /// Use the scheduling policy to select the next connection
-    auto coro_idx = 0;
+    auto coro_idx = coro_idx_;
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     uint32_t rkey = compute_node_->get_rkey(ptr.raw());
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, nullptr});
     if (!signal) {
       internal::ReadConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
                            nullptr, size, signal, fence);
+      metrics_.count(Metrics::SEQ, size);
       co_return std::nullopt;
     }
     link_seq_send_wrs(seq_idx, coro_idx);
     internal::ReadConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     co_return result;
   }
@@ -168,28 +315,36 @@ class SimpleAsyncComputeThread : public ComputeThread {
   AsyncResultVoid WriteAsync(rdma_ptr<T> ptr, const T &val, bool fence = true,
                              size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), &val, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), &val, size, fence);
+      metrics_.count(Metrics::ASYNC, size);
       co_return;
     }
     // Use the scheduling policy to select the next connection
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
-    auto staging_buf = staging_buf_t(this, size, alignof(T)).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                          op_counter, size, true, fence);
-    internal::Post(send_wr, ci.conn_.get(), op_counter);
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    // NB: The buffer and the op counter are held until the op completes, so
+    //     that no other op can reuse them while this one is in flight
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    std::optional<staging_buf_t> staging;
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(op.slot().wr_, op.slot().sge_, ptr,
+                                  (const uint8_t *)&val, rkey, op_counter,
+                                  size, true, fence);
+    } else {
+      staging.emplace(this, size, alignof(T));
+      internal::WriteConfig(op.slot().wr_, op.slot().sge_, ptr, val,
+                            staging->val(), rkey, ci.lkey_, op_counter, size,
+                            true, fence);
+    }
+    auto t0 = metrics_.start();
+    internal::Post(op.slot().wr_, ci.conn_.get(), op_counter);
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
+    metrics_.record(Metrics::ASYNC, t0, size);
     co_return;
   }
 
@@ -207,26 +362,32 @@ class SimpleAsyncComputeThread : public ComputeThread {
   AsyncResultVoid WriteAsync(rdma_ptr<T> ptr, T *seg, bool fence = true,
                              size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), seg, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), seg, size, fence);
+      metrics_.count(Metrics::ASYNC, size);
       co_return;
     }
     auto lane = Lane{qp_sched_pol_.get_lane_idx(ptr.id()),
-                     compute_node_->lane_op_counters_};
-    auto &ci = this->compute_node_->get_conn(ptr.raw(), lane.lane_idx);
+                     compute_node_->lane_ops(ptr.id(), id_)};
+    auto &ci = this->compute_node_->get_conn(ptr.raw(), id_, lane.lane_idx);
     auto rkey = this->compute_node_->get_rkey(ptr.raw());
-    auto op_counter = op_counter_t(this).val();
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                          op_counter, size, true, fence);
-    internal::Post(send_wr, ci.conn_.get(), op_counter);
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    // NB: The op counter is held until the op completes, so that no other op
+    //     can reuse it while this one is in flight
+    auto op = op_counter_t(this);
+    auto op_counter = op.val();
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(op.slot().wr_, op.slot().sge_, ptr,
+                                  (const uint8_t *)seg, rkey, op_counter, size,
+                                  true, fence);
+    } else {
+      internal::WriteConfig(op.slot().wr_, op.slot().sge_, ptr, (uint8_t *)seg,
+                            rkey, ci.lkey_, op_counter, size, true, fence);
+    }
+    auto t0 = metrics_.start();
+    internal::Post(op.slot().wr_, ci.conn_.get(), op_counter);
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
+    metrics_.record(Metrics::ASYNC, t0, size);
     co_return;
   }
   /// @brief A sequential version of write that uses coroutine index coro_idx
@@ -248,49 +409,58 @@ class SimpleAsyncComputeThread : public ComputeThread {
       rdma_ptr<T> ptr, const T &val, bool signal = false, bool fence = false,
       size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), &val, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), &val, size, fence);
+      metrics_.count(Metrics::SEQ, size);
       co_return std::nullopt;
     }
-    auto coro_idx = 0;
+    auto coro_idx = coro_idx_;
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     auto rkey = compute_node_->get_rkey(ptr.raw());
-    auto staging_buf_ptr =
-        std::make_unique<seq_staging_buf_t>(this, size, alignof(T));
-    auto staging_buf = staging_buf_ptr->val();
-    REMUS_ASSERT(staging_buf != nullptr,
-                 "Staging buffer is not enough, increase the staging buffers "
-                 "or reduce the number of requests");
-    seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
-        std::move(staging_buf_ptr));
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &slot = op_counter_ptr->slot();
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&slot.wr_, &slot.sge_, nullptr});
+    if (signal) {
+      link_seq_send_wrs(seq_idx, coro_idx);
+    }
+    auto ack = signal ? op_counter : nullptr;
+    // Small writes wait in the work request's slot, so they need no staging
+    if (size <= std::min<size_t>(ci.conn_->max_inline(),
+                                 sizeof(slot.inline_data_))) {
+      std::memcpy(slot.inline_data_, &val, size);
+      internal::WriteInlineConfig(slot.wr_, slot.sge_, ptr, slot.inline_data_,
+                                  rkey, ack, size, signal, fence);
+    } else {
+      auto staging_buf_ptr =
+          std::make_unique<seq_staging_buf_t>(this, size, alignof(T));
+      auto staging_buf = staging_buf_ptr->val();
+      REMUS_ASSERT(staging_buf != nullptr,
+                   "Staging buffer is not enough, increase the staging buffers "
+                   "or reduce the number of requests");
+      seq_send_wrs[coro_idx][seq_idx].staging_bufs.push_back(
+          std::move(staging_buf_ptr));
+      internal::WriteConfig(slot.wr_, slot.sge_, ptr, val, staging_buf, rkey,
+                            ci.lkey_, ack, size, signal, fence);
+    }
     if (!signal) {
-      internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                            nullptr, size, signal, fence);
+      metrics_.count(Metrics::SEQ, size);
       co_return std::nullopt;
     }
-    link_seq_send_wrs(seq_idx, coro_idx);
-    internal::WriteConfig(send_wr, sge, ptr, val, staging_buf, rkey, ci.lkey_,
-                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     co_return result;
   }
@@ -312,44 +482,422 @@ class SimpleAsyncComputeThread : public ComputeThread {
       rdma_ptr<T> ptr, T *seg, bool signal = false, bool fence = false,
       size_t size = sizeof(T), bool local_copy = true) {
     if (local_copy && is_local(ptr)) {
-      memcpy((void *)ptr.address(), seg, size);
-      _mm_clflush((void *)ptr.address());
-      if (fence) {
-        _mm_sfence();
-      }
+      local_write(ptr.address(), seg, size, fence);
+      metrics_.count(Metrics::SEQ, size);
       co_return std::nullopt;
     }
-    auto coro_idx =
-        0;  // because we don't support more than one top level coroutine
+    auto coro_idx = coro_idx_;
     auto seq_idx = find_seq_idx(ptr, coro_idx);
     auto &ci = compute_node_->get_conn(
-        ptr.raw(), seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
+        ptr.raw(), id_, seq_send_wrs[coro_idx][seq_idx].lane->lane_idx);
     auto rkey = this->compute_node_->get_rkey(ptr.raw());
     auto op_counter_ptr = std::make_unique<op_counter_t>(this);
     auto op_counter = op_counter_ptr->val();
+    auto &send_wr = op_counter_ptr->slot().wr_;
+    auto &sge = op_counter_ptr->slot().sge_;
     seq_send_wrs[coro_idx][seq_idx].op_counters.push_back(
         std::move(op_counter_ptr));
-    auto send_wr = std::make_shared<ibv_send_wr>(ibv_send_wr{});
-    auto sge = std::make_shared<ibv_sge>(ibv_sge{});
-    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back({send_wr, sge});
-    if (!signal) {
+    seq_send_wrs[coro_idx][seq_idx].send_wrs.push_back(
+        {&send_wr, &sge, nullptr});
+    if (signal) {
+      link_seq_send_wrs(seq_idx, coro_idx);
+    }
+    auto ack = signal ? op_counter : nullptr;
+    if (size <= ci.conn_->max_inline()) {
+      internal::WriteInlineConfig(send_wr, sge, ptr, (const uint8_t *)seg, rkey,
+                                  ack, size, signal, fence);
+    } else {
       internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                            nullptr, size, signal, fence);
+                            ack, size, signal, fence);
+    }
+    if (!signal) {
+      metrics_.count(Metrics::SEQ, size);
       co_return std::nullopt;
     }
-    link_seq_send_wrs(seq_idx, coro_idx);
-    internal::WriteConfig(send_wr, sge, ptr, (uint8_t *)seg, rkey, ci.lkey_,
-                          op_counter, size, signal, fence);
-    internal::Post(seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
+    auto t0 = metrics_.start();
+    internal::Post(*seq_send_wrs[coro_idx][seq_idx].send_wrs.front().wr,
                    ci.conn_.get(), op_counter);
     seq_send_wrs[coro_idx][seq_idx].posted = true;
     std::vector<T> result;
-    while (!internal::PollAsync(ci.conn_.get(), op_counter, ptr)) {
+    while (!op_done(ci.conn_.get(), op_counter, ptr)) {
       co_yield std::suspend_always();
     }
     get_seq_op_result<T>(seq_idx, coro_idx, result);
+    metrics_.record(Metrics::SEQ, t0, size);
     seq_send_wrs[coro_idx].erase(seq_idx);
     co_return result;
   }
+
+ protected:
+  /// @brief The part of every awaitable op that waits for its completion
+  /// @details
+  /// The op is posted when the awaitable is made.  In a spawned coroutine,
+  /// co_await records the awaiting coroutine in the op's slot, and Run()
+  /// resumes it when the op's completion arrives.  Anywhere else, co_await
+  /// polls until the op completes.  An op that the CPU does instead (on a
+  /// co-located MemoryNode) is done when the awaitable is made, and co_await
+  /// does not suspend.
+  ///
+  /// NB: An awaitable holds its lane, op counter and staging buffer until it
+  ///     is destroyed, so it must be co_awaited before it goes out of scope.
+  class op_awaitable_t {
+   protected:
+    SimpleAsyncComputeThread *const ct_;  // The thread that posted the op
+    const uint64_t raw_;                  // The op's remote pointer
+    std::optional<Lane> lane_;            // The lane the op was posted to
+    std::optional<op_counter_t> op_;      // The op's counter and work request
+    internal::Connection *conn_ = nullptr;  // The connection for the lane
+    uint32_t lkey_ = 0;                   // The lkey for the staging buffer
+    uint32_t rkey_ = 0;                   // The rkey for the remote pointer
+    uint64_t start_ = 0;                  // When the op was posted
+    uint64_t bytes_ = 0;                  // The number of bytes the op moves
+
+    /// @brief Reserve a lane and an op counter for an op on `ptr`, unless the
+    /// CPU does the op
+    /// @tparam T The type of the object the op accesses
+    /// @param ct The thread that will post the op
+    /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+    /// @param local If true, the CPU does the op, so nothing is reserved
+    template <typename T>
+    op_awaitable_t(SimpleAsyncComputeThread *ct, rdma_ptr<T> ptr, bool local)
+        : ct_(ct), raw_(ptr.raw()) {
+      if (local) {
+        return;
+      }
+      lane_.emplace(ct->qp_sched_pol_.get_lane_idx(ptr.id()),
+                    ct->compute_node_->lane_ops(ptr.id(), ct->id_));
+      op_.emplace(ct);
+      auto &ci = ct->compute_node_->get_conn(raw_, ct->id_, lane_->lane_idx);
+      conn_ = ci.conn_.get();
+      lkey_ = ci.lkey_;
+      rkey_ = ct->compute_node_->get_rkey(raw_);
+    }
+
+    /// @brief Post the op's work request, once it is configured
+    /// @param bytes The number of bytes the op moves
+    void post(uint64_t bytes) {
+      bytes_ = bytes;
+      start_ = ct_->metrics_.start();
+      internal::Post(op_->slot().wr_, conn_, op_->val());
+    }
+
+    /// @brief Count an op that the CPU did
+    /// @param bytes The number of bytes the op moved
+    void done_locally(uint64_t bytes) {
+      ct_->metrics_.count(Metrics::ASYNC, bytes);
+    }
+
+    /// @brief Count the op, once it has completed
+    void finish() {
+      if (op_) {
+        ct_->metrics_.record(Metrics::ASYNC, start_, bytes_);
+      }
+    }
+
+   public:
+    /// Forbid copying awaitables, since they own the op's resources
+    op_awaitable_t(const op_awaitable_t &) = delete;
+
+    /// There is no need to suspend if the op already completed
+    bool await_ready() { return !op_ || *op_->val() == 0; }
+
+    /// Wait for the op's completion, from the scheduler or by polling
+    bool await_suspend(std::coroutine_handle<> h) {
+      return ct_->await_op(conn_, op_->val(), rdma_ptr<uint8_t>(raw_), h);
+    }
+  };
+
+  /// @brief An awaitable Read, which produces the object read
+  template <typename T>
+  class read_awaitable_t : public op_awaitable_t {
+    std::optional<staging_buf_t> staging_;  // Where the NIC puts the object
+    T val_;                                 // The object, if the CPU read it
+
+   public:
+    read_awaitable_t(SimpleAsyncComputeThread *ct, rdma_ptr<T> ptr, bool fence,
+                     bool local_copy)
+        : op_awaitable_t(ct, ptr, local_copy && ct->is_local(ptr)) {
+      if (!op_) {
+        ct->local_read(&val_, ptr.address(), sizeof(T));
+        done_locally(sizeof(T));
+        return;
+      }
+      staging_.emplace(ct, sizeof(T), alignof(T));
+      internal::ReadConfig(op_->slot().wr_, op_->slot().sge_, ptr,
+                           staging_->val(), rkey_, lkey_, op_->val(),
+                           sizeof(T), true, fence);
+      post(sizeof(T));
+    }
+
+    /// Unpack the object read
+    T await_resume() {
+      finish();
+      return op_ ? *(T *)staging_->val() : val_;
+    }
+  };
+
+  /// @brief An awaitable Write
+  template <typename T>
+  class write_awaitable_t : public op_awaitable_t {
+    std::optional<staging_buf_t> staging_;  // Where a large value waits
+
+   public:
+    write_awaitable_t(SimpleAsyncComputeThread *ct, rdma_ptr<T> ptr,
+                      const T &val, bool fence, size_t size, bool local_copy)
+        : op_awaitable_t(ct, ptr, local_copy && ct->is_local(ptr)) {
+      if (!op_) {
+        ct->local_write(ptr.address(), &val, size, fence);
+        done_locally(size);
+        return;
+      }
+      if (size <= conn_->max_inline()) {
+        internal::WriteInlineConfig(op_->slot().wr_, op_->slot().sge_, ptr,
+                                    (const uint8_t *)&val, rkey_, op_->val(),
+                                    size, true, fence);
+      } else {
+        staging_.emplace(ct, size, alignof(T));
+        internal::WriteConfig(op_->slot().wr_, op_->slot().sge_, ptr, val,
+                              staging_->val(), rkey_, lkey_, op_->val(), size,
+                              true, fence);
+      }
+      post(size);
+    }
+
+    /// There is no value to unpack
+    void await_resume() { finish(); }
+  };
+
+  /// @brief An awaitable CompareAndSwap, which produces the value before the
+  /// operation
+  template <typename T>
+  class cas_awaitable_t : public op_awaitable_t {
+    std::optional<staging_buf_t> staging_;  // Where the NIC puts the old value
+    T old_;                                 // The old value, if the CPU did it
+
+   public:
+    cas_awaitable_t(SimpleAsyncComputeThread *ct, rdma_ptr<T> ptr, T expected,
+                    T swap, bool fence, bool local_copy)
+        : op_awaitable_t(ct, ptr, local_copy && ct->is_local_atomic(ptr)) {
+      if (!op_) {
+        old_ = ct->local_cas(ptr, expected, swap);
+        done_locally(sizeof(T));
+        return;
+      }
+      staging_.emplace(ct, sizeof(T), alignof(T));
+      internal::CompareAndSwapConfig(
+          op_->slot().wr_, op_->slot().sge_, ptr, (uint64_t)expected,
+          (uint64_t)swap, (uint64_t *)staging_->val(), rkey_, lkey_,
+          op_->val(), true, fence);
+      post(sizeof(T));
+    }
+
+    /// Unpack the value before the operation
+    T await_resume() {
+      finish();
+      return op_ ? *(T *)staging_->val() : old_;
+    }
+  };
+
+  /// @brief An awaitable FetchAndAdd, which produces the value before the
+  /// addition
+  template <typename T>
+  class faa_awaitable_t : public op_awaitable_t {
+    std::optional<staging_buf_t> staging_;  // Where the NIC puts the old value
+    T old_;                                 // The old value, if the CPU did it
+
+   public:
+    faa_awaitable_t(SimpleAsyncComputeThread *ct, rdma_ptr<T> ptr, uint64_t add,
+                    bool fence, bool local_copy)
+        : op_awaitable_t(ct, ptr, local_copy && ct->is_local_atomic(ptr)) {
+      if (!op_) {
+        old_ = ct->local_faa(ptr, add);
+        done_locally(sizeof(T));
+        return;
+      }
+      staging_.emplace(ct, sizeof(T), alignof(T));
+      internal::FetchAndAddConfig(op_->slot().wr_, op_->slot().sge_, ptr, add,
+                                  (uint64_t *)staging_->val(), rkey_, lkey_,
+                                  op_->val(), true, fence);
+      post(sizeof(T));
+    }
+
+    /// Unpack the value before the addition
+    T await_resume() {
+      finish();
+      return op_ ? *(T *)staging_->val() : old_;
+    }
+  };
+
+ public:
+  /// @brief An awaitable read operation
+  /// @tparam T The type of the object read
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param fence If true, a fence is issued after the read operation
+  /// @param local_copy If true, the read is performed locally if the pointer
+  /// is local
+  /// @return An awaitable that produces the object read from the RDMA heap
+  template <typename T>
+  read_awaitable_t<T> ReadAwait(rdma_ptr<T> ptr, bool fence = false,
+                                bool local_copy = true) {
+    return read_awaitable_t<T>(this, ptr, fence, local_copy);
+  }
+
+  /// @brief An awaitable write operation
+  /// @tparam T The type of the object to write
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param val The value to write to the RDMA heap
+  /// @param fence If true, a fence is issued after the write operation
+  /// @param size The size of the object to write, defaults to sizeof(T)
+  /// @param local_copy If true, the write is performed locally if the pointer
+  /// is local
+  /// @return An awaitable that completes when the write operation is done
+  template <typename T>
+  write_awaitable_t<T> WriteAwait(rdma_ptr<T> ptr, const T &val,
+                                  bool fence = true, size_t size = sizeof(T),
+                                  bool local_copy = true) {
+    return write_awaitable_t<T>(this, ptr, val, fence, size, local_copy);
+  }
+
+  /// @brief An awaitable CompareAndSwap operation
+  /// @tparam T The type of the object to compare and swap
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param expected The expected value of the object
+  /// @param swap The value to swap in if the object has the expected value
+  /// @param fence If true, a fence is issued after the compare and swap
+  /// @param local_copy If true, the pointer is local, and the CPU's atomics are
+  /// coherent with the RNIC's, the CAS is performed locally
+  /// @return An awaitable that produces the value before the operation
+  template <typename T>
+    requires(sizeof(T) <= 8)
+  cas_awaitable_t<T> CompareAndSwapAwait(rdma_ptr<T> ptr, T expected, T swap,
+                                         bool fence = true,
+                                         bool local_copy = true) {
+    return cas_awaitable_t<T>(this, ptr, expected, swap, fence, local_copy);
+  }
+
+  /// @brief An awaitable FetchAndAdd operation
+  /// @tparam T The type of the object to fetch and add
+  /// @param ptr The rdma_ptr pointing to the object in the RDMA heap
+  /// @param add The value to add to the object
+  /// @param fence If true, a fence is issued after the fetch and add
+  /// @param local_copy If true, the pointer is local, and the CPU's atomics are
+  /// coherent with the RNIC's, the FAA is performed locally
+  /// @return An awaitable that produces the value before the addition
+  template <typename T>
+    requires(sizeof(T) <= 8)
+  faa_awaitable_t<T> FetchAndAddAwait(rdma_ptr<T> ptr, uint64_t add,
+                                      bool fence = true,
+                                      bool local_copy = true) {
+    return faa_awaitable_t<T>(this, ptr, add, fence, local_copy);
+  }
+
+ private:
+  /// @brief Check if an async op has completed
+  /// @details
+  /// Outside of Run(), this polls the CQ.  In a spawned coroutine, it instead
+  /// parks the coroutine on the op's counter, and Run() polls for it.
+  ///
+  /// @tparam T The type of the object the op accesses
+  /// @param conn The connection that the op was posted to
+  /// @param ack The op's counter
+  /// @param ptr The pointer to report if a completion failed
+  /// @return True if the op has completed
+  template <typename T>
+  bool op_done(internal::Connection *conn, std::atomic<int> *ack,
+               rdma_ptr<T> ptr) {
+    if (!scheduled_) {
+      return internal::PollAsync(conn, ack, ptr);
+    }
+    if (*ack == 0) {
+      return true;
+    }
+    park(conn, ack, {});
+    return false;
+  }
+
+  /// @brief Wait for an awaited op to complete
+  /// @param conn The connection that the op was posted to
+  /// @param ack The op's counter
+  /// @param ptr The pointer to report if a completion failed
+  /// @param handle The coroutine that co_awaits the op
+  /// @return True if `handle` should suspend until Run() resumes it
+  bool await_op(internal::Connection *conn, std::atomic<int> *ack,
+                rdma_ptr<uint8_t> ptr, std::coroutine_handle<> handle) {
+    if (!scheduled_) {
+      internal::Poll(conn, ack, ptr);
+      return false;
+    }
+    park(conn, ack, handle);
+    return true;
+  }
+
+  /// @brief Suspend the running task until an op completes
+  /// @param conn The connection that the op was posted to
+  /// @param ack The op's counter
+  /// @param handle The coroutine to resume, or null to resume the task itself
+  void park(internal::Connection *conn, std::atomic<int> *ack,
+            std::coroutine_handle<> handle) {
+    tasks_[coro_idx_].parked_ = ack;
+    op_waiters_[ack - op_counters_.data()] = {coro_idx_, handle};
+    poll_conn_ = conn;
+  }
+
+  /// @brief Make whatever is waiting on an op counter ready
+  /// @param ack The op counter that reached zero
+  void wake(std::atomic<int> *ack) {
+    // NB: Completions of WriteUnsignaled() batches belong to no task
+    auto slot = (uintptr_t)ack - (uintptr_t)op_counters_.data();
+    if (slot >= op_counters_.size() * sizeof(std::atomic<int>)) {
+      return;
+    }
+    auto &w = op_waiters_[ack - op_counters_.data()];
+    auto &task = tasks_[w.coro_idx_];
+    // NB: The task may since have moved on to another op
+    if (task.parked_ == ack) {
+      task.parked_ = nullptr;
+      ready_.push_back(w);
+    }
+  }
+
+  /// @brief Make progress on the RPC batches that tasks wait on, sending them
+  /// if they are OPEN, and make the tasks whose responses arrived ready
+  void progress_rpcs() {
+    for (size_t i = 0; i < rpc_waiters_.size();) {
+      auto &w = rpc_waiters_[i];
+      if (!rpc_ready(w.mn_id_, w.batch_, w.gen_)) {
+        ++i;
+        continue;
+      }
+      tasks_[w.waiter_.coro_idx_].parked_ = nullptr;
+      ready_.push_back(w.waiter_);
+      w = rpc_waiters_.back();
+      rpc_waiters_.pop_back();
+    }
+  }
+
+  /// @brief Start or resume a task, until it finishes or suspends
+  /// @param w The task's coro_idx, and the coroutine within it to resume
+  void step(waiter_t w) {
+    auto &task = tasks_[w.coro_idx_];
+    coro_idx_ = w.coro_idx_;
+    scheduled_ = true;
+    if (!task.coro_) {
+      task.coro_.emplace(task.fn_());
+    } else if (w.handle_) {
+      w.handle_.resume();
+    } else {
+      task.coro_->resume();
+    }
+    scheduled_ = false;
+    coro_idx_ = 0;
+    if (task.coro_->get_ready()) {
+      task.coro_.reset();
+      task.fn_ = nullptr;
+      free_coros_.push_back(w.coro_idx_);
+    } else if (task.parked_ == nullptr) {
+      // It yielded without waiting on an op, so it can run again right away
+      ready_.push_back({w.coro_idx_, {}});
+    }
+  }
 };
 }  // namespace remus
\ No newline at end of file
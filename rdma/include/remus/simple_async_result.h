@@ -3,6 +3,7 @@
 #include <coroutine>
 #include <exception>
 #include <optional>
+#include <utility>
 
 namespace remus {
 
@@ -179,4 +180,145 @@ struct AsyncResultVoid {
   bool get_ready() const { return handle.promise().state.ready; }
 };
 
+namespace internal {
+/// @brief The parts of a Task's promise_type that do not depend on T
+struct task_promise_base {
+  /// The coroutine that is co_awaiting this Task
+  std::coroutine_handle<> continuation_ = std::noop_coroutine();
+
+  /// @brief On completion, transfer control straight to the awaiting coroutine
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<P> h) noexcept {
+      return h.promise().continuation_;
+    }
+    void await_resume() noexcept {}
+  };
+
+  /// Don't run until someone co_awaits the Task
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  /// Resume the awaiting coroutine, then stay suspended until destroyed
+  final_awaiter final_suspend() noexcept { return {}; }
+
+  /// We're not really interested in exceptions, so we'll terminate on an
+  /// unhandled exception
+  void unhandled_exception() { std::terminate(); }
+};
+}  // namespace internal
+
+/// @brief A lazily-started coroutine that produces a T when co_awaited
+/// @details
+/// Unlike AsyncResult, a Task is driven by co_await instead of resume(): the
+/// awaiting coroutine suspends, the Task runs until it completes, and then the
+/// awaiting coroutine resumes right away (by symmetric transfer, so deep chains
+/// of Tasks do not grow the stack).  This makes it possible to write a whole
+/// data-structure operation as one Task that co_awaits remote operations and
+/// other Tasks.
+///
+/// @tparam T The type of value that this Task will produce
+template <typename T = void>
+class Task {
+ public:
+  /// @brief The promise_type for Task
+  struct promise_type : internal::task_promise_base {
+    std::optional<T> val_;  // The value from co_return
+
+    /// Produce the Task that owns this coroutine
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    /// Save the value, for the awaiting coroutine
+    template <typename U>
+    void return_value(U &&value) {
+      val_.emplace(std::forward<U>(value));
+    }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> handle_;  // Save the coroutine handle
+
+ public:
+  /// Construct by copying the handle
+  explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+  /// Destruct by destroying the handle
+  ~Task() {
+    if (handle_) handle_.destroy();
+  }
+
+  /// Forbid copying Tasks
+  Task(const Task &) = delete;
+
+  /// Forbid assigning Tasks
+  Task &operator=(const Task &) = delete;
+
+  /// It's OK to move a Task
+  Task(Task &&t) noexcept : handle_(std::exchange(t.handle_, nullptr)) {}
+
+  /// A Task that already completed does not need to suspend its awaiter
+  bool await_ready() const { return handle_.done(); }
+
+  /// Start the Task, and have it resume `caller` when it completes
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+    handle_.promise().continuation_ = caller;
+    return handle_;
+  }
+
+  /// Unpack the return value from this Task
+  T await_resume() { return std::move(*handle_.promise().val_); }
+};
+
+/// @brief A lazily-started coroutine that produces nothing when co_awaited
+template <>
+class Task<void> {
+ public:
+  /// @brief The promise_type for Task<void>
+  struct promise_type : internal::task_promise_base {
+    /// Produce the Task that owns this coroutine
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    /// There is nothing to save on co_return
+    void return_void() {}
+  };
+
+ private:
+  std::coroutine_handle<promise_type> handle_;  // Save the coroutine handle
+
+ public:
+  /// Construct by copying the handle
+  explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+  /// Destruct by destroying the handle
+  ~Task() {
+    if (handle_) handle_.destroy();
+  }
+
+  /// Forbid copying Tasks
+  Task(const Task &) = delete;
+
+  /// Forbid assigning Tasks
+  Task &operator=(const Task &) = delete;
+
+  /// It's OK to move a Task
+  Task(Task &&t) noexcept : handle_(std::exchange(t.handle_, nullptr)) {}
+
+  /// A Task that already completed does not need to suspend its awaiter
+  bool await_ready() const { return handle_.done(); }
+
+  /// Start the Task, and have it resume `caller` when it completes
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+    handle_.promise().continuation_ = caller;
+    return handle_;
+  }
+
+  /// There is no return value to unpack
+  void await_resume() {}
+};
+
 }  // namespace remus
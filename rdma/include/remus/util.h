@@ -44,9 +44,16 @@ namespace remus::internal {
 constexpr int kCapacity = 1 << 16;  // Send/Recv buffers are 4 KiB
 constexpr int kMaxSge = 32;         // Max # SGEs in one RDMA write
 constexpr int kMaxRecvSge = 1;      // Max # SGEs in one RDMA receive
-constexpr int kMaxInlineData = 0;   // We aren't using INLINE data
+constexpr int kMaxInlineData = 0;   // Default: no INLINE data
 constexpr int kMaxRecvBytes = 64;   // Max message size
 constexpr int kMaxWr = kCapacity / kMaxRecvBytes;  // Max # outstanding writes
+constexpr int kMaxPollBatch = 16;  // Max # completions retired per poll
+
+/// The number of operations in flight on one QP.  Each is on its own cache
+/// line, so that threads counting on neighboring QPs do not false-share.
+struct alignas(64) lane_counter_t {
+  std::atomic<size_t> ops_{0};
+};
 
 /// Set the file descriptor `fd` as O_NONBLOCK
 inline void make_nonblocking(int fd) {
@@ -62,6 +69,17 @@ inline void make_sync(int fd) {
   }
 }
 
+/// Report if a device's atomics are coherent with the CPU's (IBV_ATOMIC_GLOB),
+/// so that CPU atomics and RDMA atomics on the same word are atomic with
+/// respect to each other
+inline bool atomics_glob(ibv_context *context) {
+  ibv_device_attr dev_attr;
+  if (ibv_query_device(context, &dev_attr) != 0) {
+    REMUS_FATAL("ibv_query_device(): {}", strerror(errno));
+  }
+  return dev_attr.atomic_cap == IBV_ATOMIC_GLOB;
+}
+
 /// Produce a vector of active RDMA ports, or None if none are found
 inline std::vector<int> find_active_ports(ibv_context *context) {
   // Find the first active port, failing if none exists.
@@ -101,14 +119,17 @@ inline std::vector<std::pair<std::string, int>> get_avail_devices() {
 /// Configure the minimum attributes for a QP
 ///
 /// TODO: Should this be used more broadly?
-inline ibv_qp_init_attr make_default_qp_init_attrs() {
+///
+/// @param max_inline The largest write payload that can be sent inline
+inline ibv_qp_init_attr
+make_default_qp_init_attrs(uint32_t max_inline = kMaxInlineData) {
   // TODO: Where do these numbers come from?  Are they still valid?
   ibv_qp_init_attr init_attr;
   std::memset(&init_attr, 0, sizeof(ibv_qp_init_attr));
   init_attr.cap.max_send_wr = init_attr.cap.max_recv_wr = kMaxWr;
   init_attr.cap.max_send_sge = kMaxSge;
   init_attr.cap.max_recv_sge = kMaxRecvSge;
-  init_attr.cap.max_inline_data = kMaxInlineData;
+  init_attr.cap.max_inline_data = max_inline;
   init_attr.sq_sig_all = 0;  // Must request completions.
   init_attr.qp_type = IBV_QPT_RC;
   return init_attr;
@@ -172,19 +193,38 @@ struct ibv_mr_deleter {
 };
 using ibv_mr_ptr = std::unique_ptr<ibv_mr, ibv_mr_deleter>;
 
+/// @brief A deleter for ibv_cq objects
+/// @details
+/// ibv_cq_deleter wraps a call to ibv_destroy_cq.  It is used by `ibv_cq_ptr`,
+/// so that a unique_ptr can hold a completion queue that we created ourselves
+/// (as opposed to one that rdma_cm created, and will destroy, with a QP).
+///
+/// NB: A CQ cannot be destroyed while any QP still uses it.
+struct ibv_cq_deleter {
+  void operator()(ibv_cq *cq) { ibv_destroy_cq(cq); }
+};
+using ibv_cq_ptr = std::unique_ptr<ibv_cq, ibv_cq_deleter>;
+
+/// The number of allocation size classes that can be recycled through a
+/// Segment's free stacks (see BumpAllocator)
+constexpr size_t kNumSizeClasses = 23;
+
 /// @brief A control block for managing segments in the distributed memory
 /// system.
 /// @details
 /// ControlBlock is a header for each Segment managed by a Memory Node.  It
 /// supports bump allocation and graceful shutdown, and offers some optional
 /// space for a barrier (for synchronizing compute threads) and root pointer
-/// (cast to rdma_ptr<> to reach the workload's root)
+/// (cast to rdma_ptr<> to reach the workload's root).  It also holds the heads
+/// of the Segment's free stacks, one per size class, through which any thread
+/// can reuse the Segment's freed blocks.
 struct alignas(64) ControlBlock {
   const uint64_t size_;                 // The size of the segment
   std::atomic<uint64_t> allocated_;     // The number of allocated bytes
   std::atomic<uint64_t> control_flag_;  // A control flag, for shutdown
   std::atomic<uint64_t> barrier_;       // An optional barrier
   std::atomic<uint64_t> root_;          // An optional root pointer
+  std::atomic<uint64_t> free_stacks_[kNumSizeClasses];  // Free stack heads
 
   /// Initialize a ControlBlock with the provided size
   ControlBlock(uint64_t size)
@@ -192,7 +232,11 @@ struct alignas(64) ControlBlock {
         allocated_(sizeof(ControlBlock)),
         control_flag_(0),
         barrier_(0),
-        root_(0) {}
+        root_(0) {
+    for (auto &head : free_stacks_) {
+      head = 0;
+    }
+  }
 };
 
 /// @brief A pseudorandom number generator based on rdtsc
@@ -0,0 +1,181 @@
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of times each thread updates each word
+constexpr uint64_t kRounds = 300;
+
+/// The lock bit of the packed lock word
+constexpr uint64_t kLockBit = 1ULL << 63;
+
+/// The number of 8-bit counters below the lock bit of the packed lock word
+constexpr uint64_t kFields = 7;
+
+/// The low bits of the word whose top byte is a counter, which must not change
+constexpr uint64_t kLowBits = 0x123456789ABCULL;
+
+/// The words that every thread updates
+struct words_t {
+  uint64_t packed_;  // A lock bit, and kFields 8-bit counters
+  uint64_t top_;     // An 8-bit counter in the top byte, above kLowBits
+  uint64_t counter_; // Protected by the lock bit of packed_
+  remus::versioned_word_t<uint64_t> pair_; // A counter and its version
+};
+
+void check_atomics(std::shared_ptr<remus::ComputeThread> t,
+                   remus::rdma_ptr<words_t> w, uint64_t uid,
+                   uint64_t total_threads) {
+  auto packed = remus::rdma_ptr<uint64_t>(w.raw() + offsetof(words_t, packed_));
+  auto top = remus::rdma_ptr<uint64_t>(w.raw() + offsetof(words_t, top_));
+  auto counter =
+      remus::rdma_ptr<uint64_t>(w.raw() + offsetof(words_t, counter_));
+  auto pair = remus::rdma_ptr<remus::versioned_word_t<uint64_t>>(
+      w.raw() + offsetof(words_t, pair_));
+  uint64_t field = (uid % kFields) * 8;
+  auto check_pair = [](const remus::versioned_word_t<uint64_t> &p) {
+    REMUS_ASSERT(p.version_ == 2 * p.val_,
+                 "Torn read of the versioned counter: {} (version {})", p.val_,
+                 p.version_);
+  };
+
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t i = 0; i < kRounds; ++i) {
+    // Take the lock, even though other threads keep changing the counters
+    // that share its word
+    while (t->MaskedCompareAndSwap(packed, uint64_t(0), kLockBit, kLockBit,
+                                   kLockBit) &
+           kLockBit) {
+    }
+    t->Write(counter, t->Read(counter) + 1);
+    auto old = t->MaskedCompareAndSwap(packed, kLockBit, kLockBit,
+                                       uint64_t(0), kLockBit);
+    REMUS_ASSERT(old & kLockBit, "The lock was released by someone else");
+
+    // Bump this thread's counter, which wraps without carrying into the next
+    t->MaskedFetchAndAdd(packed, 1ULL << field, 0xFFULL << field);
+    t->MaskedFetchAndAdd(top, 1ULL << 56, 0xFFULL << 56);
+
+    // Bump the versioned counter.  Every update adds 1 to it and 2 to its
+    // version, so a read that races with other threads' updates is torn
+    // unless the version is exactly twice the counter.
+    auto exp = t->DoubleRead(pair);
+    check_pair(exp);
+    while (!t->DoubleCompareAndSwap(
+        pair, exp, {exp.val_ + 1, exp.version_ + 2})) {
+      check_pair(exp);
+    }
+    for (uint64_t j = 0; j < 4; ++j) {
+      check_pair(t->DoubleRead(pair));
+    }
+  }
+  t->arrive_control_barrier(total_threads);
+
+  uint64_t expect_packed = 0;
+  for (uint64_t u = 0; u < total_threads; ++u) {
+    uint64_t f = (u % kFields) * 8;
+    expect_packed = (expect_packed & ~(0xFFULL << f)) |
+                    ((((expect_packed >> f) + kRounds) & 0xFF) << f);
+  }
+  uint64_t expect_top = ((total_threads * kRounds) & 0xFF) << 56 | kLowBits;
+  auto words = t->Read(w);
+  REMUS_ASSERT(words.packed_ == expect_packed,
+               "Packed word is 0x{:x}, not 0x{:x}", words.packed_,
+               expect_packed);
+  REMUS_ASSERT(words.top_ == expect_top, "Top word is 0x{:x}, not 0x{:x}",
+               words.top_, expect_top);
+  REMUS_ASSERT(words.counter_ == total_threads * kRounds,
+               "Locked counter is {}", words.counter_);
+  auto p = t->DoubleRead(pair);
+  REMUS_ASSERT(p.val_ == total_threads * kRounds &&
+                   p.version_ == 2 * total_threads * kRounds,
+               "Versioned counter is {} (version {})", p.val_, p.version_);
+  t->arrive_control_barrier(total_threads);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the words, and publishes them via the root
+    if (id == c0) {
+      auto &t = compute_threads[0];
+      auto w = t->allocate<words_t>();
+      t->Write<words_t>(w, words_t{0, kLowBits, 0, {0, 0}});
+      t->set_root(w);
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_atomics(t, t->get_root<words_t>(), uid, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Atomics test passed");
+}
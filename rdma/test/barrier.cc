@@ -0,0 +1,124 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of barrier phases to run
+constexpr uint64_t kRounds = 64;
+
+// NB: Each thread writes the round number into its own slot, and after the
+//     barrier, checks that every other thread has written it too.  The odd
+//     rounds use the split-phase API, and check their own slot in between.
+void check_rounds(std::shared_ptr<remus::ComputeThread> t,
+                  remus::rdma_ptr<uint64_t> slots, uint64_t uid,
+                  uint64_t total_threads) {
+  for (uint64_t r = 1; r <= kRounds; ++r) {
+    t->Write<uint64_t>(slots + uid, r);
+    if (r % 2 == 0) {
+      t->arrive_control_barrier(total_threads);
+    } else {
+      auto token = t->arrive_barrier(total_threads);
+      REMUS_ASSERT(t->Read<uint64_t>(slots + uid) == r,
+                   "Own slot changed before the barrier");
+      t->wait_barrier(token);
+    }
+    for (uint64_t i = 0; i < total_threads; ++i) {
+      auto v = t->Read<uint64_t>(slots + i);
+      REMUS_ASSERT(v >= r, "Thread {} passed round {} before thread {} did",
+                   uid, r, i);
+    }
+    // Keep anyone from writing round r + 1 before every check of round r
+    t->arrive_control_barrier(total_threads);
+  }
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    // NB: Each thread starts as soon as its ComputeThread exists, so the first
+    //     ones reach the barrier before their siblings are constructed
+    compute_threads.reserve(threads);
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      auto t = std::make_shared<remus::ComputeThread>(id, compute_node, args);
+      compute_threads.push_back(t);
+      // The first compute node makes the slots, and publishes them via the
+      // root
+      if (id == c0 && i == 0) {
+        auto slots = t->allocate<uint64_t>(total_threads);
+        for (uint64_t j = 0; j < total_threads; ++j) {
+          t->Write<uint64_t>(slots + j, (uint64_t)0);
+        }
+        t->set_root(slots);
+      }
+      worker_threads.push_back(std::thread([&, t, i]() {
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_rounds(t, t->get_root<uint64_t>(), uid, total_threads);
+      }));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Barrier test passed");
+}
@@ -0,0 +1,191 @@
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+// NB: Every object is allocated separately, so that (depending on --alloc-pol)
+//     a single batch reaches several MemoryNodes and lanes.
+std::vector<remus::rdma_ptr<uint64_t>>
+make_objects(std::shared_ptr<remus::ComputeThread> t, size_t num_objs) {
+  std::vector<remus::rdma_ptr<uint64_t>> ptrs;
+  for (size_t i = 0; i < num_objs; i++) {
+    ptrs.push_back(t->allocate<uint64_t>());
+  }
+  return ptrs;
+}
+
+void batch_write_read(std::shared_ptr<remus::ComputeThread> t,
+                      std::vector<remus::rdma_ptr<uint64_t>> &ptrs,
+                      size_t total_threads, bool local_copy) {
+  t->arrive_control_barrier(total_threads);
+  auto b = t->batch(ptrs.size(), local_copy);
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    b.Write<uint64_t>(ptrs[i], i);
+  }
+  b.Execute();
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    REMUS_ASSERT(t->Read<uint64_t>(ptrs[i]) == i, "Batch write mismatch");
+  }
+  std::vector<uint64_t> result(ptrs.size(), 0);
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    b.Read<uint64_t>(ptrs[i], &result[i]);
+  }
+  b.Execute();
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    REMUS_ASSERT(result[i] == i, "Batch read mismatch");
+  }
+  t->arrive_control_barrier(total_threads);
+}
+
+void batch_atomics(std::shared_ptr<remus::ComputeThread> t,
+                   std::vector<remus::rdma_ptr<uint64_t>> &ptrs,
+                   size_t total_threads, bool local_copy) {
+  t->arrive_control_barrier(total_threads);
+  auto b = t->batch(2 * ptrs.size(), local_copy);
+  std::vector<uint64_t> faa(ptrs.size(), 0), cas(ptrs.size(), 0);
+  // A FAA and then a fenced CAS on each object, all in one round
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    b.FetchAndAdd<uint64_t>(ptrs[i], 1, &faa[i]);
+    b.CompareAndSwap<uint64_t>(ptrs[i], i + 1, 42, &cas[i], true);
+  }
+  b.Execute();
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    REMUS_ASSERT(faa[i] == i, "Batch FAA mismatch");
+    REMUS_ASSERT(cas[i] == i + 1, "Batch CAS mismatch");
+    REMUS_ASSERT(t->Read<uint64_t>(ptrs[i]) == 42, "Batch CAS did not swap");
+  }
+  t->arrive_control_barrier(total_threads);
+}
+
+/// A round with more operations than a send queue holds, behind unsignaled
+/// writes that are still in flight on the same QPs
+///
+/// NB: This uses the NIC even for co-located MemoryNodes, since the CPU's ops
+///     never reach the send queues
+void batch_deep(std::shared_ptr<remus::ComputeThread> t,
+                std::vector<remus::rdma_ptr<uint64_t>> &ptrs,
+                size_t total_threads) {
+  t->arrive_control_barrier(total_threads);
+  const size_t per_obj = 3 * remus::internal::kMaxWr / ptrs.size() + 1;
+  for (auto &p : ptrs) {
+    t->Write(p, uint64_t(0));
+  }
+  auto scratch = t->allocate<uint64_t>();
+  for (uint64_t i = 0; i < 100; i++) {
+    t->WriteUnsignaled(scratch, i, false, sizeof(uint64_t), false);
+  }
+  auto b = t->batch(per_obj * ptrs.size(), false);
+  for (size_t k = 0; k < per_obj; k++) {
+    for (auto &p : ptrs) {
+      b.FetchAndAdd<uint64_t>(p, 1);
+    }
+  }
+  b.Execute();
+  t->Flush();
+  for (size_t i = 0; i < ptrs.size(); i++) {
+    REMUS_ASSERT(t->Read<uint64_t>(ptrs[i]) == per_obj,
+                 "Deep batch FAA mismatch: {} != {}",
+                 t->Read<uint64_t>(ptrs[i]), per_obj);
+  }
+  REMUS_ASSERT(t->Read<uint64_t>(scratch) == 99, "Unsignaled write lost");
+  t->deallocate(scratch);
+  t->arrive_control_barrier(total_threads);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t total_threads = (cn - c0 + 1) * args->uget(remus::CN_THREADS);
+  if (id >= c0 && id <= cn) {
+    const size_t num_objs = 64;
+    for (uint64_t i = 0; i < args->uget(remus::CN_THREADS); ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (auto &t : compute_threads) {
+      worker_threads.push_back(std::thread([&, t]() {
+        t->arrive_control_barrier(total_threads);
+        auto ptrs = make_objects(t, num_objs);
+        REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
+        // Through the NIC, and then (for a co-located MemoryNode) the CPU
+        for (bool local_copy : {false, true}) {
+          batch_write_read(t, ptrs, total_threads, local_copy);
+          REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
+          batch_atomics(t, ptrs, total_threads, local_copy);
+          REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
+        }
+        batch_deep(t, ptrs, total_threads);
+        REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
+        // Free half the objects by size, which skips reading their headers
+        for (size_t i = 0; i < ptrs.size(); i++) {
+          if (i % 2 == 0) {
+            t->deallocate(ptrs[i]);
+          } else {
+            t->deallocate(ptrs[i], 1);
+          }
+        }
+        t->arrive_control_barrier(total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Batch test passed");
+}
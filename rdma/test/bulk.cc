@@ -0,0 +1,123 @@
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The size of each thread's object: several chunks, and then a partial one
+constexpr uint64_t kSize = 5 * (1 << 16) + 123;
+
+/// The number of times each thread writes and reads its object
+constexpr uint64_t kRounds = 6;
+
+void check_bulk(std::shared_ptr<remus::ComputeThread> t, uint64_t uid,
+                uint64_t total_threads) {
+  // One local copy is in registered memory, and the other is not
+  std::vector<uint8_t> heap(kSize);
+  auto *reg = t->local_allocate<uint8_t>(kSize);
+  auto obj = t->allocate<uint8_t>(kSize);
+
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t r = 0; r < kRounds; ++r) {
+    // Memory on this node is copied directly unless local_copy is false, so
+    // mostly use the QP path
+    bool local = r == kRounds - 1;
+    auto *src = r % 2 ? reg : heap.data();
+    auto *dst = r % 2 ? heap.data() : reg;
+    for (uint64_t b = 0; b < kSize; ++b) {
+      src[b] = uint8_t(r * 31 + b * 7 + uid);
+    }
+    std::memset(dst, 0, kSize);
+    t->BulkWrite(obj, src, kSize, local);
+    t->BulkRead(obj, dst, kSize, local);
+    REMUS_ASSERT(std::memcmp(src, dst, kSize) == 0,
+                 "Round {}: the object read is not the one written", r);
+    // The last byte came from the last, partial chunk
+    REMUS_ASSERT(t->Read(remus::rdma_ptr<uint8_t>(obj.raw() + kSize - 1),
+                         true, false) == src[kSize - 1],
+                 "Round {}: the last chunk is wrong", r);
+  }
+  t->arrive_control_barrier(total_threads);
+  t->deallocate(obj, kSize);
+  t->local_deallocate(reg);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_bulk(t, uid, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Bulk read/write test passed");
+}
@@ -0,0 +1,173 @@
+#include <array>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/hash_map.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// A value that is too big to store in a slot
+using big_t = std::array<uint64_t, 4>;
+
+using small_map_t = remus::HashMap<uint64_t, uint64_t>;
+using big_map_t = remus::HashMap<uint64_t, big_t>;
+
+/// The (raw) directories of the maps that every thread uses
+struct maps_t {
+  uint64_t small_;
+  uint64_t big_;
+};
+
+// NB: Each thread inserts its own keys, but looks up everyone's, so that the
+//     threads race on shared buckets.
+void small_values(std::shared_ptr<remus::ComputeThread> t,
+                  remus::rdma_ptr<small_map_t::dir_t> d,
+                  uint64_t uid, uint64_t keys, uint64_t total_threads) {
+  small_map_t map(t.get(), d);
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = uid; k < keys; k += total_threads) {
+    REMUS_ASSERT(map.Insert(k, k * 2), "Insert of {} failed", k);
+    REMUS_ASSERT(!map.Insert(k, 0), "Duplicate insert of {} succeeded", k);
+  }
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = 0; k < keys; ++k) {
+    auto v = map.Get(k);
+    REMUS_ASSERT(v.has_value() && *v == k * 2, "Get of {} failed", k);
+  }
+  REMUS_ASSERT(!map.Get(keys).has_value(), "Get of a missing key succeeded");
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = uid; k < keys; k += total_threads) {
+    REMUS_ASSERT(map.Update(k, k * 3), "Update of {} failed", k);
+    if (k % 2 == 0) {
+      REMUS_ASSERT(map.Remove(k), "Remove of {} failed", k);
+    }
+  }
+  REMUS_ASSERT(!map.Update(keys, 0), "Update of a missing key succeeded");
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = 0; k < keys; ++k) {
+    auto v = map.Get(k);
+    if (k % 2 == 0) {
+      REMUS_ASSERT(!v.has_value(), "Get of removed key {} succeeded", k);
+    } else {
+      REMUS_ASSERT(v.has_value() && *v == k * 3, "Get of {} failed", k);
+    }
+  }
+  t->arrive_control_barrier(total_threads);
+}
+
+void big_values(std::shared_ptr<remus::ComputeThread> t,
+                remus::rdma_ptr<big_map_t::dir_t> d,
+                uint64_t uid, uint64_t keys, uint64_t total_threads) {
+  big_map_t map(t.get(), d);
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = uid; k < keys; k += total_threads) {
+    REMUS_ASSERT(map.Insert(k, big_t{k, k, k, k}), "Insert of {} failed", k);
+  }
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = uid; k < keys; k += total_threads) {
+    REMUS_ASSERT(map.Update(k, big_t{k, 1, 2, 3}), "Update of {} failed", k);
+  }
+  t->arrive_control_barrier(total_threads);
+  for (uint64_t k = 0; k < keys; ++k) {
+    auto v = map.Get(k);
+    REMUS_ASSERT(v.has_value() && *v == (big_t{k, 1, 2, 3}),
+                 "Get of {} failed", k);
+  }
+  t->arrive_control_barrier(total_threads);
+  // No thread is reading the replaced values any more
+  t->ReclaimDeferred();
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    const uint64_t keys = 1024;
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the maps, and publishes them via the root
+    if (id == c0) {
+      auto &t = compute_threads[0];
+      uint64_t parts = (mn - m0 + 1) * args->uget(remus::SEGS_PER_MN);
+      auto maps = t->allocate<maps_t>();
+      t->Write<maps_t>(maps,
+                       maps_t{small_map_t::New(t.get(), keys, parts).raw(),
+                              big_map_t::New(t.get(), keys, parts).raw()});
+      t->set_root(maps);
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        auto maps = t->Read<maps_t>(t->get_root<maps_t>());
+        small_values(t, remus::rdma_ptr<small_map_t::dir_t>(maps.small_), uid,
+                     keys, total_threads);
+        big_values(t, remus::rdma_ptr<big_map_t::dir_t>(maps.big_), uid, keys,
+                   total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("HashMap test passed");
+}
@@ -0,0 +1,82 @@
+#include <memory>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/logging.h>
+#include <remus/qp_sched_pol.h>
+#include <remus/util.h>
+
+using remus::internal::lane_counter_t;
+using remus::internal::QpSchedPolicy;
+
+/// The number of lanes to each MemoryNode
+constexpr uint64_t kLanes = 4;
+
+/// The number of ComputeThreads
+constexpr uint64_t kThreads = 2;
+
+/// The number of MemoryNodes (ids 1 and 2)
+constexpr uint64_t kMns = 2;
+
+/// The number of picks to sample for P2C
+constexpr uint64_t kPicks = 4000;
+
+int main() {
+  remus::INIT();
+
+  // The policies only need the shape of the run, so make one up
+  const char *argv[] = {"qp_sched_test", "--node-id",     "0",
+                        "--first-mn-id", "1",             "--last-mn-id",
+                        "2",             "--first-cn-id", "0",
+                        "--last-cn-id",  "0",             "--mn-port",
+                        "1",             "--cn-threads",  "2",
+                        "--qp-lanes",    "4"};
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(sizeof(argv) / sizeof(argv[0]), (char **)argv);
+
+  // Thread 1's lanes to MemoryNode m are at ((m - 1) * kThreads + 1) * kLanes
+  std::vector<lane_counter_t> loads(kMns * kThreads * kLanes);
+  auto lanes = [&](uint64_t mn) {
+    return &loads[((mn - 1) * kThreads + 1) * kLanes];
+  };
+
+  // LEAST_LOADED picks the idle lane, and rotates among equally idle lanes
+  QpSchedPolicy least(args);
+  least.set_policy(QpSchedPolicy::to_policy("LEAST_LOADED"), 1);
+  least.set_loads(lanes(1), kThreads * kLanes);
+  uint64_t busy[] = {3, 1, 0, 2};
+  for (uint64_t i = 0; i < kLanes; ++i) {
+    lanes(2)[i].ops_ = busy[i];
+  }
+  for (uint64_t i = 0; i < 10; ++i) {
+    auto lane = least.get_lane_idx(2);
+    REMUS_ASSERT(lane == 2, "LEAST_LOADED picked lane {} (load {})", lane,
+                 busy[lane]);
+  }
+  std::vector<uint64_t> seen(kLanes);
+  for (uint64_t i = 0; i < kLanes; ++i) {
+    ++seen[least.get_lane_idx(1)];
+  }
+  for (uint64_t i = 0; i < kLanes; ++i) {
+    REMUS_ASSERT(seen[i] == 1, "LEAST_LOADED picked idle lane {} {} times", i,
+                 seen[i]);
+  }
+
+  // P2C picks the least loaded lane whenever it samples it (7/16 of the time),
+  // and the most loaded only when it samples it twice (1/16 of the time)
+  QpSchedPolicy p2c(args);
+  p2c.set_policy(QpSchedPolicy::to_policy("P2C"), 1);
+  p2c.set_loads(lanes(1), kThreads * kLanes);
+  std::vector<uint64_t> picks(kLanes);
+  for (uint64_t i = 0; i < kPicks; ++i) {
+    ++picks[p2c.get_lane_idx(2)];
+  }
+  REMUS_ASSERT(picks[2] > kPicks * 3 / 10, "P2C picked the idle lane {} times",
+               picks[2]);
+  REMUS_ASSERT(picks[0] < kPicks * 3 / 20,
+               "P2C picked the busiest lane {} times", picks[0]);
+
+  REMUS_INFO("QpSchedPolicy test passed");
+}
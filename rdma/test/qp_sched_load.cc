@@ -0,0 +1,150 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of fenced writes that pile up on one lane
+constexpr uint64_t kPiled = 50;
+
+/// The number of unsignaled writes issued while that lane is loaded
+constexpr uint64_t kWrites = 64;
+
+/// Return the number of work requests that thread t has in flight on each of
+/// its lanes to a MemoryNode
+std::vector<uint64_t> loads(std::shared_ptr<remus::ComputeNode> cn,
+                            std::shared_ptr<remus::ComputeThread> t,
+                            uint16_t mn, uint64_t lanes) {
+  std::vector<uint64_t> ops;
+  for (uint64_t l = 0; l < lanes; ++l) {
+    ops.push_back(cn->lane_ops(mn, t->get_tid())[l].ops_);
+  }
+  return ops;
+}
+
+// Pile a Batch's fenced writes onto one lane, which fences keep in one chain,
+// and then issue unsignaled writes to the same MemoryNode.  LEAST_LOADED must
+// steer every one of them away from the loaded lane, which RR would give a
+// 1/lanes share.
+void check_least_loaded(std::shared_ptr<remus::ComputeNode> cn,
+                        std::shared_ptr<remus::ComputeThread> t,
+                        uint64_t lanes, size_t total_threads) {
+  t->arrive_control_barrier(total_threads);
+  auto obj = t->allocate<uint64_t>();
+  auto b = t->batch(kPiled + 1, false);
+  b.Write(obj, uint64_t(0));
+  for (uint64_t i = 1; i <= kPiled; ++i) {
+    b.Write(obj, i, true);
+  }
+  auto before = loads(cn, t, obj.id(), lanes);
+  uint64_t piled = 0;
+  for (uint64_t l = 1; l < lanes; ++l) {
+    piled = before[l] > before[piled] ? l : piled;
+  }
+  REMUS_ASSERT(before[piled] == kPiled + 1, "Lane {} holds {} of {} writes",
+               piled, before[piled], kPiled + 1);
+
+  auto other = t->allocate<uint64_t>();
+  for (uint64_t i = 0; i < kWrites; ++i) {
+    t->WriteUnsignaled(other, i, false, sizeof(uint64_t), false);
+  }
+  auto after = loads(cn, t, obj.id(), lanes);
+  REMUS_ASSERT(after[piled] == before[piled],
+               "LEAST_LOADED put {} writes on the loaded lane {}",
+               after[piled] - before[piled], piled);
+
+  b.Execute();
+  t->Flush();
+  for (auto l : loads(cn, t, obj.id(), lanes)) {
+    REMUS_ASSERT(l == 0, "{} writes are still counted", l);
+  }
+  REMUS_ASSERT(t->Read(obj) == kPiled, "Fenced writes landed out of order");
+  REMUS_ASSERT(t->Read(other) == kWrites - 1, "Unsignaled write lost");
+  t->deallocate(other);
+  t->deallocate(obj);
+  t->arrive_control_barrier(total_threads);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments, with LEAST_LOADED in place of the
+  // requested QP scheduling policy
+  std::vector<char *> argv_ll(argv, argv + argc);
+  std::string flag = remus::QP_SCHED_POL, pol = "LEAST_LOADED";
+  argv_ll.push_back(flag.data());
+  argv_ll.push_back(pol.data());
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argv_ll.size(), argv_ll.data());
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+  uint64_t lanes = args->uget(remus::QP_LANES);
+  REMUS_ASSERT(lanes > 1, "Pass {} of at least 2", remus::QP_LANES);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (auto &t : compute_threads) {
+      worker_threads.push_back(std::thread([&, t]() {
+        check_least_loaded(compute_node, t, lanes, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("QpSchedPolicy load test passed");
+}
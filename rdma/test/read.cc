@@ -17,6 +17,7 @@
 #include <remus/compute_node.h>
 #include <remus/logging.h>
 #include <remus/mem_node.h>
+#include <remus/metrics.h>
 #include <remus/simple_async_compute_thread.h>
 #include <remus/util.h>
 
@@ -232,6 +233,47 @@ void async_read_seq_zero_copy(
   t->arrive_control_barrier(total_threads);
 }
 
+// Every spawned coroutine alternates between a ReadAsync and a one-op
+// ReadSeqAsync, so that each has one op in flight and its own seq state
+void scheduled_read(remus::rdma_ptr<size_t> ptr,
+                    std::shared_ptr<remus::SimpleAsyncComputeThread> t,
+                    size_t num_ops, size_t num_coros, size_t total_threads) {
+  std::vector<size_t> reads(num_coros, 0);
+  t->arrive_control_barrier(total_threads);
+  for (size_t c = 0; c < num_coros; c++) {
+    t->Spawn([&, c]() -> remus::AsyncResultVoid {
+      for (size_t i = c; i < num_ops; i += num_coros) {
+        if (i % 2 == 0) {
+          auto res = t->ReadAsync<size_t>(ptr);
+          while (!res.get_ready()) {
+            co_yield std::suspend_always();
+            res.resume();
+          }
+          REMUS_ASSERT(res.get_value() == 42, "value read not match");
+        } else {
+          auto res = t->ReadSeqAsync<size_t>(ptr, true, true);
+          while (!res.get_ready()) {
+            co_yield std::suspend_always();
+            res.resume();
+          }
+          auto result = res.get_value().value();
+          REMUS_ASSERT(result.size() == 1 && result[0] == 42,
+                       "value read not match");
+        }
+        reads[c]++;
+      }
+    });
+  }
+  t->Run();
+  t->arrive_control_barrier(total_threads);
+  size_t total = 0;
+  for (auto r : reads) {
+    total += r;
+  }
+  REMUS_ASSERT(total == num_ops, "scheduled reads did not all run");
+  t->arrive_control_barrier(total_threads);
+}
+
 
 int main(int argc, char **argv) {
   remus::INIT();
@@ -323,11 +365,22 @@ int main(int argc, char **argv) {
             async_read_seq_zero_copy(root, t, num_ops, num_groups, total_threads);
             REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
         }
+        scheduled_read(root, t, num_ops, t->max_spawned(), total_threads);
+        REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
       }));
     }
     for (auto &t : worker_threads) {
       t.join();
     }
+    // Every thread did at least num_ops synchronous Reads
+    remus::Metrics metrics;
+    for (auto &t : compute_threads) {
+      metrics.merge(t->metrics_);
+    }
+    REMUS_ASSERT(metrics.op(remus::Metrics::READ).ops_ >=
+                     num_ops * compute_threads.size(),
+                 "Read metrics missed some Reads");
+    REMUS_INFO("Read metrics: {}", metrics.to_json());
   }
   REMUS_INFO("Read test passed");
 }
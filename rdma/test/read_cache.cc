@@ -0,0 +1,242 @@
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/read_cache.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of immutable objects that every thread reads
+constexpr uint64_t kObjs = 64;
+
+/// The number of times the versioned object changes
+constexpr uint64_t kRounds = 16;
+
+/// An object that never changes after it is written
+struct pair_t {
+  uint64_t a_;
+  uint64_t b_;
+};
+
+/// An object whose first 8 bytes are its version (odd while it is changing)
+struct versioned_t {
+  uint64_t version_;
+  std::array<uint64_t, 3> data_;
+};
+
+/// The (raw) objects that every thread reads
+struct objs_t {
+  uint64_t pairs_;
+  uint64_t versioned_;
+  uint64_t racy_;
+  uint64_t small_;
+};
+
+/// Check that the cache evicts objects to stay within its budget, and skips
+/// objects that are too big for it
+void check_eviction() {
+  // NB: Every shard has room for one 16-byte object
+  remus::internal::ReadCache cache(64 * 16);
+  pair_t p{1, 2};
+  uint64_t version = 0;
+  cache.put(7, &p, sizeof(p), 3);
+  REMUS_ASSERT(cache.get(7, &p, sizeof(p), version) && version == 3,
+               "A cached object was not found");
+  REMUS_ASSERT(!cache.get(7, &p, sizeof(p) / 2, version),
+               "A cached object was found with the wrong size");
+  cache.erase(7);
+  REMUS_ASSERT(!cache.get(7, &p, sizeof(p), version),
+               "An erased object was found");
+  std::array<uint64_t, 3> big{};
+  cache.put(8, &big, sizeof(big), 0);
+  REMUS_ASSERT(!cache.get(8, &big, sizeof(big), version),
+               "An object bigger than a shard was cached");
+  uint64_t found = 0;
+  for (uint64_t i = 0; i < 1024; ++i) {
+    cache.put(i * 64, &p, sizeof(p), 0);
+  }
+  for (uint64_t i = 0; i < 1024; ++i) {
+    found += cache.get(i * 64, &p, sizeof(p), version) ? 1 : 0;
+  }
+  REMUS_ASSERT(found > 0 && found <= 64, "{} objects fit in 64 slots", found);
+}
+
+// NB: The counters are only checked if the node has a cache (--cn-cache-size)
+void check_reads(std::shared_ptr<remus::ComputeThread> t, objs_t objs,
+                 uint64_t uid, uint64_t total_threads, bool cached) {
+  auto pairs = remus::rdma_ptr<pair_t>(objs.pairs_);
+  auto vptr = remus::rdma_ptr<versioned_t>(objs.versioned_);
+  auto small = remus::rdma_ptr<uint32_t>(objs.small_);
+
+  // Immutable objects are only read once (per node), even if they are smaller
+  // than a version would be
+  for (uint64_t pass = 0; pass < 2; ++pass) {
+    for (uint64_t i = 0; i < kObjs; ++i) {
+      auto p = t->CachedRead(pairs + i);
+      REMUS_ASSERT(p.a_ == i && p.b_ == i * 2, "Object {} is wrong", i);
+      auto s = t->CachedRead(small + i);
+      REMUS_ASSERT(s == uint32_t(i * 3), "Small object {} is {}", i, s);
+    }
+  }
+  if (cached) {
+    REMUS_ASSERT(t->metrics_.cache().hits_ >= 2 * kObjs,
+                 "Only {} of {} reads hit the cache",
+                 t->metrics_.cache().hits_, 2 * kObjs);
+  }
+
+  // Versioned objects are re-read when the remote version changes
+  for (uint64_t r = 1; r <= kRounds; ++r) {
+    if (uid == 0) {
+      t->Write(vptr, versioned_t{2 * r, {r, r, r}});
+    }
+    t->arrive_control_barrier(total_threads);
+    for (uint64_t i = 0; i < 2; ++i) {
+      auto v = t->CachedRead<remus::VERSIONED>(vptr);
+      REMUS_ASSERT(v.version_ == 2 * r && v.data_[0] == r && v.data_[2] == r,
+                   "Round {} read version {}", r, v.version_);
+    }
+    t->arrive_control_barrier(total_threads);
+  }
+  // NB: With more threads, another thread may always refresh the copy first
+  if (cached && total_threads == 1) {
+    REMUS_ASSERT(t->metrics_.cache().stale_ == kRounds - 1,
+                 "{} cached copies went stale", t->metrics_.cache().stale_);
+  }
+}
+
+/// Check that reads which race with updates to a versioned object never get a
+/// torn copy, whether from the RDMA heap or from the cache
+void check_racy_reads(std::shared_ptr<remus::ComputeThread> t, objs_t objs,
+                      uint64_t uid, uint64_t total_threads) {
+  auto vptr = remus::rdma_ptr<versioned_t>(objs.racy_);
+  auto version = remus::rdma_ptr<uint64_t>(objs.racy_);
+  auto data = remus::rdma_ptr<std::array<uint64_t, 3>>(
+      objs.racy_ + offsetof(versioned_t, data_));
+  t->arrive_control_barrier(total_threads);
+  if (uid == 0) {
+    // Update the object like a seqlock, while the other threads read it
+    for (uint64_t r = 1; r <= kRounds * 64; ++r) {
+      t->Write(version, 2 * r - 1);
+      t->Write(data, std::array<uint64_t, 3>{r, r, r});
+      t->Write(version, 2 * r);
+    }
+  } else {
+    uint64_t last = 0;
+    while (last < kRounds * 64) {
+      auto v = t->CachedRead<remus::VERSIONED>(vptr);
+      uint64_t r = v.version_ / 2;
+      REMUS_ASSERT((v.version_ & 1) == 0 && v.data_[0] == r &&
+                       v.data_[1] == r && v.data_[2] == r,
+                   "Read a torn copy of version {}", v.version_);
+      REMUS_ASSERT(r >= last, "Version {} went back to {}", last, r);
+      last = r;
+    }
+  }
+  t->arrive_control_barrier(total_threads);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  check_eviction();
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the objects, and publishes them via the
+    // root
+    if (id == c0) {
+      auto &t = compute_threads[0];
+      auto pairs = t->allocate<pair_t>(kObjs);
+      for (uint64_t i = 0; i < kObjs; ++i) {
+        t->Write(pairs + i, pair_t{i, i * 2});
+      }
+      auto vptr = t->allocate<versioned_t>();
+      t->Write(vptr, versioned_t{0, {0, 0, 0}});
+      auto racy = t->allocate<versioned_t>();
+      t->Write(racy, versioned_t{0, {0, 0, 0}});
+      auto small = t->allocate<uint32_t>(kObjs);
+      for (uint64_t i = 0; i < kObjs; ++i) {
+        t->Write(small + i, uint32_t(i * 3));
+      }
+      auto objs = t->allocate<objs_t>();
+      t->Write(objs,
+               objs_t{pairs.raw(), vptr.raw(), racy.raw(), small.raw()});
+      t->set_root(objs);
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        auto objs = t->Read<objs_t>(t->get_root<objs_t>());
+        check_reads(t, objs, uid, total_threads,
+                    compute_node->read_cache() != nullptr);
+        check_racy_reads(t, objs, uid, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("ReadCache test passed");
+}
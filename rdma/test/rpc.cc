@@ -0,0 +1,184 @@
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The RPC handlers that every MemoryNode registers
+enum rpc_op_t : uint32_t { ECHO_INC, ADD, COUNT, BIG };
+
+/// A request with more than one field
+struct pair_t {
+  uint64_t a_;
+  uint64_t b_;
+};
+
+/// A response that fills a good part of a batch
+using big_t = std::array<uint64_t, 64>;
+
+/// The number of RPCs that each thread issues before it claims any of them
+constexpr uint64_t kRpcs = 1000;
+
+/// A coroutine that does nothing but co_await, so that the awaitable path of
+/// rpc_result_t can be tested without a scheduler
+struct detached_t {
+  struct promise_type {
+    detached_t get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+detached_t await_add(remus::ComputeThread *t, uint16_t mn, uint64_t a,
+                     uint64_t *out) {
+  *out = co_await t->Rpc<uint64_t>(mn, ADD, pair_t{a, a});
+}
+
+void check_rpcs(std::shared_ptr<remus::ComputeThread> t, uint64_t m0,
+                uint64_t mn, uint64_t uid) {
+  for (uint64_t m = m0; m <= mn; ++m) {
+    // Issue many RPCs before claiming any, so that they share batches
+    std::vector<remus::ComputeThread::rpc_result_t<uint64_t>> echoes;
+    for (uint64_t i = 0; i < kRpcs; ++i) {
+      echoes.push_back(t->Rpc<uint64_t>(m, ECHO_INC, uid * kRpcs + i));
+    }
+    for (uint64_t i = 0; i < kRpcs; ++i) {
+      auto v = echoes[i].get();
+      REMUS_ASSERT(v == uid * kRpcs + i + 1, "Echo {} returned {}", i, v);
+    }
+
+    // Responses of different types can share a batch, and a result can be
+    // polled until it is ready
+    auto sum = t->Rpc<uint64_t>(m, ADD, pair_t{uid, 7});
+    auto big = t->Rpc<big_t>(m, BIG, uid);
+    t->RpcFlush();
+    while (!sum.ready()) {
+    }
+    REMUS_ASSERT(sum.get() == uid + 7, "Add returned the wrong sum");
+    auto b = big.get();
+    for (uint64_t i = 0; i < b.size(); ++i) {
+      REMUS_ASSERT(b[i] == uid + i, "Big response is wrong at {}", i);
+    }
+
+    // Results can be dropped without being claimed
+    for (uint64_t i = 0; i < kRpcs; ++i) {
+      t->Rpc<uint64_t>(m, COUNT, uint64_t(1));
+    }
+
+    // Results can be co_awaited
+    uint64_t out = 0;
+    await_add(t.get(), m, uid, &out);
+    REMUS_ASSERT(out == uid * 2, "co_await of an RPC returned {}", out);
+  }
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // The number of COUNT RPCs this MemoryNode has served
+  std::atomic<uint64_t> counted{0};
+
+  // Memory Node configuration must come first!  Its RPC handlers must be
+  // registered before init_done().
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+    memory_node->RegisterRpc<uint64_t, uint64_t>(
+        ECHO_INC, [](uint64_t v) { return v + 1; });
+    memory_node->RegisterRpc<pair_t, uint64_t>(
+        ADD, [](const pair_t &p) { return p.a_ + p.b_; });
+    memory_node->RegisterRpc<uint64_t, uint64_t>(
+        COUNT, [&](uint64_t v) { return counted.fetch_add(v); });
+    memory_node->RegisterRpc<uint64_t, big_t>(BIG, [](uint64_t v) {
+      big_t b;
+      for (uint64_t i = 0; i < b.size(); ++i) {
+        b[i] = v + i;
+      }
+      return b;
+    });
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys, memory_node->rpc_server());
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_rpcs(t, m0, mn, uid);
+        t->arrive_control_barrier(total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+
+  // Every thread's COUNT RPCs reached every MemoryNode, though nobody claimed
+  // their results
+  if (memory_node) {
+    compute_threads.clear();
+    compute_node.reset();
+    memory_node.reset();
+    REMUS_ASSERT(counted == total_threads * kRpcs, "{} COUNT RPCs, not {}",
+                 counted.load(), total_threads * kRpcs);
+  }
+  REMUS_INFO("RPC test passed");
+}
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/simple_async_compute_thread.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The RPC handlers that every MemoryNode registers
+enum rpc_op_t : uint32_t { ECHO_INC, ADD };
+
+/// A request with more than one field
+struct pair_t {
+  uint64_t a_;
+  uint64_t b_;
+};
+
+/// The number of RPCs that each coroutine awaits, per MemoryNode
+constexpr uint64_t kRounds = 64;
+
+// A Task that awaits two RPCs, for composing into the spawned coroutines
+remus::Task<uint64_t>
+inc_then_add(std::shared_ptr<remus::SimpleAsyncComputeThread> t, uint16_t mn,
+             uint64_t v) {
+  auto inc = co_await t->Rpc<uint64_t>(mn, ECHO_INC, v);
+  co_return co_await t->Rpc<uint64_t>(mn, ADD, pair_t{inc, v});
+}
+
+// Every spawned coroutine awaits its own stream of RPCs to each MemoryNode.
+// The coroutines must not wait for each other's responses: each one issues its
+// first RPC before any response arrives, so all of them share a batch.
+void awaited_rpcs(std::shared_ptr<remus::SimpleAsyncComputeThread> t,
+                  uint64_t m0, uint64_t mn, uint64_t uid,
+                  size_t total_threads) {
+  size_t num_coros = t->max_spawned();
+  uint64_t issued = 0;
+  std::vector<uint64_t> done(num_coros, 0);
+  t->arrive_control_barrier(total_threads);
+  for (size_t c = 0; c < num_coros; c++) {
+    t->Spawn([=, &issued, &done]() -> remus::Task<> {
+      for (uint64_t m = m0; m <= mn; ++m) {
+        for (uint64_t i = 0; i < kRounds; ++i) {
+          uint64_t v = (uid * num_coros + c) * kRounds + i;
+          ++issued;
+          auto r = co_await t->Rpc<uint64_t>(m, ECHO_INC, v);
+          REMUS_ASSERT(r == v + 1, "Echo of {} returned {}", v, r);
+          if (m == m0 && i == 0) {
+            REMUS_ASSERT(issued >= num_coros,
+                         "Coroutine {} resumed after {} of {} RPCs were "
+                         "issued",
+                         c, issued, num_coros);
+          }
+          r = co_await inc_then_add(t, m, v);
+          REMUS_ASSERT(r == 2 * v + 1, "Add of {} returned {}", v, r);
+          done[c]++;
+        }
+      }
+    });
+  }
+  t->Run();
+  for (size_t c = 0; c < num_coros; c++) {
+    REMUS_ASSERT(done[c] == (mn - m0 + 1) * kRounds,
+                 "Coroutine {} finished {} rounds", c, done[c]);
+  }
+  t->arrive_control_barrier(total_threads);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!  Its RPC handlers must be
+  // registered before init_done().
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+    memory_node->RegisterRpc<uint64_t, uint64_t>(
+        ECHO_INC, [](uint64_t v) { return v + 1; });
+    memory_node->RegisterRpc<pair_t, uint64_t>(
+        ADD, [](const pair_t &p) { return p.a_ + p.b_; });
+  }
+
+  // Configure this to be a Compute Node?
+  //
+  // NB: The co-located MemoryNode's handlers are not passed to connect_local(),
+  //     so that its RPCs are sent as messages too (over the loopback QPs, or
+  //     the SHM channel), like those to remote MemoryNodes
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::SimpleAsyncComputeThread>>
+      compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::SimpleAsyncComputeThread>(id, compute_node,
+                                                            args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        awaited_rpcs(t, m0, mn, uid, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Awaited RPC test passed");
+}
@@ -0,0 +1,201 @@
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of entries in each thread's log
+constexpr uint64_t kEntries = 1000;
+
+/// The number of times each thread rewrites its whole log
+constexpr uint64_t kRounds = 5;
+
+/// A log entry that is too big to send inline, so it needs staging
+struct entry_t {
+  uint64_t round_;
+  uint64_t idx_;
+  uint64_t pad_[14];
+};
+
+/// A write that fills a good part of a thread's staging buffers
+struct blob_t {
+  uint8_t bytes_[1 << 16];
+};
+
+/// The state of each thread: a version stamp, and a log
+struct log_t {
+  uint64_t version_;
+  entry_t entries_[kEntries];
+};
+
+/// Return the number of work requests that thread t has in flight to a
+/// MemoryNode, according to its lanes
+uint64_t in_flight(std::shared_ptr<remus::ComputeNode> cn,
+                   std::shared_ptr<remus::ComputeThread> t, uint16_t mn,
+                   uint64_t lanes) {
+  uint64_t wrs = 0;
+  for (uint64_t l = 0; l < lanes; ++l) {
+    wrs += cn->lane_ops(mn, t->get_tid())[l].ops_;
+  }
+  return wrs;
+}
+
+void check_unsignaled(std::shared_ptr<remus::ComputeNode> cn,
+                      std::shared_ptr<remus::ComputeThread> t,
+                      std::shared_ptr<remus::ArgMap> args,
+                      remus::rdma_ptr<uint64_t> logs,
+                      uint64_t uid, uint64_t total_threads) {
+  uint64_t lanes = args->uget(remus::QP_LANES);
+  auto mine = t->allocate<log_t>();
+  t->Write(remus::rdma_ptr<uint64_t>(logs.raw() + uid * sizeof(uint64_t)),
+           mine.raw());
+  auto version =
+      remus::rdma_ptr<uint64_t>(mine.raw() + offsetof(log_t, version_));
+  auto entry = [&](uint64_t i) {
+    return remus::rdma_ptr<entry_t>(mine.raw() + offsetof(log_t, entries_) +
+                                    i * sizeof(entry_t));
+  };
+
+  // Stream the log and a version stamp after each entry, then publish them.
+  // Memory on this node would be written directly, so force the QP path.
+  for (uint64_t r = 1; r <= kRounds; ++r) {
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      t->WriteUnsignaled(entry(i), entry_t{r, i, {}}, false, sizeof(entry_t),
+                         false);
+      t->WriteUnsignaled(version, r * kEntries + i, false, sizeof(uint64_t),
+                         false);
+    }
+  }
+  // The writes that no completion covers yet stay counted on their lanes
+  REMUS_ASSERT(in_flight(cn, t, mine.id(), lanes) > 0,
+               "Unsignaled writes are not counted on their lanes");
+  t->Flush();
+  REMUS_ASSERT(in_flight(cn, t, mine.id(), lanes) == 0,
+               "{} writes are still counted after Flush()",
+               in_flight(cn, t, mine.id(), lanes));
+  REMUS_ASSERT(t->Read(version) == kRounds * kEntries + kEntries - 1,
+               "Version is {}", t->Read(version));
+
+  // Unsignaled writes hold most of the staging buffers, so the staged read
+  // after them must flush them to make room
+  auto blob = t->allocate<blob_t>();
+  auto val = std::make_unique<blob_t>();
+  uint64_t staging = (1ull << args->uget(remus::CN_THREAD_BUFSZ)) / 2;
+  for (uint64_t i = 0; i + 1 < staging / sizeof(blob_t); ++i) {
+    std::memset(val->bytes_, (int)i + 1, sizeof(blob_t));
+    t->WriteUnsignaled(blob, *val, false, sizeof(blob_t), false);
+  }
+  auto staged = t->Read(remus::rdma_ptr<log_t>(mine.raw()), true, false);
+  REMUS_ASSERT(staged.version_ == kRounds * kEntries + kEntries - 1,
+               "Staged read of version saw {}", staged.version_);
+  t->Flush();
+  auto b = t->Read(blob, true, false);
+  REMUS_ASSERT(b.bytes_[0] == val->bytes_[0] &&
+                   b.bytes_[sizeof(blob_t) - 1] == val->bytes_[0],
+               "Blob holds {}, not {}", b.bytes_[0], val->bytes_[0]);
+  t->deallocate(blob);
+  t->arrive_control_barrier(total_threads);
+
+  // Every thread's writes are visible to every other thread
+  for (uint64_t u = 0; u < total_threads; ++u) {
+    auto log = t->Read(
+        remus::rdma_ptr<uint64_t>(logs.raw() + u * sizeof(uint64_t)));
+    auto l = t->Read(remus::rdma_ptr<log_t>(log));
+    REMUS_ASSERT(l.version_ == kRounds * kEntries + kEntries - 1,
+                 "Thread {} version is {}", u, l.version_);
+    for (uint64_t i = 0; i < kEntries; ++i) {
+      REMUS_ASSERT(l.entries_[i].round_ == kRounds && l.entries_[i].idx_ == i,
+                   "Thread {} entry {} is ({}, {})", u, i, l.entries_[i].round_,
+                   l.entries_[i].idx_);
+    }
+  }
+  t->arrive_control_barrier(total_threads);
+  t->deallocate(mine);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    // The first compute node makes the table of (raw pointers to) logs, and
+    // publishes it via the root
+    if (id == c0) {
+      auto &t = compute_threads[0];
+      t->set_root(t->allocate<uint64_t>(total_threads));
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_unsignaled(compute_node, t, args, t->get_root<uint64_t>(), uid,
+                         total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Unsignaled write test passed");
+}
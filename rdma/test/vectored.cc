@@ -0,0 +1,150 @@
+#include <cstring>
+#include <memory>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+#include <remus/cfg.h>
+#include <remus/cli.h>
+#include <remus/compute_node.h>
+#include <remus/compute_thread.h>
+#include <remus/logging.h>
+#include <remus/mem_node.h>
+#include <remus/util.h>
+
+#include "cloudlab.h"
+
+/// The number of pieces in each record, which is more than fit in one work
+/// request
+constexpr uint64_t kPieces = 3 * remus::internal::kMaxSge + 5;
+
+/// The size of the largest piece
+constexpr uint64_t kMaxPiece = 24;
+
+/// The number of records that each thread writes and reads
+constexpr uint64_t kRounds = 50;
+
+void check_vectored(std::shared_ptr<remus::ComputeThread> t, uint64_t uid,
+                    uint64_t total_threads) {
+  // Odd pieces are in registered memory, even pieces are not
+  std::vector<uint8_t> heap(kPieces * kMaxPiece);
+  auto *reg = t->local_allocate<uint8_t>(kPieces * kMaxPiece);
+  std::vector<iovec> iov(kPieces);
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < kPieces; ++i) {
+    auto *base = i % 2 ? reg : heap.data();
+    // Some pieces are empty
+    iov[i] = {base + i * kMaxPiece, (i * 7 + uid) % (kMaxPiece + 1)};
+    size += iov[i].iov_len;
+  }
+  auto rec = t->allocate<uint8_t>(size);
+
+  t->arrive_control_barrier(total_threads);
+  std::vector<uint8_t> expect(size), got(size);
+  for (uint64_t r = 0; r < kRounds; ++r) {
+    uint64_t off = 0;
+    for (uint64_t i = 0; i < kPieces; ++i) {
+      for (uint64_t b = 0; b < iov[i].iov_len; ++b) {
+        auto v = uint8_t(r * 31 + i * 5 + b + uid);
+        ((uint8_t *)iov[i].iov_base)[b] = v;
+        expect[off++] = v;
+      }
+    }
+    // Memory on this node is copied directly unless local_copy is false, so
+    // alternate between that and the QP path
+    bool local = r % 2;
+    t->WriteV(rec, iov, true, local);
+
+    // The record is contiguous in the RDMA heap
+    iovec whole{got.data(), size};
+    t->ReadV(rec, std::span<const iovec>(&whole, 1), true, !local);
+    REMUS_ASSERT(got == expect, "Round {}: WriteV record is wrong", r);
+
+    // Scatter it back into the pieces
+    for (uint64_t i = 0; i < kPieces; ++i) {
+      std::memset(iov[i].iov_base, 0, iov[i].iov_len);
+    }
+    t->ReadV(rec, iov, true, local);
+    off = 0;
+    for (uint64_t i = 0; i < kPieces; ++i) {
+      REMUS_ASSERT(std::memcmp(iov[i].iov_base, expect.data() + off,
+                               iov[i].iov_len) == 0,
+                   "Round {}: ReadV piece {} is wrong", r, i);
+      off += iov[i].iov_len;
+    }
+  }
+  t->arrive_control_barrier(total_threads);
+  t->deallocate(rec, size);
+  t->local_deallocate(reg);
+}
+
+int main(int argc, char **argv) {
+  remus::INIT();
+
+  // Configure and parse the arguments
+  auto args = std::make_shared<remus::ArgMap>();
+  args->import(remus::ARGS);
+  args->parse(argc, argv);
+
+  // Extract the args we need in EVERY node
+  uint64_t id = args->uget(remus::NODE_ID);
+  uint64_t m0 = args->uget(remus::FIRST_MN_ID);
+  uint64_t mn = args->uget(remus::LAST_MN_ID);
+  uint64_t c0 = args->uget(remus::FIRST_CN_ID);
+  uint64_t cn = args->uget(remus::LAST_CN_ID);
+
+  // prepare network information about this machine and about memnodes
+  remus::MachineInfo self(id, id_to_dns_name(id));
+  std::vector<remus::MachineInfo> memnodes;
+  for (uint64_t i = m0; i <= mn; ++i) {
+    memnodes.emplace_back(i, id_to_dns_name(i));
+  }
+
+  // Information needed if this machine will operate as a memory node
+  std::unique_ptr<remus::MemoryNode> memory_node;
+
+  // Information needed if this machine will operate as a compute node
+  std::shared_ptr<remus::ComputeNode> compute_node;
+
+  // Memory Node configuration must come first!
+  if (id >= m0 && id <= mn) {
+    memory_node.reset(new remus::MemoryNode(self, args));
+  }
+
+  // Configure this to be a Compute Node?
+  if (id >= c0 && id <= cn) {
+    compute_node.reset(new remus::ComputeNode(self, args));
+    if (memory_node.get() != nullptr) {
+      auto rkeys = memory_node->get_local_rkeys();
+      compute_node->connect_local(memnodes, rkeys);
+    }
+    compute_node->connect_remote(memnodes);
+  }
+
+  if (memory_node) {
+    memory_node->init_done();
+  }
+
+  std::vector<std::shared_ptr<remus::ComputeThread>> compute_threads;
+  uint64_t threads = args->uget(remus::CN_THREADS);
+  uint64_t total_threads = (cn - c0 + 1) * threads;
+  if (id >= c0 && id <= cn) {
+    for (uint64_t i = 0; i < threads; ++i) {
+      compute_threads.push_back(
+          std::make_shared<remus::ComputeThread>(id, compute_node, args));
+    }
+    std::vector<std::thread> worker_threads;
+    for (uint64_t i = 0; i < threads; ++i) {
+      worker_threads.push_back(std::thread([&, i]() {
+        auto &t = compute_threads[i];
+        uint64_t uid = (id - c0) * threads + i;
+        t->arrive_control_barrier(total_threads);
+        check_vectored(t, uid, total_threads);
+      }));
+    }
+    for (auto &t : worker_threads) {
+      t.join();
+    }
+  }
+  REMUS_INFO("Vectored read/write test passed");
+}
@@ -261,6 +261,50 @@ void async_write_seq_zero_copy(
   compute_thread->local_deallocate(local_alloc);
   compute_thread->arrive_control_barrier(total_threads);
 }
+// A Task that writes a value and then reads it back, for composing into the
+// coroutines of awaited_write
+remus::Task<uint64_t>
+write_then_read(std::shared_ptr<remus::SimpleAsyncComputeThread> t,
+                remus::rdma_ptr<uint64_t> ptr, uint64_t val, bool local_copy) {
+  co_await t->WriteAwait<uint64_t>(ptr, val, true, sizeof(uint64_t),
+                                   local_copy);
+  co_return co_await t->ReadAwait<uint64_t>(ptr, false, local_copy);
+}
+
+// NB: With local_copy, ops on a co-located MemoryNode complete without RDMA,
+//     so the awaitables never suspend
+void awaited_write(
+    std::shared_ptr<remus::SimpleAsyncComputeThread> compute_thread,
+    const uint64_t num_ops, remus::rdma_ptr<uint64_t> ptr,
+    size_t total_threads, bool local_copy) {
+  init_write(compute_thread, num_ops, ptr, total_threads);
+  compute_thread->arrive_control_barrier(total_threads);
+  size_t num_coros = compute_thread->max_spawned();
+  for (size_t c = 0; c < num_coros; c++) {
+    compute_thread->Spawn([=]() mutable -> remus::Task<> {
+      for (size_t i = c; i < num_ops; i += num_coros) {
+        auto val =
+            co_await write_then_read(compute_thread, ptr + i, i, local_copy);
+        REMUS_ASSERT(val == i, "Write value mismatch");
+        // Every thread writes the same values, so these must not change them
+        auto old = co_await compute_thread->FetchAndAddAwait<uint64_t>(
+            ptr + i, 0, true, local_copy);
+        REMUS_ASSERT(old == i, "FetchAndAdd value mismatch");
+        old = co_await compute_thread->CompareAndSwapAwait<uint64_t>(
+            ptr + i, i, i, true, local_copy);
+        REMUS_ASSERT(old == i, "CompareAndSwap value mismatch");
+      }
+    });
+  }
+  compute_thread->Run();
+  compute_thread->arrive_control_barrier(total_threads);
+  for (size_t i = 0; i < num_ops; i++) {
+    REMUS_ASSERT(compute_thread->Read<uint64_t>(ptr + i) == i,
+                 "Write value mismatch");
+  }
+  compute_thread->arrive_control_barrier(total_threads);
+}
+
 int main(int argc, char **argv) {
   remus::INIT();
 
@@ -372,6 +416,10 @@ int main(int argc, char **argv) {
                                     total_threads);
           REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
         }
+        awaited_write(t, num_ops, root, total_threads, false);
+        REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
+        awaited_write(t, num_ops, root, total_threads, true);
+        REMUS_ASSERT(t->no_leak_detected(), "Leak detected");
       }));
     }
     for (auto &t : worker_threads) {